@@ -0,0 +1,250 @@
+/*
+ * Copyright (C) 2007 OpenedHand Ltd
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * Author:
+ *   Dodji Seketeli <dodji@openedhand.com>
+ */
+
+#include "xvplay-private.h"
+
+/*************************
+ * <frame pool>
+ * ***********************/
+
+/**
+ * allocate a page aligned buffer of at least a_len bytes for a_frame.
+ * If the pool wants huge pages, try a MAP_HUGETLB mapping first,
+ * then a transparent huge page hint.
+ * The buffer is touched once here, so that playback does not
+ * page fault on it later.
+ */
+enum bool_t
+frame_alloc_aligned (struct frame_pool_t *a_pool,
+                     struct frame_t *a_frame,
+                     unsigned a_len)
+{
+    unsigned long page_size=0, capacity=0 ;
+    void *buf=NULL ;
+
+    RETURN_VAL_IF_FAIL (a_pool && a_frame && a_len, FALSE) ;
+
+    if (a_pool->huge_pages) {
+        page_size = HUGE_PAGE_SIZE ;
+    } else {
+        page_size = sysconf (_SC_PAGESIZE) ;
+    }
+    capacity = (a_len + page_size - 1) & ~(page_size - 1) ;
+
+#ifdef MAP_HUGETLB
+    if (a_pool->huge_pages) {
+        buf = mmap (NULL, capacity, PROT_READ|PROT_WRITE,
+                    MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0) ;
+        if (buf != MAP_FAILED) {
+            a_frame->memory = FRAME_MEMORY_MMAP ;
+            goto out ;
+        }
+        LOG ("no hugetlbfs pages available, "
+             "falling back to transparent huge pages\n") ;
+        buf = NULL ;
+    }
+#endif
+    if (posix_memalign (&buf, page_size, capacity)) {
+        LOG_ERROR ("failed to allocate %lu bytes\n", capacity) ;
+        return FALSE ;
+    }
+#ifdef MADV_HUGEPAGE
+    if (a_pool->huge_pages) {
+        madvise (buf, capacity, MADV_HUGEPAGE) ;
+    }
+#endif
+    a_frame->memory = FRAME_MEMORY_HEAP ;
+
+out:
+    memset (buf, 0, capacity) ;
+    a_frame->buf = buf ;
+    a_frame->data = buf ;
+    a_frame->capacity = capacity ;
+    a_pool->nb_allocs++ ;
+    a_pool->nb_allocated_bytes += capacity ;
+    return TRUE ;
+}
+
+void
+frame_free_aligned (struct frame_pool_t *a_pool,
+                    struct frame_t *a_frame)
+{
+    RETURN_IF_FAIL (a_frame) ;
+
+    switch (a_frame->memory) {
+        case FRAME_MEMORY_HEAP:
+            free (a_frame->buf) ;
+            break ;
+        case FRAME_MEMORY_MMAP:
+            munmap (a_frame->buf, a_frame->capacity) ;
+            break ;
+        default:
+            break ;
+    }
+    a_frame->buf = NULL ;
+    a_frame->data = NULL ;
+    a_frame->capacity = 0 ;
+    a_frame->memory = FRAME_MEMORY_NONE ;
+}
+
+/**
+ * create a_nb_frames frames of at least a_frame_len bytes.
+ * a_alloc_func is called once per frame to give it its memory,
+ * it defaults to frame_alloc_aligned().
+ * After this returns, acquiring and releasing frames
+ * does not allocate anything.
+ */
+enum bool_t
+frame_pool_init (struct frame_pool_t *a_pool,
+                 int a_nb_frames,
+                 unsigned a_frame_len,
+                 enum bool_t a_huge_pages,
+                 frame_alloc_func_t a_alloc_func,
+                 frame_free_func_t a_free_func,
+                 void *a_user_data)
+{
+    int i=0 ;
+
+    RETURN_VAL_IF_FAIL (a_pool && a_nb_frames > 0 && a_frame_len, FALSE) ;
+
+    memset (a_pool, 0, sizeof (struct frame_pool_t)) ;
+    a_pool->frame_len = a_frame_len ;
+    a_pool->huge_pages = a_huge_pages ;
+    a_pool->alloc_func = a_alloc_func ;
+    a_pool->free_func = a_free_func ;
+    a_pool->user_data = a_user_data ;
+
+    a_pool->frames = calloc (a_nb_frames, sizeof (struct frame_t)) ;
+    if (!a_pool->frames) {
+        LOG_ERROR ("failed to allocate frame pool\n") ;
+        return FALSE ;
+    }
+    a_pool->nb_frames = a_nb_frames ;
+    for (i=0 ; i < a_nb_frames ; i++) {
+        struct frame_t *frame = &a_pool->frames[i] ;
+        enum bool_t is_ok=FALSE ;
+
+        frame->index = -1 ;
+        if (a_alloc_func) {
+            is_ok = a_alloc_func (a_pool, frame) ;
+        } else {
+            is_ok = frame_alloc_aligned (a_pool, frame, a_frame_len) ;
+        }
+        if (!is_ok) {
+            LOG_ERROR ("failed to allocate frame %d of the pool\n", i) ;
+            a_pool->nb_frames = i ;
+            frame_pool_finalize (a_pool) ;
+            return FALSE ;
+        }
+        frame_pool_release (a_pool, frame) ;
+    }
+    a_pool->nb_releases = 0 ;
+    return TRUE ;
+}
+
+void
+frame_pool_finalize (struct frame_pool_t *a_pool)
+{
+    int i=0 ;
+
+    RETURN_IF_FAIL (a_pool) ;
+
+    for (i=0 ; i < a_pool->nb_frames ; i++) {
+        if (a_pool->free_func) {
+            a_pool->free_func (a_pool, &a_pool->frames[i]) ;
+        } else {
+            frame_free_aligned (a_pool, &a_pool->frames[i]) ;
+        }
+    }
+    if (a_pool->frames) {
+        free (a_pool->frames) ;
+        a_pool->frames = NULL ;
+    }
+    a_pool->nb_frames = 0 ;
+    a_pool->free_frames = NULL ;
+    a_pool->last_free_frame = NULL ;
+}
+
+/**
+ * get a free frame from the pool.
+ * Frames are handed out in the order they were released, so that
+ * the least recently used one, which the XServer is the most likely
+ * to be done with, comes first.
+ * returns NULL if they are all in use.
+ */
+struct frame_t*
+frame_pool_acquire (struct frame_pool_t *a_pool)
+{
+    struct frame_t *frame=NULL ;
+
+    RETURN_VAL_IF_FAIL (a_pool, NULL) ;
+
+    frame = a_pool->free_frames ;
+    if (!frame) {
+        a_pool->nb_exhausted++ ;
+        return NULL ;
+    }
+    a_pool->free_frames = frame->next_free ;
+    if (!a_pool->free_frames) {
+        a_pool->last_free_frame = NULL ;
+    }
+    frame->next_free = NULL ;
+    frame->data = frame->buf ;
+    frame->len = 0 ;
+    frame->index = -1 ;
+    a_pool->nb_acquires++ ;
+    return frame ;
+}
+
+void
+frame_pool_release (struct frame_pool_t *a_pool,
+                    struct frame_t *a_frame)
+{
+    RETURN_IF_FAIL (a_pool && a_frame) ;
+
+    a_frame->next_free = NULL ;
+    if (a_pool->last_free_frame) {
+        a_pool->last_free_frame->next_free = a_frame ;
+    } else {
+        a_pool->free_frames = a_frame ;
+    }
+    a_pool->last_free_frame = a_frame ;
+    a_pool->nb_releases++ ;
+}
+
+void
+frame_pool_dump_stats (struct frame_pool_t *a_pool, FILE *a_out)
+{
+    RETURN_IF_FAIL (a_pool && a_out) ;
+
+    fprintf (a_out,
+             "frame pool: %d buffers, %lu bytes in %lu allocations%s\n"
+             "frame pool: %lu acquires, %lu releases, %lu times exhausted\n",
+             a_pool->nb_frames,
+             a_pool->nb_allocated_bytes, a_pool->nb_allocs,
+             a_pool->huge_pages ? " (huge pages)" : "",
+             a_pool->nb_acquires, a_pool->nb_releases,
+             a_pool->nb_exhausted) ;
+}
+
+/*************************
+ * </frame pool>
+ * ***********************/
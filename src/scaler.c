@@ -0,0 +1,809 @@
+/*
+ * Copyright (C) 2007 OpenedHand Ltd
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * Author:
+ *   Dodji Seketeli <dodji@openedhand.com>
+ */
+
+#include "xvplay-private.h"
+
+/*************************
+ * <scaling>
+ * ***********************/
+
+static const char *scale_filter_names[] = {
+    "nearest",
+    "bilinear",
+    "cubic"
+};
+
+const char*
+scale_filter_get_name (enum scale_filter_t a_filter)
+{
+    return scale_filter_names[a_filter] ;
+}
+
+/*returns -1 if a_name is not a filter*/
+int
+scale_filter_from_name (const char *a_name)
+{
+    int i=0 ;
+
+    RETURN_VAL_IF_FAIL (a_name, -1) ;
+
+    for (i=0 ; i <= SCALE_FILTER_CUBIC ; i++) {
+        if (!strcasecmp (a_name, scale_filter_names[i])) {
+            return i ;
+        }
+    }
+    return -1 ;
+}
+
+/*the Catmull-Rom weight of a sample a_dist samples away*/
+static double
+cubic_weight (double a_dist)
+{
+    a_dist = fabs (a_dist) ;
+    if (a_dist < 1) {
+        return 1.5 * a_dist * a_dist * a_dist - 2.5 * a_dist * a_dist + 1 ;
+    }
+    if (a_dist < 2) {
+        return -0.5 * a_dist * a_dist * a_dist + 2.5 * a_dist * a_dist
+               - 4 * a_dist + 2 ;
+    }
+    return 0 ;
+}
+
+static void
+scale_axis_finalize (struct scale_axis_t *a_axis)
+{
+    free (a_axis->first) ;
+    a_axis->first = NULL ;
+    free (a_axis->coeffs) ;
+    a_axis->coeffs = NULL ;
+}
+
+/*
+ * compute the taps making a_dst_len samples out of a_src_len,
+ * sample centers being aligned.
+ */
+static enum bool_t
+scale_axis_init (struct scale_axis_t *a_axis,
+                 unsigned a_src_len,
+                 unsigned a_dst_len,
+                 enum scale_filter_t a_filter)
+{
+    int weights[SCALE_NB_TAPS] ;
+    double center=0, frac=0 ;
+    int i=0, k=0, pos=0, first=0, sum=0, max=0 ;
+    unsigned j=0 ;
+
+    memset (a_axis, 0, sizeof (struct scale_axis_t)) ;
+    a_axis->src_len = a_src_len ;
+    a_axis->dst_len = a_dst_len ;
+    a_axis->first = calloc (a_dst_len, sizeof (int)) ;
+    a_axis->coeffs = calloc (a_dst_len, SCALE_NB_TAPS) ;
+    if (!a_axis->first || !a_axis->coeffs) {
+        scale_axis_finalize (a_axis) ;
+        return FALSE ;
+    }
+    for (j=0 ; j < a_dst_len ; j++) {
+        center = (j + 0.5) * a_src_len / a_dst_len - 0.5 ;
+        i = (int)floor (center) ;
+        frac = center - i ;
+        memset (weights, 0, sizeof (weights)) ;
+        /*weights[k] is for sample i - 1 + k*/
+        switch (a_filter) {
+            case SCALE_FILTER_NEAREST:
+                weights[frac < 0.5 ? 1 : 2] = SCALE_ONE ;
+                break ;
+            case SCALE_FILTER_BILINEAR:
+                weights[2] = (int)lrint (frac * SCALE_ONE) ;
+                weights[1] = SCALE_ONE - weights[2] ;
+                break ;
+            case SCALE_FILTER_CUBIC:
+                sum = 0 ;
+                for (k=0 ; k < SCALE_NB_TAPS ; k++) {
+                    weights[k] = (int)lrint (cubic_weight (k - 1 - frac)
+                                             * SCALE_ONE) ;
+                    sum += weights[k] ;
+                }
+                /*rounding must not change the overall brightness*/
+                weights[frac < 0.5 ? 1 : 2] += SCALE_ONE - sum ;
+                break ;
+        }
+        max = a_src_len > SCALE_NB_TAPS ? a_src_len - SCALE_NB_TAPS : 0 ;
+        first = i - 1 < 0 ? 0 : i - 1 > max ? max : i - 1 ;
+        a_axis->first[j] = first ;
+        for (k=0 ; k < SCALE_NB_TAPS ; k++) {
+            pos = i - 1 + k ;
+            pos = pos < 0 ? 0
+                  : pos >= (int)a_src_len ? (int)a_src_len - 1 : pos ;
+            a_axis->coeffs[j * SCALE_NB_TAPS + pos - first] += weights[k] ;
+        }
+    }
+    return TRUE ;
+}
+
+/*
+ * a plane of a frame, as the scaler sees it: lines of row_len bytes
+ * holding up to 3 components, each a sample every step bytes.
+ */
+struct scale_plane_t {
+    const unsigned char *src ;
+    unsigned src_pitch ;
+    unsigned char *dst ;
+    unsigned dst_pitch ;
+    unsigned row_len ;
+    const struct scale_axis_t *y_axis ;
+    int nb_components ;
+    struct {
+        unsigned src_offset ;
+        unsigned dst_offset ;
+        unsigned step ;
+        const struct scale_axis_t *x_axis ;
+    } components[3] ;
+};
+
+static void
+scale_plane_add_component (struct scale_plane_t *a_plane,
+                           const unsigned char *a_src,
+                           unsigned char *a_dst,
+                           unsigned a_step,
+                           const struct scale_axis_t *a_x_axis)
+{
+    int i = a_plane->nb_components++ ;
+
+    a_plane->components[i].src_offset = a_src - a_plane->src ;
+    a_plane->components[i].dst_offset = a_dst - a_plane->dst ;
+    a_plane->components[i].step = a_step ;
+    a_plane->components[i].x_axis = a_x_axis ;
+}
+
+/*
+ * cut the frames a_src and a_dst into the planes the scaler goes
+ * through, a_src starting at the source rectangle.
+ * returns the nb of planes.
+ */
+static int
+scaler_get_planes (struct scaler_t *a_scaler,
+                   const struct yuv_planes_t *a_src,
+                   const struct yuv_planes_t *a_dst,
+                   struct scale_plane_t *a_planes)
+{
+    const struct yuv_format_info_t *info = a_src->info ;
+    unsigned x=a_scaler->src_x, y=a_scaler->src_y ;
+    unsigned chroma_y = y >> info->chroma_y_shift ;
+    const unsigned char *src_u=NULL, *src_v=NULL ;
+    unsigned char *dst_u=NULL, *dst_v=NULL ;
+
+    memset (a_planes, 0, 3 * sizeof (struct scale_plane_t)) ;
+    switch (info->layout) {
+        case YUV_LAYOUT_PLANAR:
+            a_planes[0].src = a_src->y + y * a_src->y_pitch + x ;
+            a_planes[0].src_pitch = a_src->y_pitch ;
+            a_planes[0].dst = a_dst->y ;
+            a_planes[0].dst_pitch = a_dst->y_pitch ;
+            a_planes[0].row_len = a_scaler->src_width ;
+            a_planes[0].y_axis = &a_scaler->luma_y ;
+            scale_plane_add_component (&a_planes[0], a_planes[0].src,
+                                       a_planes[0].dst, 1,
+                                       &a_scaler->luma_x) ;
+            a_planes[1].src = a_src->u + chroma_y * a_src->uv_pitch + x / 2 ;
+            a_planes[1].dst = a_dst->u ;
+            a_planes[2].src = a_src->v + chroma_y * a_src->uv_pitch + x / 2 ;
+            a_planes[2].dst = a_dst->v ;
+            a_planes[1].src_pitch = a_planes[2].src_pitch = a_src->uv_pitch ;
+            a_planes[1].dst_pitch = a_planes[2].dst_pitch = a_dst->uv_pitch ;
+            a_planes[1].row_len = a_planes[2].row_len
+                                = a_scaler->src_width / 2 ;
+            a_planes[1].y_axis = a_planes[2].y_axis = &a_scaler->chroma_y ;
+            scale_plane_add_component (&a_planes[1], a_planes[1].src,
+                                       a_planes[1].dst, 1,
+                                       &a_scaler->chroma_x) ;
+            scale_plane_add_component (&a_planes[2], a_planes[2].src,
+                                       a_planes[2].dst, 1,
+                                       &a_scaler->chroma_x) ;
+            return 3 ;
+        case YUV_LAYOUT_SEMI_PLANAR:
+            a_planes[0].src = a_src->y + y * a_src->y_pitch + x ;
+            a_planes[0].src_pitch = a_src->y_pitch ;
+            a_planes[0].dst = a_dst->y ;
+            a_planes[0].dst_pitch = a_dst->y_pitch ;
+            a_planes[0].row_len = a_scaler->src_width ;
+            a_planes[0].y_axis = &a_scaler->luma_y ;
+            scale_plane_add_component (&a_planes[0], a_planes[0].src,
+                                       a_planes[0].dst, 1,
+                                       &a_scaler->luma_x) ;
+            src_u = a_src->u + chroma_y * a_src->uv_pitch + x ;
+            src_v = a_src->v + chroma_y * a_src->uv_pitch + x ;
+            a_planes[1].src = src_u < src_v ? src_u : src_v ;
+            a_planes[1].src_pitch = a_src->uv_pitch ;
+            a_planes[1].dst = a_dst->u < a_dst->v ? a_dst->u : a_dst->v ;
+            a_planes[1].dst_pitch = a_dst->uv_pitch ;
+            a_planes[1].row_len = a_scaler->src_width ;
+            a_planes[1].y_axis = &a_scaler->chroma_y ;
+            scale_plane_add_component (&a_planes[1], src_u, a_dst->u, 2,
+                                       &a_scaler->chroma_x) ;
+            scale_plane_add_component (&a_planes[1], src_v, a_dst->v, 2,
+                                       &a_scaler->chroma_x) ;
+            return 2 ;
+        case YUV_LAYOUT_PACKED:
+            a_planes[0].src = a_src->packed + y * a_src->y_pitch + 2 * x ;
+            a_planes[0].src_pitch = a_src->y_pitch ;
+            a_planes[0].dst = a_dst->packed ;
+            a_planes[0].dst_pitch = a_dst->y_pitch ;
+            a_planes[0].row_len = 2 * a_scaler->src_width ;
+            a_planes[0].y_axis = &a_scaler->luma_y ;
+            src_u = a_src->u + y * a_src->y_pitch + 2 * x ;
+            src_v = a_src->v + y * a_src->y_pitch + 2 * x ;
+            dst_u = a_dst->u ;
+            dst_v = a_dst->v ;
+            scale_plane_add_component (&a_planes[0],
+                                       a_src->y + y * a_src->y_pitch + 2 * x,
+                                       a_dst->y, 2, &a_scaler->luma_x) ;
+            scale_plane_add_component (&a_planes[0], src_u, dst_u, 4,
+                                       &a_scaler->chroma_x) ;
+            scale_plane_add_component (&a_planes[0], src_v, dst_v, 4,
+                                       &a_scaler->chroma_x) ;
+            return 1 ;
+    }
+    return 0 ;
+}
+
+/*
+ * a_dst[i] = the a_nb_taps a_rows[k][i] weighted by a_coeffs[k],
+ * for the a_len bytes of a line.
+ */
+static void
+scale_column_scalar (const unsigned char **a_rows,
+                     const int *a_coeffs,
+                     int a_nb_taps,
+                     unsigned char *a_dst,
+                     unsigned a_len)
+{
+    unsigned i=0 ;
+    int k=0, sum=0 ;
+
+    for (i=0 ; i < a_len ; i++) {
+        sum = SCALE_ONE / 2 ;
+        for (k=0 ; k < a_nb_taps ; k++) {
+            sum += a_coeffs[k] * a_rows[k][i] ;
+        }
+        a_dst[i] = clamp_to_byte (sum >> SCALE_SHIFT) ;
+    }
+}
+
+/*one component of a line, a sample every a_step bytes*/
+static void
+scale_row_scalar (const unsigned char *a_src,
+                  unsigned a_src_step,
+                  unsigned char *a_dst,
+                  unsigned a_dst_step,
+                  const struct scale_axis_t *a_axis)
+{
+    const unsigned char *src=NULL ;
+    const signed char *coeffs=NULL ;
+    unsigned i=0 ;
+    int sum=0, k=0 ;
+
+    for (i=0 ; i < a_axis->dst_len ; i++) {
+        src = a_src + a_axis->first[i] * a_src_step ;
+        coeffs = a_axis->coeffs + i * SCALE_NB_TAPS ;
+        sum = SCALE_ONE / 2 ;
+        for (k=0 ; k < SCALE_NB_TAPS ; k++) {
+            sum += coeffs[k] * src[k * a_src_step] ;
+        }
+        a_dst[i * a_dst_step] = clamp_to_byte (sum >> SCALE_SHIFT) ;
+    }
+}
+
+#ifdef HAVE_X86_SIMD
+
+/*32 bytes per iteration, the remainder goes through the scalar code*/
+__attribute__ ((target ("avx2")))
+static void
+scale_column_avx2 (const unsigned char **a_rows,
+                   const int *a_coeffs,
+                   int a_nb_taps,
+                   unsigned char *a_dst,
+                   unsigned a_len)
+{
+    const __m256i zero = _mm256_setzero_si256 () ;
+    const __m256i round = _mm256_set1_epi16 (SCALE_ONE / 2) ;
+    __m256i coeffs[SCALE_NB_TAPS], lo, hi, in ;
+    unsigned i=0, n = a_len & ~31U ;
+    int k=0 ;
+
+    for (k=0 ; k < a_nb_taps ; k++) {
+        coeffs[k] = _mm256_set1_epi16 (a_coeffs[k]) ;
+    }
+    for (i=0 ; i < n ; i += 32) {
+        lo = hi = round ;
+        for (k=0 ; k < a_nb_taps ; k++) {
+            in = _mm256_loadu_si256 ((const __m256i*)(a_rows[k] + i)) ;
+            lo = _mm256_add_epi16 (lo, _mm256_mullo_epi16
+                                   (_mm256_unpacklo_epi8 (in, zero),
+                                    coeffs[k])) ;
+            hi = _mm256_add_epi16 (hi, _mm256_mullo_epi16
+                                   (_mm256_unpackhi_epi8 (in, zero),
+                                    coeffs[k])) ;
+        }
+        lo = _mm256_srai_epi16 (lo, SCALE_SHIFT) ;
+        hi = _mm256_srai_epi16 (hi, SCALE_SHIFT) ;
+        /*unpacking and packing within lanes keeps the bytes in order*/
+        _mm256_storeu_si256 ((__m256i*)(a_dst + i),
+                             _mm256_packus_epi16 (lo, hi)) ;
+    }
+    if (n < a_len) {
+        const unsigned char *rows[SCALE_NB_TAPS] ;
+
+        for (k=0 ; k < a_nb_taps ; k++) {
+            rows[k] = a_rows[k] + n ;
+        }
+        scale_column_scalar (rows, a_coeffs, a_nb_taps,
+                             a_dst + n, a_len - n) ;
+    }
+}
+
+/*
+ * a component which samples are next to each other, 8 samples per
+ * iteration: each gathers the 4 bytes of its taps, which are
+ * weighted all at once.
+ */
+__attribute__ ((target ("avx2")))
+static void
+scale_row_avx2 (const unsigned char *a_src,
+                unsigned char *a_dst,
+                const struct scale_axis_t *a_axis)
+{
+    const __m256i ones = _mm256_set1_epi16 (1) ;
+    const __m256i round = _mm256_set1_epi32 (SCALE_ONE / 2) ;
+    __m256i first, taps, coeffs, sum ;
+    __m128i words ;
+    unsigned i=0, n = a_axis->dst_len & ~7U ;
+
+    for (i=0 ; i < n ; i += 8) {
+        first = _mm256_loadu_si256 ((const __m256i*)(a_axis->first + i)) ;
+        taps = _mm256_i32gather_epi32 ((const int*)a_src, first, 1) ;
+        coeffs = _mm256_loadu_si256 ((const __m256i*)
+                                     (a_axis->coeffs + i * SCALE_NB_TAPS)) ;
+        sum = _mm256_madd_epi16 (_mm256_maddubs_epi16 (taps, coeffs), ones) ;
+        sum = _mm256_srai_epi32 (_mm256_add_epi32 (sum, round), SCALE_SHIFT) ;
+        words = _mm_packs_epi32 (_mm256_castsi256_si128 (sum),
+                                 _mm256_extracti128_si256 (sum, 1)) ;
+        _mm_storel_epi64 ((__m128i*)(a_dst + i),
+                          _mm_packus_epi16 (words, words)) ;
+    }
+    for ( ; i < a_axis->dst_len ; i++) {
+        const signed char *coeffs_i = a_axis->coeffs + i * SCALE_NB_TAPS ;
+        const unsigned char *src = a_src + a_axis->first[i] ;
+        int k=0, total=SCALE_ONE / 2 ;
+
+        for (k=0 ; k < SCALE_NB_TAPS ; k++) {
+            total += coeffs_i[k] * src[k] ;
+        }
+        a_dst[i] = clamp_to_byte (total >> SCALE_SHIFT) ;
+    }
+}
+
+#endif /*HAVE_X86_SIMD*/
+
+/*
+ * scale the lines of a_plane from a_first_line up to a_end_line,
+ * a_row holding a line filtered vertically.
+ */
+static void
+scaler_scale_lines (struct scaler_t *a_scaler,
+                    const struct scale_plane_t *a_plane,
+                    unsigned a_first_line,
+                    unsigned a_end_line,
+                    unsigned char *a_row)
+{
+    const struct scale_axis_t *y_axis = a_plane->y_axis ;
+    const unsigned char *rows[SCALE_NB_TAPS], *row=NULL ;
+    int coeffs[SCALE_NB_TAPS] ;
+    unsigned line=0 ;
+    int k=0, nb_taps=0, first=0, c=0 ;
+
+    for (line=a_first_line ; line < a_end_line ; line++) {
+        first = y_axis->first[line] ;
+        nb_taps = 0 ;
+        for (k=0 ; k < SCALE_NB_TAPS ; k++) {
+            c = y_axis->coeffs[line * SCALE_NB_TAPS + k] ;
+            if (c) {
+                rows[nb_taps] = a_plane->src
+                                + (first + k) * a_plane->src_pitch ;
+                coeffs[nb_taps++] = c ;
+            }
+        }
+        if (nb_taps == 1 && coeffs[0] == SCALE_ONE
+            && a_plane->row_len >= 4 * SCALE_NB_TAPS) {
+            /*the line is taken as it is*/
+            row = rows[0] ;
+        } else {
+#ifdef HAVE_X86_SIMD
+            if (a_scaler->use_avx2) {
+                scale_column_avx2 (rows, coeffs, nb_taps,
+                                   a_row, a_plane->row_len) ;
+            } else
+#endif
+            scale_column_scalar (rows, coeffs, nb_taps,
+                                 a_row, a_plane->row_len) ;
+            row = a_row ;
+        }
+        for (k=0 ; k < a_plane->nb_components ; k++) {
+            unsigned char *dst = a_plane->dst + line * a_plane->dst_pitch
+                                 + a_plane->components[k].dst_offset ;
+            unsigned step = a_plane->components[k].step ;
+
+#ifdef HAVE_X86_SIMD
+            if (a_scaler->use_avx2 && step == 1) {
+                scale_row_avx2 (row + a_plane->components[k].src_offset,
+                                dst, a_plane->components[k].x_axis) ;
+                continue ;
+            }
+#endif
+            scale_row_scalar (row + a_plane->components[k].src_offset,
+                              step, dst, step,
+                              a_plane->components[k].x_axis) ;
+        }
+    }
+}
+
+/*scale the a_slice th of a_nb_slices horizontal slices of the job*/
+static void
+scaler_scale_slice (struct scaler_t *a_scaler,
+                    int a_slice,
+                    int a_nb_slices,
+                    unsigned char *a_row)
+{
+    struct scale_plane_t planes[3] ;
+    unsigned nb_lines=0 ;
+    int i=0, nb_planes=0 ;
+
+    nb_planes = scaler_get_planes (a_scaler, a_scaler->src, a_scaler->dst,
+                                   planes) ;
+    for (i=0 ; i < nb_planes ; i++) {
+        nb_lines = planes[i].y_axis->dst_len ;
+        scaler_scale_lines (a_scaler, &planes[i],
+                            (uint64_t)nb_lines * a_slice / a_nb_slices,
+                            (uint64_t)nb_lines * (a_slice + 1) / a_nb_slices,
+                            a_row) ;
+    }
+}
+
+static void*
+scaler_thread_func (void *a_thread)
+{
+    struct scaler_thread_t *thread = a_thread ;
+    struct scaler_t *scaler = thread->scaler ;
+
+    pthread_mutex_lock (&scaler->lock) ;
+    for (;;) {
+        while (thread->generation == scaler->generation
+               && !scaler->is_quitting) {
+            pthread_cond_wait (&scaler->work_cond, &scaler->lock) ;
+        }
+        if (scaler->is_quitting) {
+            break ;
+        }
+        thread->generation = scaler->generation ;
+        if (thread->index >= scaler->nb_active) {
+            continue ;
+        }
+        pthread_mutex_unlock (&scaler->lock) ;
+        scaler_scale_slice (scaler, thread->index, scaler->nb_active,
+                            thread->row) ;
+        pthread_mutex_lock (&scaler->lock) ;
+        if (!--scaler->nb_busy) {
+            pthread_cond_signal (&scaler->done_cond) ;
+        }
+    }
+    pthread_mutex_unlock (&scaler->lock) ;
+    return NULL ;
+}
+
+/**
+ * a scaler of a_width x a_height frames of a_format, taking the
+ * source rectangle of a_geometry to a_dst_width x a_dst_height
+ * frames of the same format, split across a_nb_threads threads.
+ */
+struct scaler_t*
+scaler_new (enum yuv_format_t a_format,
+            unsigned a_width,
+            unsigned a_height,
+            const struct sink_geometry_t *a_geometry,
+            unsigned a_dst_width,
+            unsigned a_dst_height,
+            enum scale_filter_t a_filter,
+            int a_nb_threads,
+            enum bool_t a_no_simd)
+{
+    const struct yuv_format_info_t *info=NULL ;
+    struct scaler_t *scaler=NULL ;
+    unsigned shift=0, row_len=0 ;
+    int i=0 ;
+
+    RETURN_VAL_IF_FAIL (a_geometry && a_dst_width && a_dst_height, NULL) ;
+    info = yuv_format_get_info (a_format) ;
+    RETURN_VAL_IF_FAIL (info, NULL) ;
+
+    scaler = calloc (1, sizeof (struct scaler_t)) ;
+    if (!scaler) {
+        return NULL ;
+    }
+    scaler->filter = a_filter ;
+    scaler->format = a_format ;
+    shift = info->chroma_y_shift ;
+    /*chroma samples cover 2 pixels, and 2 lines in 4:2:0*/
+    scaler->src_x = a_geometry->src_x > 0 ? a_geometry->src_x & ~1 : 0 ;
+    scaler->src_y = a_geometry->src_y > 0
+                    ? a_geometry->src_y & ~((1U << shift) - 1) : 0 ;
+    scaler->src_width = a_geometry->src_width ;
+    if (scaler->src_x + scaler->src_width > a_width) {
+        scaler->src_width = a_width - scaler->src_x ;
+    }
+    scaler->src_height = a_geometry->src_height ;
+    if (scaler->src_y + scaler->src_height > a_height) {
+        scaler->src_height = a_height - scaler->src_y ;
+    }
+    scaler->src_width &= ~1 ;
+    scaler->src_height &= ~((1U << shift) - 1) ;
+    scaler->dst_width = a_dst_width ;
+    scaler->dst_height = a_dst_height ;
+    if (scaler->src_width < 2 || scaler->src_height < 2) {
+        LOG_ERROR ("no source rectangle to scale\n") ;
+        goto error ;
+    }
+    if (!scale_axis_init (&scaler->luma_x, scaler->src_width,
+                          a_dst_width, a_filter)
+        || !scale_axis_init (&scaler->luma_y, scaler->src_height,
+                             a_dst_height, a_filter)
+        || !scale_axis_init (&scaler->chroma_x, scaler->src_width / 2,
+                             a_dst_width / 2, a_filter)
+        || !scale_axis_init (&scaler->chroma_y, scaler->src_height >> shift,
+                             a_dst_height >> shift, a_filter)) {
+        goto error ;
+    }
+#ifdef HAVE_X86_SIMD
+    if (!a_no_simd) {
+        __builtin_cpu_init () ;
+        scaler->use_avx2 = __builtin_cpu_supports ("avx2") ;
+    }
+#endif
+
+    if (a_nb_threads <= 0) {
+        a_nb_threads = sysconf (_SC_NPROCESSORS_ONLN) ;
+        if (a_nb_threads > SCALE_DEFAULT_THREADS) {
+            a_nb_threads = SCALE_DEFAULT_THREADS ;
+        }
+    }
+    if (a_nb_threads < 1) {
+        a_nb_threads = 1 ;
+    } else if (a_nb_threads > SCALE_MAX_THREADS) {
+        a_nb_threads = SCALE_MAX_THREADS ;
+    }
+    scaler->threads = calloc (a_nb_threads, sizeof (struct scaler_thread_t)) ;
+    if (!scaler->threads) {
+        goto error ;
+    }
+    pthread_mutex_init (&scaler->lock, NULL) ;
+    pthread_cond_init (&scaler->work_cond, NULL) ;
+    pthread_cond_init (&scaler->done_cond, NULL) ;
+    scaler->has_sync = TRUE ;
+    /*packed lines are twice as long, and the taps may read past them*/
+    row_len = 2 * scaler->src_width + 64 ;
+    for (i=0 ; i < a_nb_threads ; i++) {
+        struct scaler_thread_t *thread = &scaler->threads[i] ;
+
+        thread->scaler = scaler ;
+        thread->index = i ;
+        thread->row = malloc (row_len) ;
+        if (!thread->row) {
+            goto error ;
+        }
+        memset (thread->row, 0, row_len) ;
+        scaler->nb_threads++ ;
+        /*the first slice is scaled by the caller*/
+        if (i > 0) {
+            if (pthread_create (&thread->thread, NULL,
+                                scaler_thread_func, thread)) {
+                LOG_ERROR ("could not create scaler thread %d\n", i) ;
+                goto error ;
+            }
+            thread->is_running = TRUE ;
+        }
+    }
+    scaler->nb_active = scaler->nb_threads ;
+    LOG ("scaling %ux%u %s frames to %ux%u, %s filter, on %d threads%s\n",
+         scaler->src_width, scaler->src_height, info->name,
+         a_dst_width, a_dst_height, scale_filter_get_name (a_filter),
+         scaler->nb_threads, scaler->use_avx2 ? " with AVX2" : "") ;
+    return scaler ;
+
+error:
+    scaler_destroy (scaler) ;
+    return NULL ;
+}
+
+void
+scaler_destroy (struct scaler_t *a_scaler)
+{
+    int i=0 ;
+
+    if (!a_scaler) {
+        return ;
+    }
+    if (a_scaler->has_sync) {
+        pthread_mutex_lock (&a_scaler->lock) ;
+        a_scaler->is_quitting = TRUE ;
+        pthread_cond_broadcast (&a_scaler->work_cond) ;
+        pthread_mutex_unlock (&a_scaler->lock) ;
+    }
+    for (i=0 ; i < a_scaler->nb_threads ; i++) {
+        if (a_scaler->threads[i].is_running) {
+            pthread_join (a_scaler->threads[i].thread, NULL) ;
+        }
+        free (a_scaler->threads[i].row) ;
+    }
+    free (a_scaler->threads) ;
+    if (a_scaler->has_sync) {
+        pthread_cond_destroy (&a_scaler->done_cond) ;
+        pthread_cond_destroy (&a_scaler->work_cond) ;
+        pthread_mutex_destroy (&a_scaler->lock) ;
+    }
+    scale_axis_finalize (&a_scaler->luma_x) ;
+    scale_axis_finalize (&a_scaler->luma_y) ;
+    scale_axis_finalize (&a_scaler->chroma_x) ;
+    scale_axis_finalize (&a_scaler->chroma_y) ;
+    free (a_scaler) ;
+}
+
+/**
+ * scale the source rectangle of the frame a_src into a_dst, which
+ * is dst_width x dst_height, both in the format of the scaler.
+ * Returns once all the threads are done with it.
+ */
+void
+scaler_scale (struct scaler_t *a_scaler,
+              const struct yuv_planes_t *a_src,
+              const struct yuv_planes_t *a_dst)
+{
+    int64_t start=0 ;
+
+    RETURN_IF_FAIL (a_scaler && a_src && a_dst) ;
+    RETURN_IF_FAIL (a_src->info->format == a_scaler->format
+                    && a_dst->info->format == a_scaler->format) ;
+
+    start = get_monotonic_ns () ;
+    a_scaler->src = a_src ;
+    a_scaler->dst = a_dst ;
+    if (a_scaler->nb_active > 1) {
+        pthread_mutex_lock (&a_scaler->lock) ;
+        a_scaler->generation++ ;
+        a_scaler->nb_busy = a_scaler->nb_active - 1 ;
+        pthread_cond_broadcast (&a_scaler->work_cond) ;
+        pthread_mutex_unlock (&a_scaler->lock) ;
+    }
+    scaler_scale_slice (a_scaler, 0, a_scaler->nb_active,
+                        a_scaler->threads[0].row) ;
+    if (a_scaler->nb_active > 1) {
+        pthread_mutex_lock (&a_scaler->lock) ;
+        while (a_scaler->nb_busy) {
+            pthread_cond_wait (&a_scaler->done_cond, &a_scaler->lock) ;
+        }
+        pthread_mutex_unlock (&a_scaler->lock) ;
+    }
+    a_scaler->src = NULL ;
+    a_scaler->dst = NULL ;
+    a_scaler->scale_ns += get_monotonic_ns () - start ;
+    a_scaler->nb_frames++ ;
+}
+
+void
+scaler_dump_stats (struct scaler_t *a_scaler, FILE *a_out)
+{
+    double seconds=0 ;
+
+    RETURN_IF_FAIL (a_scaler && a_out) ;
+
+    if (!a_scaler->nb_frames) {
+        return ;
+    }
+    seconds = a_scaler->scale_ns / 1e9 ;
+    if (seconds <= 0) {
+        seconds = 1e-9 ;
+    }
+    fprintf (a_out, "scaler: %ux%u to %ux%u, %s, %d threads%s: "
+             "%.3f ms per frame, %.1f Mpix/s\n",
+             a_scaler->src_width, a_scaler->src_height,
+             a_scaler->dst_width, a_scaler->dst_height,
+             scale_filter_get_name (a_scaler->filter),
+             a_scaler->nb_threads,
+             a_scaler->use_avx2 ? ", AVX2" : "",
+             seconds * 1e3 / a_scaler->nb_frames,
+             (double)a_scaler->dst_width * a_scaler->dst_height
+             * a_scaler->nb_frames / seconds / 1e6) ;
+}
+
+/**
+ * time the scaler on 1, 2, 4... up to all of its threads, and
+ * print the output Mpix/s of each.
+ * The frames scaled are made up, so this can run once the
+ * playback is over.
+ */
+void
+scaler_benchmark (struct scaler_t *a_scaler, FILE *a_out)
+{
+    struct yuv_planes_t src, dst ;
+    unsigned char *src_frame=NULL, *dst_frame=NULL ;
+    unsigned src_len=0, dst_len=0, i=0, width=0, height=0 ;
+    unsigned long nb_frames=0 ;
+    int64_t ns=0, start=0 ;
+    int nb_threads=0 ;
+
+    RETURN_IF_FAIL (a_scaler && a_out) ;
+
+    width = a_scaler->src_x + a_scaler->src_width ;
+    height = a_scaler->src_y + a_scaler->src_height ;
+    compute_yuv_image_size (a_scaler->format, width, height, &src_len) ;
+    compute_yuv_image_size (a_scaler->format, a_scaler->dst_width,
+                            a_scaler->dst_height, &dst_len) ;
+    src_frame = malloc (src_len) ;
+    dst_frame = malloc (dst_len) ;
+    if (!src_frame || !dst_frame) {
+        goto out ;
+    }
+    for (i=0 ; i < src_len ; i++) {
+        src_frame[i] = (i * 7) ^ (i >> 9) ;
+    }
+    yuv_planes_from_frame (&src, a_scaler->format, width, height, src_frame) ;
+    yuv_planes_from_frame (&dst, a_scaler->format, a_scaler->dst_width,
+                           a_scaler->dst_height, dst_frame) ;
+    for (nb_threads=1 ; ; nb_threads *= 2) {
+        if (nb_threads > a_scaler->nb_threads) {
+            nb_threads = a_scaler->nb_threads ;
+        }
+        a_scaler->nb_active = nb_threads ;
+        /*warm up, then scale for a quarter of a second at least*/
+        scaler_scale (a_scaler, &src, &dst) ;
+        nb_frames = 0 ;
+        start = get_monotonic_ns () ;
+        do {
+            scaler_scale (a_scaler, &src, &dst) ;
+            nb_frames++ ;
+            ns = get_monotonic_ns () - start ;
+        } while (ns < 250000000) ;
+        fprintf (a_out, "scaler benchmark: %d threads: %.1f Mpix/s\n",
+                 nb_threads,
+                 (double)a_scaler->dst_width * a_scaler->dst_height
+                 * nb_frames / (ns / 1e9) / 1e6) ;
+        if (nb_threads == a_scaler->nb_threads) {
+            break ;
+        }
+    }
+    a_scaler->nb_active = a_scaler->nb_threads ;
+
+out:
+    free (src_frame) ;
+    free (dst_frame) ;
+}
+
+/*************************
+ * </scaling>
+ * ***********************/
@@ -0,0 +1,1333 @@
+/*
+ * Copyright (C) 2007 OpenedHand Ltd
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * Author:
+ *   Dodji Seketeli <dodji@openedhand.com>
+ */
+
+#include "xvplay-private.h"
+
+#ifdef HAVE_XPRESENT
+static int present_opcode=-1 ;/*of the Present extension, once queried*/
+#endif
+static sink_event_func_t sink_event_func=NULL ;
+
+/*************************
+ * <sinks>
+ * ***********************/
+
+static void
+sink_init (struct sink_t *a_sink,
+           const char *a_name,
+           Display *a_display,
+           Window a_window,
+           const struct sink_geometry_t *a_geometry,
+           enum yuv_format_t a_format,
+           unsigned a_width,
+           unsigned a_height,
+           const struct sink_options_t *a_options)
+{
+    memset (a_sink, 0, sizeof (struct sink_t)) ;
+    a_sink->name = a_name ;
+    a_sink->display = a_display ;
+    a_sink->window = a_window ;
+    a_sink->geometry = *a_geometry ;
+    if (a_options) {
+        a_sink->options = *a_options ;
+    } else {
+        sink_options_init (&a_sink->options) ;
+    }
+    a_sink->format = a_format ;
+    a_sink->width = a_width ;
+    a_sink->height = a_height ;
+    a_sink->image_width = a_width ;
+    a_sink->image_height = a_height ;
+    a_sink->zero_copy = TRUE ;
+}
+
+/*
+ * have a_sink scale the frames itself when the dst size differs from
+ * the src size and its output cannot scale (a_can_scale is FALSE), or
+ * when --client-scale asks for it. The sink then puts images of the
+ * dst size, which src rectangle is the whole image.
+ */
+static enum bool_t
+sink_setup_scaler (struct sink_t *a_sink, enum bool_t a_can_scale)
+{
+    struct sink_geometry_t *g = &a_sink->geometry ;
+    const struct yuv_format_info_t *info=NULL ;
+    unsigned len=0 ;
+
+    if (g->dst_width <= 0 || g->dst_height <= 0
+        || (g->dst_width == g->src_width && g->dst_height == g->src_height)
+        || (a_can_scale && !a_sink->options.client_scale)) {
+        return TRUE ;
+    }
+    info = yuv_format_get_info (a_sink->format) ;
+    RETURN_VAL_IF_FAIL (info, FALSE) ;
+    /*a chroma sample covers 2 pixels, and 2 lines in 4:2:0*/
+    a_sink->image_width = (g->dst_width + 1) & ~1 ;
+    a_sink->image_height = g->dst_height ;
+    if (info->chroma_y_shift) {
+        a_sink->image_height = (a_sink->image_height + 1) & ~1 ;
+    }
+    a_sink->scaler = scaler_new (a_sink->format, a_sink->width,
+                                 a_sink->height, g,
+                                 a_sink->image_width, a_sink->image_height,
+                                 a_sink->options.scale_filter,
+                                 a_sink->options.scale_threads,
+                                 a_sink->options.no_simd) ;
+    if (!a_sink->scaler) {
+        LOG_ERROR ("could not set up the scaling to %dx%d\n",
+                   g->dst_width, g->dst_height) ;
+        return FALSE ;
+    }
+    compute_yuv_image_size (a_sink->format, a_sink->image_width,
+                            a_sink->image_height, &len) ;
+    a_sink->scaled_frame = malloc (len) ;
+    if (!a_sink->scaled_frame) {
+        return FALSE ;
+    }
+    g->src_x = 0 ;
+    g->src_y = 0 ;
+    g->src_width = a_sink->image_width ;
+    g->src_height = a_sink->image_height ;
+    return TRUE ;
+}
+
+/*
+ * scale a_frame into the scaled frame of a_sink, which a_planes
+ * then describes.
+ */
+static enum bool_t
+sink_scale_frame (struct sink_t *a_sink,
+                  struct frame_t *a_frame,
+                  struct yuv_planes_t *a_planes)
+{
+    struct yuv_planes_t src ;
+
+    RETURN_VAL_IF_FAIL (a_sink->scaler && a_sink->scaled_frame, FALSE) ;
+
+    if (!yuv_planes_from_frame (&src, a_sink->format,
+                                a_sink->width, a_sink->height,
+                                (unsigned char*)a_frame->data)
+        || !yuv_planes_from_frame (a_planes, a_sink->format,
+                                   a_sink->image_width, a_sink->image_height,
+                                   a_sink->scaled_frame)) {
+        return FALSE ;
+    }
+    scaler_scale (a_sink->scaler, &src, a_planes) ;
+    return TRUE ;
+}
+
+/*upload_frame callback of the sinks which only need to scale frames*/
+static enum bool_t
+sink_scale_upload_frame (struct sink_t *a_this, struct frame_t *a_frame)
+{
+    struct yuv_planes_t planes ;
+
+    return sink_scale_frame (a_this, a_frame, &planes) ;
+}
+
+/**
+ * show the src rectangle of the frames at the dst rectangle of
+ * a_geometry from now on. A sink scaling frames itself keeps
+ * scaling them to the size it was created with.
+ */
+void
+sink_set_geometry (struct sink_t *a_sink,
+                   const struct sink_geometry_t *a_geometry)
+{
+    RETURN_IF_FAIL (a_sink && a_geometry) ;
+
+    if (a_sink->scaler) {
+        a_sink->geometry.dst_x = a_geometry->dst_x ;
+        a_sink->geometry.dst_y = a_geometry->dst_y ;
+        a_sink->geometry.dst_width = a_geometry->dst_width ;
+        a_sink->geometry.dst_height = a_geometry->dst_height ;
+    } else {
+        a_sink->geometry = *a_geometry ;
+    }
+}
+
+void
+sink_destroy (struct sink_t *a_sink)
+{
+    RETURN_IF_FAIL (a_sink) ;
+
+    if (a_sink->destroy) {
+        a_sink->destroy (a_sink) ;
+    }
+    scaler_destroy (a_sink->scaler) ;
+    free (a_sink->scaled_frame) ;
+    free (a_sink) ;
+}
+
+/*flush callback of the sinks talking to an XServer*/
+static void
+x_sink_flush (struct sink_t *a_this, enum bool_t a_sync)
+{
+    if (a_sync) {
+        XSync (a_this->display, False) ;
+    } else {
+        XFlush (a_this->display) ;
+    }
+}
+
+/*
+ * copy the frame into its image, honoring the plane pitches and
+ * offsets of the adaptor, and scaling or repacking it if need be.
+ * Frames in the format of the image are scaled right into it.
+ */
+static enum bool_t
+xv_sink_upload_frame (struct sink_t *a_this, struct frame_t *a_frame)
+{
+    struct xv_sink_t *sink = (struct xv_sink_t*)a_this ;
+    struct yuv_planes_t src, dst ;
+
+    RETURN_VAL_IF_FAIL (a_frame && a_frame->xv_image, FALSE) ;
+
+    if (!yuv_planes_from_xv_image (&dst, sink->image_format,
+                                   a_frame->xv_image)) {
+        return FALSE ;
+    }
+    if (a_this->scaler && !sink->row_funcs) {
+        if (!yuv_planes_from_frame (&src, a_this->format,
+                                    a_this->width, a_this->height,
+                                    (unsigned char*)a_frame->data)) {
+            return FALSE ;
+        }
+        scaler_scale (a_this->scaler, &src, &dst) ;
+        return TRUE ;
+    }
+    if (a_this->scaler) {
+        if (!sink_scale_frame (a_this, a_frame, &src)) {
+            return FALSE ;
+        }
+    } else if (!yuv_planes_from_frame (&src, a_this->format,
+                                       a_this->width, a_this->height,
+                                       (unsigned char*)a_frame->data)) {
+        return FALSE ;
+    }
+    if (sink->row_funcs) {
+        repack_yuv_frame (&src, &dst, sink->row_funcs, sink->repack_tmp) ;
+    } else {
+        copy_yuv_planes (&src, &dst) ;
+    }
+    return TRUE ;
+}
+
+#ifdef HAVE_XCB_XV
+
+/*
+ * check that the a_nb oldest puts sent through XCB went through.
+ * The first check waits for the XServer to catch up with it, the
+ * next ones are answered by then.
+ */
+static void
+xv_sink_check_puts (struct xv_sink_t *a_sink, int a_nb)
+{
+    xcb_generic_error_t *error=NULL ;
+    int slot=0 ;
+
+    while (a_nb-- > 0 && a_sink->nb_pending_puts) {
+        slot = a_sink->first_pending_put ;
+        error = xcb_request_check (a_sink->xcb,
+                                   a_sink->pending_puts[slot].cookie) ;
+        if (error) {
+            LOG_ERROR ("putting frame %d failed with X error %d\n",
+                       a_sink->pending_puts[slot].index,
+                       error->error_code) ;
+            a_sink->nb_put_errors++ ;
+            free (error) ;
+        }
+        a_sink->first_pending_put = (slot + 1) % XCB_MAX_PENDING_PUTS ;
+        a_sink->nb_pending_puts-- ;
+    }
+}
+
+/*
+ * put_frame of the xv sink in XCB mode: the put is a checked request
+ * which error, if any, is only looked at a few frames later, so that
+ * frames never wait for the XServer to answer.
+ */
+static enum bool_t
+xv_sink_xcb_put_frame (struct xv_sink_t *a_sink, struct frame_t *a_frame)
+{
+    struct sink_geometry_t *g = &a_sink->base.geometry ;
+    XvImage *image = a_frame->xv_image ;
+    xcb_gcontext_t gc = XGContextFromGC (a_sink->gc) ;
+    xcb_void_cookie_t cookie ;
+    int slot=0 ;
+
+    if (a_sink->nb_pending_puts == XCB_MAX_PENDING_PUTS) {
+        xv_sink_check_puts (a_sink, XCB_MAX_PENDING_PUTS / 2) ;
+    }
+    /*so that the SHM attachment and the like go out before the put*/
+    XFlush (a_sink->base.display) ;
+    if (a_frame->has_shm) {
+        cookie = xcb_xv_shm_put_image_checked
+                    (a_sink->xcb, a_sink->xv_port, a_sink->base.window, gc,
+                     a_frame->shm_info.shmseg, image->id,
+                     image->data - a_frame->shm_info.shmaddr,
+                     g->src_x, g->src_y, g->src_width, g->src_height,
+                     g->dst_x, g->dst_y, g->dst_width, g->dst_height,
+                     image->width, image->height, 1) ;
+        a_frame->shm_pending = TRUE ;
+    } else {
+        cookie = xcb_xv_put_image_checked
+                    (a_sink->xcb, a_sink->xv_port, a_sink->base.window, gc,
+                     image->id,
+                     g->src_x, g->src_y, g->src_width, g->src_height,
+                     g->dst_x, g->dst_y, g->dst_width, g->dst_height,
+                     image->width, image->height, image->data_size,
+                     (const uint8_t*)(a_sink->needs_upload ? image->data
+                                                           : a_frame->data)) ;
+    }
+    slot = (a_sink->first_pending_put + a_sink->nb_pending_puts)
+           % XCB_MAX_PENDING_PUTS ;
+    a_sink->pending_puts[slot].cookie = cookie ;
+    a_sink->pending_puts[slot].index = a_frame->index ;
+    a_sink->nb_pending_puts++ ;
+    return TRUE ;
+}
+
+#endif /*HAVE_XCB_XV*/
+
+static enum bool_t
+xv_sink_put_frame (struct sink_t *a_this, struct frame_t *a_frame)
+{
+    struct xv_sink_t *sink = (struct xv_sink_t*)a_this ;
+    struct sink_geometry_t *g = &a_this->geometry ;
+
+    RETURN_VAL_IF_FAIL (a_frame && a_frame->xv_image, FALSE) ;
+
+#ifdef HAVE_XCB_XV
+    if (sink->xcb) {
+        return xv_sink_xcb_put_frame (sink, a_frame) ;
+    }
+#endif
+    if (a_frame->has_shm) {
+        XvShmPutImage (a_this->display, sink->xv_port, a_this->window,
+                       sink->gc, a_frame->xv_image,
+                       g->src_x, g->src_y, g->src_width, g->src_height,
+                       g->dst_x, g->dst_y, g->dst_width, g->dst_height,
+                       True) ;
+        a_frame->shm_pending = TRUE ;
+    } else {
+        if (!sink->needs_upload) {
+            a_frame->xv_image->data = a_frame->data ;
+        }
+        XvPutImage (a_this->display, sink->xv_port, a_this->window,
+                    sink->gc, a_frame->xv_image,
+                    g->src_x, g->src_y, g->src_width, g->src_height,
+                    g->dst_x, g->dst_y, g->dst_width, g->dst_height) ;
+    }
+    return TRUE ;
+}
+
+static void
+xv_sink_dump_stats (struct sink_t *a_this, FILE *a_out)
+{
+    struct xv_sink_t *sink = (struct xv_sink_t*)a_this ;
+
+#ifdef HAVE_XCB_XV
+    if (sink->xcb) {
+        xv_sink_check_puts (sink, sink->nb_pending_puts) ;
+        fprintf (a_out, "xv: port probed through xcb in %.3f ms, "
+                 "%lu puts failed\n",
+                 sink->probe_ns / 1e6, sink->nb_put_errors) ;
+        return ;
+    }
+#endif
+    fprintf (a_out, "xv: port probed through xlib in %.3f ms\n",
+             sink->probe_ns / 1e6) ;
+}
+
+static void
+xv_sink_destroy (struct sink_t *a_this)
+{
+    struct xv_sink_t *sink = (struct xv_sink_t*)a_this ;
+
+#ifdef HAVE_XCB_XV
+    if (sink->xcb) {
+        xv_sink_check_puts (sink, sink->nb_pending_puts) ;
+    }
+#endif
+    if (sink->gc) {
+        XFreeGC (a_this->display, sink->gc) ;
+        sink->gc = 0 ;
+    }
+    if (sink->has_port) {
+        release_xv_port (a_this->display, sink->xv_port) ;
+        sink->has_port = FALSE ;
+    }
+    if (sink->repack_tmp) {
+        free (sink->repack_tmp) ;
+        sink->repack_tmp = NULL ;
+    }
+}
+
+/**
+ * a sink putting frames on a_window through the first
+ * Xv adaptor port we can grab.
+ */
+struct sink_t*
+xv_sink_new (Display *a_display,
+             Window a_window,
+             const struct sink_geometry_t *a_geometry,
+             enum yuv_format_t a_format,
+             unsigned a_width,
+             unsigned a_height,
+             const struct sink_options_t *a_options)
+{
+    struct xv_sink_t *sink=NULL ;
+    enum bool_t has_probe=FALSE, can_scale=FALSE, matches_layout=FALSE ;
+    XGCValues gc_values ;
+    int64_t start=0 ;
+
+    RETURN_VAL_IF_FAIL (a_display && a_geometry, NULL) ;
+
+    sink = calloc (1, sizeof (struct xv_sink_t)) ;
+    if (!sink) {
+        return NULL ;
+    }
+    sink_init (&sink->base, "xv", a_display, a_window, a_geometry,
+               a_format, a_width, a_height, a_options) ;
+    sink->base.alloc_frame = xv_frame_alloc ;
+    sink->base.free_frame = xv_frame_free ;
+    sink->base.put_frame = xv_sink_put_frame ;
+    sink->base.flush = x_sink_flush ;
+    sink->base.dump_stats = xv_sink_dump_stats ;
+    sink->base.destroy = xv_sink_destroy ;
+
+#ifdef HAVE_XCB_XV
+    if (sink->base.options.xcb) {
+        struct xv_port_probe_t probe ;
+
+        if (!xcb_probe_xv_port (a_display, a_window, a_format,
+                                a_width, a_height, a_geometry, &probe)) {
+            LOG_ERROR ("could not get xv port\n") ;
+            goto error ;
+        }
+        has_probe = TRUE ;
+        sink->xv_port = probe.port ;
+        sink->has_port = TRUE ;
+        sink->image_format = probe.image_format ;
+        sink->probe_ns = probe.probe_ns ;
+        can_scale = probe.can_scale ;
+        matches_layout = probe.matches_layout ;
+        sink->xcb = XGetXCBConnection (a_display) ;
+        LOG ("Got xv port: %d, with %d attributes\n",
+             (int)sink->xv_port, probe.nb_attributes) ;
+    }
+#endif
+    if (!has_probe) {
+        start = get_monotonic_ns () ;
+        if (!get_xv_port (a_display, (Drawable)a_window, &sink->xv_port)) {
+            LOG_ERROR ("could not get xv port\n") ;
+            goto error ;
+        }
+        sink->has_port = TRUE ;
+        LOG ("Got xv port: %d\n", sink->xv_port) ;
+
+        if (!choose_xv_image_format (a_display, sink->xv_port, a_format,
+                                     &sink->image_format)) {
+            LOG_ERROR ("the xv port supports no format %s frames "
+                       "can be repacked to\n",
+                       yuv_format_get_info (a_format)->name) ;
+            goto error ;
+        }
+        can_scale = xv_port_can_scale (a_display, sink->xv_port, a_geometry) ;
+        sink->probe_ns = get_monotonic_ns () - start ;
+    }
+    if (!sink_setup_scaler (&sink->base, can_scale)) {
+        goto error ;
+    }
+    if (sink->image_format != a_format) {
+        sink->needs_upload = TRUE ;
+        sink->row_funcs = select_yuv_row_funcs (sink->base.options.no_simd) ;
+        sink->repack_tmp = malloc (2 * (a_width > sink->base.image_width
+                                             ? a_width
+                                             : sink->base.image_width)) ;
+        if (!sink->repack_tmp) {
+            goto error ;
+        }
+        sink->base.upload_mode = sink->base.scaler
+                                 ? "client scaling and repack" : "repack" ;
+        LOG ("repacking %s frames to %s with %s code\n",
+             yuv_format_get_info (a_format)->name,
+             yuv_format_get_info (sink->image_format)->name,
+             sink->row_funcs->name) ;
+    } else if (sink->base.scaler) {
+        sink->needs_upload = TRUE ;
+        sink->base.upload_mode = "client scaling" ;
+    } else if (!(has_probe ? matches_layout
+                           : xv_port_matches_yuv_layout (a_display,
+                                                         sink->xv_port,
+                                                         a_format,
+                                                         a_width,
+                                                         a_height))) {
+        sink->needs_upload = TRUE ;
+        sink->base.upload_mode = "plane copy" ;
+        LOG ("copying %s frames into the padded planes of the adaptor\n",
+             yuv_format_get_info (a_format)->name) ;
+    } else {
+        LOG ("putting %s frames as they are\n",
+             yuv_format_get_info (a_format)->name) ;
+    }
+    if (sink->needs_upload) {
+        sink->base.upload_frame = xv_sink_upload_frame ;
+    }
+
+    sink->gc = XCreateGC (a_display, a_window, 0L, &gc_values) ;
+    if (!sink->gc) {
+        LOG_ERROR ("failed to create gc \n") ;
+        goto error ;
+    }
+    sink->use_shm = !sink->base.options.no_shm && can_use_shm (a_display) ;
+    if (sink->use_shm) {
+        LOG ("using XvShmPutImage\n") ;
+    } else {
+        LOG ("using XvPutImage\n") ;
+    }
+    if (!sink->needs_upload) {
+        /*frames are read right into the SHM segments, or put from the source*/
+        sink->base.upload_mode = sink->use_shm ? "read into shm"
+                                               : "zero copy" ;
+    }
+    return &sink->base ;
+
+error:
+    sink_destroy (&sink->base) ;
+    return NULL ;
+}
+
+/**
+ * frame_alloc_func_t of the XImage sink.
+ * The frame buffer keeps the yuv frame, and the frame gets an
+ * XImage of the same size its pixels are converted into, in a
+ * SHM segment if possible.
+ */
+enum bool_t
+ximage_frame_alloc (struct frame_pool_t *a_pool,
+                    struct frame_t *a_frame)
+{
+    struct ximage_sink_t *sink=NULL ;
+    XImage *ximage=NULL ;
+
+    RETURN_VAL_IF_FAIL (a_pool && a_pool->user_data && a_frame, FALSE) ;
+
+    sink = a_pool->user_data ;
+    if (!frame_alloc_aligned (a_pool, a_frame, a_pool->frame_len)) {
+        return FALSE ;
+    }
+    if (sink->use_shm) {
+        ximage = XShmCreateImage (sink->base.display, sink->visual,
+                                  sink->depth, ZPixmap, NULL,
+                                  &a_frame->shm_info,
+                                  sink->base.image_width,
+                                  sink->base.image_height) ;
+        if (ximage
+            && !attach_shm_segment (sink->base.display, &a_frame->shm_info,
+                                    ximage->bytes_per_line * ximage->height)) {
+            XDestroyImage (ximage) ;
+            ximage = NULL ;
+        }
+        if (ximage) {
+            ximage->data = a_frame->shm_info.shmaddr ;
+            a_frame->has_shm = TRUE ;
+            goto out ;
+        }
+        LOG ("falling back to XPutImage\n") ;
+        sink->use_shm = FALSE ;
+    }
+    ximage = XCreateImage (sink->base.display, sink->visual, sink->depth,
+                           ZPixmap, 0, NULL,
+                           sink->base.image_width, sink->base.image_height,
+                           32, 0) ;
+    if (!ximage) {
+        LOG_ERROR ("failed to create image\n") ;
+        goto error ;
+    }
+    /*XDestroyImage() free()s this*/
+    ximage->data = malloc (ximage->bytes_per_line * ximage->height) ;
+    if (!ximage->data) {
+        XDestroyImage (ximage) ;
+        goto error ;
+    }
+
+out:
+    a_pool->nb_allocated_bytes += ximage->bytes_per_line * ximage->height ;
+    a_frame->ximage = ximage ;
+    if (sink->use_present) {
+        sink->pool = a_pool ;
+        a_frame->pixmap = XCreatePixmap (sink->base.display, sink->base.window,
+                                         sink->pixmap_width,
+                                         sink->pixmap_height, sink->depth) ;
+        a_frame->pixmap_is_stale = TRUE ;
+    }
+    return TRUE ;
+
+error:
+    frame_free_aligned (a_pool, a_frame) ;
+    return FALSE ;
+}
+
+void
+ximage_frame_free (struct frame_pool_t *a_pool,
+                   struct frame_t *a_frame)
+{
+    struct ximage_sink_t *sink=NULL ;
+
+    RETURN_IF_FAIL (a_pool && a_pool->user_data && a_frame) ;
+
+    sink = a_pool->user_data ;
+    if (a_frame->pixmap) {
+        /*the server keeps it until it is done presenting it*/
+        XFreePixmap (sink->base.display, a_frame->pixmap) ;
+        a_frame->pixmap = None ;
+        a_frame->nb_presents_pending = 0 ;
+    }
+    if (a_frame->ximage) {
+        if (a_frame->has_shm) {
+            wait_for_shm_completion (sink->base.display, a_frame) ;
+            detach_shm_segment (sink->base.display, &a_frame->shm_info) ;
+            a_frame->ximage->data = NULL ;
+            a_frame->has_shm = FALSE ;
+        }
+        XDestroyImage (a_frame->ximage) ;
+        a_frame->ximage = NULL ;
+    }
+    frame_free_aligned (a_pool, a_frame) ;
+}
+
+/*
+ * converts the frame into the RGB pixels of its XImage, scaling
+ * it first if need be.
+ */
+static enum bool_t
+ximage_sink_upload_frame (struct sink_t *a_this, struct frame_t *a_frame)
+{
+    struct ximage_sink_t *sink = (struct ximage_sink_t*)a_this ;
+    unsigned char *i420_frame=NULL ;
+    struct yuv_planes_t src, dst ;
+
+    RETURN_VAL_IF_FAIL (a_frame && a_frame->ximage, FALSE) ;
+
+    i420_frame = (unsigned char*)a_frame->data ;
+    if (a_this->scaler) {
+        if (!sink_scale_frame (a_this, a_frame, &src)) {
+            return FALSE ;
+        }
+        i420_frame = a_this->scaled_frame ;
+    } else if (sink->i420_frame
+               && !yuv_planes_from_frame (&src, a_this->format,
+                                          a_this->width, a_this->height,
+                                          i420_frame)) {
+        return FALSE ;
+    }
+    if (sink->i420_frame) {
+        yuv_planes_from_frame (&dst, YUV_FORMAT_420_PLANAR,
+                               a_this->image_width, a_this->image_height,
+                               sink->i420_frame) ;
+        repack_yuv_frame (&src, &dst, sink->row_funcs, sink->repack_tmp) ;
+        i420_frame = sink->i420_frame ;
+    }
+    convert_i420_to_rgb32 (i420_frame,
+                           a_this->image_width, a_this->image_height,
+                           (unsigned char*)a_frame->ximage->data,
+                           a_frame->ximage->bytes_per_line,
+                           sink->order, sink->convert_row) ;
+    a_frame->pixmap_is_stale = TRUE ;
+    return TRUE ;
+}
+
+static enum bool_t
+ximage_sink_put_frame (struct sink_t *a_this, struct frame_t *a_frame)
+{
+    struct ximage_sink_t *sink = (struct ximage_sink_t*)a_this ;
+    struct sink_geometry_t *g = &a_this->geometry ;
+
+    RETURN_VAL_IF_FAIL (a_frame && a_frame->ximage, FALSE) ;
+
+    if (a_frame->has_shm) {
+        XShmPutImage (a_this->display, a_this->window, sink->gc,
+                      a_frame->ximage,
+                      g->src_x, g->src_y, g->dst_x, g->dst_y,
+                      g->src_width, g->src_height, True) ;
+        a_frame->shm_pending = TRUE ;
+    } else {
+        XPutImage (a_this->display, a_this->window, sink->gc,
+                   a_frame->ximage,
+                   g->src_x, g->src_y, g->dst_x, g->dst_y,
+                   g->src_width, g->src_height) ;
+    }
+    return TRUE ;
+}
+
+static void
+ximage_sink_destroy (struct sink_t *a_this)
+{
+    struct ximage_sink_t *sink = (struct ximage_sink_t*)a_this ;
+
+    if (sink->gc) {
+        XFreeGC (a_this->display, sink->gc) ;
+        sink->gc = 0 ;
+    }
+    if (sink->i420_frame) {
+        free (sink->i420_frame) ;
+        sink->i420_frame = NULL ;
+    }
+    if (sink->repack_tmp) {
+        free (sink->repack_tmp) ;
+        sink->repack_tmp = NULL ;
+    }
+}
+
+#ifdef HAVE_XPRESENT
+
+static Bool
+is_present_event (Display *a_display, XEvent *a_event, XPointer a_data)
+{
+    return a_event->type == GenericEvent
+        && a_event->xcookie.extension == present_opcode ;
+}
+
+/*
+ * block until the XServer is done showing the pixmap of a_frame,
+ * handling the Present events which come in meanwhile. That is
+ * what keeps us from queuing more frames than the server shows.
+ */
+static void
+present_sink_wait_for_idle (struct ximage_sink_t *a_sink,
+                            struct frame_t *a_frame)
+{
+    XEvent event ;
+    int64_t start=0 ;
+
+    if (a_frame->nb_presents_pending <= 0) {
+        return ;
+    }
+    start = get_monotonic_ns () ;
+    while (a_frame->nb_presents_pending > 0) {
+        XIfEvent (a_sink->base.display, &event, is_present_event, NULL) ;
+        if (sink_event_func) {
+            sink_event_func (&event) ;
+        } else {
+            XGenericEventCookie cookie = event.xcookie ;
+
+            if (XGetEventData (cookie.display, &cookie)) {
+                a_sink->base.process_event (&a_sink->base, &cookie) ;
+                XFreeEventData (cookie.display, &cookie) ;
+            }
+        }
+    }
+    a_sink->nb_idle_waits++ ;
+    a_sink->idle_wait_ns += get_monotonic_ns () - start ;
+}
+
+/*
+ * the msc of the first vblank at or after the deadline of a_frame,
+ * from the last completion and the measured refresh period. Frames
+ * without a deadline, or put before the period is known, go to the
+ * vblank following the previous present.
+ */
+static uint64_t
+present_sink_get_target_msc (struct ximage_sink_t *a_sink,
+                             const struct frame_t *a_frame)
+{
+    int64_t delta_us=0, period=a_sink->refresh_us, nb_vblanks=0 ;
+
+    if (!a_frame->deadline_ns || !period || !a_sink->last_msc) {
+        return a_sink->next_msc ;
+    }
+    /*both the UST and our deadlines are CLOCK_MONOTONIC*/
+    delta_us = a_frame->deadline_ns / 1000 - (int64_t)a_sink->last_ust ;
+    if (delta_us >= 0) {
+        nb_vblanks = (delta_us + period - 1) / period ;
+    } else {
+        /*already late, it still is due at the vblank it missed*/
+        nb_vblanks = -(-delta_us / period) ;
+    }
+    if ((int64_t)a_sink->last_msc + nb_vblanks < 1) {
+        return 1 ;
+    }
+    return a_sink->last_msc + nb_vblanks ;
+}
+
+/*
+ * draws the image of the frame to its pixmap unless it is there
+ * already, e.g. for a redraw, and presents the pixmap at the vblank
+ * its deadline falls on, or at the one following the previous present
+ * for frames which are not paced.
+ */
+static enum bool_t
+present_sink_put_frame (struct sink_t *a_this, struct frame_t *a_frame)
+{
+    struct ximage_sink_t *sink = (struct ximage_sink_t*)a_this ;
+    struct sink_geometry_t *g = &a_this->geometry ;
+    uint64_t target=0 ;
+    int slot=0 ;
+
+    RETURN_VAL_IF_FAIL (a_frame && a_frame->ximage && a_frame->pixmap,
+                        FALSE) ;
+
+    if (a_frame->pixmap_is_stale) {
+        present_sink_wait_for_idle (sink, a_frame) ;
+        if (a_frame->has_shm) {
+            XShmPutImage (a_this->display, a_frame->pixmap, sink->gc,
+                          a_frame->ximage, g->src_x, g->src_y, 0, 0,
+                          sink->pixmap_width, sink->pixmap_height, True) ;
+            a_frame->shm_pending = TRUE ;
+        } else {
+            XPutImage (a_this->display, a_frame->pixmap, sink->gc,
+                       a_frame->ximage, g->src_x, g->src_y, 0, 0,
+                       sink->pixmap_width, sink->pixmap_height) ;
+        }
+        a_frame->pixmap_is_stale = FALSE ;
+    }
+    /*serials tell the completions apart, 0 is left out*/
+    if (!++sink->present_serial) {
+        sink->present_serial++ ;
+    }
+    slot = sink->present_serial % PRESENT_NB_SERIALS ;
+    target = present_sink_get_target_msc (sink, a_frame) ;
+    sink->target_mscs[slot] = target ;
+    sink->frame_indices[slot] = a_frame->index ;
+    XPresentPixmap (a_this->display, a_this->window, a_frame->pixmap,
+                    sink->present_serial, None, None, g->dst_x, g->dst_y,
+                    None, None, None, PresentOptionNone,
+                    target, 0, 0, NULL, 0) ;
+    if (target && sink->next_msc <= target) {
+        sink->next_msc = target + 1 ;
+    }
+    a_frame->nb_presents_pending++ ;
+    sink->nb_presents++ ;
+    return TRUE ;
+}
+
+static void
+present_sink_process_complete (struct ximage_sink_t *a_sink,
+                               const XPresentCompleteNotifyEvent *a_event)
+{
+    uint64_t interval=0, target=0 ;
+    int slot = a_event->serial_number % PRESENT_NB_SERIALS ;
+
+    if (a_event->kind != PresentCompleteKindPixmap) {
+        return ;
+    }
+    a_sink->nb_completes++ ;
+    switch (a_event->mode) {
+        case PresentCompleteModeFlip:
+            a_sink->nb_flips++ ;
+            break ;
+        case PresentCompleteModeSkip:
+            /*a later present replaced it before its vblank*/
+            a_sink->nb_skips++ ;
+            LOG_FRAME ("frame %d was skipped by the XServer\n",
+                       a_sink->frame_indices[slot]) ;
+            return ;
+        default:
+            a_sink->nb_copies++ ;
+            break ;
+    }
+    target = a_sink->target_mscs[slot] ;
+    if (target && a_event->msc > target) {
+        a_sink->nb_late += 1 ;
+        a_sink->nb_missed_vblanks += a_event->msc - target ;
+    }
+    if (a_sink->last_ust && a_event->ust > a_sink->last_ust) {
+        interval = a_event->ust - a_sink->last_ust ;
+        if (!a_sink->nb_intervals || interval < a_sink->interval_min_us) {
+            a_sink->interval_min_us = interval ;
+        }
+        if (interval > a_sink->interval_max_us) {
+            a_sink->interval_max_us = interval ;
+        }
+        a_sink->interval_sum_us += interval ;
+        a_sink->nb_intervals++ ;
+        LOG_FRAME ("frame %d presented at msc %llu, %.3f ms after "
+                   "the previous one\n", a_sink->frame_indices[slot],
+                   (unsigned long long)a_event->msc, interval / 1e3) ;
+    }
+    a_sink->last_ust = a_event->ust ;
+    a_sink->last_msc = a_event->msc ;
+    if (!a_sink->first_msc) {
+        a_sink->first_ust = a_event->ust ;
+        a_sink->first_msc = a_event->msc ;
+    } else if (a_event->msc > a_sink->first_msc
+               && a_event->ust > a_sink->first_ust) {
+        /*averaged since the first completion, UST jitter fades out*/
+        a_sink->refresh_us = (a_event->ust - a_sink->first_ust)
+                             / (a_event->msc - a_sink->first_msc) ;
+    }
+    /*the frames queued from now on go to the vblanks that follow*/
+    if (a_sink->next_msc <= a_event->msc) {
+        a_sink->next_msc = a_event->msc + 1 ;
+    }
+}
+
+/*
+ * process_event callback of the present sink: the completions and
+ * idle notifications of the pixmaps presented to its window.
+ */
+static void
+present_sink_process_event (struct sink_t *a_this,
+                            const XGenericEventCookie *a_cookie)
+{
+    struct ximage_sink_t *sink = (struct ximage_sink_t*)a_this ;
+    const XPresentIdleNotifyEvent *idle=NULL ;
+    int i=0 ;
+
+    if (a_cookie->extension != present_opcode || !a_cookie->data) {
+        return ;
+    }
+    switch (a_cookie->evtype) {
+        case PresentCompleteNotify:
+            if (((XPresentCompleteNotifyEvent*)a_cookie->data)->window
+                == a_this->window) {
+                present_sink_process_complete (sink, a_cookie->data) ;
+            }
+            break ;
+        case PresentIdleNotify:
+            idle = a_cookie->data ;
+            if (idle->window != a_this->window || !sink->pool) {
+                break ;
+            }
+            for (i=0 ; i < sink->pool->nb_frames ; i++) {
+                if (sink->pool->frames[i].pixmap == idle->pixmap) {
+                    if (sink->pool->frames[i].nb_presents_pending > 0) {
+                        sink->pool->frames[i].nb_presents_pending-- ;
+                    }
+                    break ;
+                }
+            }
+            break ;
+    }
+}
+
+static void
+present_sink_dump_stats (struct sink_t *a_this, FILE *a_out)
+{
+    struct ximage_sink_t *sink = (struct ximage_sink_t*)a_this ;
+
+    fprintf (a_out, "present: %lu presents, %lu completed: %lu flips, "
+             "%lu copies, %lu skipped\n",
+             sink->nb_presents, sink->nb_completes, sink->nb_flips,
+             sink->nb_copies, sink->nb_skips) ;
+    if (sink->nb_intervals) {
+        fprintf (a_out, "present: present to present interval: "
+                 "min %.3f ms, mean %.3f ms, max %.3f ms\n",
+                 sink->interval_min_us / 1e3,
+                 sink->interval_sum_us / 1e3 / sink->nb_intervals,
+                 sink->interval_max_us / 1e3) ;
+    }
+    fprintf (a_out, "present: %lu frames late for their vblank, "
+             "by %lu vblanks in all\n",
+             sink->nb_late, sink->nb_missed_vblanks) ;
+    fprintf (a_out, "present: waited %lu times for an idle pixmap, "
+             "%.3f ms in all\n",
+             sink->nb_idle_waits, sink->idle_wait_ns / 1e6) ;
+}
+
+static void
+present_sink_destroy (struct sink_t *a_this)
+{
+    struct ximage_sink_t *sink = (struct ximage_sink_t*)a_this ;
+
+    if (sink->present_eid) {
+        XPresentFreeInput (a_this->display, a_this->window,
+                           sink->present_eid) ;
+        sink->present_eid = 0 ;
+    }
+    ximage_sink_destroy (a_this) ;
+}
+
+#endif /*HAVE_XPRESENT*/
+
+/**
+ * a sink converting frames to RGB and putting them with core
+ * XPutImage or XShmPutImage, which any XServer supports.
+ * Core X does not scale, so frames are scaled here to the
+ * destination size.
+ * Frames in other formats than I420 are repacked to I420 first.
+ * Only 24 bits little endian TrueColor visuals are supported,
+ * with red in either the low or the high byte.
+ */
+struct sink_t*
+ximage_sink_new (Display *a_display,
+                 Window a_window,
+                 const struct sink_geometry_t *a_geometry,
+                 enum yuv_format_t a_format,
+                 unsigned a_width,
+                 unsigned a_height,
+                 const struct sink_options_t *a_options)
+{
+    struct ximage_sink_t *sink=NULL ;
+    XGCValues gc_values ;
+    Visual *visual=NULL ;
+    enum rgb_order_t order=RGB_ORDER_BGRX ;
+    int screen=0 ;
+    unsigned i420_len=0 ;
+
+    RETURN_VAL_IF_FAIL (a_display && a_geometry, NULL) ;
+
+    screen = DefaultScreen (a_display) ;
+    visual = DefaultVisual (a_display, screen) ;
+    if (visual->class != TrueColor
+        || DefaultDepth (a_display, screen) != 24
+        || visual->green_mask != 0xff00
+        || ImageByteOrder (a_display) != LSBFirst) {
+        LOG_ERROR ("the ximage sink needs a 24 bits BGRX or RGBX visual\n") ;
+        return NULL ;
+    }
+    if (visual->red_mask == 0xff0000 && visual->blue_mask == 0xff) {
+        order = RGB_ORDER_BGRX ;
+    } else if (visual->red_mask == 0xff && visual->blue_mask == 0xff0000) {
+        order = RGB_ORDER_RGBX ;
+    } else {
+        LOG_ERROR ("the ximage sink needs a 24 bits BGRX or RGBX visual\n") ;
+        return NULL ;
+    }
+    sink = calloc (1, sizeof (struct ximage_sink_t)) ;
+    if (!sink) {
+        return NULL ;
+    }
+    sink_init (&sink->base, "ximage", a_display, a_window, a_geometry,
+               a_format, a_width, a_height, a_options) ;
+    sink->base.alloc_frame = ximage_frame_alloc ;
+    sink->base.free_frame = ximage_frame_free ;
+    sink->base.upload_frame = ximage_sink_upload_frame ;
+    sink->base.upload_mode = "rgb conversion" ;
+    sink->base.put_frame = ximage_sink_put_frame ;
+    sink->base.flush = x_sink_flush ;
+    sink->base.destroy = ximage_sink_destroy ;
+    sink->visual = visual ;
+    sink->depth = 24 ;
+    sink->order = order ;
+    sink->convert_row = select_i420_row_to_rgb32 (sink->base.options.no_simd) ;
+    if (!sink_setup_scaler (&sink->base, FALSE)) {
+        sink_destroy (&sink->base) ;
+        return NULL ;
+    }
+    if (sink->base.scaler) {
+        sink->base.upload_mode = "client scaling and rgb conversion" ;
+    }
+    if (a_format != YUV_FORMAT_420_PLANAR) {
+        compute_yuv_image_size (YUV_FORMAT_420_PLANAR,
+                                sink->base.image_width,
+                                sink->base.image_height, &i420_len) ;
+        sink->i420_frame = malloc (i420_len) ;
+        sink->repack_tmp = malloc (2 * (a_width > sink->base.image_width
+                                             ? a_width
+                                             : sink->base.image_width)) ;
+        if (!sink->i420_frame || !sink->repack_tmp) {
+            sink_destroy (&sink->base) ;
+            return NULL ;
+        }
+        sink->row_funcs = select_yuv_row_funcs (sink->base.options.no_simd) ;
+        sink->base.upload_mode = sink->base.scaler
+                                 ? "client scaling, repack and rgb conversion"
+                                 : "repack and rgb conversion" ;
+    }
+
+    sink->gc = XCreateGC (a_display, a_window, 0L, &gc_values) ;
+    if (!sink->gc) {
+        LOG_ERROR ("failed to create gc \n") ;
+        sink_destroy (&sink->base) ;
+        return NULL ;
+    }
+    sink->use_shm = !sink->base.options.no_shm && can_use_shm (a_display) ;
+    if (sink->use_shm) {
+        LOG ("using XShmPutImage\n") ;
+    } else {
+        LOG ("using XPutImage\n") ;
+    }
+    return &sink->base ;
+}
+
+/**
+ * a sink converting frames to RGB like the ximage sink, which draws
+ * them to a pixmap per frame and presents those at the vblanks with
+ * the Present extension, rather than putting them to the window
+ * whenever they come. The pixmaps are drawn to again once the
+ * XServer tells they are idle, which bounds the frames queued to it.
+ */
+struct sink_t*
+present_sink_new (Display *a_display,
+                  Window a_window,
+                  const struct sink_geometry_t *a_geometry,
+                  enum yuv_format_t a_format,
+                  unsigned a_width,
+                  unsigned a_height,
+                  const struct sink_options_t *a_options)
+{
+#ifdef HAVE_XPRESENT
+    struct ximage_sink_t *sink=NULL ;
+    struct sink_geometry_t *g=NULL ;
+    int event_base=0, error_base=0 ;
+
+    RETURN_VAL_IF_FAIL (a_display && a_geometry, NULL) ;
+
+    if (!XPresentQueryExtension (a_display, &present_opcode,
+                                 &event_base, &error_base)) {
+        LOG_ERROR ("the XServer does not support the Present extension\n") ;
+        return NULL ;
+    }
+    sink = (struct ximage_sink_t*)ximage_sink_new (a_display, a_window,
+                                                   a_geometry, a_format,
+                                                   a_width, a_height,
+                                                   a_options) ;
+    if (!sink) {
+        return NULL ;
+    }
+    sink->base.name = "present" ;
+    sink->base.put_frame = present_sink_put_frame ;
+    sink->base.process_event = present_sink_process_event ;
+    sink->base.dump_stats = present_sink_dump_stats ;
+    sink->base.destroy = present_sink_destroy ;
+    sink->use_present = TRUE ;
+    /*the pixmaps hold the src rectangle of the images*/
+    g = &sink->base.geometry ;
+    sink->pixmap_width = g->src_width ;
+    if (g->src_x + sink->pixmap_width > sink->base.image_width) {
+        sink->pixmap_width = g->src_x < (int)sink->base.image_width
+                             ? sink->base.image_width - g->src_x : 1 ;
+    }
+    sink->pixmap_height = g->src_height ;
+    if (g->src_y + sink->pixmap_height > sink->base.image_height) {
+        sink->pixmap_height = g->src_y < (int)sink->base.image_height
+                              ? sink->base.image_height - g->src_y : 1 ;
+    }
+    sink->present_eid = XPresentSelectInput (a_display, a_window,
+                                             PresentCompleteNotifyMask
+                                             | PresentIdleNotifyMask) ;
+    LOG ("presenting %ux%u pixmaps at the vblanks\n",
+         sink->pixmap_width, sink->pixmap_height) ;
+    return &sink->base ;
+#else
+    LOG_ERROR ("the present sink was not built in, "
+               "libXpresent was not found\n") ;
+    return NULL ;
+#endif
+}
+
+static enum bool_t
+null_sink_put_frame (struct sink_t *a_this, struct frame_t *a_frame)
+{
+    return TRUE ;
+}
+
+/**
+ * a sink discarding frames, to measure the pipeline
+ * feeding the sinks on its own, scaling included.
+ */
+struct sink_t*
+null_sink_new (const struct sink_geometry_t *a_geometry,
+               enum yuv_format_t a_format,
+               unsigned a_width,
+               unsigned a_height,
+               const struct sink_options_t *a_options)
+{
+    struct sink_t *sink=NULL ;
+
+    RETURN_VAL_IF_FAIL (a_geometry, NULL) ;
+
+    sink = calloc (1, sizeof (struct sink_t)) ;
+    if (!sink) {
+        return NULL ;
+    }
+    sink_init (sink, "null", NULL, 0, a_geometry,
+               a_format, a_width, a_height, a_options) ;
+    sink->put_frame = null_sink_put_frame ;
+    if (!sink_setup_scaler (sink, FALSE)) {
+        sink_destroy (sink) ;
+        return NULL ;
+    }
+    if (sink->scaler) {
+        sink->upload_frame = sink_scale_upload_frame ;
+        sink->upload_mode = "client scaling" ;
+    }
+    return sink ;
+}
+
+static enum bool_t
+file_sink_put_frame (struct sink_t *a_this, struct frame_t *a_frame)
+{
+    struct file_sink_t *sink = (struct file_sink_t*)a_this ;
+    const unsigned char *data = (const unsigned char*)a_frame->data ;
+    unsigned nb_written=0, len=a_frame->len ;
+    ssize_t nb=0 ;
+
+    if (a_this->scaler) {
+        data = a_this->scaled_frame ;
+        compute_yuv_image_size (a_this->format, a_this->image_width,
+                                a_this->image_height, &len) ;
+    }
+    while (nb_written < len) {
+        nb = write (sink->fd, data + nb_written, len - nb_written) ;
+        if (nb < 0) {
+            if (errno == EINTR) {
+                continue ;
+            }
+            LOG_ERROR ("write failed: %s\n", strerror (errno)) ;
+            return FALSE ;
+        }
+        nb_written += nb ;
+    }
+    return TRUE ;
+}
+
+static void
+file_sink_flush (struct sink_t *a_this, enum bool_t a_sync)
+{
+    struct file_sink_t *sink = (struct file_sink_t*)a_this ;
+
+    if (a_sync) {
+        fdatasync (sink->fd) ;
+    }
+}
+
+static void
+file_sink_destroy (struct sink_t *a_this)
+{
+    struct file_sink_t *sink = (struct file_sink_t*)a_this ;
+
+    if (sink->fd >= 0) {
+        close (sink->fd) ;
+        sink->fd = -1 ;
+    }
+}
+
+/**
+ * a sink writing raw frames to the file at a_path,
+ * which plays back like the input. Frames are scaled to the
+ * dst size first if it differs from the src size.
+ */
+struct sink_t*
+file_sink_new (const char *a_path,
+               const struct sink_geometry_t *a_geometry,
+               enum yuv_format_t a_format,
+               unsigned a_width,
+               unsigned a_height,
+               const struct sink_options_t *a_options)
+{
+    struct file_sink_t *sink=NULL ;
+
+    RETURN_VAL_IF_FAIL (a_path && a_geometry, NULL) ;
+
+    sink = calloc (1, sizeof (struct file_sink_t)) ;
+    if (!sink) {
+        return NULL ;
+    }
+    sink_init (&sink->base, "file", NULL, 0, a_geometry,
+               a_format, a_width, a_height, a_options) ;
+    sink->base.put_frame = file_sink_put_frame ;
+    sink->base.flush = file_sink_flush ;
+    sink->base.destroy = file_sink_destroy ;
+    sink->fd = -1 ;
+    if (!sink_setup_scaler (&sink->base, FALSE)) {
+        sink_destroy (&sink->base) ;
+        return NULL ;
+    }
+    if (sink->base.scaler) {
+        sink->base.upload_frame = sink_scale_upload_frame ;
+        sink->base.upload_mode = "client scaling" ;
+    }
+    sink->fd = open (a_path, O_WRONLY|O_CREAT|O_TRUNC, 0644) ;
+    if (sink->fd < 0) {
+        LOG_ERROR ("could not open '%s': %s\n", a_path, strerror (errno)) ;
+        sink_destroy (&sink->base) ;
+        return NULL ;
+    }
+    return &sink->base ;
+}
+
+/**
+ * fill a_options with what sinks do by default: SIMD kernels, MIT-SHM
+ * when the XServer has it, and bilinear scaling where the output
+ * cannot scale.
+ */
+void
+sink_options_init (struct sink_options_t *a_options)
+{
+    RETURN_IF_FAIL (a_options) ;
+
+    memset (a_options, 0, sizeof (struct sink_options_t)) ;
+    a_options->scale_filter = SCALE_FILTER_BILINEAR ;
+}
+
+/**
+ * have a_func get the events sinks pull off the queue of their
+ * display, e.g. the Present completions of the other windows. With
+ * no such function, a sink only handles the events meant for itself.
+ */
+void
+sink_set_event_func (sink_event_func_t a_func)
+{
+    sink_event_func = a_func ;
+}
+
+struct sink_t*
+sink_new (enum sink_type_t a_type,
+          const char *a_path,
+          Display *a_display,
+          Window a_window,
+          const struct sink_geometry_t *a_geometry,
+          enum yuv_format_t a_format,
+          unsigned a_width,
+          unsigned a_height,
+          const struct sink_options_t *a_options)
+{
+    switch (a_type) {
+        case SINK_TYPE_XV:
+            return xv_sink_new (a_display, a_window, a_geometry,
+                                a_format, a_width, a_height, a_options) ;
+        case SINK_TYPE_XIMAGE:
+            return ximage_sink_new (a_display, a_window, a_geometry,
+                                    a_format, a_width, a_height, a_options) ;
+        case SINK_TYPE_PRESENT:
+            return present_sink_new (a_display, a_window, a_geometry,
+                                     a_format, a_width, a_height,
+                                     a_options) ;
+        case SINK_TYPE_NULL:
+            return null_sink_new (a_geometry, a_format, a_width, a_height,
+                                  a_options) ;
+        case SINK_TYPE_FILE:
+            return file_sink_new (a_path, a_geometry,
+                                  a_format, a_width, a_height, a_options) ;
+        default:
+            LOG_ERROR ("unknown sink type: %d\n", a_type) ;
+            return NULL ;
+    }
+}
+
+/**
+ * tells whether frames put to sinks of type a_type
+ * go to an XServer.
+ */
+enum bool_t
+sink_type_needs_display (enum sink_type_t a_type)
+{
+    return a_type == SINK_TYPE_XV || a_type == SINK_TYPE_XIMAGE
+        || a_type == SINK_TYPE_PRESENT ;
+}
+
+/*************************
+ * </sinks>
+ * ***********************/
@@ -0,0 +1,218 @@
+/*
+ * Copyright (C) 2007 OpenedHand Ltd
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * Author:
+ *   Dodji Seketeli <dodji@openedhand.com>
+ */
+
+/*
+ * run by make check: scales random frames of each format with each
+ * filter, cropped or not, and fails unless the AVX2 kernels give the
+ * bytes the scalar ones give.
+ */
+#include "xvplay-private.h"
+
+#define TEST_SEED 0x1b873593
+#define TEST_NB_ELEMENTS(a) (sizeof (a) / sizeof ((a)[0]))
+/*bytes around the frames, which the scaler must not write to*/
+#define TEST_GUARD 64
+
+struct test_case_t {
+    unsigned src_width ;
+    unsigned src_height ;
+    struct sink_geometry_t crop ;/*the source rectangle*/
+    unsigned dst_width ;
+    unsigned dst_height ;
+};
+
+/*
+ * widths the vectors of the kernels, 32 bytes of a line or 8
+ * samples, do not fill, odd crops, and sizes kept as they are, for
+ * the lines taken without filtering.
+ */
+static const struct test_case_t test_cases[] = {
+    {64, 48, {0, 0, 64, 48}, 37, 29},
+    {16, 16, {0, 0, 16, 16}, 9, 7},
+    {77, 45, {3, 5, 61, 33}, 101, 67},
+    {33, 18, {2, 2, 30, 14}, 30, 14},
+    {320, 240, {17, 9, 250, 190}, 203, 151},
+    {640, 360, {101, 51, 400, 200}, 719, 405},
+    {640, 360, {320, 180, 320, 180}, 320, 180},
+} ;
+static const enum scale_filter_t test_filters[] = {
+    SCALE_FILTER_NEAREST, SCALE_FILTER_BILINEAR, SCALE_FILTER_CUBIC
+} ;
+
+static uint32_t
+test_random (uint32_t *a_state)
+{
+    /*xorshift32, so that failures can be reproduced*/
+    *a_state ^= *a_state << 13 ;
+    *a_state ^= *a_state >> 17 ;
+    *a_state ^= *a_state << 5 ;
+    return *a_state ;
+}
+
+/*a frame of a_format between two guards*/
+struct test_frame_t {
+    unsigned char *buf ;
+    unsigned len ;
+    struct yuv_planes_t planes ;
+};
+
+static enum bool_t
+test_frame_init (struct test_frame_t *a_frame,
+                 enum yuv_format_t a_format,
+                 unsigned a_width,
+                 unsigned a_height)
+{
+    memset (a_frame, 0, sizeof (struct test_frame_t)) ;
+    if (!compute_yuv_image_size (a_format, a_width, a_height,
+                                 &a_frame->len)) {
+        return FALSE ;
+    }
+    a_frame->buf = malloc (a_frame->len + 2 * TEST_GUARD) ;
+    if (!a_frame->buf) {
+        return FALSE ;
+    }
+    memset (a_frame->buf, 0x5a, a_frame->len + 2 * TEST_GUARD) ;
+    return yuv_planes_from_frame (&a_frame->planes, a_format,
+                                  a_width, a_height,
+                                  a_frame->buf + TEST_GUARD) ;
+}
+
+static void
+test_frame_finalize (struct test_frame_t *a_frame)
+{
+    free (a_frame->buf) ;
+    a_frame->buf = NULL ;
+}
+
+/*
+ * scale a random frame of a_format as a_case says with a_filter,
+ * with the scalar kernels and with the AVX2 ones.
+ * FALSE if the outputs differ.
+ */
+static enum bool_t
+test_scale (enum yuv_format_t a_format,
+            const struct test_case_t *a_case,
+            enum scale_filter_t a_filter,
+            uint32_t *a_state)
+{
+    const struct yuv_format_info_t *info = yuv_format_get_info (a_format) ;
+    struct scaler_t *scalar=NULL, *avx2=NULL ;
+    struct test_frame_t src, expected, got ;
+    unsigned len=0, i=0 ;
+    enum bool_t is_ok=FALSE ;
+
+    memset (&src, 0, sizeof (src)) ;
+    memset (&expected, 0, sizeof (expected)) ;
+    memset (&got, 0, sizeof (got)) ;
+    scalar = scaler_new (a_format, a_case->src_width, a_case->src_height,
+                         &a_case->crop, a_case->dst_width,
+                         a_case->dst_height, a_filter, 1, TRUE) ;
+    avx2 = scaler_new (a_format, a_case->src_width, a_case->src_height,
+                       &a_case->crop, a_case->dst_width,
+                       a_case->dst_height, a_filter, 1, FALSE) ;
+    if (!scalar || !avx2
+        || !test_frame_init (&src, a_format,
+                             a_case->src_width, a_case->src_height)
+        || !test_frame_init (&expected, a_format,
+                             a_case->dst_width, a_case->dst_height)
+        || !test_frame_init (&got, a_format,
+                             a_case->dst_width, a_case->dst_height)) {
+        fprintf (stderr, "%s: could not set the scalers up\n", info->name) ;
+        goto out ;
+    }
+    for (i=0 ; i < src.len ; i++) {
+        src.buf[TEST_GUARD + i] = test_random (a_state) ;
+    }
+    scaler_scale (scalar, &src.planes, &expected.planes) ;
+    scaler_scale (avx2, &src.planes, &got.planes) ;
+    len = expected.len + 2 * TEST_GUARD ;
+    if (memcmp (expected.buf, got.buf, len)) {
+        for (i=0 ; i < len && expected.buf[i] == got.buf[i] ; i++) ;
+        fprintf (stderr, "%s, %s filter: %ux%u+%d+%d of %ux%u to %ux%u,"
+                 " byte %d of the frame is %u instead of %u\n",
+                 info->name, scale_filter_get_name (a_filter),
+                 a_case->crop.src_width, a_case->crop.src_height,
+                 a_case->crop.src_x, a_case->crop.src_y,
+                 a_case->src_width, a_case->src_height,
+                 a_case->dst_width, a_case->dst_height,
+                 (int)i - TEST_GUARD, got.buf[i], expected.buf[i]) ;
+        goto out ;
+    }
+    is_ok = TRUE ;
+
+out:
+    if (scalar) {
+        scaler_destroy (scalar) ;
+    }
+    if (avx2) {
+        scaler_destroy (avx2) ;
+    }
+    test_frame_finalize (&src) ;
+    test_frame_finalize (&expected) ;
+    test_frame_finalize (&got) ;
+    return is_ok ;
+}
+
+/*whether scaler_new() picks the AVX2 kernels on this CPU*/
+static enum bool_t
+test_has_avx2 (void)
+{
+    struct sink_geometry_t crop = {0, 0, 16, 16} ;
+    struct scaler_t *scaler=NULL ;
+    enum bool_t has_avx2=FALSE ;
+
+    scaler = scaler_new (YUV_FORMAT_420_PLANAR, 16, 16, &crop,
+                         8, 8, SCALE_FILTER_BILINEAR, 1, FALSE) ;
+    if (scaler) {
+        has_avx2 = scaler->use_avx2 ;
+        scaler_destroy (scaler) ;
+    }
+    return has_avx2 ;
+}
+
+int
+main (int argc, char **argv)
+{
+    uint32_t state=TEST_SEED ;
+    unsigned c=0, f=0, nb_failed=0, nb_filter_failed=0 ;
+    int format=0 ;
+
+    if (!test_has_avx2 ()) {
+        printf ("avx2: not supported here, skipped\n") ;
+        return 0 ;
+    }
+    for (f=0 ; f < TEST_NB_ELEMENTS (test_filters) ; f++) {
+        nb_filter_failed = 0 ;
+        for (format=YUV_FORMAT_UNDEF+1 ; format < YUV_NB_FORMATS ; format++) {
+            for (c=0 ; c < TEST_NB_ELEMENTS (test_cases) ; c++) {
+                if (!test_scale (format, &test_cases[c],
+                                 test_filters[f], &state)) {
+                    nb_filter_failed++ ;
+                }
+            }
+        }
+        printf ("avx2, %s filter: %s\n",
+                scale_filter_get_name (test_filters[f]), nb_filter_failed
+                ? "differs from the scalar kernels" : "bit exact") ;
+        nb_failed += nb_filter_failed ;
+    }
+    return nb_failed ? 1 : 0 ;
+}
@@ -0,0 +1,13 @@
+#!/bin/sh
+# libxvplay.a must only define global symbols of the xvplay_
+# namespace, see the list of xvplay-private.h.
+
+nm=${NM:-nm}
+symbols=`$nm -g --defined-only libxvplay.a | \
+         awk 'NF == 3 && $3 !~ /^xvplay_/ {print $3}'`
+if test -n "$symbols"; then
+    echo "symbols of libxvplay.a outside the xvplay_ namespace:"
+    echo "$symbols"
+    exit 1
+fi
+exit 0
@@ -0,0 +1,37 @@
+#!/bin/sh
+# play the clips of data/ in the orders testxvideo knows, with
+# --verify checking each frame against its golden hash.
+
+srcdir=${srcdir:-.}
+data=$srcdir/../data
+clip=$data/320x240-yuv420p-5frames
+log=test-verify.out
+status=0
+
+verify ()
+{
+    echo "testxvideo $*"
+    if ! ./testxvideo --sink null --src-size 320x240 \
+             --verify $clip.crc "$@" $clip.yuv > $log 2>&1; then
+        cat $log
+        echo "FAILED: testxvideo $*"
+        status=1
+    elif grep "not in the golden list" $log; then
+        echo "FAILED: testxvideo $*"
+        status=1
+    fi
+}
+
+verify
+verify --no-simd
+verify --reverse
+verify --start-frame 1 --end-frame 4 --loop 2
+verify --reverse --start-frame 1 --end-frame 4 --loop 3
+verify --mmap --start-frame 3 --loop 2
+verify --direct-io --start-frame 2 --loop 3
+verify --direct-io --reverse --loop 2
+verify --preload 3 --nb-frames 8
+verify --preload 5 --reverse --start-frame 1 --nb-frames 9
+
+rm -f $log
+exit $status
@@ -19,48 +19,30 @@
  *   Dodji Seketeli <dodji@openedhand.com>
  */
 
-#include <stdlib.h>
-#include <stdio.h>
-#include <string.h>
-#include <X11/Xlib.h>
-#include <X11/extensions/Xvlib.h>
-#include <assert.h>
-#include <unistd.h>
-#include <ctype.h>
+#include "xvplay-private.h"
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#ifdef HAVE_MALLINFO2
+#include <malloc.h>
+#endif
 
-#define LOG_POSITION \
-fprintf(stdout, "in (%s) at %s:%d: ", __func__, __FILE__, __LINE__) ;
-
-#define LOG_ERROR(args...) \
-LOG_POSITION ; fprintf (stdout, "error: " args)
-
-#define LOG(args...) \
-LOG_POSITION ; fprintf (stdout, args)
-
-#define RETURN_IF_FAIL(expr) \
-if (!(expr)) {LOG_ERROR("assertion failed: %s", #expr);return;}
+/*
+ * a paced frame put this long after its deadline counts as late.
+ */
+#define PACING_LATE_THRESHOLD_NS 1000000
 
-#define RETURN_VAL_IF_FAIL(expr, val) \
-if (!(expr)) {LOG_ERROR("assertion failed: %s", #expr);return val;}
+/*
+ * --trace keeps the last TRACE_NB_EVENTS events, a power of 2.
+ * That is a few MB, and a few minutes of playback at 60 fps.
+ */
+#define TRACE_NB_EVENTS (1 << 16)
 
-#define GUID_YUV12_PLANAR 0x32315659 /*YUV 4:2:0 planar*/
-#define GUID_YUV16_PLANAR 0x36315659 /*YUV 4:2:2 planar*/
+#define LATENCY_SUB_BITS 4
+#define LATENCY_NB_BUCKETS (64 << LATENCY_SUB_BITS)
 
 /******************
  * <data types>
  *****************/
-enum bool_t {
-    FALSE=0,
-    TRUE
-};
-
-enum yuv_format_t {
-    YUV_FORMAT_UNDEF,
-    YUV_FORMAT_420_PLANAR,
-    YUV_FORMAT_420_INTERLEAVED,
-    YUV_FORMAT_422_PLANAR
-};
-
 struct int_pair_t {
     int first ;
     int second ;
@@ -79,9 +61,233 @@ struct options_t {
     int dst_height ;
     enum yuv_format_t yuv_format ;
     int nb_frames ;
-    char *path_to_yuv_file ;
+    int start_frame ;
+    int end_frame ;/*0 for the end of the file*/
+    int nb_loops ;/*0 for ever*/
+    enum bool_t reverse ;
+    enum bool_t no_shm ;
+    enum bool_t huge_pages ;
+    enum bool_t use_mmap ;
+    enum bool_t direct_io ;
+    int preload ;/*frames read into RAM before playing, 0 for none*/
+    double duration ;/*seconds to play for, 0 for no limit*/
+    int prefetch ;
+    double fps ;/*< 0 for the rate of the input, 0 for no pacing*/
+    enum bool_t benchmark ;
+    char *benchmark_json_path ;
+    char *trace_path ;/*where --trace writes the timeline*/
+    char *verify_path ;/*the frame hashes --verify checks against*/
+    char *verify_write_path ;/*where --verify-write puts them*/
+    enum bool_t sync ;
+    enum sink_type_t sink_type ;
+    char *sink_path ;/*for SINK_TYPE_FILE*/
+    enum bool_t no_simd ;
+    enum scale_filter_t scale_filter ;
+    int scale_threads ;/*0 for as many as there are cpus, up to a few*/
+    enum bool_t client_scale ;/*scale frames even if the sink could*/
+    enum bool_t xcb ;/*probe the xv port and put frames through XCB*/
+    enum bool_t hold ;/*keep the windows up once the streams end*/
+    /*window geometries, XParseGeometry style, the nth for the nth file*/
+    char *geometries[MAX_STREAMS] ;
+    int nb_geometries ;
+    char *paths_to_yuv_files[MAX_STREAMS] ;
+    /*the nth input is a --source, e.g. pattern:bars, not a path*/
+    enum bool_t is_source_spec[MAX_STREAMS] ;
+    int nb_yuv_files ;
+};
+
+/*
+ * single producer, single consumer lock free ring of frames.
+ * head and tail only ever grow, and live on their own
+ * cache lines so that the two threads do not fight over them.
+ */
+struct frame_ring_t {
+    struct frame_t **slots ;
+    unsigned mask ;
+    unsigned head __attribute__ ((aligned (64))) ;/*written by producer*/
+    unsigned tail __attribute__ ((aligned (64))) ;/*written by consumer*/
+};
+
+/*
+ * paces frames at a fixed rate from CLOCK_MONOTONIC absolute deadlines.
+ * Frame first_index is due at start_ns, and each following
+ * frame one period later.
+ */
+struct pacer_t {
+    double fps ;
+    int64_t period_ns ;
+    int64_t start_ns ;
+    int first_index ;
+    int end_index ;/*0 => no end*/
+    int is_started ;
+    /*stats*/
+    unsigned long nb_on_time ;
+    unsigned long nb_late ;
+    unsigned long nb_dropped ;/*read, then dropped by the display*/
+    unsigned long nb_skipped ;/*never read, written by the reader only*/
+    double lateness_sum ;/*ms*/
+    double lateness_sum_sq ;
+    double lateness_max ;
+};
+
+/*
+ * a reader thread filling frames ahead of the display.
+ * Frames go round between two rings: the reader takes free frames,
+ * fills them and pushes them to full_ring, the display pops them
+ * and gives them back through free_ring once the XServer is done.
+ */
+struct prefetcher_t {
+    struct yuv_source_t *source ;
+    struct pacer_t *pacer ;/*if set, late frames are skipped unread*/
+    int stream_id ;/*for tracing*/
+    struct frame_ring_t full_ring ;
+    struct frame_ring_t free_ring ;
+    int full_eventfd ;/*signaled after each push to full_ring*/
+    int free_eventfd ;/*signaled after each push to free_ring*/
+    pthread_t thread ;
+    enum bool_t is_running ;
+    int eof ;
+    int stop ;
+    /*stats*/
+    unsigned max_occupancy ;
+    unsigned long *occupancy ;/*nb of pops per number of queued frames*/
+    unsigned long nb_pops ;
+    unsigned long nb_starved ;
+    double starved_time ;
+    double starve_start ;/*when the display found the ring empty, or 0*/
+    unsigned long nb_reader_waits ;
+};
+
+/*
+ * log-linear histogram of latencies in ns.
+ */
+struct latency_histogram_t {
+    uint64_t buckets[LATENCY_NB_BUCKETS] ;
+    uint64_t count ;
+    int64_t sum_ns ;
+    int64_t max_ns ;
+};
+
+enum benchmark_stage_t {
+    BENCHMARK_STAGE_READ,/*getting the next frame from the source*/
+    BENCHMARK_STAGE_UPLOAD,/*copying it into the image of the sink*/
+    BENCHMARK_STAGE_PUT,/*handing the frame to the sink*/
+    BENCHMARK_STAGE_FLUSH,/*e.g. XFlush, or XSync with --sync*/
+    BENCHMARK_NB_STAGES
+};
+
+struct benchmark_t {
+    struct latency_histogram_t stages[BENCHMARK_NB_STAGES] ;
+    int64_t start_ns ;
+    int64_t end_ns ;
+    unsigned long nb_frames ;
+    unsigned long frame_len ;
+    uint64_t nb_bytes ;
+    const char *upload_mode ;
+};
+
+/*
+ * the hashes of the frames of a stream, indexed by frame, either
+ * read from a golden list to check the frames put against, or
+ * computed from them to write such a list.
+ */
+struct verifier_t {
+    enum bool_t is_checking ;/*FALSE when writing the list*/
+    uint32_t (*hash) (const unsigned char *a_data, size_t a_len) ;
+    uint32_t *hashes ;
+    unsigned char *has_hash ;
+    int nb_hashes ;/*one past the highest frame index known*/
+    int capacity ;
+    /*stats*/
+    unsigned long nb_checked ;
+    unsigned long nb_mismatches ;
+    int first_mismatch ;/*-1 if none*/
+    unsigned long nb_unknown ;/*frames the golden list does not have*/
+    int64_t hash_ns ;
+};
+
+/*
+ * a yuv file played into its own window and sink, with its own
+ * frame pool, reader thread and pacing.
+ */
+struct stream_t {
+    int id ;
+    const char *path ;
+    struct yuv_source_t *source ;
+    Window window ;
+    int window_x ;
+    int window_y ;
+    unsigned window_width ;
+    unsigned window_height ;
+    enum bool_t is_mapped ;
+    struct sink_geometry_t geometry ;
+    struct sink_t *sink ;
+    struct frame_pool_t pool ;
+    enum bool_t has_pool ;
+    struct prefetcher_t prefetcher ;
+    struct pacer_t pacer ;
+    struct pacer_t *pacer_ptr ;/*NULL if not paced*/
+    struct benchmark_t benchmark ;
+    struct benchmark_t *benchmark_ptr ;/*NULL if not benchmarking*/
+    struct verifier_t verifier ;
+    struct verifier_t *verifier_ptr ;/*NULL unless --verify*/
+    struct frame_t *pending_frame ;/*read, waiting for its deadline*/
+    struct frame_t *displayed_frame ;/*put, held for the reader thread*/
+    enum bool_t was_shown ;/*in the current round*/
+    enum bool_t needs_redraw ;/*exposed or resized since the last put*/
+    enum bool_t is_done ;
+    /*stats*/
+    unsigned long nb_shown ;
+    unsigned long nb_redraws ;
+    uint64_t nb_bytes ;
+    int64_t start_ns ;
+    int64_t end_ns ;
+    int64_t first_frame_ns ;/*when the first frame was put*/
+};
+
+/*the streams being played, and the stats they share*/
+struct playback_t {
+    Display *display ;
+    struct stream_t *streams ;
+    int nb_streams ;
+    enum bool_t is_started ;
+    enum bool_t has_dumped_stats ;
+    int64_t start_ns ;
+    unsigned long nb_rounds ;/*in which frames were shown*/
+#ifdef HAVE_MALLINFO2
+    size_t heap_in_use ;/*after the first round*/
+#endif
+};
+
+/*the threads a stream runs on, as shown in a trace*/
+enum trace_thread_t {
+    TRACE_THREAD_DISPLAY=0,
+    TRACE_THREAD_READER
+};
+
+/*
+ * a span of time, or an instant if start_ns == end_ns.
+ */
+struct trace_event_t {
+    const char *name ;/*a string literal*/
+    int64_t start_ns ;
+    int64_t end_ns ;
+    int stream_id ;
+    enum trace_thread_t thread ;
+    int frame_index ;/*-1 if the event is not about a frame*/
 };
 
+/*
+ * a ring of the last events of the playback, recorded without locks
+ * from the display and reader threads, written out once they are
+ * all stopped.
+ */
+struct tracer_t {
+    struct trace_event_t *events ;
+    unsigned long nb_events ;/*a power of 2*/
+    unsigned long nb_recorded ;/*the next slot is that modulo nb_events*/
+    int64_t start_ns ;
+};
 /******************
  * </data types>
  *****************/
@@ -95,339 +301,2378 @@ enum bool_t parse_int_pair (const char *a_in,
 enum bool_t parse_command_line (int a_argc,
                                 char **a_argv,
                                 struct options_t *a_options) ;
-void run_event_loop (Display *a_display) ;
+enum bool_t run_event_loop (Display *a_display) ;
 void do_dispatch_event (const XEvent *a_event) ;
 void do_process_expose_event (const XExposeEvent *a_event) ;
 void do_process_map_event (const XMapEvent *a_event) ;
-
-enum bool_t compute_yuv_image_size (enum yuv_format_t a_yuv_format,
-                                    unsigned a_width,
-                                    unsigned a_height,
-                                    unsigned *a_len) ;
-enum bool_t
-read_next_yuv_image_of_size_and_format (FILE *a_input,
-                                        unsigned a_width,
-                                        unsigned a_height,
-                                        enum yuv_format_t a_yuv_format,
-                                        char **a_buf,
-                                        unsigned *a_len) ;
-
-enum bool_t get_xv_port (Display *a_display,
-                         Drawable a_drawable,
-                         XvPortID *a_port) ;
-
-enum bool_t get_xv_supported_image_formats (Display *a_display,
-                                            XvPortID a_xv_port,
-                                            XvImageFormatValues **a_formats,
-                                            int *a_nb_formats) ;
-enum bool_t lookup_image_format (Display *a_display,
-                                 XvPortID a_xv_port,
-                                 int a_id,
-                                 XvImageFormatValues *a_image_format) ;
-
-enum bool_t push_yuv_to_xvideo (Display *a_display,
-                                Window a_window,
-                                int a_nb_frames,/*0 => all frames*/
-                                int a_src_x,
-                                int a_src_y,
-                                int a_src_width,
-                                int a_src_height,
-                                int a_dst_x,
-                                int a_dst_y,
-                                int a_dst_width,
-                                int a_dst_height) ;
+void do_process_configure_event (const XConfigureEvent *a_event) ;
+void do_process_client_message_event (const XClientMessageEvent *a_event) ;
+void do_process_shm_completion_event (const XShmCompletionEvent *a_event) ;
+void do_process_generic_event (const XGenericEventCookie *a_cookie) ;
+enum bool_t frame_ring_init (struct frame_ring_t *a_ring, unsigned a_size) ;
+void frame_ring_finalize (struct frame_ring_t *a_ring) ;
+enum bool_t frame_ring_push (struct frame_ring_t *a_ring,
+                             struct frame_t *a_frame) ;
+struct frame_t* frame_ring_pop (struct frame_ring_t *a_ring) ;
+unsigned frame_ring_count (struct frame_ring_t *a_ring) ;
+enum bool_t prefetcher_start (struct prefetcher_t *a_prefetcher,
+                              struct yuv_source_t *a_source,
+                              struct pacer_t *a_pacer,
+                              struct frame_pool_t *a_pool,
+                              int a_stream_id) ;
+void prefetcher_stop (struct prefetcher_t *a_prefetcher) ;
+struct frame_t* prefetcher_try_pop (struct prefetcher_t *a_prefetcher,
+                                    enum bool_t *a_eof) ;
+void prefetcher_push_free (struct prefetcher_t *a_prefetcher,
+                           struct frame_t *a_frame) ;
+void prefetcher_dump_stats (struct prefetcher_t *a_prefetcher, FILE *a_out) ;
+void pacer_init (struct pacer_t *a_pacer, double a_fps, int a_end_index) ;
+void pacer_start (struct pacer_t *a_pacer, int a_index) ;
+enum bool_t pacer_is_started (struct pacer_t *a_pacer) ;
+int64_t pacer_get_deadline (struct pacer_t *a_pacer, int a_index) ;
+int pacer_get_due_frame (struct pacer_t *a_pacer) ;
+void pacer_skip_late_frames (struct pacer_t *a_pacer,
+                             struct yuv_source_t *a_source) ;
+enum bool_t pacer_is_frame_late (struct pacer_t *a_pacer, int a_index) ;
+void pacer_wait_for_frame (struct pacer_t *a_pacer, int a_index) ;
+void pacer_dump_stats (struct pacer_t *a_pacer, FILE *a_out) ;
+void latency_histogram_add (struct latency_histogram_t *a_histogram,
+                            int64_t a_ns) ;
+int64_t latency_histogram_percentile (struct latency_histogram_t *a_histogram,
+                                      double a_percent) ;
+void benchmark_init (struct benchmark_t *a_benchmark) ;
+int64_t benchmark_record (struct benchmark_t *a_benchmark,
+                          enum benchmark_stage_t a_stage,
+                          int64_t a_start_ns) ;
+void benchmark_dump (struct benchmark_t *a_benchmark, FILE *a_out) ;
+enum bool_t benchmark_write_json (struct benchmark_t *a_benchmark,
+                                  const char *a_path) ;
+enum bool_t tracer_init (struct tracer_t *a_tracer, unsigned long a_nb_events) ;
+void tracer_finalize (struct tracer_t *a_tracer) ;
+void tracer_record (struct tracer_t *a_tracer,
+                    const char *a_name,
+                    int a_stream_id,
+                    enum trace_thread_t a_thread,
+                    int a_frame_index,
+                    int64_t a_start_ns,
+                    int64_t a_end_ns) ;
+enum bool_t tracer_write_json (struct tracer_t *a_tracer,
+                               const char *a_path,
+                               char **a_stream_names,
+                               int a_nb_streams) ;
+enum bool_t verifier_init (struct verifier_t *a_verifier,
+                           const char *a_golden_path,
+                           enum bool_t a_no_simd) ;
+void verifier_finalize (struct verifier_t *a_verifier) ;
+void verifier_check_frame (struct verifier_t *a_verifier,
+                           int a_index,
+                           const char *a_data,
+                           size_t a_len) ;
+void verifier_dump (struct verifier_t *a_verifier, FILE *a_out) ;
+enum bool_t verifier_write (struct verifier_t *a_verifier,
+                            const char *a_path,
+                            unsigned a_width,
+                            unsigned a_height,
+                            enum yuv_format_t a_format) ;
+enum bool_t stream_init (struct stream_t *a_stream,
+                         int a_id,
+                         const char *a_path) ;
+void stream_init_geometry (struct stream_t *a_stream,
+                           const char *a_geometry,
+                           int a_nb_columns) ;
+enum bool_t stream_start (struct stream_t *a_stream, Display *a_display) ;
+enum bool_t stream_fetch_frame (struct stream_t *a_stream) ;
+int64_t stream_get_deadline (struct stream_t *a_stream) ;
+void stream_show_frame (struct stream_t *a_stream) ;
+void stream_redraw (struct stream_t *a_stream) ;
+void stream_resize (struct stream_t *a_stream, int a_width, int a_height) ;
+void stream_flush (struct stream_t *a_stream) ;
+void stream_dump_stats (struct stream_t *a_stream, FILE *a_out) ;
+void stream_stop (struct stream_t *a_stream) ;
+void stream_finalize (struct stream_t *a_stream) ;
+enum bool_t playback_start (struct playback_t *a_playback,
+                            Display *a_display,
+                            struct stream_t *a_streams,
+                            int a_nb_streams) ;
+int playback_run_round (struct playback_t *a_playback, int64_t *a_wake_ns) ;
+void playback_dump_stats (struct playback_t *a_playback) ;
+void playback_finish (struct playback_t *a_playback) ;
 
 static struct options_t *options=NULL ;
-static Window window ;
-static XvPortID xv_port=0 ;
-static FILE *yuv_input=NULL ;
+static struct stream_t *streams=NULL ;
+static int nb_streams=0 ;
+static struct tracer_t trace_ring ;
+static struct tracer_t *tracer=NULL ;/*NULL unless --trace*/
 static char *current_yuv_frame=NULL ;
 static char *current_yuv_frame_len=NULL ;
+static Atom wm_delete_window=None ;
+static enum bool_t quit_requested=FALSE ;
+static int64_t startup_ns=0 ;/*when main() started*/
 
 /*************************
- * <yuv stuff>
+ * <prefetch>
  * ***********************/
 
+/**
+ * a_size is rounded up to a power of two, so that it can hold
+ * any number of frames up to a_size.
+ */
 enum bool_t
-compute_yuv_image_size (enum yuv_format_t a_yuv_format,
-                        unsigned a_width,
-                        unsigned a_height,
-                        unsigned *a_len)
+frame_ring_init (struct frame_ring_t *a_ring, unsigned a_size)
 {
-    RETURN_VAL_IF_FAIL (a_len, FALSE) ;
+    unsigned size=1 ;
 
-    switch (a_yuv_format) {
-        case YUV_FORMAT_420_PLANAR:
-        case YUV_FORMAT_420_INTERLEAVED:
-            *a_len = 3*a_width*a_height/2 ;
-            break ;
-        case YUV_FORMAT_422_PLANAR:
-            *a_len = 3*a_width*a_height;
-            break ;
-        default:
-            LOG_ERROR ("unsupported format: %d\n", a_yuv_format) ;
-            return FALSE ;
+    RETURN_VAL_IF_FAIL (a_ring && a_size, FALSE) ;
+
+    memset (a_ring, 0, sizeof (struct frame_ring_t)) ;
+    while (size < a_size) {
+        size <<= 1 ;
+    }
+    a_ring->slots = calloc (size, sizeof (struct frame_t*)) ;
+    if (!a_ring->slots) {
+        return FALSE ;
     }
+    a_ring->mask = size - 1 ;
     return TRUE ;
 }
 
-enum bool_t
-read_next_yuv_image_of_size_and_format (FILE *a_input,
-                                        unsigned a_width,
-                                        unsigned a_height,
-                                        enum yuv_format_t a_yuv_format,
-                                        char **a_buf,
-                                        unsigned *a_len)
-{
-    unsigned nb_to_read=0, nb_read=0 ;
-    char *buf=NULL ;
-    enum bool_t is_ok=FALSE ;
+void
+frame_ring_finalize (struct frame_ring_t *a_ring)
+{
+    RETURN_IF_FAIL (a_ring) ;
+
+    if (a_ring->slots) {
+        free (a_ring->slots) ;
+        a_ring->slots = NULL ;
+    }
+}
 
-    RETURN_VAL_IF_FAIL (a_input, FALSE) ;
+/**
+ * must only be called by the producer thread of a_ring.
+ * returns FALSE if a_ring is full.
+ */
+enum bool_t
+frame_ring_push (struct frame_ring_t *a_ring, struct frame_t *a_frame)
+{
+    unsigned head=0, tail=0 ;
 
-    if (!compute_yuv_image_size (a_yuv_format, a_width,
-                                 a_height, &nb_to_read)) {
-        LOG_ERROR ("failed to compute image size\n") ;
+    head = __atomic_load_n (&a_ring->head, __ATOMIC_RELAXED) ;
+    tail = __atomic_load_n (&a_ring->tail, __ATOMIC_ACQUIRE) ;
+    if (head - tail > a_ring->mask) {
         return FALSE ;
     }
-    RETURN_VAL_IF_FAIL (nb_to_read, FALSE) ;
+    a_ring->slots[head & a_ring->mask] = a_frame ;
+    __atomic_store_n (&a_ring->head, head + 1, __ATOMIC_RELEASE) ;
+    return TRUE ;
+}
 
-    buf = calloc (nb_to_read, 1) ;
-    if (!buf) {
-        LOG_ERROR ("failed to allocate buffer\n") ;
-        goto out ;
-    }
+/**
+ * must only be called by the consumer thread of a_ring.
+ * returns NULL if a_ring is empty.
+ */
+struct frame_t*
+frame_ring_pop (struct frame_ring_t *a_ring)
+{
+    unsigned head=0, tail=0 ;
+    struct frame_t *frame=NULL ;
 
-    LOG ("reading image of %d bytes ...\n", nb_to_read) ;
-    nb_read = fread (buf, 1, nb_to_read, a_input) ;
-    if (nb_read != nb_to_read) {
-        LOG_ERROR ("unexpected end of file\n") ;
-        goto out ;
+    tail = __atomic_load_n (&a_ring->tail, __ATOMIC_RELAXED) ;
+    head = __atomic_load_n (&a_ring->head, __ATOMIC_ACQUIRE) ;
+    if (head == tail) {
+        return NULL ;
     }
-    LOG ("image read ok\n") ;
+    frame = a_ring->slots[tail & a_ring->mask] ;
+    __atomic_store_n (&a_ring->tail, tail + 1, __ATOMIC_RELEASE) ;
+    return frame ;
+}
 
-    *a_buf = buf ;
-    buf = NULL ;
-    *a_len = nb_read ;
-    is_ok = TRUE ;
+unsigned
+frame_ring_count (struct frame_ring_t *a_ring)
+{
+    return __atomic_load_n (&a_ring->head, __ATOMIC_ACQUIRE)
+         - __atomic_load_n (&a_ring->tail, __ATOMIC_ACQUIRE) ;
+}
 
-out:
-    if (buf) {
-        free (buf) ;
+static void
+signal_eventfd (int a_fd)
+{
+    uint64_t one=1 ;
+
+    while (write (a_fd, &one, sizeof (one)) < 0 && errno == EINTR)
+        ;
+}
+
+static void
+wait_eventfd (int a_fd)
+{
+    uint64_t count=0 ;
+
+    while (read (a_fd, &count, sizeof (count)) < 0 && errno == EINTR)
+        ;
+}
+
+static void*
+prefetcher_thread_func (void *a_prefetcher)
+{
+    struct prefetcher_t *prefetcher = a_prefetcher ;
+    struct frame_t *frame=NULL ;
+    int64_t start_ns=0 ;
+
+    for (;;) {
+        if (__atomic_load_n (&prefetcher->stop, __ATOMIC_ACQUIRE)) {
+            break ;
+        }
+        if (tracer) {
+            start_ns = get_monotonic_ns () ;
+        }
+        frame = frame_ring_pop (&prefetcher->free_ring) ;
+        if (!frame) {
+            /*all the frames are ahead of the display, wait for one back*/
+            prefetcher->nb_reader_waits++ ;
+            wait_eventfd (prefetcher->free_eventfd) ;
+            if (tracer) {
+                tracer_record (tracer, "wait", prefetcher->stream_id,
+                               TRACE_THREAD_READER, -1,
+                               start_ns, get_monotonic_ns ()) ;
+            }
+            continue ;
+        }
+        pacer_skip_late_frames (prefetcher->pacer, prefetcher->source) ;
+        if (!prefetcher->source->read_frame (prefetcher->source, frame)) {
+            break ;
+        }
+        if (tracer) {
+            tracer_record (tracer, "read", prefetcher->stream_id,
+                           TRACE_THREAD_READER, frame->index,
+                           start_ns, get_monotonic_ns ()) ;
+        }
+        frame_ring_push (&prefetcher->full_ring, frame) ;
+        signal_eventfd (prefetcher->full_eventfd) ;
     }
-    return is_ok ;
+    __atomic_store_n (&prefetcher->eof, TRUE, __ATOMIC_RELEASE) ;
+    signal_eventfd (prefetcher->full_eventfd) ;
+    return NULL ;
 }
 
+/**
+ * start a thread reading frames of a_source into the frames of
+ * a_pool ahead of the display.
+ * If a_pacer is not NULL, the thread skips the frames it
+ * would read too late to be displayed.
+ * a_stream_id tells the stream the thread reads for in traces.
+ * From then on, frames must be obtained with prefetcher_try_pop()
+ * and given back with prefetcher_push_free(), not through a_pool.
+ */
 enum bool_t
-get_xv_port (Display *a_display, Drawable a_drawable, XvPortID *a_port)
+prefetcher_start (struct prefetcher_t *a_prefetcher,
+                  struct yuv_source_t *a_source,
+                  struct pacer_t *a_pacer,
+                  struct frame_pool_t *a_pool,
+                  int a_stream_id)
 {
-    enum bool_t result=FALSE ;
-    XvAdaptorInfo *adaptor_infos=NULL ;
-    int nb_adaptors=0, i=0 ;
+    struct frame_t *frame=NULL ;
+
+    RETURN_VAL_IF_FAIL (a_prefetcher && a_source && a_pool, FALSE) ;
+
+    memset (a_prefetcher, 0, sizeof (struct prefetcher_t)) ;
+    a_prefetcher->source = a_source ;
+    a_prefetcher->pacer = a_pacer ;
+    a_prefetcher->stream_id = a_stream_id ;
+    a_prefetcher->full_eventfd = -1 ;
+    a_prefetcher->free_eventfd = -1 ;
+    if (!frame_ring_init (&a_prefetcher->full_ring, a_pool->nb_frames)
+        || !frame_ring_init (&a_prefetcher->free_ring, a_pool->nb_frames)) {
+        LOG_ERROR ("failed to allocate frame rings\n") ;
+        goto error ;
+    }
+    a_prefetcher->occupancy = calloc (a_pool->nb_frames + 1,
+                                      sizeof (unsigned long)) ;
+    if (!a_prefetcher->occupancy) {
+        goto error ;
+    }
+    a_prefetcher->max_occupancy = a_pool->nb_frames ;
+    a_prefetcher->full_eventfd = eventfd (0, 0) ;
+    a_prefetcher->free_eventfd = eventfd (0, 0) ;
+    if (a_prefetcher->full_eventfd < 0 || a_prefetcher->free_eventfd < 0) {
+        LOG_ERROR ("failed to create eventfds: %s\n", strerror (errno)) ;
+        goto error ;
+    }
+    while ((frame = frame_pool_acquire (a_pool))) {
+        frame_ring_push (&a_prefetcher->free_ring, frame) ;
+    }
+    if (pthread_create (&a_prefetcher->thread, NULL,
+                        prefetcher_thread_func, a_prefetcher)) {
+        LOG_ERROR ("failed to start the reader thread\n") ;
+        goto error ;
+    }
+    a_prefetcher->is_running = TRUE ;
+    return TRUE ;
 
-    RETURN_VAL_IF_FAIL (a_display && a_port, FALSE) ;
+error:
+    prefetcher_stop (a_prefetcher) ;
+    return FALSE ;
+}
 
-    if (XvQueryAdaptors (a_display, a_drawable,
-                         &nb_adaptors, &adaptor_infos) != Success) {
-        LOG_ERROR ("XvQueryAdaptors failed\n") ;
-        goto out ;
+/**
+ * stop the reader thread.
+ * Frames still in the rings stay owned by their pool, which frees
+ * them in frame_pool_finalize().
+ */
+void
+prefetcher_stop (struct prefetcher_t *a_prefetcher)
+{
+    RETURN_IF_FAIL (a_prefetcher) ;
+
+    if (a_prefetcher->is_running) {
+        __atomic_store_n (&a_prefetcher->stop, TRUE, __ATOMIC_RELEASE) ;
+        signal_eventfd (a_prefetcher->free_eventfd) ;
+        pthread_join (a_prefetcher->thread, NULL) ;
+        a_prefetcher->is_running = FALSE ;
     }
-    LOG ("got %d adaptors\n", nb_adaptors) ;
-
-    for (i=0; i<nb_adaptors;i++) {
-        /*
-         * get the first adaptor that supports
-         * video input and image puting
-         */
-        if ((adaptor_infos[i].type & (XvInputMask|XvImageMask))
-            == (XvInputMask|XvImageMask)) {
-            XvPortID p = 0 ;
-            /*get the first port that we can grab*/
-            for (p = adaptor_infos[i].base_id ;
-                 p < adaptor_infos[i].base_id + adaptor_infos[i].num_ports;
-                 p++) {
-                if (XvGrabPort (a_display, p, CurrentTime) == Success) {
-                    *a_port = p ;
-                    result = TRUE ;
-                    goto out ;
-                } else {
-                    LOG_ERROR ("failed to grab port: %d\n", p) ;
-                }
-            }
+    if (a_prefetcher->full_eventfd >= 0) {
+        close (a_prefetcher->full_eventfd) ;
+        a_prefetcher->full_eventfd = -1 ;
+    }
+    if (a_prefetcher->free_eventfd >= 0) {
+        close (a_prefetcher->free_eventfd) ;
+        a_prefetcher->free_eventfd = -1 ;
+    }
+    frame_ring_finalize (&a_prefetcher->full_ring) ;
+    frame_ring_finalize (&a_prefetcher->free_ring) ;
+    if (a_prefetcher->occupancy) {
+        free (a_prefetcher->occupancy) ;
+        a_prefetcher->occupancy = NULL ;
+    }
+}
+
+/**
+ * get the next frame read by the reader thread if there is one,
+ * without waiting. Otherwise full_eventfd gets readable when one
+ * comes in.
+ * returns NULL if no frame is ready, setting *a_eof at the end
+ * of the input.
+ */
+struct frame_t*
+prefetcher_try_pop (struct prefetcher_t *a_prefetcher, enum bool_t *a_eof)
+{
+    struct frame_t *frame=NULL ;
+    unsigned count=0 ;
+
+    RETURN_VAL_IF_FAIL (a_prefetcher && a_eof, NULL) ;
+
+    *a_eof = FALSE ;
+    count = frame_ring_count (&a_prefetcher->full_ring) ;
+    if (count > a_prefetcher->max_occupancy) {
+        count = a_prefetcher->max_occupancy ;
+    }
+    frame = frame_ring_pop (&a_prefetcher->full_ring) ;
+    if (!frame && __atomic_load_n (&a_prefetcher->eof, __ATOMIC_ACQUIRE)) {
+        /*the reader may have pushed a frame right before the end*/
+        frame = frame_ring_pop (&a_prefetcher->full_ring) ;
+        if (!frame) {
+            /*hitting the end of the input is not starving*/
+            a_prefetcher->starve_start = 0 ;
+            *a_eof = TRUE ;
+            return NULL ;
+        }
+    }
+    if (!frame) {
+        if (!a_prefetcher->starve_start) {
+            a_prefetcher->starve_start = get_monotonic_time () ;
         }
+        return NULL ;
+    }
+    if (a_prefetcher->starve_start) {
+        a_prefetcher->nb_starved++ ;
+        a_prefetcher->starved_time += get_monotonic_time ()
+                                      - a_prefetcher->starve_start ;
+        a_prefetcher->starve_start = 0 ;
     }
+    a_prefetcher->occupancy[count]++ ;
+    a_prefetcher->nb_pops++ ;
+    return frame ;
+}
 
-out:
-    if (adaptor_infos) {
-        XvFreeAdaptorInfo (adaptor_infos) ;
-        adaptor_infos = NULL ;
+/**
+ * give a_frame back to the reader thread.
+ * The XServer must be done with it.
+ */
+void
+prefetcher_push_free (struct prefetcher_t *a_prefetcher,
+                      struct frame_t *a_frame)
+{
+    RETURN_IF_FAIL (a_prefetcher && a_frame) ;
+
+    frame_ring_push (&a_prefetcher->free_ring, a_frame) ;
+    signal_eventfd (a_prefetcher->free_eventfd) ;
+}
+
+void
+prefetcher_dump_stats (struct prefetcher_t *a_prefetcher, FILE *a_out)
+{
+    unsigned i=0 ;
+    double mean=0 ;
+
+    RETURN_IF_FAIL (a_prefetcher && a_out) ;
+
+    if (!a_prefetcher->nb_pops) {
+        return ;
+    }
+    for (i=0 ; i <= a_prefetcher->max_occupancy ; i++) {
+        mean += (double)i * a_prefetcher->occupancy[i] ;
+    }
+    mean /= a_prefetcher->nb_pops ;
+    fprintf (a_out,
+             "prefetch: %u frames deep, mean ring occupancy %.2f\n"
+             "prefetch: display starved %lu times out of %lu frames, "
+             "waiting %.3fs in total\n"
+             "prefetch: reader waited %lu times for a free frame\n",
+             a_prefetcher->max_occupancy, mean,
+             a_prefetcher->nb_starved, a_prefetcher->nb_pops,
+             a_prefetcher->starved_time,
+             a_prefetcher->nb_reader_waits) ;
+    fprintf (a_out, "prefetch: occupancy histogram:") ;
+    for (i=0 ; i <= a_prefetcher->max_occupancy ; i++) {
+        fprintf (a_out, " %u:%lu", i, a_prefetcher->occupancy[i]) ;
     }
-    return result ;
+    fprintf (a_out, "\n") ;
+}
+
+/*************************
+ * </prefetch>
+ * ***********************/
+
+/*************************
+ * <pacing>
+ * ***********************/
+
+void
+pacer_init (struct pacer_t *a_pacer, double a_fps, int a_end_index)
+{
+    RETURN_IF_FAIL (a_pacer && a_fps > 0) ;
+
+    memset (a_pacer, 0, sizeof (struct pacer_t)) ;
+    a_pacer->fps = a_fps ;
+    a_pacer->period_ns = (int64_t)(1e9 / a_fps) ;
+    a_pacer->end_index = a_end_index ;
+}
+
+/**
+ * make frame a_index due now, and the following ones
+ * every period from there.
+ */
+void
+pacer_start (struct pacer_t *a_pacer, int a_index)
+{
+    RETURN_IF_FAIL (a_pacer) ;
+
+    a_pacer->start_ns = get_monotonic_ns () ;
+    a_pacer->first_index = a_index ;
+    __atomic_store_n (&a_pacer->is_started, TRUE, __ATOMIC_RELEASE) ;
 }
 
 enum bool_t
-get_xv_supported_image_formats (Display *a_display,
-                                XvPortID a_xv_port,
-                                XvImageFormatValues **a_formats,
-                                int *a_nb_formats)
+pacer_is_started (struct pacer_t *a_pacer)
 {
-    XvImageFormatValues *image_formats=NULL ;
-    int nb_formats=0, i=0 ;
+    return __atomic_load_n (&a_pacer->is_started, __ATOMIC_ACQUIRE) ;
+}
 
-    image_formats = XvListImageFormats (a_display, a_xv_port, &nb_formats) ;
-    if (!image_formats) {
-        return FALSE ;
+int64_t
+pacer_get_deadline (struct pacer_t *a_pacer, int a_index)
+{
+    return a_pacer->start_ns
+        + (int64_t)(a_index - a_pacer->first_index) * a_pacer->period_ns ;
+}
+
+/**
+ * the index of the frame which display period we are in.
+ * Frames before it can't be shown in time anymore.
+ */
+int
+pacer_get_due_frame (struct pacer_t *a_pacer)
+{
+    int64_t elapsed=0 ;
+    int due=0 ;
+
+    elapsed = get_monotonic_ns () - a_pacer->start_ns ;
+    if (elapsed < 0) {
+        return a_pacer->first_index ;
     }
-    LOG_ERROR ("XServer supports %d formats\n", nb_formats) ;
-    for (i=0 ; i < nb_formats ; i++) {
-        LOG ("format id: %#x", image_formats[i]) ;
+    due = a_pacer->first_index + (int)(elapsed / a_pacer->period_ns) ;
+    if (a_pacer->end_index && due > a_pacer->end_index) {
+        due = a_pacer->end_index ;
+    }
+    return due ;
+}
+
+/**
+ * move a_source past the frames which display period is over,
+ * without reading them.
+ * This is called by whoever reads a_source, i.e. the reader thread
+ * when prefetching.
+ */
+void
+pacer_skip_late_frames (struct pacer_t *a_pacer,
+                        struct yuv_source_t *a_source)
+{
+    int nb=0 ;
+
+    if (!a_pacer || !a_source || !pacer_is_started (a_pacer)) {
+        return ;
+    }
+    nb = pacer_get_due_frame (a_pacer) - a_source->next_frame ;
+    if (nb <= 0 || !a_source->skip_frames) {
+        return ;
+    }
+    if (a_source->skip_frames (a_source, nb)) {
+        a_pacer->nb_skipped += nb ;
     }
-    XFree (image_formats) ;
-    return TRUE ;
 }
 
+/**
+ * tells whether a frame already read must be dropped
+ * because its display period is over.
+ */
 enum bool_t
-lookup_image_format (Display *a_display,
-                     XvPortID a_xv_port,
-                     int a_format,
-                     XvImageFormatValues *a_image_format)
+pacer_is_frame_late (struct pacer_t *a_pacer, int a_index)
 {
-    XvImageFormatValues *image_formats=NULL ;
-    int nb_formats=0, i=0 ;
-    enum bool_t is_ok=FALSE ;
+    RETURN_VAL_IF_FAIL (a_pacer, FALSE) ;
+
+    if (!pacer_is_started (a_pacer)) {
+        return FALSE ;
+    }
+    if (a_index < pacer_get_due_frame (a_pacer)) {
+        a_pacer->nb_dropped++ ;
+        return TRUE ;
+    }
+    return FALSE ;
+}
+
+/**
+ * sleep until the deadline of frame a_index, and account for
+ * how late we are for it when we wake up.
+ */
+void
+pacer_wait_for_frame (struct pacer_t *a_pacer, int a_index)
+{
+    struct timespec ts ;
+    int64_t deadline=0, lateness=0 ;
+    double lateness_ms=0 ;
 
-    RETURN_VAL_IF_FAIL (a_display && a_image_format, FALSE) ;
+    RETURN_IF_FAIL (a_pacer) ;
 
-    image_formats = XvListImageFormats (a_display, a_xv_port, &nb_formats) ;
-    if (!image_formats) {
-        goto out ;
+    if (!pacer_is_started (a_pacer)) {
+        pacer_start (a_pacer, a_index) ;
     }
-    for (i=0 ; i < nb_formats ; i++) {
-        if (image_formats[i].id == a_format) {
-            memcpy (a_image_format,
-                    &image_formats[i],
-                    sizeof (XvImageFormatValues)) ;
-            is_ok = TRUE ;
-            break ;
-        }
+    deadline = pacer_get_deadline (a_pacer, a_index) ;
+    ts.tv_sec = deadline / 1000000000 ;
+    ts.tv_nsec = deadline % 1000000000 ;
+    while (clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL)
+           == EINTR)
+        ;
+
+    lateness = get_monotonic_ns () - deadline ;
+    if (lateness < 0) {
+        lateness = 0 ;
+    }
+    if (lateness > PACING_LATE_THRESHOLD_NS) {
+        a_pacer->nb_late++ ;
+    } else {
+        a_pacer->nb_on_time++ ;
+    }
+    lateness_ms = lateness / 1e6 ;
+    a_pacer->lateness_sum += lateness_ms ;
+    a_pacer->lateness_sum_sq += lateness_ms * lateness_ms ;
+    if (lateness_ms > a_pacer->lateness_max) {
+        a_pacer->lateness_max = lateness_ms ;
     }
+}
 
-out:
-    if (image_formats) {
-        XFree (image_formats) ;
+void
+pacer_dump_stats (struct pacer_t *a_pacer, FILE *a_out)
+{
+    unsigned long nb_shown=0 ;
+    double mean=0, variance=0 ;
+
+    RETURN_IF_FAIL (a_pacer && a_out) ;
+
+    nb_shown = a_pacer->nb_on_time + a_pacer->nb_late ;
+    if (nb_shown) {
+        mean = a_pacer->lateness_sum / nb_shown ;
+        variance = a_pacer->lateness_sum_sq / nb_shown - mean * mean ;
+        if (variance < 0) {
+            variance = 0 ;
+        }
     }
-    return is_ok ;
+    fprintf (a_out,
+             "pacing: %.3f fps, %lu frames on time, %lu late, %lu dropped "
+             "(%lu skipped unread)\n"
+             "pacing: deadline miss mean %.3fms, jitter %.3fms, max %.3fms\n",
+             a_pacer->fps, a_pacer->nb_on_time, a_pacer->nb_late,
+             a_pacer->nb_dropped + a_pacer->nb_skipped, a_pacer->nb_skipped,
+             mean, sqrt (variance), a_pacer->lateness_max) ;
 }
 
-enum bool_t
-push_yuv_to_xvideo (Display *a_display,
-                    Window a_window,
-                    int a_nb_frames /*0 => all frames*/,
-                    int a_src_x,
-                    int a_src_y,
-                    int a_src_width,
-                    int a_src_height,
-                    int a_dst_x,
-                    int a_dst_y,
-                    int a_dst_width,
-                    int a_dst_height)
-{
-    enum bool_t is_ok = FALSE ;
-    XvImageFormatValues image_format ;
-    XvImage *xv_image=NULL ;
-    GC gc=0 ;
-    XGCValues gc_values;
-    char *yuv_buf=NULL ;
-    unsigned yuv_buf_len=0 ;
-    int i=0 ;
+/*************************
+ * </pacing>
+ * ***********************/
 
-    LOG ("src_x:%d, src_y:%d, src_w:%d, src_h:%d\n"
-         "dst_x:%d, dst_y:%d, dst_w:%d, dst_h:%d",
-         a_src_x, a_src_y, a_src_width, a_src_height,
-         a_dst_x, a_dst_y, a_dst_width, a_dst_height) ;
+/*************************
+ * <benchmark>
+ * ***********************/
 
-    if (!a_src_width || ! a_src_height) {
-        LOG_ERROR ("zero source width or source height was given\n") ;
-        return FALSE ;
+static const char *benchmark_stage_names[BENCHMARK_NB_STAGES] = {
+    "read",
+    "upload",
+    "put",
+    "flush"
+};
+
+/*
+ * latencies below 2^LATENCY_SUB_BITS ns get a bucket each, larger
+ * ones share a power of two range split in 2^LATENCY_SUB_BITS
+ * buckets, which keeps every bucket within ~6% of its values.
+ */
+static int
+latency_to_bucket (int64_t a_ns)
+{
+    int msb=0, shift=0 ;
+    uint64_t v=a_ns ;
+
+    if (a_ns < 0) {
+        return 0 ;
     }
-    if (!get_xv_port (a_display, (Drawable)a_window, &xv_port)) {
-        LOG_ERROR ("could not get xv port\n") ;
-        goto out ;
+    if (v < (1 << LATENCY_SUB_BITS)) {
+        return (int)v ;
     }
-    LOG ("Got xv port: %d\n", xv_port) ;
+    msb = 63 - __builtin_clzll (v) ;
+    shift = msb - LATENCY_SUB_BITS ;
+    return ((shift + 1) << LATENCY_SUB_BITS)
+         + (int)((v >> shift) & ((1 << LATENCY_SUB_BITS) - 1)) ;
+}
 
-    if (!lookup_image_format (a_display, xv_port,
-                              GUID_YUV12_PLANAR, &image_format)) {
-        LOG_ERROR ("yuv12planar format not supported by xserver\n") ;
-        goto out ;
+/*the largest latency falling in bucket a_bucket*/
+static int64_t
+bucket_to_latency (int a_bucket)
+{
+    int shift=0, sub=0 ;
+
+    if (a_bucket < (1 << LATENCY_SUB_BITS)) {
+        return a_bucket ;
     }
+    shift = (a_bucket >> LATENCY_SUB_BITS) - 1 ;
+    sub = a_bucket & ((1 << LATENCY_SUB_BITS) - 1) ;
+    return ((((int64_t)1 << LATENCY_SUB_BITS) + sub + 1) << shift) - 1 ;
+}
 
-    gc = XCreateGC (a_display, a_window, 0L, &gc_values) ;
-    if (!gc) {
-        LOG_ERROR ("failed to create gc \n") ;
-        goto out ;
+void
+latency_histogram_add (struct latency_histogram_t *a_histogram,
+                       int64_t a_ns)
+{
+    RETURN_IF_FAIL (a_histogram) ;
+
+    a_histogram->buckets[latency_to_bucket (a_ns)]++ ;
+    if (!a_histogram->count || a_ns > a_histogram->max_ns) {
+        a_histogram->max_ns = a_ns ;
     }
-    xv_image = (XvImage*) XvCreateImage (a_display,
-                                         xv_port, image_format.id,
-                                         NULL, a_src_width, a_src_height) ;
-    if (!xv_image) {
-        LOG_ERROR ("failed to create image\n") ;
-        goto out ;
+    a_histogram->count++ ;
+    a_histogram->sum_ns += a_ns ;
+}
+
+/**
+ * the latency under which a_percent % of the samples fall,
+ * never more than the largest sample.
+ */
+int64_t
+latency_histogram_percentile (struct latency_histogram_t *a_histogram,
+                              double a_percent)
+{
+    uint64_t rank=0, seen=0 ;
+    int i=0 ;
+    int64_t latency=0 ;
+
+    RETURN_VAL_IF_FAIL (a_histogram, 0) ;
+
+    if (!a_histogram->count) {
+        return 0 ;
     }
-    for (i=0; ;i++) {
-        if (a_nb_frames && i >= a_nb_frames)
-            break ;
-        if (!read_next_yuv_image_of_size_and_format (yuv_input,
-                                                     a_src_width,
-                                                     a_src_height,
-                                                     YUV_FORMAT_420_PLANAR,
-                                                     &yuv_buf,
-                                                     &yuv_buf_len)) {
+    rank = (uint64_t)ceil (a_histogram->count * a_percent / 100.0) ;
+    if (rank < 1) {
+        rank = 1 ;
+    }
+    for (i=0 ; i < LATENCY_NB_BUCKETS ; i++) {
+        seen += a_histogram->buckets[i] ;
+        if (seen >= rank) {
             break ;
         }
-        xv_image->data = yuv_buf ;
-        LOG ("pushing frame %d to xvideo ... \n", i) ;
-        XvPutImage (a_display, xv_port, a_window, gc, xv_image,
-                    a_src_x, a_src_y, a_src_width, a_src_height,
-                    a_dst_x, a_dst_y, a_dst_width, a_dst_height) ;
-        XFlush (a_display) ;
-        if (yuv_buf) {
-            free (yuv_buf) ;
-            yuv_buf = NULL ;
-        }
-        LOG ("pushed frame %d.\n", i) ;
     }
-    is_ok = TRUE ;
+    latency = bucket_to_latency (i) ;
+    if (latency > a_histogram->max_ns) {
+        latency = a_histogram->max_ns ;
+    }
+    return latency ;
+}
+
+void
+benchmark_init (struct benchmark_t *a_benchmark)
+{
+    RETURN_IF_FAIL (a_benchmark) ;
+
+    memset (a_benchmark, 0, sizeof (struct benchmark_t)) ;
+}
+
+/**
+ * account for a stage that started at a_start_ns and just ended.
+ * returns the current time, so that it can start the next stage.
+ */
+int64_t
+benchmark_record (struct benchmark_t *a_benchmark,
+                  enum benchmark_stage_t a_stage,
+                  int64_t a_start_ns)
+{
+    int64_t now=0 ;
+
+    if (!a_benchmark) {
+        return 0 ;
+    }
+    now = get_monotonic_ns () ;
+    if (!a_benchmark->start_ns) {
+        a_benchmark->start_ns = a_start_ns ;
+    }
+    a_benchmark->end_ns = now ;
+    latency_histogram_add (&a_benchmark->stages[a_stage], now - a_start_ns) ;
+    return now ;
+}
+
+void
+benchmark_dump (struct benchmark_t *a_benchmark, FILE *a_out)
+{
+    double seconds=0 ;
+    int i=0 ;
+
+    RETURN_IF_FAIL (a_benchmark && a_out) ;
+
+    seconds = (a_benchmark->end_ns - a_benchmark->start_ns) / 1e9 ;
+    if (seconds <= 0) {
+        seconds = 1e-9 ;
+    }
+    fprintf (a_out,
+             "benchmark: %lu frames of %lu bytes in %.3fs: "
+             "%.2f fps, %.2f MB/s\n",
+             a_benchmark->nb_frames, a_benchmark->frame_len, seconds,
+             a_benchmark->nb_frames / seconds,
+             a_benchmark->nb_bytes / seconds / (1024.0 * 1024.0)) ;
+    if (a_benchmark->upload_mode) {
+        fprintf (a_out, "benchmark: upload mode: %s\n",
+                 a_benchmark->upload_mode) ;
+    }
+    fprintf (a_out, "benchmark: %-8s %10s %10s %10s %10s %10s (ms)\n",
+             "stage", "mean", "p50", "p90", "p99", "max") ;
+    for (i=0 ; i < BENCHMARK_NB_STAGES ; i++) {
+        struct latency_histogram_t *h = &a_benchmark->stages[i] ;
+
+        if (!h->count) {
+            continue ;
+        }
+        fprintf (a_out,
+                 "benchmark: %-8s %10.3f %10.3f %10.3f %10.3f %10.3f\n",
+                 benchmark_stage_names[i],
+                 h->sum_ns / 1e6 / h->count,
+                 latency_histogram_percentile (h, 50) / 1e6,
+                 latency_histogram_percentile (h, 90) / 1e6,
+                 latency_histogram_percentile (h, 99) / 1e6,
+                 h->max_ns / 1e6) ;
+    }
+}
+
+enum bool_t
+benchmark_write_json (struct benchmark_t *a_benchmark, const char *a_path)
+{
+    FILE *out=NULL ;
+    double seconds=0 ;
+    int i=0 ;
+    enum bool_t is_first=TRUE ;
+
+    RETURN_VAL_IF_FAIL (a_benchmark && a_path, FALSE) ;
+
+    out = fopen (a_path, "w") ;
+    if (!out) {
+        LOG_ERROR ("could not open '%s': %s\n", a_path, strerror (errno)) ;
+        return FALSE ;
+    }
+    seconds = (a_benchmark->end_ns - a_benchmark->start_ns) / 1e9 ;
+    if (seconds <= 0) {
+        seconds = 1e-9 ;
+    }
+    fprintf (out,
+             "{\n"
+             "  \"frames\": %lu,\n"
+             "  \"frame_bytes\": %lu,\n"
+             "  \"seconds\": %.6f,\n"
+             "  \"fps\": %.3f,\n"
+             "  \"mb_per_s\": %.3f,\n",
+             a_benchmark->nb_frames, a_benchmark->frame_len, seconds,
+             a_benchmark->nb_frames / seconds,
+             a_benchmark->nb_bytes / seconds / (1024.0 * 1024.0)) ;
+    if (a_benchmark->upload_mode) {
+        fprintf (out, "  \"upload_mode\": \"%s\",\n",
+                 a_benchmark->upload_mode) ;
+    }
+    fprintf (out, "  \"stages\": {") ;
+    for (i=0 ; i < BENCHMARK_NB_STAGES ; i++) {
+        struct latency_histogram_t *h = &a_benchmark->stages[i] ;
+
+        if (!h->count) {
+            continue ;
+        }
+        fprintf (out,
+                 "%s\n    \"%s\": {\"count\": %lu, \"mean_us\": %.3f, "
+                 "\"p50_us\": %.3f, \"p90_us\": %.3f, \"p99_us\": %.3f, "
+                 "\"max_us\": %.3f}",
+                 is_first ? "" : ",",
+                 benchmark_stage_names[i], (unsigned long)h->count,
+                 h->sum_ns / 1e3 / h->count,
+                 latency_histogram_percentile (h, 50) / 1e3,
+                 latency_histogram_percentile (h, 90) / 1e3,
+                 latency_histogram_percentile (h, 99) / 1e3,
+                 h->max_ns / 1e3) ;
+        is_first = FALSE ;
+    }
+    fprintf (out, "\n  }\n}\n") ;
+    fclose (out) ;
+    return TRUE ;
+}
+
+/*************************
+ * </benchmark>
+ * ***********************/
+
+/*************************
+ * <tracing>
+ * ***********************/
+
+enum bool_t
+tracer_init (struct tracer_t *a_tracer, unsigned long a_nb_events)
+{
+    RETURN_VAL_IF_FAIL (a_tracer, FALSE) ;
+    RETURN_VAL_IF_FAIL (a_nb_events && !(a_nb_events & (a_nb_events - 1)),
+                        FALSE) ;
+
+    memset (a_tracer, 0, sizeof (struct tracer_t)) ;
+    /*touch it all now, rather than page faulting in the hot loop*/
+    a_tracer->events = malloc (a_nb_events * sizeof (struct trace_event_t)) ;
+    if (!a_tracer->events) {
+        LOG_ERROR ("could not allocate %lu trace events\n", a_nb_events) ;
+        return FALSE ;
+    }
+    memset (a_tracer->events, 0, a_nb_events * sizeof (struct trace_event_t)) ;
+    a_tracer->nb_events = a_nb_events ;
+    a_tracer->start_ns = get_monotonic_ns () ;
+    return TRUE ;
+}
+
+void
+tracer_finalize (struct tracer_t *a_tracer)
+{
+    RETURN_IF_FAIL (a_tracer) ;
+
+    free (a_tracer->events) ;
+    memset (a_tracer, 0, sizeof (struct tracer_t)) ;
+}
+
+/**
+ * record an event in the ring, overwriting the oldest one once
+ * the ring is full. Any thread may call this at any time, a_tracer
+ * being NULL when not tracing.
+ */
+void
+tracer_record (struct tracer_t *a_tracer,
+               const char *a_name,
+               int a_stream_id,
+               enum trace_thread_t a_thread,
+               int a_frame_index,
+               int64_t a_start_ns,
+               int64_t a_end_ns)
+{
+    struct trace_event_t *event=NULL ;
+    unsigned long slot=0 ;
+
+    if (!a_tracer) {
+        return ;
+    }
+    slot = __atomic_fetch_add (&a_tracer->nb_recorded, 1, __ATOMIC_RELAXED) ;
+    event = &a_tracer->events[slot & (a_tracer->nb_events - 1)] ;
+    event->name = a_name ;
+    event->start_ns = a_start_ns ;
+    event->end_ns = a_end_ns ;
+    event->stream_id = a_stream_id ;
+    event->thread = a_thread ;
+    event->frame_index = a_frame_index ;
+}
+
+static void
+write_json_string (FILE *a_out, const char *a_str)
+{
+    const char *p=NULL ;
+
+    fputc ('"', a_out) ;
+    for (p = a_str ; *p ; p++) {
+        if (*p == '"' || *p == '\\') {
+            fprintf (a_out, "\\%c", *p) ;
+        } else if ((unsigned char)*p < 0x20) {
+            fprintf (a_out, "\\u%04x", (unsigned char)*p) ;
+        } else {
+            fputc (*p, a_out) ;
+        }
+    }
+    fputc ('"', a_out) ;
+}
+
+/**
+ * write the events of a_tracer, oldest first, as Chrome trace
+ * events, which chrome://tracing or Perfetto can show.
+ * Each stream is a process named after a_stream_names, with a
+ * display and a reader thread.
+ * The threads recording events must be stopped by then.
+ */
+enum bool_t
+tracer_write_json (struct tracer_t *a_tracer,
+                   const char *a_path,
+                   char **a_stream_names,
+                   int a_nb_streams)
+{
+    FILE *out=NULL ;
+    struct trace_event_t *event=NULL ;
+    const char *sep="" ;
+    unsigned long first=0, i=0 ;
+    int id=0 ;
+
+    RETURN_VAL_IF_FAIL (a_tracer && a_tracer->events && a_path, FALSE) ;
+
+    out = fopen (a_path, "w") ;
+    if (!out) {
+        LOG_ERROR ("could not open '%s': %s\n", a_path, strerror (errno)) ;
+        return FALSE ;
+    }
+    fprintf (out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n") ;
+    for (id=0 ; id < a_nb_streams ; id++) {
+        fprintf (out, "%s{\"ph\":\"M\",\"name\":\"process_name\","
+                      "\"pid\":%d,\"args\":{\"name\":", sep, id) ;
+        write_json_string (out, a_stream_names[id]) ;
+        fprintf (out, "}},\n"
+                 "{\"ph\":\"M\",\"name\":\"thread_name\","
+                 "\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"display\"}},\n"
+                 "{\"ph\":\"M\",\"name\":\"thread_name\","
+                 "\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"reader\"}}",
+                 id, TRACE_THREAD_DISPLAY, id, TRACE_THREAD_READER) ;
+        sep = ",\n" ;
+    }
+    if (a_tracer->nb_recorded > a_tracer->nb_events) {
+        first = a_tracer->nb_recorded - a_tracer->nb_events ;
+    }
+    for (i = first ; i < a_tracer->nb_recorded ; i++) {
+        event = &a_tracer->events[i & (a_tracer->nb_events - 1)] ;
+        fprintf (out, "%s{\"name\":\"%s\",\"pid\":%d,\"tid\":%d,"
+                      "\"ts\":%.3f,",
+                 sep, event->name, event->stream_id, event->thread,
+                 (event->start_ns - a_tracer->start_ns) / 1e3) ;
+        if (event->end_ns > event->start_ns) {
+            fprintf (out, "\"ph\":\"X\",\"dur\":%.3f",
+                     (event->end_ns - event->start_ns) / 1e3) ;
+        } else {
+            fprintf (out, "\"ph\":\"i\",\"s\":\"t\"") ;
+        }
+        if (event->frame_index >= 0) {
+            fprintf (out, ",\"args\":{\"frame\":%d}", event->frame_index) ;
+        }
+        fprintf (out, "}") ;
+        sep = ",\n" ;
+    }
+    fprintf (out, "\n]}\n") ;
+    if (fclose (out)) {
+        LOG_ERROR ("could not write '%s': %s\n", a_path, strerror (errno)) ;
+        return FALSE ;
+    }
+    fprintf (stdout, "trace: %lu events written to %s",
+             a_tracer->nb_recorded - first, a_path) ;
+    if (first) {
+        fprintf (stdout, ", the %lu oldest were overwritten", first) ;
+    }
+    fprintf (stdout, "\n") ;
+    return TRUE ;
+}
+
+/*************************
+ * </tracing>
+ * ***********************/
+
+/*************************
+ * <verification>
+ * ***********************/
+
+#define CRC32C_POLY 0x82f63b78 /*reflected Castagnoli polynomial*/
+/*frame hashes mismatching past the first ones are only counted*/
+#define VERIFY_MAX_LOGGED 10
+
+static uint32_t crc32c_table[256] ;
+
+static void
+crc32c_init_table (void)
+{
+    uint32_t crc=0 ;
+    int i=0, j=0 ;
+
+    for (i=0 ; i < 256 ; i++) {
+        crc = i ;
+        for (j=0 ; j < 8 ; j++) {
+            crc = (crc >> 1) ^ (crc & 1 ? CRC32C_POLY : 0) ;
+        }
+        crc32c_table[i] = crc ;
+    }
+}
+
+static uint32_t
+crc32c_update_scalar (uint32_t a_crc, const unsigned char *a_data, size_t a_len)
+{
+    size_t i=0 ;
+
+    for (i=0 ; i < a_len ; i++) {
+        a_crc = crc32c_table[(a_crc ^ a_data[i]) & 0xff] ^ (a_crc >> 8) ;
+    }
+    return a_crc ;
+}
+
+/*
+ * a frame is hashed as three lanes of a third of it each, so that
+ * the CRC32 instruction, which has a latency of 3 cycles, runs on
+ * three independent chains. The lane CRCs and the bytes left over
+ * are then folded into a last CRC. The scalar version computes the
+ * same value, for the golden lists to hold on any machine.
+ */
+static void
+frame_hash_split (size_t a_len, size_t *a_lane_len)
+{
+    *a_lane_len = a_len / 24 * 8 ;
+}
+
+static uint32_t
+frame_hash_fold (uint32_t a_crc0,
+                 uint32_t a_crc1,
+                 uint32_t a_crc2,
+                 const unsigned char *a_rest,
+                 size_t a_rest_len)
+{
+    unsigned char lanes[8] ;
+    int i=0 ;
+
+    for (i=0 ; i < 4 ; i++) {
+        lanes[i] = a_crc1 >> (8 * i) ;
+        lanes[4 + i] = a_crc2 >> (8 * i) ;
+    }
+    a_crc0 = crc32c_update_scalar (a_crc0, lanes, sizeof (lanes)) ;
+    return ~crc32c_update_scalar (a_crc0, a_rest, a_rest_len) ;
+}
+
+static uint32_t
+frame_hash_scalar (const unsigned char *a_data, size_t a_len)
+{
+    uint32_t crc0=~0U, crc1=~0U, crc2=~0U ;
+    size_t lane_len=0 ;
+
+    frame_hash_split (a_len, &lane_len) ;
+    crc0 = crc32c_update_scalar (crc0, a_data, lane_len) ;
+    crc1 = crc32c_update_scalar (crc1, a_data + lane_len, lane_len) ;
+    crc2 = crc32c_update_scalar (crc2, a_data + 2 * lane_len, lane_len) ;
+    return frame_hash_fold (crc0, crc1, crc2, a_data + 3 * lane_len,
+                            a_len - 3 * lane_len) ;
+}
+
+#if defined(HAVE_X86_SIMD) && defined(__x86_64__)
+#define HAVE_CRC32C_SSE42 1
+
+__attribute__ ((target ("sse4.2")))
+static uint32_t
+frame_hash_sse42 (const unsigned char *a_data, size_t a_len)
+{
+    uint64_t crc0=~0U, crc1=~0U, crc2=~0U, word0=0, word1=0, word2=0 ;
+    const unsigned char *lane1=NULL, *lane2=NULL ;
+    size_t lane_len=0, i=0 ;
+
+    frame_hash_split (a_len, &lane_len) ;
+    lane1 = a_data + lane_len ;
+    lane2 = a_data + 2 * lane_len ;
+    for (i=0 ; i < lane_len ; i += 8) {
+        memcpy (&word0, a_data + i, 8) ;
+        memcpy (&word1, lane1 + i, 8) ;
+        memcpy (&word2, lane2 + i, 8) ;
+        crc0 = _mm_crc32_u64 (crc0, word0) ;
+        crc1 = _mm_crc32_u64 (crc1, word1) ;
+        crc2 = _mm_crc32_u64 (crc2, word2) ;
+    }
+    return frame_hash_fold (crc0, crc1, crc2, a_data + 3 * lane_len,
+                            a_len - 3 * lane_len) ;
+}
+#endif /*HAVE_X86_SIMD && __x86_64__*/
+
+static enum bool_t
+verifier_grow (struct verifier_t *a_verifier, int a_index)
+{
+    uint32_t *hashes=NULL ;
+    unsigned char *has_hash=NULL ;
+    int capacity=0 ;
+
+    if (a_index < a_verifier->capacity) {
+        return TRUE ;
+    }
+    capacity = a_verifier->capacity ? a_verifier->capacity : 256 ;
+    while (capacity <= a_index) {
+        capacity *= 2 ;
+    }
+    hashes = realloc (a_verifier->hashes, capacity * sizeof (uint32_t)) ;
+    if (!hashes) {
+        return FALSE ;
+    }
+    a_verifier->hashes = hashes ;
+    has_hash = realloc (a_verifier->has_hash, capacity) ;
+    if (!has_hash) {
+        return FALSE ;
+    }
+    memset (has_hash + a_verifier->capacity, 0,
+            capacity - a_verifier->capacity) ;
+    a_verifier->has_hash = has_hash ;
+    a_verifier->capacity = capacity ;
+    return TRUE ;
+}
+
+static enum bool_t
+verifier_set_hash (struct verifier_t *a_verifier, int a_index, uint32_t a_hash)
+{
+    if (a_index < 0 || !verifier_grow (a_verifier, a_index)) {
+        return FALSE ;
+    }
+    a_verifier->hashes[a_index] = a_hash ;
+    a_verifier->has_hash[a_index] = TRUE ;
+    if (a_index >= a_verifier->nb_hashes) {
+        a_verifier->nb_hashes = a_index + 1 ;
+    }
+    return TRUE ;
+}
+
+/**
+ * get ready to check frames against the golden list in the file
+ * a_golden_path, or to record their hashes if it is NULL.
+ * The lists are made of "<frame index> <crc32c in hex>" lines, and
+ * of comment lines starting with '#'.
+ */
+enum bool_t
+verifier_init (struct verifier_t *a_verifier,
+               const char *a_golden_path,
+               enum bool_t a_no_simd)
+{
+    char line[256] ;
+    FILE *file=NULL ;
+    unsigned hash=0 ;
+    int index=0, line_nb=0 ;
+
+    RETURN_VAL_IF_FAIL (a_verifier, FALSE) ;
+
+    memset (a_verifier, 0, sizeof (struct verifier_t)) ;
+    a_verifier->first_mismatch = -1 ;
+    crc32c_init_table () ;
+    a_verifier->hash = frame_hash_scalar ;
+#ifdef HAVE_CRC32C_SSE42
+    if (!a_no_simd) {
+        __builtin_cpu_init () ;
+        if (__builtin_cpu_supports ("sse4.2")) {
+            a_verifier->hash = frame_hash_sse42 ;
+        }
+    }
+#endif
+    LOG ("hashing frames with %s\n",
+         a_verifier->hash == frame_hash_scalar ? "scalar code" : "SSE4.2") ;
+    if (!a_golden_path) {
+        return TRUE ;
+    }
+
+    a_verifier->is_checking = TRUE ;
+    file = fopen (a_golden_path, "r") ;
+    if (!file) {
+        LOG_ERROR ("could not open '%s': %s\n",
+                   a_golden_path, strerror (errno)) ;
+        return FALSE ;
+    }
+    while (fgets (line, sizeof (line), file)) {
+        line_nb++ ;
+        if (line[0] == '#' || line[0] == '\n') {
+            continue ;
+        }
+        if (sscanf (line, "%d %x", &index, &hash) != 2 || index < 0) {
+            LOG_ERROR ("%s:%d: expected a frame index and a hash\n",
+                       a_golden_path, line_nb) ;
+            goto error ;
+        }
+        if (!verifier_set_hash (a_verifier, index, hash)) {
+            goto error ;
+        }
+    }
+    fclose (file) ;
+    LOG ("checking frames against the %d hashes of '%s'\n",
+         a_verifier->nb_hashes, a_golden_path) ;
+    return TRUE ;
+
+error:
+    fclose (file) ;
+    verifier_finalize (a_verifier) ;
+    return FALSE ;
+}
+
+void
+verifier_finalize (struct verifier_t *a_verifier)
+{
+    RETURN_IF_FAIL (a_verifier) ;
+
+    free (a_verifier->hashes) ;
+    a_verifier->hashes = NULL ;
+    free (a_verifier->has_hash) ;
+    a_verifier->has_hash = NULL ;
+    a_verifier->nb_hashes = 0 ;
+    a_verifier->capacity = 0 ;
+}
+
+/**
+ * hash the a_len bytes at a_data of frame a_index of the input, then
+ * check the hash against the golden list or record it.
+ */
+void
+verifier_check_frame (struct verifier_t *a_verifier,
+                      int a_index,
+                      const char *a_data,
+                      size_t a_len)
+{
+    int64_t start=0 ;
+    uint32_t hash=0 ;
+
+    RETURN_IF_FAIL (a_verifier && a_data) ;
+
+    start = get_monotonic_ns () ;
+    hash = a_verifier->hash ((const unsigned char*)a_data, a_len) ;
+    a_verifier->hash_ns += get_monotonic_ns () - start ;
+    a_verifier->nb_checked++ ;
+    if (!a_verifier->is_checking) {
+        if (!verifier_set_hash (a_verifier, a_index, hash)) {
+            LOG_ERROR ("could not record the hash of frame %d\n", a_index) ;
+        }
+        return ;
+    }
+    if (a_index < 0 || a_index >= a_verifier->nb_hashes
+        || !a_verifier->has_hash[a_index]) {
+        a_verifier->nb_unknown++ ;
+        return ;
+    }
+    if (a_verifier->hashes[a_index] == hash) {
+        return ;
+    }
+    if (a_verifier->nb_mismatches < VERIFY_MAX_LOGGED) {
+        LOG_ERROR ("frame %d has hash %08x instead of %08x\n",
+                   a_index, hash, a_verifier->hashes[a_index]) ;
+    }
+    if (a_verifier->first_mismatch < 0) {
+        a_verifier->first_mismatch = a_index ;
+    }
+    a_verifier->nb_mismatches++ ;
+}
+
+void
+verifier_dump (struct verifier_t *a_verifier, FILE *a_out)
+{
+    RETURN_IF_FAIL (a_verifier && a_out) ;
+
+    if (!a_verifier->nb_checked) {
+        return ;
+    }
+    fprintf (a_out, "verify: %lu frames hashed, %.1fus per frame\n",
+             a_verifier->nb_checked,
+             a_verifier->hash_ns / 1e3 / a_verifier->nb_checked) ;
+    if (!a_verifier->is_checking) {
+        return ;
+    }
+    if (a_verifier->nb_mismatches) {
+        fprintf (a_out, "verify: FAILED, %lu frames mismatch,"
+                 " the first one is frame %d\n",
+                 a_verifier->nb_mismatches, a_verifier->first_mismatch) ;
+    } else {
+        fprintf (a_out, "verify: all the frames match\n") ;
+    }
+    if (a_verifier->nb_unknown) {
+        fprintf (a_out, "verify: %lu frames are not in the golden list\n",
+                 a_verifier->nb_unknown) ;
+    }
+}
+
+/**
+ * write the hashes recorded to a_path as a golden list of frames of
+ * a_width x a_height pixels in a_format.
+ */
+enum bool_t
+verifier_write (struct verifier_t *a_verifier,
+                const char *a_path,
+                unsigned a_width,
+                unsigned a_height,
+                enum yuv_format_t a_format)
+{
+    FILE *file=NULL ;
+    int i=0 ;
+
+    RETURN_VAL_IF_FAIL (a_verifier && a_path, FALSE) ;
+
+    file = fopen (a_path, "w") ;
+    if (!file) {
+        LOG_ERROR ("could not open '%s': %s\n", a_path, strerror (errno)) ;
+        return FALSE ;
+    }
+    fprintf (file, "# frame hashes of testxvideo --verify\n"
+             "# %ux%u %s frames, as put to the sink\n",
+             a_width, a_height, yuv_format_get_info (a_format)->name) ;
+    for (i=0 ; i < a_verifier->nb_hashes ; i++) {
+        if (a_verifier->has_hash[i]) {
+            fprintf (file, "%d %08x\n", i, a_verifier->hashes[i]) ;
+        }
+    }
+    if (fclose (file)) {
+        LOG_ERROR ("could not write '%s': %s\n", a_path, strerror (errno)) ;
+        return FALSE ;
+    }
+    LOG ("wrote the hashes of %d frames to '%s'\n",
+         a_verifier->nb_hashes, a_path) ;
+    return TRUE ;
+}
+
+/*************************
+ * </verification>
+ * ***********************/
+
+/*************************
+ * <streams>
+ * ***********************/
+
+/**
+ * open the yuv file of a stream, whose output is then set up
+ * by stream_start().
+ */
+enum bool_t
+stream_init (struct stream_t *a_stream, int a_id, const char *a_path)
+{
+    struct stat st ;
+
+    RETURN_VAL_IF_FAIL (a_stream && a_path && options, FALSE) ;
+
+    memset (a_stream, 0, sizeof (struct stream_t)) ;
+    a_stream->id = a_id ;
+    a_stream->path = a_path ;
+    if (options->is_source_spec[a_id]) {
+        a_stream->source = pattern_source_new
+                        (a_path + strlen (PATTERN_SOURCE_PREFIX),
+                         options->src_width ? options->src_width
+                                            : PATTERN_DEFAULT_WIDTH,
+                         options->src_height ? options->src_height
+                                             : PATTERN_DEFAULT_HEIGHT,
+                         options->yuv_format,
+                         options->no_simd) ;
+    } else if (!strcmp (a_path, "-")
+        || (!stat (a_path, &st) && !S_ISREG (st.st_mode))) {
+        if (options->use_mmap) {
+            LOG ("can't map '%s', reading it as a stream\n", a_path) ;
+        }
+        a_stream->source = pipe_source_new (a_path,
+                                            options->src_width,
+                                            options->src_height,
+                                            options->yuv_format) ;
+    } else if (options->direct_io) {
+        if (options->use_mmap) {
+            LOG ("--direct-io reads '%s' instead of mapping it\n", a_path) ;
+        }
+        a_stream->source = direct_source_new (a_path,
+                                              options->src_width,
+                                              options->src_height,
+                                              options->yuv_format) ;
+    } else if (options->use_mmap) {
+        a_stream->source = mmap_source_new (a_path,
+                                            options->src_width,
+                                            options->src_height,
+                                            options->yuv_format) ;
+    } else {
+        a_stream->source = stdio_source_new (a_path,
+                                             options->src_width,
+                                             options->src_height,
+                                             options->yuv_format) ;
+    }
+    if (!a_stream->source) {
+        LOG_ERROR ("could not open file '%s'\n", a_path) ;
+        return FALSE ;
+    }
+    if (!yuv_source_set_range (a_stream->source,
+                               options->start_frame,
+                               options->end_frame ? options->end_frame : -1,
+                               options->nb_loops,
+                               options->reverse)) {
+        LOG_ERROR ("could not play the frames asked for of '%s'\n", a_path) ;
+        return FALSE ;
+    }
+    if (options->preload > 0) {
+        a_stream->source = preload_source_new (a_stream->source,
+                                               options->preload,
+                                               options->huge_pages) ;
+        if (!a_stream->source) {
+            LOG_ERROR ("could not preload the frames of '%s'\n", a_path) ;
+            return FALSE ;
+        }
+    }
+    return TRUE ;
+}
+
+/**
+ * place the window of a_stream, the a_id th of a grid a_nb_columns
+ * wide unless a_geometry says otherwise, and set what part of the
+ * frames goes where in it.
+ * The frames fill the window, unless --dst-size is given.
+ */
+void
+stream_init_geometry (struct stream_t *a_stream,
+                      const char *a_geometry,
+                      int a_nb_columns)
+{
+    int dst_width=0, dst_height=0, x=0, y=0, mask=0 ;
+    unsigned width=0, height=0 ;
+
+    RETURN_IF_FAIL (a_stream && a_stream->source
+                    && options && a_nb_columns > 0) ;
+
+    /*the destination size defaults to the source size*/
+    dst_width = options->dst_width ? options->dst_width
+                                   : (int)a_stream->source->width ;
+    dst_height = options->dst_height ? options->dst_height
+                                     : (int)a_stream->source->height ;
+    a_stream->window_width = dst_width > 0 ? dst_width : 320 ;
+    a_stream->window_height = dst_height > 0 ? dst_height : 240 ;
+    a_stream->window_x = (a_stream->id % a_nb_columns)
+                         * a_stream->window_width ;
+    a_stream->window_y = (a_stream->id / a_nb_columns)
+                         * a_stream->window_height ;
+    if (a_geometry) {
+        mask = XParseGeometry (a_geometry, &x, &y, &width, &height) ;
+        if (mask & XValue) {
+            a_stream->window_x = x ;
+        }
+        if (mask & YValue) {
+            a_stream->window_y = y ;
+        }
+        if (mask & WidthValue) {
+            a_stream->window_width = width ;
+            if (!options->dst_width) {
+                dst_width = width ;
+            }
+        }
+        if (mask & HeightValue) {
+            a_stream->window_height = height ;
+            if (!options->dst_height) {
+                dst_height = height ;
+            }
+        }
+    }
+    a_stream->geometry.src_x = options->src_x ;
+    a_stream->geometry.src_y = options->src_y ;
+    a_stream->geometry.src_width = a_stream->source->width ;
+    a_stream->geometry.src_height = a_stream->source->height ;
+    a_stream->geometry.dst_x = options->dst_x ;
+    a_stream->geometry.dst_y = options->dst_y ;
+    a_stream->geometry.dst_width = dst_width ;
+    a_stream->geometry.dst_height = dst_height ;
+}
+
+/*
+ * a_path, suffixed with the stream id when several streams would
+ * otherwise write to the same file. To be free()d.
+ */
+static char*
+stream_make_output_path (struct stream_t *a_stream, const char *a_path)
+{
+    char *path=NULL ;
+
+    if (!a_path) {
+        return NULL ;
+    }
+    if (nb_streams <= 1) {
+        return strdup (a_path) ;
+    }
+    path = malloc (strlen (a_path) + 16) ;
+    if (path) {
+        sprintf (path, "%s.%d", a_path, a_stream->id) ;
+    }
+    return path ;
+}
+
+/**
+ * create the sink of a_stream on a_display, which is NULL for
+ * the sinks not using an XServer, then its frame pool and its
+ * reader thread.
+ */
+enum bool_t
+stream_start (struct stream_t *a_stream, Display *a_display)
+{
+    struct yuv_source_t *source=NULL ;
+    int nb_pool_frames=FRAME_POOL_SIZE ;
+    char *sink_path=NULL ;
+    struct sink_options_t sink_options ;
+    double fps=0 ;
+
+    RETURN_VAL_IF_FAIL (a_stream && a_stream->source && options, FALSE) ;
+
+    source = a_stream->source ;
+    if (options->verify_path || options->verify_write_path) {
+        char *golden_path = stream_make_output_path (a_stream,
+                                                     options->verify_path) ;
+        enum bool_t is_ok = verifier_init (&a_stream->verifier, golden_path,
+                                           options->no_simd) ;
+
+        free (golden_path) ;
+        if (!is_ok) {
+            LOG_ERROR ("could not set up the frame verification\n") ;
+            return FALSE ;
+        }
+        a_stream->verifier_ptr = &a_stream->verifier ;
+    }
+    if (options->benchmark) {
+        benchmark_init (&a_stream->benchmark) ;
+        a_stream->benchmark.frame_len = source->frame_len ;
+        a_stream->benchmark_ptr = &a_stream->benchmark ;
+    }
+    fps = options->fps < 0 ? source->fps : options->fps ;
+    if (fps > 0) {
+        int end_index = yuv_source_get_nb_frames (a_stream->source) ;
+
+        if (options->nb_frames
+            && (!end_index || options->nb_frames < end_index)) {
+            end_index = options->nb_frames ;
+        }
+        pacer_init (&a_stream->pacer, fps, end_index) ;
+        a_stream->pacer_ptr = &a_stream->pacer ;
+    }
+    if (options->prefetch > 0) {
+        nb_pool_frames += options->prefetch ;
+    }
+    if (options->sink_type == SINK_TYPE_PRESENT) {
+        /*the frames queued to the XServer hold on to their pixmap*/
+        nb_pool_frames += PRESENT_MAX_QUEUED ;
+    }
+
+    sink_options_init (&sink_options) ;
+    sink_options.no_simd = options->no_simd ;
+    sink_options.no_shm = options->no_shm ;
+    sink_options.client_scale = options->client_scale ;
+    sink_options.scale_filter = options->scale_filter ;
+    sink_options.scale_threads = options->scale_threads ;
+    sink_options.xcb = options->xcb ;
+
+    sink_path = stream_make_output_path (a_stream, options->sink_path) ;
+    a_stream->sink = sink_new (options->sink_type, sink_path,
+                               a_display, a_stream->window,
+                               &a_stream->geometry, source->format,
+                               source->width, source->height,
+                               &sink_options) ;
+    free (sink_path) ;
+    if (!a_stream->sink && options->sink_type == SINK_TYPE_XV) {
+        LOG ("no usable Xv adaptor, falling back to the ximage sink\n") ;
+        a_stream->sink = sink_new (SINK_TYPE_XIMAGE, NULL,
+                                   a_display, a_stream->window,
+                                   &a_stream->geometry, source->format,
+                                   source->width, source->height,
+                                   &sink_options) ;
+    }
+    if (!a_stream->sink) {
+        LOG_ERROR ("could not create the output sink\n") ;
+        return FALSE ;
+    }
+
+    a_stream->has_pool = frame_pool_init (&a_stream->pool, nb_pool_frames,
+                                          source->frame_len,
+                                          options->huge_pages,
+                                          a_stream->sink->alloc_frame,
+                                          a_stream->sink->free_frame,
+                                          a_stream->sink) ;
+    if (!a_stream->has_pool) {
+        LOG_ERROR ("failed to create frame pool\n") ;
+        return FALSE ;
+    }
+    source->zero_copy = a_stream->sink->zero_copy ;
+    LOG ("zero copy frames: %s\n", source->zero_copy ? "yes" : "no") ;
+    if (a_stream->sink->upload_mode) {
+        LOG ("upload mode: %s\n", a_stream->sink->upload_mode) ;
+    }
+    if (a_stream->benchmark_ptr) {
+        a_stream->benchmark_ptr->upload_mode = a_stream->sink->upload_mode ;
+    }
+    source->nb_frames_in_use = nb_pool_frames ;
+
+    if (options->prefetch > 0) {
+        if (!prefetcher_start (&a_stream->prefetcher, source,
+                               a_stream->pacer_ptr, &a_stream->pool,
+                               a_stream->id)) {
+            LOG_ERROR ("failed to start prefetching\n") ;
+            return FALSE ;
+        }
+        LOG ("prefetching %d frames\n", options->prefetch) ;
+    }
+    a_stream->start_ns = get_monotonic_ns () ;
+    return TRUE ;
+}
+
+/**
+ * account for a stage of a_stream started at a_start_ns and
+ * ending now, in its benchmark and in the trace.
+ * returns now, or 0 if neither is on.
+ */
+static int64_t
+stream_record_stage (struct stream_t *a_stream,
+                     enum benchmark_stage_t a_stage,
+                     int a_frame_index,
+                     int64_t a_start_ns)
+{
+    int64_t now=0 ;
+
+    now = benchmark_record (a_stream->benchmark_ptr, a_stage, a_start_ns) ;
+    if (tracer) {
+        if (!now) {
+            now = get_monotonic_ns () ;
+        }
+        tracer_record (tracer, benchmark_stage_names[a_stage], a_stream->id,
+                       TRACE_THREAD_DISPLAY, a_frame_index, a_start_ns, now) ;
+    }
+    return now ;
+}
+
+/*give a frame the display is done with back to whoever reads them*/
+static void
+stream_recycle_frame (struct stream_t *a_stream, struct frame_t *a_frame)
+{
+    if (a_stream->prefetcher.is_running) {
+        prefetcher_push_free (&a_stream->prefetcher, a_frame) ;
+    } else {
+        frame_pool_release (&a_stream->pool, a_frame) ;
+    }
+}
+
+/**
+ * get the next frame of a_stream to show into a_stream->pending_frame,
+ * dropping the frames which display period is already over.
+ * This does not wait for the reader thread: if it has no frame ready
+ * yet, its full_eventfd tells when to try again.
+ * returns FALSE if no frame is pending, setting a_stream->is_done
+ * at the end of the stream.
+ */
+enum bool_t
+stream_fetch_frame (struct stream_t *a_stream)
+{
+    struct yuv_source_t *source=NULL ;
+    struct frame_t *frame=NULL ;
+    int64_t stage_start=0 ;
+    int nb_frames=0 ;
+
+    RETURN_VAL_IF_FAIL (a_stream && a_stream->sink, FALSE) ;
+
+    source = a_stream->source ;
+    nb_frames = options->nb_frames ;
+    while (!a_stream->pending_frame && !a_stream->is_done) {
+        if (options->duration > 0
+            && get_monotonic_ns () - a_stream->start_ns
+               >= (int64_t)(options->duration * 1e9)) {
+            LOG ("stream %d played for %.2fs\n",
+                 a_stream->id, options->duration) ;
+            a_stream->is_done = TRUE ;
+            return FALSE ;
+        }
+        if (a_stream->benchmark_ptr || tracer) {
+            stage_start = get_monotonic_ns () ;
+        }
+        if (a_stream->prefetcher.is_running) {
+            enum bool_t eof=FALSE ;
+
+            frame = prefetcher_try_pop (&a_stream->prefetcher, &eof) ;
+            if (!frame) {
+                a_stream->is_done = eof ;
+                return FALSE ;
+            }
+        } else {
+            frame = frame_pool_acquire (&a_stream->pool) ;
+            if (!frame) {
+                LOG_ERROR ("frame pool exhausted\n") ;
+                a_stream->is_done = TRUE ;
+                return FALSE ;
+            }
+            /*the server may still be reading the segment of that frame*/
+            wait_for_shm_completion (a_stream->sink->display, frame) ;
+            pacer_skip_late_frames (a_stream->pacer_ptr, source) ;
+            if (!source->read_frame (source, frame)) {
+                frame_pool_release (&a_stream->pool, frame) ;
+                a_stream->is_done = TRUE ;
+                return FALSE ;
+            }
+        }
+        if (a_stream->prefetcher.is_running) {
+            /*the reader thread traces the read itself*/
+            benchmark_record (a_stream->benchmark_ptr, BENCHMARK_STAGE_READ,
+                              stage_start) ;
+        } else {
+            stream_record_stage (a_stream, BENCHMARK_STAGE_READ,
+                                 frame->index, stage_start) ;
+        }
+        if (nb_frames && frame->index >= nb_frames) {
+            stream_recycle_frame (a_stream, frame) ;
+            a_stream->is_done = TRUE ;
+            return FALSE ;
+        }
+        if (a_stream->pacer_ptr
+            && pacer_is_frame_late (a_stream->pacer_ptr, frame->index)) {
+            stream_recycle_frame (a_stream, frame) ;
+            if (tracer) {
+                stage_start = get_monotonic_ns () ;
+                tracer_record (tracer, "drop", a_stream->id,
+                               TRACE_THREAD_DISPLAY, frame->index,
+                               stage_start, stage_start) ;
+            }
+            LOG_FRAME ("dropped late frame %d of stream %d\n",
+                       frame->index, a_stream->id) ;
+            continue ;
+        }
+        a_stream->pending_frame = frame ;
+    }
+    return a_stream->pending_frame != NULL ;
+}
+
+/**
+ * the time the pending frame of a_stream is due at,
+ * 0 if the stream is not paced.
+ */
+int64_t
+stream_get_deadline (struct stream_t *a_stream)
+{
+    RETURN_VAL_IF_FAIL (a_stream && a_stream->pending_frame, 0) ;
+
+    if (!a_stream->pacer_ptr) {
+        return 0 ;
+    }
+    if (!pacer_is_started (a_stream->pacer_ptr)) {
+        pacer_start (a_stream->pacer_ptr, a_stream->pending_frame->index) ;
+    }
+    return pacer_get_deadline (a_stream->pacer_ptr,
+                               a_stream->pending_frame->index) ;
+}
+
+/**
+ * upload and put the pending frame of a_stream, which must be due.
+ * The sink is flushed by the caller, once for all the streams
+ * sharing its display.
+ */
+void
+stream_show_frame (struct stream_t *a_stream)
+{
+    struct sink_t *sink=NULL ;
+    struct frame_t *frame=NULL ;
+    int64_t stage_start=0 ;
+
+    RETURN_IF_FAIL (a_stream && a_stream->pending_frame) ;
+
+    sink = a_stream->sink ;
+    frame = a_stream->pending_frame ;
+    a_stream->pending_frame = NULL ;
+    frame->deadline_ns = 0 ;
+    if (a_stream->pacer_ptr) {
+        /*returns right away, but accounts for how late we are*/
+        pacer_wait_for_frame (a_stream->pacer_ptr, frame->index) ;
+        /*for the sinks which can schedule the frame to a vblank*/
+        frame->deadline_ns = pacer_get_deadline (a_stream->pacer_ptr,
+                                                 frame->index) ;
+    }
+    if (a_stream->verifier_ptr) {
+        /*the golden list is keyed by the frame of the file*/
+        verifier_check_frame (a_stream->verifier_ptr,
+                              yuv_source_get_input_frame (a_stream->source,
+                                                          frame->index),
+                              frame->data, frame->len) ;
+    }
+    if (a_stream->benchmark_ptr || tracer) {
+        stage_start = get_monotonic_ns () ;
+    }
+    if (sink->upload_frame) {
+        if (!sink->upload_frame (sink, frame)) {
+            LOG_ERROR ("failed to upload frame %d\n", frame->index) ;
+        }
+        stage_start = stream_record_stage (a_stream, BENCHMARK_STAGE_UPLOAD,
+                                           frame->index, stage_start) ;
+    }
+    LOG_FRAME ("pushing frame %d to the %s sink ... \n",
+               frame->index, sink->name) ;
+    if (!sink->put_frame (sink, frame)) {
+        LOG_ERROR ("failed to put frame %d\n", frame->index) ;
+    }
+    stream_record_stage (a_stream, BENCHMARK_STAGE_PUT,
+                         frame->index, stage_start) ;
+    if (a_stream->benchmark_ptr) {
+        a_stream->benchmark_ptr->nb_frames++ ;
+        a_stream->benchmark_ptr->nb_bytes += frame->len ;
+    }
+    a_stream->nb_shown++ ;
+    a_stream->nb_bytes += frame->len ;
+    a_stream->end_ns = get_monotonic_ns () ;
+    if (a_stream->nb_shown == 1) {
+        a_stream->first_frame_ns = a_stream->end_ns ;
+    }
+    /*
+     * keep the frame for redraws until the next one is shown. The
+     * reader thread can't wait for the XServer, so it only gets the
+     * previous frame back, which the server has had the time to read
+     * while we were putting this one.
+     */
+    if (a_stream->displayed_frame) {
+        wait_for_shm_completion (sink->display, a_stream->displayed_frame) ;
+        stream_recycle_frame (a_stream, a_stream->displayed_frame) ;
+    }
+    a_stream->displayed_frame = frame ;
+    a_stream->needs_redraw = FALSE ;
+    LOG_FRAME ("pushed frame %d.\n", frame->index) ;
+}
+
+/**
+ * put the last frame shown again, e.g. after its window got exposed
+ * or resized. It is still in its image, so nothing is read nor
+ * uploaded.
+ */
+void
+stream_redraw (struct stream_t *a_stream)
+{
+    struct frame_t *frame=NULL ;
+    int64_t start_ns=0 ;
+
+    RETURN_IF_FAIL (a_stream) ;
+
+    a_stream->needs_redraw = FALSE ;
+    frame = a_stream->displayed_frame ;
+    if (!frame || !a_stream->sink || !a_stream->sink->display) {
+        return ;
+    }
+    /*a second completion for the segment would confuse the first one*/
+    wait_for_shm_completion (a_stream->sink->display, frame) ;
+    /*its deadline is gone, show it at the next vblank*/
+    frame->deadline_ns = 0 ;
+    LOG_FRAME ("redrawing frame %d of stream %d\n",
+               frame->index, a_stream->id) ;
+    if (tracer) {
+        start_ns = get_monotonic_ns () ;
+    }
+    if (!a_stream->sink->put_frame (a_stream->sink, frame)) {
+        LOG_ERROR ("failed to redraw frame %d\n", frame->index) ;
+    }
+    if (tracer) {
+        tracer_record (tracer, "redraw", a_stream->id, TRACE_THREAD_DISPLAY,
+                       frame->index, start_ns, get_monotonic_ns ()) ;
+    }
+    a_stream->nb_redraws++ ;
+}
+
+/**
+ * make the frames of a_stream fill its window, now a_width x a_height,
+ * unless --dst-size gave their size.
+ */
+void
+stream_resize (struct stream_t *a_stream, int a_width, int a_height)
+{
+    RETURN_IF_FAIL (a_stream && options) ;
+
+    if (a_width == (int)a_stream->window_width
+        && a_height == (int)a_stream->window_height) {
+        return ;
+    }
+    a_stream->window_width = a_width ;
+    a_stream->window_height = a_height ;
+    if (!options->dst_width) {
+        a_stream->geometry.dst_width = a_width ;
+    }
+    if (!options->dst_height) {
+        a_stream->geometry.dst_height = a_height ;
+    }
+    if (a_stream->sink) {
+        sink_set_geometry (a_stream->sink, &a_stream->geometry) ;
+    }
+    /*shrinking a window does not expose it*/
+    a_stream->needs_redraw = TRUE ;
+}
+
+void
+stream_flush (struct stream_t *a_stream)
+{
+    int64_t stage_start=0 ;
+
+    RETURN_IF_FAIL (a_stream && a_stream->sink) ;
+
+    if (!a_stream->sink->flush) {
+        return ;
+    }
+    if (a_stream->benchmark_ptr || tracer) {
+        stage_start = get_monotonic_ns () ;
+    }
+    a_stream->sink->flush (a_stream->sink, options->sync) ;
+    stream_record_stage (a_stream, BENCHMARK_STAGE_FLUSH, -1, stage_start) ;
+}
+
+void
+stream_dump_stats (struct stream_t *a_stream, FILE *a_out)
+{
+    char *json_path=NULL ;
+
+    RETURN_IF_FAIL (a_stream && a_out) ;
+
+    if (a_stream->prefetcher.is_running) {
+        prefetcher_dump_stats (&a_stream->prefetcher, a_out) ;
+        /*the reader thread updates the pacer skip count until then*/
+        prefetcher_stop (&a_stream->prefetcher) ;
+    }
+    if (a_stream->pacer_ptr) {
+        pacer_dump_stats (a_stream->pacer_ptr, a_out) ;
+    }
+    if (a_stream->source->dump_stats) {
+        a_stream->source->dump_stats (a_stream->source,
+                                      a_stream->pacer_ptr
+                                      ? a_stream->pacer_ptr->fps : 0,
+                                      a_out) ;
+    }
+    if (a_stream->first_frame_ns) {
+        fprintf (a_out, "stream %d: first frame put %.3f ms after startup\n",
+                 a_stream->id,
+                 (a_stream->first_frame_ns - startup_ns) / 1e6) ;
+    }
+    if (a_stream->sink->dump_stats) {
+        a_stream->sink->dump_stats (a_stream->sink, a_out) ;
+    }
+    if (a_stream->sink->scaler) {
+        scaler_dump_stats (a_stream->sink->scaler, a_out) ;
+        if (a_stream->benchmark_ptr) {
+            scaler_benchmark (a_stream->sink->scaler, a_out) ;
+        }
+    }
+    if (a_stream->benchmark_ptr) {
+        benchmark_dump (a_stream->benchmark_ptr, a_out) ;
+        if (options->benchmark_json_path) {
+            json_path = stream_make_output_path
+                                (a_stream, options->benchmark_json_path) ;
+            if (json_path) {
+                benchmark_write_json (a_stream->benchmark_ptr, json_path) ;
+                free (json_path) ;
+            }
+        }
+    }
+    if (a_stream->verifier_ptr) {
+        verifier_dump (a_stream->verifier_ptr, a_out) ;
+        if (options->verify_write_path) {
+            char *hashes_path = stream_make_output_path
+                                    (a_stream, options->verify_write_path) ;
+            if (hashes_path) {
+                verifier_write (a_stream->verifier_ptr, hashes_path,
+                                a_stream->source->width,
+                                a_stream->source->height,
+                                a_stream->source->format) ;
+                free (hashes_path) ;
+            }
+        }
+    }
+    frame_pool_dump_stats (&a_stream->pool, a_out) ;
+    if (a_stream->nb_redraws) {
+        fprintf (a_out, "redraws: %lu after expose or resize\n",
+                 a_stream->nb_redraws) ;
+    }
+}
+
+/**
+ * release what stream_start() set up.
+ * The stream can't be played anymore, but keeps its stats.
+ */
+void
+stream_stop (struct stream_t *a_stream)
+{
+    RETURN_IF_FAIL (a_stream) ;
+
+    prefetcher_stop (&a_stream->prefetcher) ;
+    if (a_stream->has_pool) {
+        frame_pool_finalize (&a_stream->pool) ;
+        a_stream->has_pool = FALSE ;
+    }
+    a_stream->pending_frame = NULL ;
+    a_stream->displayed_frame = NULL ;
+    if (a_stream->sink) {
+        sink_destroy (a_stream->sink) ;
+        a_stream->sink = NULL ;
+    }
+}
+
+void
+stream_finalize (struct stream_t *a_stream)
+{
+    RETURN_IF_FAIL (a_stream) ;
+
+    stream_stop (a_stream) ;
+    if (a_stream->verifier_ptr) {
+        verifier_finalize (a_stream->verifier_ptr) ;
+        a_stream->verifier_ptr = NULL ;
+    }
+    if (a_stream->source) {
+        yuv_source_destroy (a_stream->source) ;
+        a_stream->source = NULL ;
+    }
+}
+
+/**
+ * start playing a_streams side by side on a_display, which is NULL
+ * if their sinks do not use an XServer.
+ * playback_run_round() must then be called whenever a frame may be
+ * due or a reader thread has signaled one.
+ */
+enum bool_t
+playback_start (struct playback_t *a_playback,
+                Display *a_display,
+                struct stream_t *a_streams,
+                int a_nb_streams)
+{
+    int i=0 ;
+
+    RETURN_VAL_IF_FAIL (a_playback && a_streams && a_nb_streams > 0, FALSE) ;
+
+    memset (a_playback, 0, sizeof (struct playback_t)) ;
+    a_playback->display = a_display ;
+    a_playback->streams = a_streams ;
+    a_playback->nb_streams = a_nb_streams ;
+    for (i=0 ; i < a_nb_streams ; i++) {
+        if (!stream_start (&a_streams[i], a_display)) {
+            LOG_ERROR ("could not start stream %d (%s)\n",
+                       i, a_streams[i].path) ;
+            goto error ;
+        }
+    }
+    a_playback->is_started = TRUE ;
+    a_playback->start_ns = get_monotonic_ns () ;
+    return TRUE ;
+
+error:
+    for (i=0 ; i < a_nb_streams ; i++) {
+        stream_stop (&a_streams[i]) ;
+    }
+    return FALSE ;
+}
+
+/**
+ * show the frames which are due and flush each display once, so
+ * that N streams cost one flush per round rather than N. Unpaced
+ * streams are always due, and go as fast as they can.
+ * Nothing here waits, but for reading a frame when there is no
+ * reader thread.
+ * *a_wake_ns is set to 0 if the next round can run right away, to
+ * the earliest deadline of the pending frames otherwise, or to
+ * INT64_MAX if only the reader threads can bring new frames.
+ * returns the nb of streams still playing.
+ */
+int
+playback_run_round (struct playback_t *a_playback, int64_t *a_wake_ns)
+{
+    struct stream_t *streams=NULL ;
+    int64_t now=0, deadline=0 ;
+    int i=0, j=0, nb_active=0 ;
+    enum bool_t has_shown=FALSE ;
+
+    RETURN_VAL_IF_FAIL (a_playback && a_playback->is_started
+                        && a_wake_ns, 0) ;
+
+    streams = a_playback->streams ;
+    *a_wake_ns = INT64_MAX ;
+    now = get_monotonic_ns () ;
+    for (i=0 ; i < a_playback->nb_streams ; i++) {
+        struct stream_t *stream = &streams[i] ;
+
+        stream->was_shown = FALSE ;
+        if (stream->is_done) {
+            continue ;
+        }
+        nb_active++ ;
+        if (!stream_fetch_frame (stream)) {
+            if (stream->is_done) {
+                nb_active-- ;
+            }
+            continue ;
+        }
+        deadline = stream_get_deadline (stream) ;
+        if (deadline > now) {
+            if (deadline < *a_wake_ns) {
+                *a_wake_ns = deadline ;
+            }
+            continue ;
+        }
+        stream_show_frame (stream) ;
+        stream->was_shown = TRUE ;
+        has_shown = TRUE ;
+    }
+    for (i=0 ; i < a_playback->nb_streams ; i++) {
+        if (!streams[i].was_shown) {
+            continue ;
+        }
+        /*the first stream shown on a display flushes it for all*/
+        for (j=0 ; j < i ; j++) {
+            if (streams[j].was_shown
+                && streams[j].sink->display
+                && streams[j].sink->display == streams[i].sink->display) {
+                break ;
+            }
+        }
+        if (j == i) {
+            stream_flush (&streams[i]) ;
+        }
+    }
+    if (has_shown) {
+        /*the streams shown have room for their next frame already*/
+        *a_wake_ns = 0 ;
+#ifdef HAVE_MALLINFO2
+        if (!a_playback->nb_rounds) {
+            /*whatever Xlib allocates lazily is done by now*/
+            a_playback->heap_in_use = mallinfo2 ().uordblks ;
+        }
+#endif
+        a_playback->nb_rounds++ ;
+    }
+    return nb_active ;
+}
+
+/**
+ * print the stats of the streams, once they have ended or when
+ * playback is stopped early.
+ */
+void
+playback_dump_stats (struct playback_t *a_playback)
+{
+    struct stream_t *streams=NULL ;
+    unsigned long nb_shown=0 ;
+    uint64_t nb_bytes=0 ;
+    double seconds=0 ;
+    int64_t end_ns=0 ;
+    int i=0 ;
+
+    RETURN_IF_FAIL (a_playback) ;
+
+    if (!a_playback->is_started || a_playback->has_dumped_stats) {
+        return ;
+    }
+    a_playback->has_dumped_stats = TRUE ;
+    end_ns = get_monotonic_ns () ;
+    streams = a_playback->streams ;
+    for (i=0 ; i < a_playback->nb_streams ; i++) {
+        struct stream_t *stream = &streams[i] ;
+
+        if (!stream->sink) {
+            /*never started*/
+            continue ;
+        }
+        if (a_playback->nb_streams > 1) {
+            seconds = (stream->end_ns - stream->start_ns) / 1e9 ;
+            if (seconds <= 0) {
+                seconds = 1e-9 ;
+            }
+            fprintf (stdout,
+                     "stream %d (%s): %lu frames in %.3fs: "
+                     "%.2f fps, %.2f MB/s\n",
+                     stream->id, stream->path, stream->nb_shown, seconds,
+                     stream->nb_shown / seconds,
+                     stream->nb_bytes / seconds / (1024.0 * 1024.0)) ;
+        }
+        stream_dump_stats (stream, stdout) ;
+        nb_shown += stream->nb_shown ;
+        nb_bytes += stream->nb_bytes ;
+    }
+    if (a_playback->nb_streams > 1) {
+        seconds = (end_ns - a_playback->start_ns) / 1e9 ;
+        if (seconds <= 0) {
+            seconds = 1e-9 ;
+        }
+        fprintf (stdout,
+                 "all %d streams: %lu frames in %.3fs: "
+                 "%.2f fps, %.2f MB/s\n",
+                 a_playback->nb_streams, nb_shown, seconds,
+                 nb_shown / seconds,
+                 nb_bytes / seconds / (1024.0 * 1024.0)) ;
+    }
+#ifdef HAVE_MALLINFO2
+    if (a_playback->nb_rounds > 1) {
+        fprintf (stdout, "heap growth after the first frame: %ld bytes\n",
+                 (long)mallinfo2 ().uordblks
+                 - (long)a_playback->heap_in_use) ;
+    }
+#endif
+}
 
-out:
-    if (xv_image) {
-        XFree (xv_image) ;
+/**
+ * print the stats of the streams if not done yet, then release
+ * what playback_start() set up.
+ */
+void
+playback_finish (struct playback_t *a_playback)
+{
+    int i=0 ;
+
+    RETURN_IF_FAIL (a_playback) ;
+
+    if (!a_playback->is_started) {
+        return ;
     }
-    if (yuv_buf) {
-        free (yuv_buf) ;
+    playback_dump_stats (a_playback) ;
+    for (i=0 ; i < a_playback->nb_streams ; i++) {
+        stream_stop (&a_playback->streams[i]) ;
     }
-    return is_ok ;
+    a_playback->is_started = FALSE ;
 }
 
 /*************************
- * </yuv stuff>
+ * </streams>
  * ***********************/
 
 /**************************
  * <x11 stuff>
  * ************************/
 
-void
+/**
+ * play the streams, handling the events of a_display in between.
+ * a_display is NULL if the sinks do not use an XServer, in which
+ * case playback starts right away, otherwise once all the windows
+ * are mapped.
+ * Only poll() waits, for X events, for the timerfd armed at the
+ * next frame deadline, and for the eventfds of the reader threads
+ * streams are waiting for, so events never wait for more than
+ * a frame.
+ * returns FALSE if playback failed. Closing a window ends it early.
+ */
+enum bool_t
 run_event_loop (Display *a_display)
 {
+    struct pollfd fds[2 + MAX_STREAMS] ;
+    struct itimerspec timer ;
+    struct playback_t playback ;
     XEvent event ;
+    int64_t wake_ns=0 ;
+    int timer_fd=-1, nb_fds=0, i=0, timeout=0 ;
+    enum bool_t is_ok=FALSE ;
 
-    RETURN_IF_FAIL (a_display) ;
+    RETURN_VAL_IF_FAIL (streams && nb_streams > 0, FALSE) ;
 
-    for (;;) {
-        XNextEvent (a_display, &event) ;
-        do_dispatch_event ((XEvent*)&event) ;
+    memset (&playback, 0, sizeof (playback)) ;
+    timer_fd = timerfd_create (CLOCK_MONOTONIC, TFD_NONBLOCK|TFD_CLOEXEC) ;
+    if (timer_fd < 0) {
+        LOG_ERROR ("failed to create a timerfd: %s\n", strerror (errno)) ;
+        return FALSE ;
+    }
+    if (a_display) {
+        /*completions come in with the other events, see do_dispatch_event*/
+        get_shm_completion_type (a_display) ;
+    }
+
+    while (!quit_requested) {
+        if (a_display) {
+            while (XPending (a_display)) {
+                XNextEvent (a_display, &event) ;
+                do_dispatch_event (&event) ;
+            }
+            if (quit_requested) {
+                break ;
+            }
+        }
+        if (!playback.is_started) {
+            for (i=0 ; i < nb_streams ; i++) {
+                if (a_display && !streams[i].is_mapped)
+                    break ;
+            }
+            if (i == nb_streams
+                && !playback_start (&playback, a_display,
+                                    streams, nb_streams)) {
+                goto out ;
+            }
+        }
+
+        timeout = -1 ;
+        nb_fds = 0 ;
+        if (a_display) {
+            fds[nb_fds].fd = ConnectionNumber (a_display) ;
+            fds[nb_fds].events = POLLIN ;
+            nb_fds++ ;
+        }
+        fds[nb_fds].fd = timer_fd ;
+        fds[nb_fds].events = POLLIN ;
+        nb_fds++ ;
+        if (playback.is_started) {
+            if (!playback_run_round (&playback, &wake_ns)) {
+                if (!a_display || !options->hold) {
+                    LOG ("all the streams ended\n") ;
+                    break ;
+                }
+                if (!playback.has_dumped_stats) {
+                    LOG ("all the streams ended, holding their last frame "
+                         "until a window is closed\n") ;
+                    playback_dump_stats (&playback) ;
+                }
+            }
+            /*however many Expose came in, redraw once*/
+            for (i=0 ; i < nb_streams ; i++) {
+                if (streams[i].needs_redraw && !streams[i].was_shown) {
+                    stream_redraw (&streams[i]) ;
+                }
+            }
+            memset (&timer, 0, sizeof (timer)) ;
+            if (!wake_ns) {
+                timeout = 0 ;
+            } else if (wake_ns != INT64_MAX) {
+                timer.it_value.tv_sec = wake_ns / 1000000000 ;
+                timer.it_value.tv_nsec = wake_ns % 1000000000 ;
+            }
+            /*a zero it_value disarms the timer*/
+            timerfd_settime (timer_fd, TFD_TIMER_ABSTIME, &timer, NULL) ;
+            for (i=0 ; i < nb_streams ; i++) {
+                if (!streams[i].is_done && !streams[i].pending_frame
+                    && streams[i].prefetcher.is_running) {
+                    fds[nb_fds].fd = streams[i].prefetcher.full_eventfd ;
+                    fds[nb_fds].events = POLLIN ;
+                    nb_fds++ ;
+                }
+            }
+        }
+        if (a_display) {
+            /*Xlib writes its requests out only when asked to*/
+            XFlush (a_display) ;
+            /*and events it already read don't make the socket readable*/
+            if (XEventsQueued (a_display, QueuedAlready)) {
+                timeout = 0 ;
+            }
+        }
+
+        if (poll (fds, nb_fds, timeout) < 0 && errno != EINTR) {
+            LOG_ERROR ("poll failed: %s\n", strerror (errno)) ;
+            goto out ;
+        }
+        for (i = a_display ? 1 : 0 ; i < nb_fds ; i++) {
+            if (fds[i].revents & POLLIN) {
+                /*timerfds and eventfds both hold a 64 bits counter*/
+                wait_eventfd (fds[i].fd) ;
+            }
+        }
+    }
+    if (quit_requested) {
+        LOG ("window closed, stopping\n") ;
     }
+    is_ok = TRUE ;
+
+out:
+    playback_finish (&playback) ;
+    close (timer_fd) ;
+    return is_ok ;
 }
 
 void
@@ -442,48 +2687,146 @@ do_dispatch_event (const XEvent *a_event)
         case MapNotify:
             do_process_map_event ((XMapEvent*)a_event) ;
             break ;
+        case ConfigureNotify:
+            do_process_configure_event ((XConfigureEvent*)a_event) ;
+            break ;
+        case ClientMessage:
+            do_process_client_message_event ((XClientMessageEvent*)a_event) ;
+            break ;
+        case GenericEvent: {
+            XGenericEventCookie cookie = a_event->xcookie ;
+
+            if (XGetEventData (cookie.display, &cookie)) {
+                do_process_generic_event (&cookie) ;
+                XFreeEventData (cookie.display, &cookie) ;
+            }
+            break ;
+        }
         default:
+            if (a_event->type == get_shm_completion_type (NULL)) {
+                do_process_shm_completion_event
+                                    ((XShmCompletionEvent*)a_event) ;
+            }
             break ;
     }
 }
 
+/*
+ * returns the stream playing into a_window, NULL if there is none.
+ */
+static struct stream_t*
+lookup_stream_of_window (Window a_window)
+{
+    int i=0 ;
+
+    for (i=0 ; i < nb_streams ; i++) {
+        if (streams[i].window == a_window) {
+            return &streams[i] ;
+        }
+    }
+    return NULL ;
+}
+
+/*
+ * the redraw happens in run_event_loop, once the queued events are
+ * processed, so that a burst of Expose costs a single put.
+ */
 void
 do_process_expose_event (const XExposeEvent *a_event)
 {
-    LOG ("mark\n") ;
+    struct stream_t *stream=NULL ;
+
+    RETURN_IF_FAIL (a_event) ;
+
+    stream = lookup_stream_of_window (a_event->window) ;
+    if (stream) {
+        stream->needs_redraw = TRUE ;
+    }
+}
+
+void
+do_process_configure_event (const XConfigureEvent *a_event)
+{
+    struct stream_t *stream=NULL ;
+
+    RETURN_IF_FAIL (a_event) ;
+
+    stream = lookup_stream_of_window (a_event->window) ;
+    if (stream) {
+        stream_resize (stream, a_event->width, a_event->height) ;
+    }
 }
 
 void
 do_process_map_event (const XMapEvent *a_event)
 {
-    int dst_width=0, dst_height=0 ;
+    struct stream_t *stream=NULL ;
 
-    RETURN_IF_FAIL (a_event && options) ;
+    RETURN_IF_FAIL (a_event) ;
 
-    if (a_event->window != window)
-        return ;
+    stream = lookup_stream_of_window (a_event->window) ;
+    if (stream) {
+        /*run_event_loop starts playing once all the windows are up*/
+        stream->is_mapped = TRUE ;
+    }
+}
 
-    if (options->dst_width) {
-        dst_width = options->dst_width ;
-    } else {
-        dst_width = options->src_width ;
+void
+do_process_client_message_event (const XClientMessageEvent *a_event)
+{
+    RETURN_IF_FAIL (a_event) ;
+
+    if (a_event->format == 32
+        && (Atom)a_event->data.l[0] == wm_delete_window) {
+        quit_requested = TRUE ;
     }
-    if (options->dst_height) {
-        dst_height = options->dst_height ;
-    } else {
-        dst_height = options->src_height ;
-    }
-    if (!push_yuv_to_xvideo (a_event->display,
-                             a_event->window,
-                             options->nb_frames,
-                             options->src_x, options->src_y,
-                             options->src_width, options->src_height,
-                             options->dst_x, options->dst_y,
-                             dst_width, dst_height)) {
-        LOG_ERROR ("failed to push yuv to xvideo\n") ;
-        return ;
+}
+
+/**
+ * the XServer is done reading the SHM segment of a frame.
+ * wait_for_shm_completion() must not wait for that event anymore,
+ * now that it is out of the queue.
+ */
+void
+do_process_shm_completion_event (const XShmCompletionEvent *a_event)
+{
+    struct frame_pool_t *pool=NULL ;
+    int i=0, j=0 ;
+
+    RETURN_IF_FAIL (a_event && streams) ;
+
+    for (i=0 ; i < nb_streams ; i++) {
+        if (!streams[i].has_pool) {
+            continue ;
+        }
+        pool = &streams[i].pool ;
+        for (j=0 ; j < pool->nb_frames ; j++) {
+            if (pool->frames[j].shm_pending
+                && pool->frames[j].shm_info.shmseg == a_event->shmseg) {
+                pool->frames[j].shm_pending = FALSE ;
+                return ;
+            }
+        }
+    }
+}
+
+/**
+ * an event of an extension, e.g. Present, which data is fetched.
+ * The sinks which selected such events on their window sort out
+ * theirs.
+ */
+void
+do_process_generic_event (const XGenericEventCookie *a_cookie)
+{
+    int i=0 ;
+
+    RETURN_IF_FAIL (a_cookie && streams) ;
+
+    for (i=0 ; i < nb_streams ; i++) {
+        if (streams[i].sink && streams[i].sink->process_event) {
+            streams[i].sink->process_event (streams[i].sink, a_cookie) ;
+        }
     }
-    LOG ("pushed yuv to xvideo ok\n") ;
 }
 
 /**************************
@@ -500,20 +2843,94 @@ display_help (const char *a_prog_name)
         return ;
 
     fprintf (stderr,
-             "usage: %s [options] <path-to-yuv-file>\n", a_prog_name) ;
+             "usage: %s [options] <path-to-yuv-file>...\n"
+             "a path of - reads the frames from stdin, which like"
+                                          " other pipes can't seek\n",
+             a_prog_name) ;
     fprintf (stderr,
              "where options can be: \n"
               "--help                 display this help\n"
               "--display              X11 display\n"
-              "--src-size <size>      source frame size. e.g: 320x240\n"
+              "--src-size <size>      source frame size. e.g: 320x240,"
+                                          " y4m files give theirs\n"
               "--src-origin <size>    source frame origin e.g: 0x0\n"
               "--dst-origin <origin>  destination origin. eg: 10x10\n"
-              "--dst-size <size>      destination size eg: 320x240\n"
+              "--dst-size <size>      destination size eg: 320x240. Frames"
+                                 " are scaled here when the\n"
+              "                       adaptor cannot, and for the ximage,"
+                                                  " null and file sinks\n"
+              "--scale-filter <f>     nearest, bilinear (default) or cubic\n"
+              "--scale-threads <nb>   scale frames on nb threads"
+                                       " (up to 4 by default)\n"
+              "--client-scale         scale frames here even if the adaptor"
+                                                           " can\n"
               "--nb-frames <nb>       read nb frames from yuv file"
                                                       " (all by default)\n"
+              "--start-frame <n>      start playing at frame n of the file\n"
+              "--end-frame <n>        stop playing before frame n of"
+                                                          " the file\n"
+              "--loop <nb>            play the frames nb times, 0 for ever\n"
+              "--reverse              play the frames from the last one\n"
+              "--no-shm               do not use MIT-SHM, send frames"
+                                                " through the X socket\n"
+              "--xcb                  query the xv adaptors in pipelined"
+                                          " XCB requests, and put\n"
+              "                       frames as XCB requests checked"
+                                                         " later\n"
+              "--huge-pages           back frame buffers with huge pages\n"
+              "--mmap                 map the yuv file instead of reading it\n"
+              "--direct-io            read the yuv file with O_DIRECT, keeping"
+                                          " several frames in flight\n"
+              "                       through io_uring if the system has it\n"
+              "--source <input>       play input besides the files, one of"
+                                                       " pattern:bars,\n"
+              "                       pattern:zoneplate, pattern:gradient"
+                                              " or pattern:counter,\n"
+              "                       rendered at --src-size without any"
+                                                        " I/O. A +counter\n"
+              "                       suffix draws the frame number over"
+                                                       " the pattern\n"
+              "--preload <nb>         read the first nb frames into RAM, then"
+                                            " play them over and over\n"
+              "                       without any I/O\n"
+              "--duration <seconds>   stop playing after that many seconds\n"
+              "--prefetch <nb>        read up to nb frames ahead of the display"
+                                                  " in a separate thread\n"
+              "--fps <rate>           display frames at rate frames per second,"
+                                            " dropping the late ones.\n"
+              "                       y4m files play at their own rate"
+                                         " unless given, 0 for none\n"
+              "--sync                 wait for the XServer to process"
+                                                    " each frame\n"
+              "--benchmark            time the read, put and flush stages"
+                                        " instead of logging each frame\n"
+              "--benchmark-json <f>   also write the benchmark results"
+                                                       " to file f\n"
+              "--trace <f>            record the read, upload, put, flush"
+                                           " and drop events of the\n"
+              "                       last frames, and write them to"
+                              " file f as Chrome trace json\n"
+              "--verify <f>           check the crc32c of each frame put"
+                               " against the list in file f\n"
+              "--verify-write <f>     write the crc32c of each frame put"
+                                            " to file f, for --verify\n"
+              "--sink <sink>          where frames go: xv (default), ximage,"
+                                       " present, null or file:<path>\n"
+              "                       present shows RGB frames at the vblanks"
+                                       " with the Present extension\n"
+              "--no-simd              convert yuv to rgb with scalar code"
+                                                              " only\n"
+              "--format <fmt>         input yuv format: i420 (default), yv12,"
+                                 " nv12, nv21, i422, yv16, yuy2 or uyvy\n"
               "--yuv420planar       input yuv format is 420 planar (default)\n"
               "--yuv420interleaved  input yuv format is 420 interleaved\n"
-              "--yuv422planar       input yuv format is 422 interleaved\n") ;
+              "--yuv422planar       input yuv format is 422 planar\n"
+              "--geometry <geom>      window geometry, e.g. 640x480+0+0."
+                                           " Given once per file when\n"
+              "                       playing several files, which are"
+                                              " tiled by default\n"
+              "--hold                 keep showing the last frames once"
+                            " the files end, until a window is closed\n") ;
 }
 
 void
@@ -525,21 +2942,53 @@ options_init (struct options_t *a_options)
     a_options->src_width = 0 ;
     a_options->src_height = 0 ;
     a_options->yuv_format = YUV_FORMAT_420_PLANAR ;
+    a_options->nb_loops = 1 ;
+    a_options->fps = -1 ;
+    a_options->scale_filter = SCALE_FILTER_BILINEAR ;
 }
 
 void
 options_free_members (struct options_t *a_opts)
 {
+    int i=0 ;
+
     if (!a_opts)
         return ;
-    if (a_opts->path_to_yuv_file) {
-        free (a_opts->path_to_yuv_file) ;
-        a_opts->path_to_yuv_file = NULL ;
+    for (i=0 ; i < a_opts->nb_yuv_files ; i++) {
+        free (a_opts->paths_to_yuv_files[i]) ;
+        a_opts->paths_to_yuv_files[i] = NULL ;
+        a_opts->is_source_spec[i] = FALSE ;
+    }
+    a_opts->nb_yuv_files = 0 ;
+    for (i=0 ; i < a_opts->nb_geometries ; i++) {
+        free (a_opts->geometries[i]) ;
+        a_opts->geometries[i] = NULL ;
     }
+    a_opts->nb_geometries = 0 ;
     if (a_opts->display_name) {
         free (a_opts->display_name) ;
         a_opts->display_name = NULL ;
     }
+    if (a_opts->benchmark_json_path) {
+        free (a_opts->benchmark_json_path) ;
+        a_opts->benchmark_json_path = NULL ;
+    }
+    if (a_opts->sink_path) {
+        free (a_opts->sink_path) ;
+        a_opts->sink_path = NULL ;
+    }
+    if (a_opts->trace_path) {
+        free (a_opts->trace_path) ;
+        a_opts->trace_path = NULL ;
+    }
+    if (a_opts->verify_path) {
+        free (a_opts->verify_path) ;
+        a_opts->verify_path = NULL ;
+    }
+    if (a_opts->verify_write_path) {
+        free (a_opts->verify_write_path) ;
+        a_opts->verify_write_path = NULL ;
+    }
 }
 
 /**
@@ -634,12 +3083,14 @@ enum bool_t
 parse_command_line (int a_argc, char **a_argv, struct options_t *a_options)
 {
     int i=0 ;
+    enum bool_t has_stdin=FALSE ;
 
     if (!a_argv || !a_options)
         return -1;
 
     for (i=1 ; i < a_argc ; i++) {
-        if (a_argv[i][0] != '-')
+        /*a lone dash is stdin*/
+        if (a_argv[i][0] != '-' || !strcmp (a_argv[i], "-"))
             break ;
 
         if (!strcmp (a_argv[i], "--help") || !strcmp (a_argv[i], "-h")) {
@@ -726,29 +3177,270 @@ parse_command_line (int a_argc, char **a_argv, struct options_t *a_options)
             }
             a_options->nb_frames = atoi (a_argv[i+1]) ;
             i++ ;
+        } else if (!strcmp (a_argv[i], "--start-frame")) {
+            if (i >= a_argc || a_argv[i+1] == NULL || a_argv[i+1][0] == '-') {
+                LOG_ERROR ("please, give a frame number to --start-frame\n") ;
+                a_options->display_help = TRUE ;
+                return FALSE ;
+            }
+            a_options->start_frame = atoi (a_argv[i+1]) ;
+            i++ ;
+        } else if (!strcmp (a_argv[i], "--end-frame")) {
+            if (i >= a_argc || a_argv[i+1] == NULL || a_argv[i+1][0] == '-') {
+                LOG_ERROR ("please, give a frame number to --end-frame\n") ;
+                a_options->display_help = TRUE ;
+                return FALSE ;
+            }
+            a_options->end_frame = atoi (a_argv[i+1]) ;
+            i++ ;
+        } else if (!strcmp (a_argv[i], "--loop")) {
+            if (i >= a_argc || a_argv[i+1] == NULL || a_argv[i+1][0] == '-') {
+                LOG_ERROR ("please, give a number of loops to --loop\n") ;
+                a_options->display_help = TRUE ;
+                return FALSE ;
+            }
+            a_options->nb_loops = atoi (a_argv[i+1]) ;
+            i++ ;
+        } else if (!strcmp (a_argv[i], "--reverse")) {
+            a_options->reverse = TRUE ;
+        } else if (!strcmp (a_argv[i], "--no-shm")) {
+            a_options->no_shm = TRUE ;
+        } else if (!strcmp (a_argv[i], "--huge-pages")) {
+            a_options->huge_pages = TRUE ;
+        } else if (!strcmp (a_argv[i], "--mmap")) {
+            a_options->use_mmap = TRUE ;
+        } else if (!strcmp (a_argv[i], "--direct-io")) {
+            a_options->direct_io = TRUE ;
+        } else if (!strcmp (a_argv[i], "--source")) {
+            enum pattern_type_t type=PATTERN_BARS ;
+            enum bool_t has_counter=FALSE ;
+
+            if (i >= a_argc || a_argv[i+1] == NULL || a_argv[i+1][0] == '-') {
+                LOG_ERROR ("please, give an input to --source\n") ;
+                a_options->display_help = TRUE ;
+                return FALSE ;
+            }
+            if (strncmp (a_argv[i+1], PATTERN_SOURCE_PREFIX,
+                         strlen (PATTERN_SOURCE_PREFIX))
+                || !pattern_parse_name (a_argv[i+1]
+                                        + strlen (PATTERN_SOURCE_PREFIX),
+                                        &type, &has_counter)) {
+                LOG_ERROR ("unknown source: %s\n", a_argv[i+1]) ;
+                a_options->display_help = TRUE ;
+                return FALSE ;
+            }
+            if (a_options->nb_yuv_files >= MAX_STREAMS) {
+                LOG_ERROR ("can't play more than %d files\n", MAX_STREAMS) ;
+                return FALSE ;
+            }
+            a_options->is_source_spec[a_options->nb_yuv_files] = TRUE ;
+            a_options->paths_to_yuv_files[a_options->nb_yuv_files++] =
+                                                    strdup (a_argv[i+1]) ;
+            i++ ;
+        } else if (!strcmp (a_argv[i], "--preload")) {
+            if (i >= a_argc || a_argv[i+1] == NULL || a_argv[i+1][0] == '-') {
+                LOG_ERROR ("please, give a number of frames to --preload\n") ;
+                a_options->display_help = TRUE ;
+                return FALSE ;
+            }
+            a_options->preload = atoi (a_argv[i+1]) ;
+            i++ ;
+        } else if (!strcmp (a_argv[i], "--duration")) {
+            if (i >= a_argc || a_argv[i+1] == NULL || a_argv[i+1][0] == '-') {
+                LOG_ERROR ("please, give a number of seconds to --duration\n") ;
+                a_options->display_help = TRUE ;
+                return FALSE ;
+            }
+            a_options->duration = atof (a_argv[i+1]) ;
+            i++ ;
+        } else if (!strcmp (a_argv[i], "--prefetch")) {
+            if (i >= a_argc || a_argv[i+1] == NULL || a_argv[i+1][0] == '-') {
+                LOG_ERROR ("please, give a number of frames to --prefetch\n") ;
+                a_options->display_help = TRUE ;
+                return FALSE ;
+            }
+            a_options->prefetch = atoi (a_argv[i+1]) ;
+            i++ ;
+        } else if (!strcmp (a_argv[i], "--fps")) {
+            if (i >= a_argc || a_argv[i+1] == NULL || a_argv[i+1][0] == '-') {
+                LOG_ERROR ("please, give a frame rate to --fps\n") ;
+                a_options->display_help = TRUE ;
+                return FALSE ;
+            }
+            a_options->fps = atof (a_argv[i+1]) ;
+            i++ ;
+        } else if (!strcmp (a_argv[i], "--sync")) {
+            a_options->sync = TRUE ;
+        } else if (!strcmp (a_argv[i], "--benchmark")) {
+            a_options->benchmark = TRUE ;
+        } else if (!strcmp (a_argv[i], "--benchmark-json")) {
+            if (i >= a_argc || a_argv[i+1] == NULL || a_argv[i+1][0] == '-') {
+                LOG_ERROR ("please, give a file path to --benchmark-json\n") ;
+                a_options->display_help = TRUE ;
+                return FALSE ;
+            }
+            a_options->benchmark = TRUE ;
+            a_options->benchmark_json_path = strdup (a_argv[i+1]) ;
+            i++ ;
+        } else if (!strcmp (a_argv[i], "--verify")) {
+            if (i >= a_argc || a_argv[i+1] == NULL || a_argv[i+1][0] == '-') {
+                LOG_ERROR ("please, give a file path to --verify\n") ;
+                a_options->display_help = TRUE ;
+                return FALSE ;
+            }
+            free (a_options->verify_path) ;
+            a_options->verify_path = strdup (a_argv[i+1]) ;
+            i++ ;
+        } else if (!strcmp (a_argv[i], "--verify-write")) {
+            if (i >= a_argc || a_argv[i+1] == NULL || a_argv[i+1][0] == '-') {
+                LOG_ERROR ("please, give a file path to --verify-write\n") ;
+                a_options->display_help = TRUE ;
+                return FALSE ;
+            }
+            free (a_options->verify_write_path) ;
+            a_options->verify_write_path = strdup (a_argv[i+1]) ;
+            i++ ;
+        } else if (!strcmp (a_argv[i], "--trace")) {
+            if (i >= a_argc || a_argv[i+1] == NULL || a_argv[i+1][0] == '-') {
+                LOG_ERROR ("please, give a file path to --trace\n") ;
+                a_options->display_help = TRUE ;
+                return FALSE ;
+            }
+            free (a_options->trace_path) ;
+            a_options->trace_path = strdup (a_argv[i+1]) ;
+            i++ ;
+        } else if (!strcmp (a_argv[i], "--sink")) {
+            if (i >= a_argc || a_argv[i+1] == NULL || a_argv[i+1][0] == '-') {
+                LOG_ERROR ("please, give a sink to --sink\n") ;
+                a_options->display_help = TRUE ;
+                return FALSE ;
+            }
+            if (!strcmp (a_argv[i+1], "xv")) {
+                a_options->sink_type = SINK_TYPE_XV ;
+            } else if (!strcmp (a_argv[i+1], "ximage")) {
+                a_options->sink_type = SINK_TYPE_XIMAGE ;
+            } else if (!strcmp (a_argv[i+1], "present")) {
+                a_options->sink_type = SINK_TYPE_PRESENT ;
+            } else if (!strcmp (a_argv[i+1], "null")) {
+                a_options->sink_type = SINK_TYPE_NULL ;
+            } else if (!strncmp (a_argv[i+1], "file:", 5)
+                       && a_argv[i+1][5]) {
+                a_options->sink_type = SINK_TYPE_FILE ;
+                free (a_options->sink_path) ;
+                a_options->sink_path = strdup (a_argv[i+1] + 5) ;
+            } else {
+                LOG_ERROR ("unknown sink: %s\n", a_argv[i+1]) ;
+                a_options->display_help = TRUE ;
+                return FALSE ;
+            }
+            i++ ;
+        } else if (!strcmp (a_argv[i], "--no-simd")) {
+            a_options->no_simd = TRUE ;
+        } else if (!strcmp (a_argv[i], "--format")) {
+            if (i >= a_argc || a_argv[i+1] == NULL || a_argv[i+1][0] == '-') {
+                LOG_ERROR ("please, give a yuv format to --format\n") ;
+                a_options->display_help = TRUE ;
+                return FALSE ;
+            }
+            a_options->yuv_format = yuv_format_from_name (a_argv[i+1]) ;
+            if (a_options->yuv_format == YUV_FORMAT_UNDEF) {
+                LOG_ERROR ("unknown yuv format: %s\n", a_argv[i+1]) ;
+                a_options->display_help = TRUE ;
+                return FALSE ;
+            }
+            i++ ;
+        } else if (!strcmp (a_argv[i], "--scale-filter")) {
+            int filter=0 ;
+
+            if (i >= a_argc || a_argv[i+1] == NULL || a_argv[i+1][0] == '-') {
+                LOG_ERROR ("please, give a filter to --scale-filter\n") ;
+                a_options->display_help = TRUE ;
+                return FALSE ;
+            }
+            filter = scale_filter_from_name (a_argv[i+1]) ;
+            if (filter < 0) {
+                LOG_ERROR ("unknown scale filter: %s\n", a_argv[i+1]) ;
+                a_options->display_help = TRUE ;
+                return FALSE ;
+            }
+            a_options->scale_filter = filter ;
+            i++ ;
+        } else if (!strcmp (a_argv[i], "--scale-threads")) {
+            if (i >= a_argc || a_argv[i+1] == NULL || a_argv[i+1][0] == '-') {
+                LOG_ERROR ("please, give a number of threads"
+                           " to --scale-threads\n") ;
+                a_options->display_help = TRUE ;
+                return FALSE ;
+            }
+            a_options->scale_threads = atoi (a_argv[i+1]) ;
+            i++ ;
+        } else if (!strcmp (a_argv[i], "--client-scale")) {
+            a_options->client_scale = TRUE ;
+        } else if (!strcmp (a_argv[i], "--xcb")) {
+#ifdef HAVE_XCB_XV
+            a_options->xcb = TRUE ;
+#else
+            LOG ("built without xcb-xv, --xcb is ignored\n") ;
+#endif
         } else if (!strcmp (a_argv[i], "--yuv420planar")) {
             a_options->yuv_format = YUV_FORMAT_420_PLANAR ;
         } else if (!strcmp (a_argv[i], "--yuv420interleaved")) {
             a_options->yuv_format = YUV_FORMAT_420_INTERLEAVED ;
         } else if (!strcmp (a_argv[i], "--yuv422planar")) {
             a_options->yuv_format = YUV_FORMAT_422_PLANAR ;
+        } else if (!strcmp (a_argv[i], "--hold")) {
+            a_options->hold = TRUE ;
+        } else if (!strcmp (a_argv[i], "--geometry")) {
+            int x=0, y=0 ;
+            unsigned width=0, height=0 ;
+
+            if (i >= a_argc || a_argv[i+1] == NULL || a_argv[i+1][0] == '-') {
+                LOG_ERROR ("please, give a geometry to --geometry\n") ;
+                a_options->display_help = TRUE ;
+                return FALSE ;
+            }
+            if (!XParseGeometry (a_argv[i+1], &x, &y, &width, &height)) {
+                LOG_ERROR ("argument to --geometry is not well formed\n") ;
+                a_options->display_help = TRUE ;
+                return FALSE ;
+            }
+            if (a_options->nb_geometries >= MAX_STREAMS) {
+                LOG_ERROR ("too many geometries\n") ;
+                return FALSE ;
+            }
+            a_options->geometries[a_options->nb_geometries++] =
+                                                    strdup (a_argv[i+1]) ;
+            i++ ;
         } else {
             LOG_ERROR ("unknown option: %s\n", a_argv[i]) ;
             a_options->display_help = TRUE ;
             return FALSE ;
         }
     }
-    if (i >= a_argc || a_argv[i][0] == '-') {
+    if (i >= a_argc && !a_options->nb_yuv_files) {
         LOG_ERROR ("you must give the path to yuv file\n") ;
         return FALSE ;
     }
-    a_options->path_to_yuv_file = strdup (a_argv[i]);
+    for (; i < a_argc ; i++) {
+        if (a_options->nb_yuv_files >= MAX_STREAMS) {
+            LOG_ERROR ("can't play more than %d files\n", MAX_STREAMS) ;
+            return FALSE ;
+        }
+        if (!strcmp (a_argv[i], "-") && has_stdin) {
+            LOG_ERROR ("stdin can only be read once\n") ;
+            return FALSE ;
+        }
+        has_stdin = has_stdin || !strcmp (a_argv[i], "-") ;
+        a_options->paths_to_yuv_files[a_options->nb_yuv_files++] =
+                                                        strdup (a_argv[i]) ;
+    }
     return TRUE ;
 }
 /*****************************************
  * </display help, command line parsing>
  * ***************************************/
 
+
 int
 main (int argc, char **argv)
 {
@@ -757,20 +3449,57 @@ main (int argc, char **argv)
     Display *display=NULL ;
     int black_color=0, white_color=0,
         xv_major=0, xv_first_event=0,
-        xv_first_error=0 ;
+        xv_first_error=0, nb_columns=1, i=0 ;
     char *display_name ;
 
+    startup_ns = get_monotonic_ns () ;
     options_init (&opts) ;
     if (!parse_command_line (argc, argv, &opts) || opts.display_help) {
         display_help (argv[0]) ;
         goto out ;
     }
     options = &opts ;
+    if (opts.benchmark) {
+        xvplay_set_frame_logs (FALSE) ;
+    }
+    if (opts.trace_path) {
+        if (!tracer_init (&trace_ring, TRACE_NB_EVENTS)) {
+            goto out ;
+        }
+        tracer = &trace_ring ;
+    }
+
+    if (opts.nb_yuv_files > 1 && opts.prefetch <= 0) {
+        /*so that a stream waiting for its file does not hold the others*/
+        opts.prefetch = FRAME_POOL_SIZE ;
+        LOG ("giving each of the %d streams a reader thread\n",
+             opts.nb_yuv_files) ;
+    }
+
+    /*open yuv input files, tiling their windows in a square grid*/
+    streams = calloc (opts.nb_yuv_files, sizeof (struct stream_t)) ;
+    if (!streams) {
+        goto out ;
+    }
+    while (nb_columns * nb_columns < opts.nb_yuv_files) {
+        nb_columns++ ;
+    }
+    for (i=0 ; i < opts.nb_yuv_files ; i++) {
+        if (!stream_init (&streams[i], i, opts.paths_to_yuv_files[i])) {
+            goto out ;
+        }
+        nb_streams++ ;
+        stream_init_geometry (&streams[i],
+                              i < opts.nb_geometries ? opts.geometries[i]
+                                                     : NULL,
+                              nb_columns) ;
+    }
 
-    /*open yuv input file*/
-    yuv_input = fopen (opts.path_to_yuv_file, "r") ;
-    if (!yuv_input) {
-        LOG_ERROR ("could not open file '%s'\n", opts.path_to_yuv_file) ;
+    if (!sink_type_needs_display (opts.sink_type)) {
+        /*no XServer involved, play the frames right away*/
+        if (run_event_loop (NULL)) {
+            result = 0 ;
+        }
         goto out ;
     }
 
@@ -784,36 +3513,76 @@ main (int argc, char **argv)
         LOG_ERROR ("Could not open display\n") ;
         goto out ;
     }
+    /*the present sinks hand us the events of the other windows*/
+    sink_set_event_func (do_dispatch_event) ;
 
     /*make sure the xserver has the xvideo extension*/
-    if (XQueryExtension (display,
-                         "XVideo",
-                         &xv_major,
-                         &xv_first_event,
-                         &xv_first_error) != True) {
-        LOG_ERROR ("XServer does not support the XVideo extention\n") ;
-        goto out ;
+    if (opts.sink_type == SINK_TYPE_XV) {
+        if (XQueryExtension (display,
+                             "XVideo",
+                             &xv_major,
+                             &xv_first_event,
+                             &xv_first_error) != True) {
+            LOG ("XServer does not support the XVideo extention, "
+                 "falling back to the ximage sink\n") ;
+            opts.sink_type = SINK_TYPE_XIMAGE ;
+        } else {
+            LOG ("XServer supports XVideo extension. cool!\n") ;
+        }
     }
-    LOG ("XServer supports XVideo extension. cool!\n") ;
 
-    /*create a window*/
+    /*create a window per stream, all on the same connection*/
     black_color = BlackPixel (display, DefaultScreen (display)) ;
-    window = XCreateSimpleWindow (display,
-                                  DefaultRootWindow (display),
-                                  0, 0, 320, 240, 0,
-                                  black_color, black_color) ;
-
-    /*select events we want on that window*/
-    XSelectInput (display, window, ExposureMask|StructureNotifyMask) ;
-
-    /*map the window*/
-    XMapWindow (display, window) ;
+    wm_delete_window = XInternAtom (display, "WM_DELETE_WINDOW", False) ;
+    for (i=0 ; i < nb_streams ; i++) {
+        streams[i].window = XCreateSimpleWindow (display,
+                                                 DefaultRootWindow (display),
+                                                 streams[i].window_x,
+                                                 streams[i].window_y,
+                                                 streams[i].window_width,
+                                                 streams[i].window_height,
+                                                 0,
+                                                 black_color, black_color) ;
+        XStoreName (display, streams[i].window, streams[i].path) ;
+
+        /*select events we want on that window*/
+        XSelectInput (display, streams[i].window,
+                      ExposureMask|StructureNotifyMask) ;
+        /*have the window manager tell us when the window is closed*/
+        XSetWMProtocols (display, streams[i].window, &wm_delete_window, 1) ;
+
+        /*map the window*/
+        XMapWindow (display, streams[i].window) ;
+    }
     XFlush (display) ;
 
-    run_event_loop (display) ;
-    result = 1 ;
+    if (run_event_loop (display)) {
+        result = 0 ;
+    }
 
 out:
+    if (streams) {
+        for (i=0 ; i < nb_streams ; i++) {
+            if (streams[i].verifier_ptr
+                && streams[i].verifier_ptr->nb_mismatches) {
+                result = 1 ;
+            }
+            stream_finalize (&streams[i]) ;
+        }
+        free (streams) ;
+        streams = NULL ;
+        nb_streams = 0 ;
+    }
+    if (tracer) {
+        /*the reader threads are all stopped now*/
+        tracer_write_json (tracer, opts.trace_path,
+                           opts.paths_to_yuv_files, opts.nb_yuv_files) ;
+        tracer_finalize (tracer) ;
+        tracer = NULL ;
+    }
+    if (display) {
+        XCloseDisplay (display) ;
+    }
     options_free_members (&opts) ;
     return result;
 }
@@ -0,0 +1,271 @@
+/*
+ * Copyright (C) 2007 OpenedHand Ltd
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * Author:
+ *   Dodji Seketeli <dodji@openedhand.com>
+ */
+
+/*
+ * run by make check: copies random frames of each format into
+ * XvImages which lines are padded and which planes are out of order
+ * with gaps between them, like some adaptors lay them out, and fails
+ * unless every plane lands byte for byte where the XvImage says,
+ * without a byte written around them.
+ */
+#include "xvplay-private.h"
+
+#define TEST_SEED 0x9e3779b9
+#define TEST_NB_ELEMENTS(a) (sizeof (a) / sizeof ((a)[0]))
+/*bytes before the first plane, and between the others*/
+#define TEST_PLANE_GAP 96
+#define TEST_UNTOUCHED 0xee
+
+static const unsigned test_widths[] = {1, 2, 3, 6, 16, 17, 34, 320, 642} ;
+static const unsigned test_heights[] = {2, 4, 18, 240} ;
+
+static uint32_t
+test_random (uint32_t *a_state)
+{
+    /*xorshift32, so that failures can be reproduced*/
+    *a_state ^= *a_state << 13 ;
+    *a_state ^= *a_state >> 17 ;
+    *a_state ^= *a_state << 5 ;
+    return *a_state ;
+}
+
+/*where a plane of a frame sits, and its size*/
+struct test_plane_t {
+    unsigned offset ;
+    unsigned pitch ;
+    unsigned row_len ;
+    unsigned nb_rows ;
+};
+
+/*
+ * the planes of a frame of a_format in a yuv file: one after the
+ * other, lines not padded. Returns the nb of planes.
+ */
+static int
+test_get_file_planes (enum yuv_format_t a_format,
+                      unsigned a_width,
+                      unsigned a_height,
+                      struct test_plane_t *a_planes)
+{
+    const struct yuv_format_info_t *info = yuv_format_get_info (a_format) ;
+    unsigned chroma_height = a_height >> info->chroma_y_shift ;
+
+    a_planes[0].offset = 0 ;
+    a_planes[0].nb_rows = a_height ;
+    switch (info->layout) {
+        case YUV_LAYOUT_PLANAR:
+            a_planes[0].row_len = a_width ;
+            a_planes[1].row_len = a_planes[2].row_len = a_width / 2 ;
+            a_planes[1].nb_rows = a_planes[2].nb_rows = chroma_height ;
+            a_planes[1].offset = a_width * a_height ;
+            a_planes[2].offset = a_planes[1].offset
+                                 + (a_width / 2) * chroma_height ;
+            break ;
+        case YUV_LAYOUT_SEMI_PLANAR:
+            a_planes[0].row_len = a_planes[1].row_len = a_width ;
+            a_planes[1].nb_rows = chroma_height ;
+            a_planes[1].offset = a_width * a_height ;
+            break ;
+        case YUV_LAYOUT_PACKED:
+            a_planes[0].row_len = 2 * a_width ;
+            break ;
+    }
+    a_planes[0].pitch = a_planes[0].row_len ;
+    a_planes[1].pitch = a_planes[1].row_len ;
+    a_planes[2].pitch = a_planes[2].row_len ;
+    switch (info->layout) {
+        case YUV_LAYOUT_PLANAR:
+            return 3 ;
+        case YUV_LAYOUT_SEMI_PLANAR:
+            return 2 ;
+        default:
+            return 1 ;
+    }
+}
+
+/*
+ * copy a random frame of a_format into an XvImage which pitches are
+ * wider than the lines and which planes are stored last one first,
+ * a gap before each. FALSE if a byte is not where it should be.
+ */
+static enum bool_t
+test_copy (enum yuv_format_t a_format,
+           unsigned a_width,
+           unsigned a_height,
+           uint32_t *a_state)
+{
+    const struct yuv_format_info_t *info = yuv_format_get_info (a_format) ;
+    struct test_plane_t planes[3] ;
+    struct yuv_planes_t src_planes, dst_planes ;
+    XvImage xv_image ;
+    int pitches[3], offsets[3], nb_planes=0, i=0 ;
+    unsigned char *src=NULL, *expected=NULL ;
+    unsigned src_len=0, len=0, row=0, pos=0 ;
+    enum bool_t is_ok=FALSE ;
+
+    memset (planes, 0, sizeof (planes)) ;
+    memset (&xv_image, 0, sizeof (xv_image)) ;
+    nb_planes = test_get_file_planes (a_format, a_width, a_height, planes) ;
+    compute_yuv_image_size (a_format, a_width, a_height, &src_len) ;
+    len = TEST_PLANE_GAP ;
+    for (i=nb_planes-1 ; i >= 0 ; i--) {
+        /*a multiple of 32, and at least 7 bytes of padding*/
+        pitches[i] = (planes[i].row_len + 7 + 31) & ~31 ;
+        offsets[i] = len ;
+        len += pitches[i] * planes[i].nb_rows + TEST_PLANE_GAP ;
+    }
+    xv_image.id = info->fourcc ;
+    xv_image.width = a_width ;
+    xv_image.height = a_height ;
+    xv_image.data_size = len ;
+    xv_image.num_planes = nb_planes ;
+    xv_image.pitches = pitches ;
+    xv_image.offsets = offsets ;
+
+    src = malloc (src_len) ;
+    expected = malloc (len) ;
+    xv_image.data = malloc (len) ;
+    if (!src || !expected || !xv_image.data) {
+        fprintf (stderr, "%s: could not allocate the frames\n", info->name) ;
+        goto out ;
+    }
+    for (pos=0 ; pos < src_len ; pos++) {
+        src[pos] = test_random (a_state) ;
+    }
+    memset (xv_image.data, TEST_UNTOUCHED, len) ;
+    memset (expected, TEST_UNTOUCHED, len) ;
+    for (i=0 ; i < nb_planes ; i++) {
+        for (row=0 ; row < planes[i].nb_rows ; row++) {
+            memcpy (expected + offsets[i] + row * pitches[i],
+                    src + planes[i].offset + row * planes[i].pitch,
+                    planes[i].row_len) ;
+        }
+    }
+
+    if (xv_image_matches_yuv_layout (&xv_image, a_format,
+                                     a_width, a_height)) {
+        fprintf (stderr, "%s: %ux%u, padded planes taken for the layout"
+                 " of the file\n", info->name, a_width, a_height) ;
+        goto out ;
+    }
+    if (!yuv_planes_from_frame (&src_planes, a_format,
+                                a_width, a_height, src)
+        || !yuv_planes_from_xv_image (&dst_planes, a_format, &xv_image)) {
+        fprintf (stderr, "%s: could not describe the planes\n", info->name) ;
+        goto out ;
+    }
+    copy_yuv_planes (&src_planes, &dst_planes) ;
+    for (pos=0 ; pos < len ; pos++) {
+        if ((unsigned char)xv_image.data[pos] == expected[pos]) {
+            continue ;
+        }
+        /*tell which plane, or which gap, the byte is in*/
+        for (i=0 ; i < nb_planes ; i++) {
+            if (pos >= (unsigned)offsets[i]
+                && pos < offsets[i] + pitches[i] * planes[i].nb_rows) {
+                break ;
+            }
+        }
+        if (i < nb_planes) {
+            fprintf (stderr, "%s: %ux%u, byte %u of plane %d is %u"
+                     " instead of %u\n", info->name, a_width, a_height,
+                     pos - offsets[i], i,
+                     (unsigned char)xv_image.data[pos], expected[pos]) ;
+        } else {
+            fprintf (stderr, "%s: %ux%u, byte %u of the image, out of the"
+                     " planes, was written to\n",
+                     info->name, a_width, a_height, pos) ;
+        }
+        goto out ;
+    }
+    is_ok = TRUE ;
+
+out:
+    free (src) ;
+    free (expected) ;
+    free (xv_image.data) ;
+    return is_ok ;
+}
+
+/*
+ * the layout of a yuv file must be taken for one, so that frames
+ * are put right where they sit in the file.
+ */
+static enum bool_t
+test_matching_layout (enum yuv_format_t a_format,
+                      unsigned a_width,
+                      unsigned a_height)
+{
+    const struct yuv_format_info_t *info = yuv_format_get_info (a_format) ;
+    struct test_plane_t planes[3] ;
+    XvImage xv_image ;
+    int pitches[3], offsets[3], i=0 ;
+    unsigned len=0 ;
+
+    memset (planes, 0, sizeof (planes)) ;
+    memset (&xv_image, 0, sizeof (xv_image)) ;
+    xv_image.num_planes = test_get_file_planes (a_format, a_width,
+                                                a_height, planes) ;
+    for (i=0 ; i < xv_image.num_planes ; i++) {
+        pitches[i] = planes[i].pitch ;
+        offsets[i] = planes[i].offset ;
+    }
+    compute_yuv_image_size (a_format, a_width, a_height, &len) ;
+    xv_image.width = a_width ;
+    xv_image.height = a_height ;
+    xv_image.data_size = len ;
+    xv_image.pitches = pitches ;
+    xv_image.offsets = offsets ;
+    if (!xv_image_matches_yuv_layout (&xv_image, a_format,
+                                      a_width, a_height)) {
+        fprintf (stderr, "%s: %ux%u, the layout of the file is not taken"
+                 " for one\n", info->name, a_width, a_height) ;
+        return FALSE ;
+    }
+    return TRUE ;
+}
+
+int
+main (int argc, char **argv)
+{
+    const struct yuv_format_info_t *info=NULL ;
+    uint32_t state=TEST_SEED ;
+    unsigned w=0, h=0, nb_failed=0, nb_format_failed=0 ;
+    int f=0 ;
+
+    for (f=YUV_FORMAT_UNDEF+1 ; f < YUV_NB_FORMATS ; f++) {
+        info = yuv_format_get_info (f) ;
+        nb_format_failed = 0 ;
+        for (w=0 ; w < TEST_NB_ELEMENTS (test_widths) ; w++) {
+            for (h=0 ; h < TEST_NB_ELEMENTS (test_heights) ; h++) {
+                if (!test_copy (f, test_widths[w], test_heights[h], &state)
+                    || !test_matching_layout (f, test_widths[w],
+                                              test_heights[h])) {
+                    nb_format_failed++ ;
+                }
+            }
+        }
+        printf ("%s: %s\n", info->name, nb_format_failed
+                ? "misplaced bytes" : "copied byte for byte") ;
+        nb_failed += nb_format_failed ;
+    }
+    return nb_failed ? 1 : 0 ;
+}
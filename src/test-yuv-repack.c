@@ -0,0 +1,254 @@
+/*
+ * Copyright (C) 2007 OpenedHand Ltd
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * Author:
+ *   Dodji Seketeli <dodji@openedhand.com>
+ */
+
+/*
+ * run by make check: repacks random frames between each format and
+ * those its conversions list, and fails unless they come back as they
+ * were, and unless the SIMD rows give the bytes the scalar ones give.
+ */
+#include "xvplay-private.h"
+
+#define TEST_SEED 0x6c078965
+#define TEST_NB_FRAMES 2
+#define TEST_NB_ELEMENTS(a) (sizeof (a) / sizeof ((a)[0]))
+/*bytes around the frames, which nothing may write to*/
+#define TEST_GUARD 64
+
+/*odd ones for the tails of the SIMD rows, and some the vectors fill*/
+static const unsigned test_widths[] = {
+    1, 2, 3, 6, 15, 16, 17, 30, 32, 34, 33, 63, 64, 66, 129, 642
+} ;
+static const unsigned test_heights[] = {2, 4, 18} ;
+
+static uint32_t
+test_random (uint32_t *a_state)
+{
+    /*xorshift32, so that failures can be reproduced*/
+    *a_state ^= *a_state << 13 ;
+    *a_state ^= *a_state >> 17 ;
+    *a_state ^= *a_state << 5 ;
+    return *a_state ;
+}
+
+/*
+ * a frame of a_format, one byte past an aligned address so that the
+ * SIMD rows take their unaligned paths, between two guards.
+ */
+struct test_frame_t {
+    enum yuv_format_t format ;
+    unsigned char *buf ;
+    unsigned len ;
+    struct yuv_planes_t planes ;
+};
+
+static enum bool_t
+test_frame_init (struct test_frame_t *a_frame,
+                 enum yuv_format_t a_format,
+                 unsigned a_width,
+                 unsigned a_height)
+{
+    memset (a_frame, 0, sizeof (struct test_frame_t)) ;
+    a_frame->format = a_format ;
+    if (!compute_yuv_image_size (a_format, a_width, a_height,
+                                 &a_frame->len)) {
+        return FALSE ;
+    }
+    a_frame->buf = malloc (a_frame->len + 2 * TEST_GUARD + 1) ;
+    if (!a_frame->buf) {
+        return FALSE ;
+    }
+    memset (a_frame->buf, 0x5a, a_frame->len + 2 * TEST_GUARD + 1) ;
+    return yuv_planes_from_frame (&a_frame->planes, a_format,
+                                  a_width, a_height,
+                                  a_frame->buf + TEST_GUARD + 1) ;
+}
+
+static void
+test_frame_finalize (struct test_frame_t *a_frame)
+{
+    free (a_frame->buf) ;
+    a_frame->buf = NULL ;
+}
+
+/*the frame and its guards*/
+static unsigned
+test_frame_get_total_len (const struct test_frame_t *a_frame)
+{
+    return a_frame->len + 2 * TEST_GUARD + 1 ;
+}
+
+static void
+test_frame_fill (struct test_frame_t *a_frame, uint32_t *a_state)
+{
+    unsigned i=0 ;
+
+    for (i=0 ; i < a_frame->len ; i++) {
+        a_frame->buf[TEST_GUARD + 1 + i] = test_random (a_state) ;
+    }
+}
+
+static void
+test_repack (const struct test_frame_t *a_src,
+             const struct test_frame_t *a_dst,
+             const struct yuv_row_funcs_t *a_funcs,
+             unsigned char *a_tmp)
+{
+    repack_yuv_frame (&a_src->planes, &a_dst->planes, a_funcs, a_tmp) ;
+}
+
+/*FALSE, and the first byte that differs logged, if a_got isn't a_expected*/
+static enum bool_t
+test_compare (const struct test_frame_t *a_expected,
+              const struct test_frame_t *a_got,
+              const char *a_what,
+              unsigned a_width,
+              unsigned a_height)
+{
+    unsigned len=test_frame_get_total_len (a_expected), i=0 ;
+
+    if (!memcmp (a_expected->buf, a_got->buf, len)) {
+        return TRUE ;
+    }
+    for (i=0 ; i < len && a_expected->buf[i] == a_got->buf[i] ; i++) ;
+    fprintf (stderr, "%s: %ux%u, byte %d of the frame is %u"
+             " instead of %u\n",
+             a_what, a_width, a_height, (int)i - TEST_GUARD - 1,
+             a_got->buf[i], a_expected->buf[i]) ;
+    return FALSE ;
+}
+
+/*
+ * repack a random a_width x a_height frame of a_from to a_to with the
+ * scalar rows and with a_simd, and back. FALSE if the SIMD rows give
+ * other bytes than the scalar ones, or if the round trip loses what
+ * a_to can hold.
+ */
+static enum bool_t
+test_pair (enum yuv_format_t a_from,
+           enum yuv_format_t a_to,
+           const struct yuv_row_funcs_t *a_simd,
+           unsigned a_width,
+           unsigned a_height,
+           uint32_t *a_state)
+{
+    const struct yuv_row_funcs_t *scalar = select_yuv_row_funcs (TRUE) ;
+    const struct yuv_format_info_t *from_info = yuv_format_get_info (a_from),
+                                   *to_info = yuv_format_get_info (a_to) ;
+    struct test_frame_t src, there, there_simd, back, back_simd, again ;
+    unsigned char *tmp=NULL ;
+    char what[64] ;
+    enum bool_t is_ok=FALSE ;
+
+    snprintf (what, sizeof (what), "%s to %s", from_info->name,
+              to_info->name) ;
+    memset (&src, 0, sizeof (src)) ;
+    memset (&there, 0, sizeof (there)) ;
+    memset (&there_simd, 0, sizeof (there_simd)) ;
+    memset (&back, 0, sizeof (back)) ;
+    memset (&back_simd, 0, sizeof (back_simd)) ;
+    memset (&again, 0, sizeof (again)) ;
+    tmp = malloc (2 * a_width) ;
+    if (!tmp
+        || !test_frame_init (&src, a_from, a_width, a_height)
+        || !test_frame_init (&there, a_to, a_width, a_height)
+        || !test_frame_init (&there_simd, a_to, a_width, a_height)
+        || !test_frame_init (&back, a_from, a_width, a_height)
+        || !test_frame_init (&back_simd, a_from, a_width, a_height)
+        || !test_frame_init (&again, a_to, a_width, a_height)) {
+        fprintf (stderr, "%s: could not allocate the frames\n", what) ;
+        goto out ;
+    }
+    test_frame_fill (&src, a_state) ;
+
+    test_repack (&src, &there, scalar, tmp) ;
+    test_repack (&there, &back, scalar, tmp) ;
+    test_repack (&src, &there_simd, a_simd, tmp) ;
+    test_repack (&there_simd, &back_simd, a_simd, tmp) ;
+    if (!test_compare (&there, &there_simd, what, a_width, a_height)
+        || !test_compare (&back, &back_simd, what, a_width, a_height)) {
+        fprintf (stderr, "%s: %s differs from the scalar rows\n",
+                 what, a_simd->name) ;
+        goto out ;
+    }
+
+    /*
+     * packed formats have no room for the last luma sample of odd
+     * lines, and the chroma of 4:2:2 lines dropped going to 4:2:0
+     * can't come back, but what a_to held must.
+     */
+    if (a_width & 1) {
+        is_ok = TRUE ;
+        goto out ;
+    }
+    if (to_info->chroma_y_shift > from_info->chroma_y_shift) {
+        test_repack (&back, &again, scalar, tmp) ;
+        is_ok = test_compare (&there, &again, what, a_width, a_height) ;
+    } else {
+        is_ok = test_compare (&src, &back, what, a_width, a_height) ;
+    }
+    if (!is_ok) {
+        fprintf (stderr, "%s: the round trip loses samples\n", what) ;
+    }
+
+out:
+    test_frame_finalize (&src) ;
+    test_frame_finalize (&there) ;
+    test_frame_finalize (&there_simd) ;
+    test_frame_finalize (&back) ;
+    test_frame_finalize (&back_simd) ;
+    test_frame_finalize (&again) ;
+    free (tmp) ;
+    return is_ok ;
+}
+
+int
+main (int argc, char **argv)
+{
+    const struct yuv_row_funcs_t *simd = select_yuv_row_funcs (FALSE) ;
+    const struct yuv_format_info_t *info=NULL ;
+    uint32_t state=TEST_SEED ;
+    unsigned w=0, h=0, n=0, nb_pairs=0, nb_failed=0 ;
+    int f=0, c=0 ;
+
+    if (simd == select_yuv_row_funcs (TRUE)) {
+        printf ("no SIMD repacking rows here, only round trips\n") ;
+    }
+    for (f=YUV_FORMAT_UNDEF+1 ; f < YUV_NB_FORMATS ; f++) {
+        info = yuv_format_get_info (f) ;
+        for (c=0 ; c < YUV_NB_FORMATS && info->conversions[c] ; c++) {
+            nb_pairs++ ;
+            for (w=0 ; w < TEST_NB_ELEMENTS (test_widths) ; w++) {
+                for (h=0 ; h < TEST_NB_ELEMENTS (test_heights) ; h++) {
+                    for (n=0 ; n < TEST_NB_FRAMES ; n++) {
+                        if (!test_pair (f, info->conversions[c], simd,
+                                        test_widths[w], test_heights[h],
+                                        &state)) {
+                            nb_failed++ ;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    printf ("%u pairs, %s rows: %s\n", nb_pairs, simd->name,
+            nb_failed ? "failed" : "round trips and bit exact") ;
+    return nb_failed ? 1 : 0 ;
+}
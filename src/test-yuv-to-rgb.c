@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2007 OpenedHand Ltd
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * Author:
+ *   Dodji Seketeli <dodji@openedhand.com>
+ */
+
+/*
+ * run by make check: converts random I420 frames to RGB32 with each
+ * row converter the CPU supports, and fails unless they all give the
+ * bytes the scalar one gives.
+ */
+#include "xvplay-private.h"
+
+#define TEST_SEED 0x2545f491
+#define TEST_NB_FRAMES 4
+#define TEST_NB_ELEMENTS(a) (sizeof (a) / sizeof ((a)[0]))
+
+/*odd ones for the tails of the SIMD rows, and some the vectors fill*/
+static const unsigned test_widths[] = {
+    1, 2, 3, 5, 7, 8, 9, 15, 16, 17, 31, 32, 33, 63, 65, 127, 129, 641
+} ;
+static const unsigned test_heights[] = {1, 2, 3, 17} ;
+static const char *test_kernels[] = {"sse2", "avx2"} ;
+
+static uint32_t
+test_random (uint32_t *a_state)
+{
+    /*xorshift32, so that failures can be reproduced*/
+    *a_state ^= *a_state << 13 ;
+    *a_state ^= *a_state >> 17 ;
+    *a_state ^= *a_state << 5 ;
+    return *a_state ;
+}
+
+/*
+ * convert a random a_width x a_height frame with a_func and with the
+ * scalar row, in both byte orders. FALSE if the outputs differ.
+ */
+static enum bool_t
+test_frame (i420_row_to_rgb32_func_t a_func,
+            const char *a_name,
+            unsigned a_width,
+            unsigned a_height,
+            uint32_t *a_state)
+{
+    i420_row_to_rgb32_func_t scalar = lookup_i420_row_to_rgb32 ("scalar") ;
+    enum rgb_order_t orders[] = {RGB_ORDER_BGRX, RGB_ORDER_RGBX} ;
+    unsigned char *yuv=NULL, *expected=NULL, *got=NULL ;
+    unsigned len=0, rgb_len=a_width * a_height * 4, i=0, o=0 ;
+    enum bool_t is_ok=FALSE ;
+
+    compute_yuv_image_size (YUV_FORMAT_420_PLANAR, a_width, a_height, &len) ;
+    /*
+     * with odd widths, the last pixel of a line takes the chroma
+     * sample after the line, past the frame for the last one.
+     */
+    len += a_width + 1 ;
+    yuv = malloc (len) ;
+    expected = malloc (rgb_len) ;
+    got = malloc (rgb_len) ;
+    if (!yuv || !expected || !got) {
+        goto out ;
+    }
+    for (i=0 ; i < len ; i++) {
+        yuv[i] = test_random (a_state) ;
+    }
+    for (o=0 ; o < TEST_NB_ELEMENTS (orders) ; o++) {
+        memset (expected, 0xaa, rgb_len) ;
+        memset (got, 0x55, rgb_len) ;
+        convert_i420_to_rgb32 (yuv, a_width, a_height, expected,
+                               a_width * 4, orders[o], scalar) ;
+        convert_i420_to_rgb32 (yuv, a_width, a_height, got,
+                               a_width * 4, orders[o], a_func) ;
+        if (memcmp (expected, got, rgb_len)) {
+            for (i=0 ; i < rgb_len && expected[i] == got[i] ; i++) ;
+            fprintf (stderr, "%s: %ux%u, order %d: byte %u of pixel"
+                     " (%u, %u) is %u instead of %u\n",
+                     a_name, a_width, a_height, orders[o], i % 4,
+                     (i / 4) % a_width, (i / 4) / a_width,
+                     got[i], expected[i]) ;
+            goto out ;
+        }
+    }
+    is_ok = TRUE ;
+
+out:
+    free (yuv) ;
+    free (expected) ;
+    free (got) ;
+    return is_ok ;
+}
+
+int
+main (int argc, char **argv)
+{
+    i420_row_to_rgb32_func_t func=NULL ;
+    uint32_t state=TEST_SEED ;
+    unsigned k=0, w=0, h=0, n=0, nb_failed=0, nb_kernel_failed=0 ;
+
+    for (k=0 ; k < TEST_NB_ELEMENTS (test_kernels) ; k++) {
+        func = lookup_i420_row_to_rgb32 (test_kernels[k]) ;
+        if (!func) {
+            printf ("%s: not supported here, skipped\n", test_kernels[k]) ;
+            continue ;
+        }
+        nb_kernel_failed = 0 ;
+        for (w=0 ; w < TEST_NB_ELEMENTS (test_widths) ; w++) {
+            for (h=0 ; h < TEST_NB_ELEMENTS (test_heights) ; h++) {
+                for (n=0 ; n < TEST_NB_FRAMES ; n++) {
+                    if (!test_frame (func, test_kernels[k], test_widths[w],
+                                     test_heights[h], &state)) {
+                        nb_kernel_failed++ ;
+                    }
+                }
+            }
+        }
+        printf ("%s: %s\n", test_kernels[k], nb_kernel_failed
+                ? "differs from the scalar rows" : "bit exact") ;
+        nb_failed += nb_kernel_failed ;
+    }
+    return nb_failed ? 1 : 0 ;
+}
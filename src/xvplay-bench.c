@@ -0,0 +1,781 @@
+/*
+ * Copyright (C) 2007 OpenedHand Ltd
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * Author:
+ *   Dodji Seketeli <dodji@openedhand.com>
+ */
+
+/*
+ * microbenchmarks of libxvplay, run by make bench: reading frames,
+ * copying and converting their planes, and putting them to sinks,
+ * at several frame sizes. Only uses what xvplay.h declares.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include "xvplay.h"
+
+/*how long a run of a benchmark lasts at least, iterations are doubled until*/
+#define BENCH_RUN_NS 50000000
+/*the best of that many runs is kept, which is what stays stable*/
+#define BENCH_NB_RUNS 5
+/*runs stop doubling there, so that put/file writes a bounded file*/
+#define BENCH_MAX_RUN_BYTES (64 * 1024 * 1024)
+/*frames of the file the read benchmarks go through over and over*/
+#define BENCH_FILE_FRAMES 8
+/*the format of the frames measured*/
+#define BENCH_FORMAT XVPLAY_FORMAT_I420
+/*what a line of results looks like, see bench_parse_results()*/
+#define BENCH_MAX_NAME_LEN 64
+#define BENCH_MAX_RESULTS 256
+
+/******************
+ * <data types>
+ *****************/
+enum bench_source_t {
+    BENCH_SOURCE_STDIO,
+    BENCH_SOURCE_MMAP,
+    BENCH_SOURCE_DIRECT,
+    BENCH_SOURCE_PRELOAD,
+    BENCH_SOURCE_PATTERN
+};
+
+struct bench_size_t {
+    unsigned width ;
+    unsigned height ;
+};
+
+/*
+ * what the benchmarks of a frame size work on. The benchmark being
+ * run owns source, sink, scaler and pool, see bench_context_reset().
+ */
+struct bench_context_t {
+    unsigned width ;
+    unsigned height ;
+    unsigned frame_len ;/*of an I420 frame, the unit of the throughputs*/
+    char *yuv_path ;/*BENCH_FILE_FRAMES I420 frames*/
+    char *sink_path ;/*what put/file writes to*/
+    Display *display ;/*NULL if the X sinks are not measured*/
+    Window window ;
+    unsigned char *src ;/*an I420 frame of the bars*/
+    unsigned char *dst ;/*room for a frame of any format, or RGB32*/
+    /*what the repack benchmarks repack, set up by them*/
+    const unsigned char *repack_src ;
+    enum xvplay_format_t repack_src_format ;
+    unsigned char *repack_dst ;
+    enum xvplay_format_t repack_dst_format ;
+    struct xvplay_source_t *source ;
+    struct xvplay_sink_t *sink ;
+    struct xvplay_scaler_t *scaler ;
+    struct xvplay_frame_pool_t *pool ;
+    struct xvplay_frame_t *frame ;
+};
+
+struct bench_t {
+    const char *name ;
+    int arg ;/*handed to setup, e.g. a source kind or a format*/
+    /*0 skips the benchmark, e.g. the X sinks without a display*/
+    int (*setup) (struct bench_context_t *a_ctx, int a_arg) ;
+    /*one iteration, on one frame*/
+    int (*run) (struct bench_context_t *a_ctx) ;
+};
+
+struct bench_result_t {
+    char name[BENCH_MAX_NAME_LEN] ;
+    char size[BENCH_MAX_NAME_LEN] ;
+    double ns ;
+};
+
+struct bench_options_t {
+    const char *output_path ;
+    const char *compare_path ;
+    const char *filter ;
+    const char *display_name ;
+    int no_display ;
+    int display_help ;
+};
+/******************
+ * </data types>
+ *****************/
+
+static int64_t bench_now_ns (void) ;
+static void bench_context_reset (struct bench_context_t *a_ctx) ;
+static int bench_context_init (struct bench_context_t *a_ctx,
+                                       unsigned a_width,
+                                       unsigned a_height,
+                                       const char *a_tmp_dir,
+                                       Display *a_display) ;
+static void bench_context_finalize (struct bench_context_t *a_ctx) ;
+static int bench_measure (struct bench_context_t *a_ctx,
+                                  const struct bench_t *a_bench,
+                                  double *a_ns) ;
+static int bench_parse_results (const char *a_path,
+                                struct bench_result_t *a_results,
+                                int a_max) ;
+static int parse_command_line (int a_argc,
+                                       char **a_argv,
+                                       struct bench_options_t *a_options) ;
+static void display_help (const char *a_prog_name) ;
+
+/*
+ * the frame sizes measured, and what is measured at each. The names
+ * and their order are what results are compared by, keep them.
+ */
+static const struct bench_size_t bench_sizes[] = {
+    {640, 360},
+    {1280, 720},
+    {1920, 1080},
+    {3840, 2160}
+};
+#define BENCH_NB_SIZES (int)(sizeof (bench_sizes) / sizeof (bench_sizes[0]))
+
+/******************
+ * <benchmarks>
+ *****************/
+
+static int64_t
+bench_now_ns (void)
+{
+    struct timespec ts ;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts) ;
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec ;
+}
+
+/*a pool of one frame, which the read benchmarks read into*/
+static int
+bench_context_acquire_frame (struct bench_context_t *a_ctx,
+                             struct xvplay_sink_t *a_sink)
+{
+    a_ctx->pool = xvplay_frame_pool_new (1, a_ctx->frame_len, 0, a_sink) ;
+    if (!a_ctx->pool) {
+        return 0 ;
+    }
+    a_ctx->frame = xvplay_frame_pool_acquire (a_ctx->pool) ;
+    return a_ctx->frame != NULL ;
+}
+
+static int
+bench_setup_read (struct bench_context_t *a_ctx, int a_arg)
+{
+    struct xvplay_source_t *source=NULL ;
+
+    switch (a_arg) {
+        case BENCH_SOURCE_STDIO:
+            source = xvplay_source_new_stdio (a_ctx->yuv_path, a_ctx->width,
+                                              a_ctx->height, BENCH_FORMAT) ;
+            break ;
+        case BENCH_SOURCE_MMAP:
+            source = xvplay_source_new_mmap (a_ctx->yuv_path, a_ctx->width,
+                                             a_ctx->height, BENCH_FORMAT) ;
+            break ;
+        case BENCH_SOURCE_DIRECT:
+            source = xvplay_source_new_direct (a_ctx->yuv_path, a_ctx->width,
+                                               a_ctx->height, BENCH_FORMAT) ;
+            break ;
+        case BENCH_SOURCE_PRELOAD:
+            source = xvplay_source_new_stdio (a_ctx->yuv_path, a_ctx->width,
+                                              a_ctx->height, BENCH_FORMAT) ;
+            if (source) {
+                /*plays the frames over and over by itself*/
+                a_ctx->source = xvplay_source_new_preload
+                                        (source, BENCH_FILE_FRAMES, 0) ;
+                return a_ctx->source
+                       && bench_context_acquire_frame (a_ctx, NULL) ;
+            }
+            break ;
+        case BENCH_SOURCE_PATTERN:
+            source = xvplay_source_new_pattern ("zoneplate", a_ctx->width,
+                                                a_ctx->height, BENCH_FORMAT,
+                                                0) ;
+            break ;
+        default:
+            break ;
+    }
+    if (!source) {
+        return 0 ;
+    }
+    a_ctx->source = source ;
+    if (!xvplay_source_set_range (source, 0, -1, 0, 0)) {
+        return 0 ;
+    }
+    return bench_context_acquire_frame (a_ctx, NULL) ;
+}
+
+static int
+bench_run_read (struct bench_context_t *a_ctx)
+{
+    return xvplay_source_read_frame (a_ctx->source, a_ctx->frame) ;
+}
+
+/*a_arg is the format the I420 frame is repacked to, I420 for a copy*/
+static int
+bench_setup_repack (struct bench_context_t *a_ctx, int a_arg)
+{
+    a_ctx->repack_src = a_ctx->src ;
+    a_ctx->repack_src_format = BENCH_FORMAT ;
+    a_ctx->repack_dst = a_ctx->dst ;
+    a_ctx->repack_dst_format = a_arg ;
+    return 1 ;
+}
+
+static int
+bench_run_repack (struct bench_context_t *a_ctx)
+{
+    return xvplay_repack_frame (a_ctx->repack_src, a_ctx->repack_src_format,
+                                a_ctx->repack_dst, a_ctx->repack_dst_format,
+                                a_ctx->width, a_ctx->height, 0) ;
+}
+
+/*NV12 to I420, the frame first being repacked to NV12 in dst*/
+static int
+bench_setup_unpack (struct bench_context_t *a_ctx, int a_arg)
+{
+    if (!xvplay_repack_frame (a_ctx->src, BENCH_FORMAT,
+                              a_ctx->dst, XVPLAY_FORMAT_NV12,
+                              a_ctx->width, a_ctx->height, 0)) {
+        return 0 ;
+    }
+    /*the I420 frame comes back to src, as it was*/
+    a_ctx->repack_src = a_ctx->dst ;
+    a_ctx->repack_src_format = XVPLAY_FORMAT_NV12 ;
+    a_ctx->repack_dst = a_ctx->src ;
+    a_ctx->repack_dst_format = BENCH_FORMAT ;
+    return 1 ;
+}
+
+static int
+bench_setup_rgb (struct bench_context_t *a_ctx, int a_arg)
+{
+    return 1 ;
+}
+
+static int
+bench_run_rgb (struct bench_context_t *a_ctx)
+{
+    xvplay_convert_i420_to_rgb32 (a_ctx->src, a_ctx->width, a_ctx->height,
+                                  a_ctx->dst, a_ctx->width * 4,
+                                  XVPLAY_RGB_ORDER_BGRX, 0) ;
+    return 1 ;
+}
+
+/*scale to half the size with the a_arg filter, on one thread*/
+static int
+bench_setup_scale (struct bench_context_t *a_ctx, int a_arg)
+{
+    struct xvplay_geometry_t geometry ;
+    unsigned dst_width = a_ctx->width / 2, dst_height = a_ctx->height / 2 ;
+
+    memset (&geometry, 0, sizeof (geometry)) ;
+    geometry.src_width = a_ctx->width ;
+    geometry.src_height = a_ctx->height ;
+    geometry.dst_width = dst_width ;
+    geometry.dst_height = dst_height ;
+    a_ctx->scaler = xvplay_scaler_new (BENCH_FORMAT, a_ctx->width,
+                                       a_ctx->height, &geometry,
+                                       dst_width, dst_height, a_arg, 1, 0) ;
+    return a_ctx->scaler != NULL ;
+}
+
+static int
+bench_run_scale (struct bench_context_t *a_ctx)
+{
+    xvplay_scaler_scale (a_ctx->scaler, a_ctx->src, a_ctx->dst) ;
+    return 1 ;
+}
+
+/*a sink of type a_arg showing the whole frame, with a frame of its own*/
+static int
+bench_setup_put (struct bench_context_t *a_ctx, int a_arg)
+{
+    struct xvplay_geometry_t geometry ;
+    struct xvplay_sink_options_t options ;
+
+    if (xvplay_sink_type_needs_display (a_arg) && !a_ctx->display) {
+        return 0 ;
+    }
+    memset (&geometry, 0, sizeof (geometry)) ;
+    geometry.src_width = geometry.dst_width = a_ctx->width ;
+    geometry.src_height = geometry.dst_height = a_ctx->height ;
+    xvplay_sink_options_init (&options) ;
+    a_ctx->sink = xvplay_sink_new (a_arg, a_ctx->sink_path, a_ctx->display,
+                                   a_ctx->window, &geometry, BENCH_FORMAT,
+                                   a_ctx->width, a_ctx->height, &options) ;
+    if (!a_ctx->sink
+        || !bench_context_acquire_frame (a_ctx, a_ctx->sink)) {
+        return 0 ;
+    }
+    return xvplay_frame_load (a_ctx->frame, a_ctx->src, a_ctx->frame_len) ;
+}
+
+/*what a stream does to show a frame, waiting for the XServer too*/
+static int
+bench_run_put (struct bench_context_t *a_ctx)
+{
+    if (!xvplay_sink_put_frame (a_ctx->sink, a_ctx->frame)) {
+        return 0 ;
+    }
+    xvplay_sink_flush (a_ctx->sink, 1) ;
+    xvplay_sink_wait_for_frame (a_ctx->sink, a_ctx->frame) ;
+    return 1 ;
+}
+
+static const struct bench_t benchmarks[] = {
+    {"read/stdio", BENCH_SOURCE_STDIO, bench_setup_read, bench_run_read},
+    {"read/mmap", BENCH_SOURCE_MMAP, bench_setup_read, bench_run_read},
+    {"read/direct", BENCH_SOURCE_DIRECT, bench_setup_read, bench_run_read},
+    {"read/preload", BENCH_SOURCE_PRELOAD, bench_setup_read, bench_run_read},
+    {"read/pattern", BENCH_SOURCE_PATTERN, bench_setup_read, bench_run_read},
+    {"copy/i420", BENCH_FORMAT, bench_setup_repack, bench_run_repack},
+    {"repack/i420-nv12", XVPLAY_FORMAT_NV12, bench_setup_repack,
+     bench_run_repack},
+    {"repack/i420-yuy2", XVPLAY_FORMAT_YUY2, bench_setup_repack,
+     bench_run_repack},
+    {"repack/nv12-i420", 0, bench_setup_unpack, bench_run_repack},
+    {"convert/i420-rgb32", 0, bench_setup_rgb, bench_run_rgb},
+    {"scale/bilinear-half", XVPLAY_SCALE_FILTER_BILINEAR, bench_setup_scale,
+     bench_run_scale},
+    {"scale/cubic-half", XVPLAY_SCALE_FILTER_CUBIC, bench_setup_scale,
+     bench_run_scale},
+    {"put/null", XVPLAY_SINK_NULL, bench_setup_put, bench_run_put},
+    {"put/file", XVPLAY_SINK_FILE, bench_setup_put, bench_run_put},
+    {"put/xv", XVPLAY_SINK_XV, bench_setup_put, bench_run_put},
+    {"put/ximage", XVPLAY_SINK_XIMAGE, bench_setup_put, bench_run_put}
+};
+#define BENCH_NB_BENCHMARKS \
+    (int)(sizeof (benchmarks) / sizeof (benchmarks[0]))
+
+/*
+ * undo what the setup of a benchmark did. The sink goes last, its
+ * frames being freed through it.
+ */
+static void
+bench_context_reset (struct bench_context_t *a_ctx)
+{
+    if (a_ctx->pool) {
+        if (a_ctx->frame) {
+            xvplay_frame_pool_release (a_ctx->pool, a_ctx->frame) ;
+            a_ctx->frame = NULL ;
+        }
+        xvplay_frame_pool_destroy (a_ctx->pool) ;
+        a_ctx->pool = NULL ;
+    }
+    if (a_ctx->source) {
+        xvplay_source_destroy (a_ctx->source) ;
+        a_ctx->source = NULL ;
+    }
+    if (a_ctx->sink) {
+        xvplay_sink_destroy (a_ctx->sink) ;
+        a_ctx->sink = NULL ;
+    }
+    if (a_ctx->scaler) {
+        xvplay_scaler_destroy (a_ctx->scaler) ;
+        a_ctx->scaler = NULL ;
+    }
+}
+
+/*
+ * get the frames of the bars and write them to a file in
+ * a_tmp_dir, the frames of which start with their index.
+ */
+static int
+bench_context_init (struct bench_context_t *a_ctx,
+                    unsigned a_width,
+                    unsigned a_height,
+                    const char *a_tmp_dir,
+                    Display *a_display)
+{
+    FILE *file=NULL ;
+    int fd=-1, i=0 ;
+
+    memset (a_ctx, 0, sizeof (struct bench_context_t)) ;
+    a_ctx->width = a_width ;
+    a_ctx->height = a_height ;
+    a_ctx->display = a_display ;
+    if (!xvplay_frame_size (BENCH_FORMAT, a_width, a_height,
+                            &a_ctx->frame_len)) {
+        return 0 ;
+    }
+    a_ctx->src = malloc (a_ctx->frame_len) ;
+    /*YUY2 and RGB32 take the most room, 2 and 4 bytes a pixel*/
+    a_ctx->dst = malloc ((size_t)a_width * a_height * 4) ;
+    a_ctx->yuv_path = malloc (strlen (a_tmp_dir) + 32) ;
+    a_ctx->sink_path = malloc (strlen (a_tmp_dir) + 32) ;
+    if (!a_ctx->src || !a_ctx->dst
+        || !a_ctx->yuv_path || !a_ctx->sink_path) {
+        goto error ;
+    }
+    sprintf (a_ctx->yuv_path, "%s/xvplay-bench-XXXXXX", a_tmp_dir) ;
+    sprintf (a_ctx->sink_path, "%s/xvplay-bench-put-%d",
+             a_tmp_dir, (int)getpid ()) ;
+
+    /*the bars are read like a benchmark would, then dropped*/
+    a_ctx->source = xvplay_source_new_pattern ("bars", a_width, a_height,
+                                               BENCH_FORMAT, 0) ;
+    if (!a_ctx->source
+        || !bench_context_acquire_frame (a_ctx, NULL)
+        || !xvplay_source_read_frame (a_ctx->source, a_ctx->frame)) {
+        goto error ;
+    }
+    memcpy (a_ctx->src, xvplay_frame_get_data (a_ctx->frame),
+            a_ctx->frame_len) ;
+    bench_context_reset (a_ctx) ;
+
+    fd = mkstemp (a_ctx->yuv_path) ;
+    if (fd < 0 || !(file = fdopen (fd, "w"))) {
+        fprintf (stderr, "could not create '%s': %s\n",
+                 a_ctx->yuv_path, strerror (errno)) ;
+        if (fd >= 0) {
+            close (fd) ;
+        }
+        a_ctx->yuv_path[0] = '\0' ;
+        goto error ;
+    }
+    for (i=0 ; i < BENCH_FILE_FRAMES ; i++) {
+        a_ctx->src[0] = i ;
+        if (fwrite (a_ctx->src, a_ctx->frame_len, 1, file) != 1) {
+            fprintf (stderr, "could not write '%s': %s\n",
+                     a_ctx->yuv_path, strerror (errno)) ;
+            fclose (file) ;
+            goto error ;
+        }
+    }
+    if (fclose (file)) {
+        goto error ;
+    }
+    if (a_display) {
+        a_ctx->window = XCreateSimpleWindow (a_display,
+                                             DefaultRootWindow (a_display),
+                                             0, 0, a_width, a_height, 0,
+                                             0, 0) ;
+        XMapWindow (a_display, a_ctx->window) ;
+        XSync (a_display, False) ;
+    }
+    return 1 ;
+
+error:
+    bench_context_finalize (a_ctx) ;
+    return 0 ;
+}
+
+static void
+bench_context_finalize (struct bench_context_t *a_ctx)
+{
+    bench_context_reset (a_ctx) ;
+    if (a_ctx->window) {
+        XDestroyWindow (a_ctx->display, a_ctx->window) ;
+        a_ctx->window = 0 ;
+    }
+    if (a_ctx->yuv_path) {
+        if (a_ctx->yuv_path[0] && !strstr (a_ctx->yuv_path, "XXXXXX")) {
+            unlink (a_ctx->yuv_path) ;
+        }
+        free (a_ctx->yuv_path) ;
+        a_ctx->yuv_path = NULL ;
+    }
+    if (a_ctx->sink_path) {
+        unlink (a_ctx->sink_path) ;
+        free (a_ctx->sink_path) ;
+        a_ctx->sink_path = NULL ;
+    }
+    free (a_ctx->src) ;
+    free (a_ctx->dst) ;
+    a_ctx->src = a_ctx->dst = NULL ;
+}
+
+/*
+ * set a_bench up and time a_nb iterations of it, in ns an
+ * iteration, -1 if it could not be set up or failed.
+ */
+static double
+bench_time_run (struct bench_context_t *a_ctx,
+                const struct bench_t *a_bench,
+                int a_nb)
+{
+    int64_t start=0, end=0 ;
+    int i=0 ;
+
+    if (!a_bench->setup (a_ctx, a_bench->arg)) {
+        bench_context_reset (a_ctx) ;
+        return -1 ;
+    }
+    start = bench_now_ns () ;
+    for (i=0 ; i < a_nb ; i++) {
+        if (!a_bench->run (a_ctx)) {
+            bench_context_reset (a_ctx) ;
+            return -1 ;
+        }
+    }
+    end = bench_now_ns () ;
+    bench_context_reset (a_ctx) ;
+    return (double)(end - start) / a_nb ;
+}
+
+/*
+ * time a_bench on the frames of a_ctx: double the iterations of a
+ * run until it lasts BENCH_RUN_NS, then keep the fastest of
+ * BENCH_NB_RUNS runs. Every run is set up afresh, so that e.g.
+ * put/file starts a new file. 0 if the benchmark is skipped.
+ */
+static int
+bench_measure (struct bench_context_t *a_ctx,
+               const struct bench_t *a_bench,
+               double *a_ns)
+{
+    int nb=1, max_nb=0, i=0 ;
+    double ns=0, best=-1 ;
+
+    max_nb = BENCH_MAX_RUN_BYTES / a_ctx->frame_len ;
+    if (max_nb < 1) {
+        max_nb = 1 ;
+    }
+    for (;;) {
+        ns = bench_time_run (a_ctx, a_bench, nb) ;
+        if (ns < 0) {
+            return 0 ;
+        }
+        if (ns * nb >= BENCH_RUN_NS || nb >= max_nb) {
+            break ;
+        }
+        nb = nb * 2 < max_nb ? nb * 2 : max_nb ;
+    }
+    for (i=0 ; i < BENCH_NB_RUNS ; i++) {
+        ns = bench_time_run (a_ctx, a_bench, nb) ;
+        if (ns < 0) {
+            return 0 ;
+        }
+        if (best < 0 || ns < best) {
+            best = ns ;
+        }
+    }
+    *a_ns = best ;
+    return 1 ;
+}
+
+/*
+ * read the lines of results a previous run wrote to a_path into
+ * a_results. Returns how many there were, -1 on errors.
+ */
+static int
+bench_parse_results (const char *a_path,
+                     struct bench_result_t *a_results,
+                     int a_max)
+{
+    FILE *file=NULL ;
+    char line[256] ;
+    int nb=0 ;
+
+    file = fopen (a_path, "r") ;
+    if (!file) {
+        fprintf (stderr, "could not open '%s': %s\n",
+                 a_path, strerror (errno)) ;
+        return -1 ;
+    }
+    while (nb < a_max && fgets (line, sizeof (line), file)) {
+        if (line[0] == '#') {
+            continue ;
+        }
+        if (sscanf (line, "%63s %63s %lf", a_results[nb].name,
+                    a_results[nb].size, &a_results[nb].ns) == 3) {
+            nb++ ;
+        }
+    }
+    fclose (file) ;
+    return nb ;
+}
+
+static const struct bench_result_t*
+bench_lookup_result (const struct bench_result_t *a_results,
+                     int a_nb,
+                     const char *a_name,
+                     const char *a_size)
+{
+    int i=0 ;
+
+    for (i=0 ; i < a_nb ; i++) {
+        if (!strcmp (a_results[i].name, a_name)
+            && !strcmp (a_results[i].size, a_size)) {
+            return &a_results[i] ;
+        }
+    }
+    return NULL ;
+}
+
+/******************
+ * </benchmarks>
+ *****************/
+
+/******************
+ * <display help, command line parsing>
+ *****************/
+
+static void
+display_help (const char *a_prog_name)
+{
+    printf ("usage: %s [options]\n", a_prog_name) ;
+    printf ("times reading, converting and putting frames at several sizes,\n"
+            "one line a benchmark: name, size, ns a frame, MB/s of I420\n") ;
+    printf ("--output <file>        also write the results to file\n") ;
+    printf ("--compare <file>       print how the results changed since the\n"
+            "                       ones a previous run wrote to file\n") ;
+    printf ("--filter <text>        only run the benchmarks named with text\n") ;
+    printf ("--display <name>       the XServer the X sinks are measured on,\n"
+            "                       $DISPLAY by default\n") ;
+    printf ("--no-display           do not measure the X sinks\n") ;
+    printf ("--help                 display this help\n") ;
+}
+
+static int
+parse_command_line (int a_argc,
+                    char **a_argv,
+                    struct bench_options_t *a_options)
+{
+    int i=0 ;
+
+    for (i=1 ; i < a_argc ; i++) {
+        if (!strcmp (a_argv[i], "--output") && i + 1 < a_argc) {
+            a_options->output_path = a_argv[++i] ;
+        } else if (!strcmp (a_argv[i], "--compare") && i + 1 < a_argc) {
+            a_options->compare_path = a_argv[++i] ;
+        } else if (!strcmp (a_argv[i], "--filter") && i + 1 < a_argc) {
+            a_options->filter = a_argv[++i] ;
+        } else if (!strcmp (a_argv[i], "--display") && i + 1 < a_argc) {
+            a_options->display_name = a_argv[++i] ;
+        } else if (!strcmp (a_argv[i], "--no-display")) {
+            a_options->no_display = 1 ;
+        } else if (!strcmp (a_argv[i], "--help")) {
+            a_options->display_help = 1 ;
+        } else {
+            fprintf (stderr, "unknown option, or missing argument: %s\n",
+                     a_argv[i]) ;
+            return 0 ;
+        }
+    }
+    return 1 ;
+}
+
+/******************
+ * </display help, command line parsing>
+ *****************/
+
+int
+main (int argc, char **argv)
+{
+    struct bench_options_t options ;
+    struct bench_context_t ctx ;
+    static struct bench_result_t previous[BENCH_MAX_RESULTS] ;
+    const struct bench_result_t *old=NULL ;
+    int nb_previous=0, i=0, j=0, result=-1 ;
+    const char *tmp_dir=NULL ;
+    Display *display=NULL ;
+    FILE *output=NULL, *results=NULL ;
+    char size[BENCH_MAX_NAME_LEN] ;
+    char line[256] ;
+    double ns=0 ;
+
+    memset (&options, 0, sizeof (options)) ;
+    if (!parse_command_line (argc, argv, &options) || options.display_help) {
+        display_help (argv[0]) ;
+        return options.display_help ? 0 : -1 ;
+    }
+    if (options.compare_path) {
+        nb_previous = bench_parse_results (options.compare_path, previous,
+                                           BENCH_MAX_RESULTS) ;
+        if (nb_previous < 0) {
+            return -1 ;
+        }
+    }
+    if (options.output_path) {
+        output = fopen (options.output_path, "w") ;
+        if (!output) {
+            fprintf (stderr, "could not create '%s': %s\n",
+                     options.output_path, strerror (errno)) ;
+            return -1 ;
+        }
+        fprintf (output, "# xvplay-bench, api version %d\n",
+                 XVPLAY_API_VERSION) ;
+    }
+    if (!options.no_display
+        && (options.display_name || getenv ("DISPLAY"))) {
+        display = XOpenDisplay (options.display_name) ;
+        if (!display) {
+            fprintf (stderr, "could not open the display,"
+                     " the X sinks are not measured\n") ;
+        }
+    }
+    tmp_dir = getenv ("TMPDIR") ? getenv ("TMPDIR") : "/tmp" ;
+    /*libxvplay logs to stdout, which only gets the results from now on*/
+    fflush (stdout) ;
+    results = fdopen (dup (STDOUT_FILENO), "w") ;
+    if (!results) {
+        goto out ;
+    }
+    dup2 (STDERR_FILENO, STDOUT_FILENO) ;
+    xvplay_set_frame_logs (0) ;
+
+    for (i=0 ; i < BENCH_NB_SIZES ; i++) {
+        if (!bench_context_init (&ctx, bench_sizes[i].width,
+                                 bench_sizes[i].height, tmp_dir, display)) {
+            fprintf (stderr, "could not set up the %ux%u benchmarks\n",
+                     bench_sizes[i].width, bench_sizes[i].height) ;
+            goto out ;
+        }
+        snprintf (size, sizeof (size), "%ux%u",
+                  bench_sizes[i].width, bench_sizes[i].height) ;
+        for (j=0 ; j < BENCH_NB_BENCHMARKS ; j++) {
+            if (options.filter
+                && !strstr (benchmarks[j].name, options.filter)) {
+                continue ;
+            }
+            if (!bench_measure (&ctx, &benchmarks[j], &ns)) {
+                continue ;
+            }
+            snprintf (line, sizeof (line), "%-20s %-9s %12.0f ns %9.1f MB/s",
+                      benchmarks[j].name, size, ns,
+                      ctx.frame_len / ns * 1e9 / (1024 * 1024)) ;
+            if (output) {
+                fprintf (output, "%s\n", line) ;
+            }
+            old = bench_lookup_result (previous, nb_previous,
+                                       benchmarks[j].name, size) ;
+            if (old && old->ns > 0) {
+                fprintf (results, "%s %+7.1f%% (%.0f ns before)\n", line,
+                         (ns - old->ns) * 100 / old->ns, old->ns) ;
+            } else {
+                fprintf (results, "%s\n", line) ;
+            }
+            fflush (results) ;
+        }
+        bench_context_finalize (&ctx) ;
+    }
+    result = 0 ;
+
+out:
+    if (output && fclose (output)) {
+        result = -1 ;
+    }
+    if (results) {
+        fclose (results) ;
+    }
+    if (display) {
+        XCloseDisplay (display) ;
+    }
+    return result ;
+}
@@ -0,0 +1,1193 @@
+/*
+ * Copyright (C) 2007 OpenedHand Ltd
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * Author:
+ *   Dodji Seketeli <dodji@openedhand.com>
+ */
+
+/*
+ * what the files of libxvplay share: logging, tunings, and the
+ * sources, sinks, pools and conversions the handles of xvplay.h
+ * stand for. None of it is installed, so it changes freely.
+ */
+#ifndef __XVPLAY_PRIVATE_H__
+#define __XVPLAY_PRIVATE_H__
+
+/*for F_SETPIPE_SZ*/
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdint.h>
+#include <limits.h>
+#include <time.h>
+#include <math.h>
+#include <pthread.h>
+#include <poll.h>
+#include <assert.h>
+#include <unistd.h>
+#include <ctype.h>
+#if defined(HAVE_IMMINTRIN_H) && (defined(__x86_64__) || defined(__i386__))
+/*kernels are compiled for their instruction set and picked at runtime*/
+#define HAVE_X86_SIMD 1
+#include <immintrin.h>
+#endif
+#ifdef HAVE_XPRESENT
+#include <X11/extensions/Xpresent.h>
+#endif
+#ifdef HAVE_XCB_XV
+#include <X11/Xlib-xcb.h>
+#include <xcb/xv.h>
+#endif
+#ifdef HAVE_LINUX_IO_URING_H
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#ifdef __NR_io_uring_setup
+#define HAVE_IO_URING 1
+#endif
+#endif
+
+#include <sys/types.h>
+/*XShm.h must come before Xvlib.h, or XvShmCreateImage() is not declared*/
+#include <X11/extensions/XShm.h>
+#include <X11/extensions/Xvlib.h>
+
+#include "xvplay.h"
+
+#define LOG_POSITION \
+fprintf(stdout, "in (%s) at %s:%d: ", __func__, __FILE__, __LINE__) ;
+
+#define LOG_ERROR(args...) \
+LOG_POSITION ; fprintf (stdout, "error: " args)
+
+/*
+ * logs up to LOG_LEVEL are compiled in, the others are compiled out
+ * altogether. Per frame logs take the stdio lock several times a
+ * frame, so only --enable-debug builds have them by default.
+ */
+#define LOG_LEVEL_ERROR 0
+#define LOG_LEVEL_INFO 1
+#define LOG_LEVEL_FRAME 2
+
+#ifndef LOG_LEVEL
+#ifdef __DEBUG
+#define LOG_LEVEL LOG_LEVEL_FRAME
+#else
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+#endif
+
+/*still type checks the arguments of the logs compiled out*/
+#define LOG_NOTHING(args...) \
+do {if (0) {fprintf (stdout, args) ;}} while (0)
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG(args...) \
+LOG_POSITION ; fprintf (stdout, args)
+#else
+#define LOG(args...) LOG_NOTHING (args)
+#endif
+
+/*logs emitted for every frame, which --benchmark silences*/
+#if LOG_LEVEL >= LOG_LEVEL_FRAME
+#define LOG_FRAME(args...) \
+do {if (get_frame_logs ()) {LOG (args) ;}} while (0)
+#else
+#define LOG_FRAME(args...) LOG_NOTHING (args)
+#endif
+
+#define RETURN_IF_FAIL(expr) \
+if (!(expr)) {LOG_ERROR("assertion failed: %s", #expr);return;}
+
+#define RETURN_VAL_IF_FAIL(expr, val) \
+if (!(expr)) {LOG_ERROR("assertion failed: %s", #expr);return val;}
+
+#define GUID_YUV12_PLANAR 0x32315659 /*YUV 4:2:0 planar*/
+#define GUID_YUV16_PLANAR 0x36315659 /*YUV 4:2:2 planar*/
+#define GUID_I420_PLANAR 0x30323449 /*YUV 4:2:0 planar, U first*/
+#define GUID_NV12 0x3231564e /*YUV 4:2:0, interleaved UV*/
+#define GUID_NV21 0x3132564e /*YUV 4:2:0, interleaved VU*/
+#define GUID_YUY2 0x32595559 /*YUV 4:2:2 packed, Y0 U Y1 V*/
+#define GUID_UYVY 0x59565955 /*YUV 4:2:2 packed, U Y0 V Y1*/
+
+/*
+ * one frame being displayed while the next one is read.
+ * --prefetch N adds N frames read ahead of the display.
+ */
+#define FRAME_POOL_SIZE 2
+#define HUGE_PAGE_SIZE (2*1024*1024)
+
+/*
+ * how many frames ahead of the one being read, in playback order,
+ * the kernel is asked to bring in, and in --mmap mode how many bytes
+ * behind it are kept mapped before being given back.
+ */
+#define READAHEAD_FRAMES 4
+#define MMAP_RELEASE_CHUNK (16*1024*1024)
+
+/*
+ * y4m files start with a line of stream parameters after
+ * Y4M_SIGNATURE, then each frame comes after a FRAME line.
+ * Longer lines are not accepted.
+ */
+#define Y4M_SIGNATURE "YUV4MPEG2"
+#define Y4M_SIGNATURE_LEN 9
+#define Y4M_MAX_LINE_LEN 4096
+
+/*
+ * inputs which can't be seeked, like a pipe from a decoder, are read
+ * PIPE_READ_BLOCK bytes at a time, but for the frames which are read
+ * straight into the frame buffers. Pipes get PIPE_BUFFER_SIZE bytes
+ * of buffer if the system lets us.
+ */
+#define PIPE_READ_BLOCK (64*1024)
+#define PIPE_BUFFER_SIZE (1024*1024)
+
+/*
+ * --direct-io reads whole blocks of DIRECT_IO_ALIGN bytes into
+ * buffers aligned as much, and keeps up to DIRECT_IO_QUEUE_DEPTH
+ * of them in flight when io_uring is there.
+ */
+#define DIRECT_IO_ALIGN 4096
+#define DIRECT_IO_QUEUE_DEPTH 4
+
+/*
+ * --source pattern:<name> renders frames of PATTERN_DEFAULT_WIDTH x
+ * PATTERN_DEFAULT_HEIGHT unless --src-size is given. The bars move
+ * PATTERN_BARS_SPEED pixels, the rings of the zone plate
+ * PATTERN_ZONE_PLATE_SPEED 65536th of a period, each frame.
+ * The counter shows the last PATTERN_COUNTER_DIGITS digits of the
+ * frame number, in blocks of 1/PATTERN_COUNTER_SCALE of the height.
+ */
+#define PATTERN_SOURCE_PREFIX "pattern:"
+#define PATTERN_DEFAULT_WIDTH 1280
+#define PATTERN_DEFAULT_HEIGHT 720
+#define PATTERN_BARS_SPEED 4
+#define PATTERN_ZONE_PLATE_SPEED 2048
+#define PATTERN_COUNTER_DIGITS 6
+#define PATTERN_COUNTER_SCALE 40
+
+/*
+ * the client side scaler makes each sample out of 4 input samples,
+ * weighted in 1/SCALE_ONE. It splits frames across up to
+ * SCALE_MAX_THREADS threads, SCALE_DEFAULT_THREADS unless told.
+ */
+#define SCALE_NB_TAPS 4
+#define SCALE_SHIFT 6
+#define SCALE_ONE (1 << SCALE_SHIFT)
+#define SCALE_MAX_THREADS 64
+#define SCALE_DEFAULT_THREADS 4
+
+/*
+ * the present sink queues up to that many frames to the XServer
+ * besides the one on screen, and then waits for a pixmap to be idle.
+ */
+#define PRESENT_MAX_QUEUED 2
+#define PRESENT_NB_SERIALS 64
+
+/*
+ * with --xcb, the xv sink checks its puts went through once that many
+ * are sent, and probes up to that many adaptors.
+ */
+#define XCB_MAX_PENDING_PUTS 8
+#define XCB_MAX_PROBED_ADAPTORS 32
+
+/*
+ * how many files can be played side by side, each in its own
+ * window, through its own Xv port.
+ */
+#define MAX_STREAMS 64
+
+/******************
+ * <data types>
+ *****************/
+enum bool_t {
+    FALSE=0,
+    TRUE
+};
+
+enum yuv_format_t {
+    YUV_FORMAT_UNDEF,
+    YUV_FORMAT_420_PLANAR,/*I420*/
+    YUV_FORMAT_420_INTERLEAVED,/*NV12*/
+    YUV_FORMAT_422_PLANAR,/*I422*/
+    YUV_FORMAT_420_INTERLEAVED_VU,/*NV21*/
+    YUV_FORMAT_YV12,/*I420 with V before U*/
+    YUV_FORMAT_YV16,/*I422 with V before U*/
+    YUV_FORMAT_YUY2,
+    YUV_FORMAT_UYVY,
+    YUV_NB_FORMATS
+};
+
+enum yuv_layout_t {
+    YUV_LAYOUT_PLANAR,/*a Y, a U and a V plane*/
+    YUV_LAYOUT_SEMI_PLANAR,/*a Y plane, then a plane of UV pairs*/
+    YUV_LAYOUT_PACKED/*YUYV or UYVY quads for each pair of pixels*/
+};
+
+struct yuv_format_info_t {
+    enum yuv_format_t format ;
+    const char *name ;
+    int fourcc ;/*id of the XvImage format, 0 if Xv has none*/
+    enum yuv_layout_t layout ;
+    int chroma_y_shift ;/*1 if chroma has half the lines of luma*/
+    enum bool_t vu ;/*V comes before U*/
+    /*formats this one repacks to, cheapest first, 0 terminated*/
+    enum yuv_format_t conversions[YUV_NB_FORMATS] ;
+};
+
+/*
+ * where the samples of a frame are.
+ * All the formats have half as many chroma samples as luma samples
+ * on a line. U and V point to the first sample of their component,
+ * so that semi planar and packed formats are described too,
+ * samples being 2 or 4 bytes apart.
+ */
+struct yuv_planes_t {
+    const struct yuv_format_info_t *info ;
+    unsigned width ;
+    unsigned height ;
+    unsigned char *y ;
+    unsigned char *u ;
+    unsigned char *v ;
+    unsigned char *packed ;/*start of the lines of packed formats*/
+    unsigned y_pitch ;/*bytes between two lines*/
+    unsigned uv_pitch ;
+};
+
+/*the line kernels repack_yuv_frame() is built on*/
+struct yuv_row_funcs_t {
+    const char *name ;
+    void (*deinterleave) (const unsigned char *a_src,
+                          unsigned char *a_first,
+                          unsigned char *a_second,
+                          unsigned a_nb) ;
+    void (*interleave) (const unsigned char *a_first,
+                        const unsigned char *a_second,
+                        unsigned char *a_dst,
+                        unsigned a_nb) ;
+    void (*pack_422) (const unsigned char *a_y,
+                      const unsigned char *a_u,
+                      const unsigned char *a_v,
+                      unsigned char *a_dst,
+                      unsigned a_width,
+                      enum bool_t a_uyvy) ;
+    void (*unpack_422) (const unsigned char *a_src,
+                        unsigned char *a_y,
+                        unsigned char *a_u,
+                        unsigned char *a_v,
+                        unsigned a_width,
+                        enum bool_t a_uyvy) ;
+};
+
+enum sink_type_t {
+    SINK_TYPE_XV,
+    SINK_TYPE_XIMAGE,
+    SINK_TYPE_NULL,
+    SINK_TYPE_FILE,
+    SINK_TYPE_PRESENT
+};
+
+/*how the client side scaler filters*/
+enum scale_filter_t {
+    SCALE_FILTER_NEAREST,
+    SCALE_FILTER_BILINEAR,
+    SCALE_FILTER_CUBIC/*Catmull-Rom*/
+};
+
+enum frame_memory_t {
+    FRAME_MEMORY_NONE,
+    FRAME_MEMORY_HEAP,
+    FRAME_MEMORY_MMAP,
+    FRAME_MEMORY_SHM
+};
+
+/*
+ * a frame buffer of a frame_pool_t.
+ * Buffers are allocated once when the pool is created,
+ * then recycled for the whole playback.
+ */
+struct frame_t {
+    char *buf ;/*memory owned by the frame*/
+    unsigned capacity ;/*nb of bytes allocated for buf*/
+    /*
+     * where the frame bytes are. That is buf, unless the source
+     * could hand out a pointer to its own memory, e.g. a mapping.
+     */
+    char *data ;
+    unsigned len ;/*nb of bytes of data holding the frame*/
+    enum frame_memory_t memory ;
+    int index ;/*index of the frame in the input*/
+    /*
+     * CLOCK_MONOTONIC ns at which the frame is due, 0 to show it as
+     * soon as possible. Set by whoever paces the frames.
+     */
+    int64_t deadline_ns ;
+    XvImage *xv_image ;/*of the xv sink, created once, wraps data*/
+    XImage *ximage ;/*of the ximage sink, data converted to RGB*/
+    XShmSegmentInfo shm_info ;
+    enum bool_t has_shm ;/*the image of the frame lives in shm_info*/
+    enum bool_t shm_pending ;/*the server may still be reading data*/
+    Pixmap pixmap ;/*of the present sink, the XImage is drawn to*/
+    enum bool_t pixmap_is_stale ;/*the XImage changed since*/
+    /*
+     * presents of the pixmap the server may still show. A redrawn
+     * frame is presented again before the first one went idle.
+     */
+    int nb_presents_pending ;
+    struct frame_t *next_free ;
+};
+
+struct frame_pool_t ;
+typedef enum bool_t (*frame_alloc_func_t) (struct frame_pool_t *a_pool,
+                                           struct frame_t *a_frame) ;
+typedef void (*frame_free_func_t) (struct frame_pool_t *a_pool,
+                                   struct frame_t *a_frame) ;
+
+struct frame_pool_t {
+    struct frame_t *frames ;
+    int nb_frames ;
+    struct frame_t *free_frames ;/*oldest released frame first*/
+    struct frame_t *last_free_frame ;
+    unsigned frame_len ;
+    enum bool_t huge_pages ;
+    frame_alloc_func_t alloc_func ;
+    frame_free_func_t free_func ;
+    void *user_data ;
+    /*counters*/
+    unsigned long nb_allocs ;
+    unsigned long nb_allocated_bytes ;
+    unsigned long nb_acquires ;
+    unsigned long nb_releases ;
+    unsigned long nb_exhausted ;
+};
+
+/*
+ * where frames come from.
+ * Implementations embed this as their first member.
+ */
+struct yuv_source_t {
+    const char *name ;
+    unsigned width ;
+    unsigned height ;
+    enum yuv_format_t format ;
+    unsigned frame_len ;
+    /*
+     * index of the frame read_frame returns next. Indexes count the
+     * frames in playback order, yuv_source_get_file_frame() tells
+     * which frame of the file each one is.
+     */
+    int next_frame ;
+    int nb_file_frames ;/*whole frames in the file, -1 if unknown*/
+    /*the frames played, see yuv_source_set_range()*/
+    int start_frame ;
+    int end_frame ;/*one past the last one, -1 for the end of the file*/
+    int nb_loops ;/*0 to loop for ever*/
+    enum bool_t reverse ;
+    /*where the frames are in the file, all 0 for raw yuv*/
+    off_t data_offset ;/*bytes before the first frame, e.g. a y4m header*/
+    unsigned frame_header_len ;/*bytes before each frame, if all alike*/
+    enum bool_t has_frame_markers ;/*a y4m FRAME line before each frame*/
+    double fps ;/*the frame rate of the input, 0 if unknown*/
+    /*
+     * set by the consumer when it accepts frame data pointing
+     * to memory owned by the source instead of the frame buffer.
+     */
+    enum bool_t zero_copy ;
+    /*
+     * nb of frames before next_frame the consumer may still be using,
+     * which a source must not give back to the system yet.
+     */
+    int nb_frames_in_use ;
+    enum bool_t (*read_frame) (struct yuv_source_t *a_this,
+                               struct frame_t *a_frame) ;
+    /*move a_nb frames forward without reading them*/
+    enum bool_t (*skip_frames) (struct yuv_source_t *a_this, int a_nb) ;
+    /*optional, lets the source adapt its hints to a new range*/
+    void (*range_changed) (struct yuv_source_t *a_this) ;
+    /*
+     * optional, for sources playing the frames of another source,
+     * e.g. preloaded: the frame of the input their frame a_frame of
+     * the file is. See yuv_source_get_input_frame().
+     */
+    int (*get_input_frame) (struct yuv_source_t *a_this, int a_frame) ;
+    /*
+     * optional, called once the reading is over. a_fps is the rate
+     * the frames were played at, 0 if they were not paced.
+     */
+    void (*dump_stats) (struct yuv_source_t *a_this,
+                        double a_fps,
+                        FILE *a_out) ;
+    void (*destroy) (struct yuv_source_t *a_this) ;
+};
+
+/*the stream parameters of a y4m file*/
+struct y4m_header_t {
+    unsigned width ;
+    unsigned height ;
+    enum yuv_format_t format ;
+    double fps ;/*0 if not given*/
+    char interlacing ;/*p, t, b or m for mixed, ? if not given*/
+};
+
+enum pattern_type_t {
+    PATTERN_BARS,/*75% color bars, moving sideways*/
+    PATTERN_ZONE_PLATE,/*rings getting closer towards the edges*/
+    PATTERN_GRADIENT,/*ramps of luma and chroma, scrolling*/
+    PATTERN_COUNTER,/*the frame number on gray*/
+    PATTERN_NB_TYPES
+};
+
+/*byte order of 32 bits RGB pixels in memory*/
+enum rgb_order_t {
+    RGB_ORDER_BGRX,
+    RGB_ORDER_RGBX
+};
+
+/*converts a line of I420 pixels, a_u and a_v being half as wide*/
+typedef void (*i420_row_to_rgb32_func_t) (const unsigned char *a_y,
+                                          const unsigned char *a_u,
+                                          const unsigned char *a_v,
+                                          unsigned char *a_dst,
+                                          unsigned a_width,
+                                          enum rgb_order_t a_order) ;
+
+struct scaler_t ;
+
+/*how sinks work, besides what they show and where*/
+struct sink_options_t {
+    enum bool_t no_simd ;/*only use the scalar kernels*/
+    enum bool_t no_shm ;
+    enum bool_t client_scale ;/*scale frames even if the output could*/
+    enum scale_filter_t scale_filter ;
+    int scale_threads ;/*0 for as many as there are cpus, up to a few*/
+    enum bool_t xcb ;/*probe the xv port and put frames through XCB*/
+};
+
+/*
+ * gets the events a sink pulls off the queue of its display while
+ * it waits on the XServer, which may be meant for other sinks.
+ */
+typedef void (*sink_event_func_t) (const XEvent *a_event) ;
+
+/*which part of the frames a sink shows, and where*/
+struct sink_geometry_t {
+    int src_x ;
+    int src_y ;
+    int src_width ;
+    int src_height ;
+    int dst_x ;
+    int dst_y ;
+    int dst_width ;
+    int dst_height ;
+};
+
+/*
+ * where frames go.
+ * Implementations embed this as their first member.
+ */
+struct sink_t {
+    const char *name ;
+    Display *display ;/*NULL for sinks which do not use an XServer*/
+    Window window ;
+    struct sink_geometry_t geometry ;
+    struct sink_options_t options ;
+    enum yuv_format_t format ;
+    unsigned width ;/*of the frames*/
+    unsigned height ;
+    /*
+     * whether put_frame accepts frames which data points to memory
+     * owned by the source. Known once the pool frames are allocated.
+     */
+    enum bool_t zero_copy ;
+    /*
+     * give the pool frames whatever put_frame needs, with the sink
+     * as user data. NULL means plain page aligned buffers.
+     */
+    frame_alloc_func_t alloc_frame ;
+    frame_free_func_t free_frame ;
+    /*
+     * copy a frame to wherever put_frame reads it from, when that is
+     * not the frame buffer itself. NULL if frames are put as they are.
+     */
+    enum bool_t (*upload_frame) (struct sink_t *a_this,
+                                 struct frame_t *a_frame) ;
+    /*how frames reach the output, for the logs and the benchmark*/
+    const char *upload_mode ;
+    /*
+     * set when frames are scaled here rather than by the output.
+     * They are then image_width x image_height, and go through
+     * scaled_frame unless the sink scales them right into its images.
+     */
+    struct scaler_t *scaler ;
+    unsigned image_width ;
+    unsigned image_height ;
+    unsigned char *scaled_frame ;
+    enum bool_t (*put_frame) (struct sink_t *a_this,
+                              struct frame_t *a_frame) ;
+    /*push out the frames put so far, waiting for them if a_sync*/
+    void (*flush) (struct sink_t *a_this, enum bool_t a_sync) ;
+    /*
+     * handle an event of an extension the sink selected on its
+     * window, which data is fetched. NULL if it selected none.
+     */
+    void (*process_event) (struct sink_t *a_this,
+                           const XGenericEventCookie *a_cookie) ;
+    /*print what the sink measured itself, NULL if nothing*/
+    void (*dump_stats) (struct sink_t *a_this, FILE *a_out) ;
+    void (*destroy) (struct sink_t *a_this) ;
+};
+struct stdio_source_t {
+    struct yuv_source_t base ;
+    FILE *file ;
+    int file_frame ;/*the frame at the file position, -1 if unknown*/
+};
+
+struct mmap_source_t {
+    struct yuv_source_t base ;
+    int fd ;
+    char *map ;
+    off_t map_len ;
+    off_t released_len ;/*bytes at the start of map we gave back*/
+    off_t released_from ;/*same at the end, when playing in reverse*/
+};
+
+/*
+ * a source reading a pipe, or any input it can't seek in, with
+ * read(). The bytes before a frame go through block, the frames
+ * themselves are read right into the frame buffers.
+ */
+struct pipe_source_t {
+    struct yuv_source_t base ;
+    int fd ;
+    enum bool_t owns_fd ;/*FALSE for stdin*/
+    char *block ;/*PIPE_READ_BLOCK bytes*/
+    unsigned block_start ;/*first byte not consumed yet*/
+    unsigned block_end ;
+    enum bool_t is_drained ;/*the last read emptied the pipe*/
+    /*stats*/
+    unsigned long nb_reads ;
+    uint64_t nb_bytes ;
+    unsigned long nb_split_frames ;/*frames which took several reads*/
+    unsigned long nb_waits ;/*reads which had to wait for the producer*/
+    double wait_time ;
+};
+
+/*
+ * a source playing frames read once into a single arena, over and
+ * over, so that no I/O happens while playing.
+ */
+struct preload_source_t {
+    struct yuv_source_t base ;
+    char *arena ;
+    size_t arena_len ;
+    enum frame_memory_t memory ;/*how arena was allocated*/
+    enum bool_t is_locked ;/*arena was mlock()ed*/
+    unsigned frame_stride ;/*bytes from one frame to the next*/
+    int *input_frames ;/*the frame of the input each one was*/
+};
+
+/*the line generators of pattern_source_t*/
+struct pattern_row_funcs_t {
+    const char *name ;
+    /*a_dst[i] = a_start + i, wrapping at 256*/
+    void (*ramp) (unsigned char *a_dst, unsigned a_start, unsigned a_nb) ;
+    /*a triangle wave of the 16 bit phases a_phases[i] + a_offset*/
+    void (*zone_plate) (unsigned char *a_dst,
+                        const uint32_t *a_phases,
+                        uint32_t a_offset,
+                        unsigned a_nb) ;
+};
+
+/*
+ * a source rendering test patterns into the frame buffers, so that
+ * the display can be pushed at any size without any I/O.
+ * Frames only depend on their index.
+ */
+struct pattern_source_t {
+    struct yuv_source_t base ;
+    enum pattern_type_t type ;
+    enum bool_t has_counter ;/*the frame number is drawn over the pattern*/
+    const struct pattern_row_funcs_t *funcs ;
+    const struct yuv_row_funcs_t *row_funcs ;/*to interleave and pack*/
+    unsigned char *tmp ;/*the Y, U and V of a line not stored planar*/
+    unsigned char *bars ;/*the Y, U and V of a line of bars*/
+    uint32_t *zone_phases ;/*of each column, then of each line*/
+    /*counters*/
+    unsigned long nb_rendered ;
+    int64_t render_ns ;
+};
+
+#ifdef HAVE_IO_URING
+/*the rings shared with the kernel, as io_uring_setup(2) tells*/
+struct io_ring_t {
+    int fd ;
+    void *sq_map ;
+    size_t sq_map_len ;
+    unsigned *sq_head ;
+    unsigned *sq_tail ;
+    unsigned *sq_mask ;
+    unsigned *sq_array ;
+    struct io_uring_sqe *sqes ;
+    size_t sqes_len ;
+    void *cq_map ;
+    size_t cq_map_len ;
+    unsigned *cq_head ;
+    unsigned *cq_tail ;
+    unsigned *cq_mask ;
+    struct io_uring_cqe *cqes ;
+    unsigned nb_queued ;/*sqes filled but not submitted yet*/
+};
+#endif
+
+/*a frame read, or being read, by a direct_source_t*/
+struct direct_slot_t {
+    char *buf ;/*DIRECT_IO_ALIGN aligned*/
+    unsigned buf_len ;
+    int index ;/*the playback index of the frame, -1 if none*/
+    unsigned head ;/*bytes of buf before the frame header*/
+    unsigned len ;/*bytes asked for*/
+    enum bool_t is_pending ;/*the read is in flight*/
+    int result ;/*bytes read, or -errno*/
+    /*the nb_handed the frame was handed out zero copy at, 0 if not*/
+    unsigned long serial ;
+};
+
+/*
+ * a source reading with O_DIRECT, bypassing the page cache, through
+ * io_uring if the system has it, pread() otherwise.
+ */
+struct direct_source_t {
+    struct yuv_source_t base ;
+    int fd ;
+    enum bool_t is_direct ;/*fd was opened with O_DIRECT*/
+    off_t file_len ;
+    struct direct_slot_t *slots ;
+    int nb_slots ;
+    int depth ;/*reads in flight ahead of the one being read*/
+    unsigned long nb_handed ;/*frames handed out pointing into slots*/
+#ifdef HAVE_IO_URING
+    struct io_ring_t ring ;
+    enum bool_t has_ring ;
+#endif
+    /*stats*/
+    unsigned long nb_reads ;
+    uint64_t nb_bytes ;
+    double start_time ;/*of the first read*/
+    double end_time ;/*of the last one done*/
+    unsigned long nb_waits ;/*reads we had to wait for*/
+    double wait_time ;
+};
+
+/*
+ * how each sample along one axis is made: out of the SCALE_NB_TAPS
+ * input samples from first[i], weighted by the SCALE_NB_TAPS
+ * coefficients from coeffs[i * SCALE_NB_TAPS], which add up to
+ * SCALE_ONE. Edges are folded into the taps, so that they never
+ * read outside of the input.
+ */
+struct scale_axis_t {
+    unsigned src_len ;
+    unsigned dst_len ;
+    int *first ;
+    signed char *coeffs ;
+};
+
+/*a thread of a scaler, the first one being the caller's*/
+struct scaler_thread_t {
+    struct scaler_t *scaler ;
+    int index ;
+    pthread_t thread ;
+    enum bool_t is_running ;
+    unsigned char *row ;/*a line filtered vertically*/
+    unsigned long generation ;/*of the last job seen*/
+};
+
+/*
+ * scales a rectangle of frames to another size, keeping their
+ * format, in horizontal slices spread over a pool of threads.
+ */
+struct scaler_t {
+    enum scale_filter_t filter ;
+    enum yuv_format_t format ;
+    unsigned src_x ;
+    unsigned src_y ;
+    unsigned src_width ;
+    unsigned src_height ;
+    unsigned dst_width ;
+    unsigned dst_height ;
+    struct scale_axis_t luma_x ;
+    struct scale_axis_t luma_y ;
+    struct scale_axis_t chroma_x ;
+    struct scale_axis_t chroma_y ;
+    enum bool_t use_avx2 ;
+    struct scaler_thread_t *threads ;
+    int nb_threads ;
+    int nb_active ;/*threads the frames are split across*/
+    pthread_mutex_t lock ;
+    pthread_cond_t work_cond ;
+    pthread_cond_t done_cond ;
+    enum bool_t has_sync ;
+    unsigned long generation ;/*of the job being scaled*/
+    int nb_busy ;/*threads still scaling their slice of it*/
+    enum bool_t is_quitting ;
+    const struct yuv_planes_t *src ;
+    const struct yuv_planes_t *dst ;
+    /*stats*/
+    unsigned long nb_frames ;
+    int64_t scale_ns ;
+};
+
+/*what the xv sink needs to know about the port it got*/
+struct xv_port_probe_t {
+    XvPortID port ;
+    enum yuv_format_t image_format ;
+    enum bool_t can_scale ;
+    /*images of image_format are laid out like the frames*/
+    enum bool_t matches_layout ;
+    int nb_attributes ;
+    int nb_round_trips ;
+    int64_t probe_ns ;
+};
+
+struct xv_sink_t {
+    struct sink_t base ;
+    XvPortID xv_port ;
+    enum bool_t has_port ;
+    int64_t probe_ns ;/*time it took to get the port and its properties*/
+    enum yuv_format_t image_format ;
+    GC gc ;
+    enum bool_t use_shm ;
+    /*
+     * set when the adaptor lacks the format of the frames, or lays
+     * out its planes differently than a yuv file does. The frames
+     * are then copied from the frame buffer into the image.
+     */
+    enum bool_t needs_upload ;
+    const struct yuv_row_funcs_t *row_funcs ;/*NULL unless repacking*/
+    unsigned char *repack_tmp ;
+#ifdef HAVE_XCB_XV
+    /*set with --xcb, frames are then put through XCB*/
+    xcb_connection_t *xcb ;
+    struct {
+        xcb_void_cookie_t cookie ;
+        int index ;
+    } pending_puts[XCB_MAX_PENDING_PUTS] ;/*not checked yet*/
+    int first_pending_put ;
+    int nb_pending_puts ;
+    unsigned long nb_put_errors ;
+#endif
+};
+
+struct ximage_sink_t {
+    struct sink_t base ;
+    GC gc ;
+    Visual *visual ;
+    int depth ;
+    enum rgb_order_t order ;
+    i420_row_to_rgb32_func_t convert_row ;
+    enum bool_t use_shm ;
+    /*frames not in I420 are repacked there before the conversion*/
+    unsigned char *i420_frame ;
+    const struct yuv_row_funcs_t *row_funcs ;
+    unsigned char *repack_tmp ;
+    /*
+     * set for the present sink, which draws the images to a pixmap
+     * per frame and presents those at the next vblanks.
+     */
+    enum bool_t use_present ;
+    struct frame_pool_t *pool ;/*whose frames own the pixmaps*/
+    unsigned pixmap_width ;
+    unsigned pixmap_height ;
+#ifdef HAVE_XPRESENT
+    XID present_eid ;
+    uint32_t present_serial ;
+    uint64_t next_msc ;/*target of the next present, 0 until known*/
+    /*the last completion, and the first one the period is measured from*/
+    uint64_t last_ust ;
+    uint64_t last_msc ;
+    uint64_t first_ust ;
+    uint64_t first_msc ;
+    uint64_t refresh_us ;/*period of the vblanks, 0 until measured*/
+    /*the target msc and frame of the last serials*/
+    uint64_t target_mscs[PRESENT_NB_SERIALS] ;
+    int frame_indices[PRESENT_NB_SERIALS] ;
+    /*counters*/
+    unsigned long nb_presents ;
+    unsigned long nb_completes ;
+    unsigned long nb_flips ;
+    unsigned long nb_copies ;
+    unsigned long nb_skips ;
+    unsigned long nb_late ;
+    unsigned long nb_missed_vblanks ;
+    unsigned long nb_intervals ;
+    uint64_t interval_sum_us ;
+    uint64_t interval_min_us ;
+    uint64_t interval_max_us ;
+    unsigned long nb_idle_waits ;
+    int64_t idle_wait_ns ;
+#endif
+};
+
+struct file_sink_t {
+    struct sink_t base ;
+    int fd ;
+};
+/******************
+ * </data types>
+ *****************/
+
+enum bool_t compute_yuv_image_size (enum yuv_format_t a_yuv_format,
+                                    unsigned a_width,
+                                    unsigned a_height,
+                                    unsigned *a_len) ;
+enum bool_t
+read_next_yuv_image_of_size_and_format (FILE *a_input,
+                                        unsigned a_width,
+                                        unsigned a_height,
+                                        enum yuv_format_t a_yuv_format,
+                                        struct frame_t *a_frame) ;
+enum bool_t read_next_yuv_image_into_buffer (FILE *a_input,
+                                             char *a_buf,
+                                             unsigned a_len) ;
+struct yuv_source_t* stdio_source_new (const char *a_path,
+                                       unsigned a_width,
+                                       unsigned a_height,
+                                       enum yuv_format_t a_format) ;
+struct yuv_source_t* mmap_source_new (const char *a_path,
+                                      unsigned a_width,
+                                      unsigned a_height,
+                                      enum yuv_format_t a_format) ;
+struct yuv_source_t* pipe_source_new (const char *a_path,
+                                      unsigned a_width,
+                                      unsigned a_height,
+                                      enum yuv_format_t a_format) ;
+struct yuv_source_t* direct_source_new (const char *a_path,
+                                        unsigned a_width,
+                                        unsigned a_height,
+                                        enum yuv_format_t a_format) ;
+struct yuv_source_t* preload_source_new (struct yuv_source_t *a_source,
+                                         int a_nb_frames,
+                                         enum bool_t a_huge_pages) ;
+enum bool_t pattern_parse_name (const char *a_name,
+                                enum pattern_type_t *a_type,
+                                enum bool_t *a_has_counter) ;
+struct yuv_source_t* pattern_source_new (const char *a_name,
+                                         unsigned a_width,
+                                         unsigned a_height,
+                                         enum yuv_format_t a_format,
+                                         enum bool_t a_no_simd) ;
+enum bool_t yuv_source_set_range (struct yuv_source_t *a_source,
+                                  int a_start_frame,
+                                  int a_end_frame,
+                                  int a_nb_loops,
+                                  enum bool_t a_reverse) ;
+int yuv_source_get_nb_frames (struct yuv_source_t *a_source) ;
+enum bool_t y4m_parse_header (const char *a_line,
+                              struct y4m_header_t *a_header) ;
+int yuv_source_get_file_frame (struct yuv_source_t *a_source, int a_index) ;
+int yuv_source_get_input_frame (struct yuv_source_t *a_source, int a_index) ;
+int yuv_source_get_frames_ahead (struct yuv_source_t *a_source,
+                                 int a_index,
+                                 int a_max,
+                                 int *a_first) ;
+void yuv_source_destroy (struct yuv_source_t *a_source) ;
+enum bool_t frame_pool_init (struct frame_pool_t *a_pool,
+                             int a_nb_frames,
+                             unsigned a_frame_len,
+                             enum bool_t a_huge_pages,
+                             frame_alloc_func_t a_alloc_func,
+                             frame_free_func_t a_free_func,
+                             void *a_user_data) ;
+void frame_pool_finalize (struct frame_pool_t *a_pool) ;
+struct frame_t* frame_pool_acquire (struct frame_pool_t *a_pool) ;
+void frame_pool_release (struct frame_pool_t *a_pool,
+                         struct frame_t *a_frame) ;
+void frame_pool_dump_stats (struct frame_pool_t *a_pool, FILE *a_out) ;
+enum bool_t frame_alloc_aligned (struct frame_pool_t *a_pool,
+                                 struct frame_t *a_frame,
+                                 unsigned a_len) ;
+void frame_free_aligned (struct frame_pool_t *a_pool,
+                         struct frame_t *a_frame) ;
+void wait_for_shm_completion (Display *a_display, struct frame_t *a_frame) ;
+
+int get_shm_completion_type (Display *a_display) ;
+i420_row_to_rgb32_func_t select_i420_row_to_rgb32 (enum bool_t a_no_simd) ;
+void convert_i420_to_rgb32 (const unsigned char *a_yuv,
+                            unsigned a_width,
+                            unsigned a_height,
+                            unsigned char *a_dst,
+                            unsigned a_dst_stride,
+                            enum rgb_order_t a_order,
+                            i420_row_to_rgb32_func_t a_row_func) ;
+const struct yuv_format_info_t* yuv_format_get_info (enum yuv_format_t a_format) ;
+enum yuv_format_t yuv_format_from_name (const char *a_name) ;
+enum bool_t yuv_planes_from_frame (struct yuv_planes_t *a_planes,
+                                   enum yuv_format_t a_format,
+                                   unsigned a_width,
+                                   unsigned a_height,
+                                   unsigned char *a_data) ;
+enum bool_t yuv_planes_from_xv_image (struct yuv_planes_t *a_planes,
+                                      enum yuv_format_t a_format,
+                                      XvImage *a_xv_image) ;
+const struct yuv_row_funcs_t* select_yuv_row_funcs (enum bool_t a_no_simd) ;
+void copy_yuv_planes (const struct yuv_planes_t *a_src,
+                      const struct yuv_planes_t *a_dst) ;
+void repack_yuv_frame (const struct yuv_planes_t *a_src,
+                       const struct yuv_planes_t *a_dst,
+                       const struct yuv_row_funcs_t *a_funcs,
+                       unsigned char *a_tmp) ;
+struct sink_t* xv_sink_new (Display *a_display,
+                            Window a_window,
+                            const struct sink_geometry_t *a_geometry,
+                            enum yuv_format_t a_format,
+                            unsigned a_width,
+                            unsigned a_height,
+                            const struct sink_options_t *a_options) ;
+struct sink_t* ximage_sink_new (Display *a_display,
+                                Window a_window,
+                                const struct sink_geometry_t *a_geometry,
+                                enum yuv_format_t a_format,
+                                unsigned a_width,
+                                unsigned a_height,
+                                const struct sink_options_t *a_options) ;
+struct sink_t* present_sink_new (Display *a_display,
+                                 Window a_window,
+                                 const struct sink_geometry_t *a_geometry,
+                                 enum yuv_format_t a_format,
+                                 unsigned a_width,
+                                 unsigned a_height,
+                                 const struct sink_options_t *a_options) ;
+struct sink_t* null_sink_new (const struct sink_geometry_t *a_geometry,
+                              enum yuv_format_t a_format,
+                              unsigned a_width,
+                              unsigned a_height,
+                              const struct sink_options_t *a_options) ;
+struct sink_t* file_sink_new (const char *a_path,
+                              const struct sink_geometry_t *a_geometry,
+                              enum yuv_format_t a_format,
+                              unsigned a_width,
+                              unsigned a_height,
+                              const struct sink_options_t *a_options) ;
+struct sink_t* sink_new (enum sink_type_t a_type,
+                         const char *a_path,
+                         Display *a_display,
+                         Window a_window,
+                         const struct sink_geometry_t *a_geometry,
+                         enum yuv_format_t a_format,
+                         unsigned a_width,
+                         unsigned a_height,
+                         const struct sink_options_t *a_options) ;
+void sink_destroy (struct sink_t *a_sink) ;
+void sink_set_geometry (struct sink_t *a_sink,
+                        const struct sink_geometry_t *a_geometry) ;
+const char* scale_filter_get_name (enum scale_filter_t a_filter) ;
+int scale_filter_from_name (const char *a_name) ;
+struct scaler_t* scaler_new (enum yuv_format_t a_format,
+                             unsigned a_width,
+                             unsigned a_height,
+                             const struct sink_geometry_t *a_geometry,
+                             unsigned a_dst_width,
+                             unsigned a_dst_height,
+                             enum scale_filter_t a_filter,
+                             int a_nb_threads,
+                             enum bool_t a_no_simd) ;
+void scaler_destroy (struct scaler_t *a_scaler) ;
+void scaler_scale (struct scaler_t *a_scaler,
+                   const struct yuv_planes_t *a_src,
+                   const struct yuv_planes_t *a_dst) ;
+void scaler_dump_stats (struct scaler_t *a_scaler, FILE *a_out) ;
+void scaler_benchmark (struct scaler_t *a_scaler, FILE *a_out) ;
+enum bool_t sink_type_needs_display (enum sink_type_t a_type) ;
+void sink_options_init (struct sink_options_t *a_options) ;
+void sink_set_event_func (sink_event_func_t a_func) ;
+
+enum bool_t xv_image_matches_yuv_layout (const XvImage *a_xv_image,
+                                         enum yuv_format_t a_format,
+                                         unsigned a_width,
+                                         unsigned a_height) ;
+enum bool_t xv_port_matches_yuv_layout (Display *a_display,
+                                        XvPortID a_xv_port,
+                                        enum yuv_format_t a_format,
+                                        unsigned a_width,
+                                        unsigned a_height) ;
+enum bool_t xv_port_can_scale (Display *a_display,
+                               XvPortID a_xv_port,
+                               const struct sink_geometry_t *a_geometry) ;
+enum bool_t get_xv_port (Display *a_display,
+                         Drawable a_drawable,
+                         XvPortID *a_port) ;
+enum bool_t xcb_probe_xv_port (Display *a_display,
+                               Window a_window,
+                               enum yuv_format_t a_format,
+                               unsigned a_width,
+                               unsigned a_height,
+                               const struct sink_geometry_t *a_geometry,
+                               struct xv_port_probe_t *a_probe) ;
+void release_xv_port (Display *a_display, XvPortID a_port) ;
+enum bool_t get_xv_supported_image_formats (Display *a_display,
+                                            XvPortID a_xv_port,
+                                            XvImageFormatValues **a_formats,
+                                            int *a_nb_formats) ;
+enum bool_t lookup_image_format (Display *a_display,
+                                 XvPortID a_xv_port,
+                                 int a_id,
+                                 XvImageFormatValues *a_image_format) ;
+enum bool_t can_use_shm (Display *a_display) ;
+enum bool_t attach_shm_segment (Display *a_display,
+                                XShmSegmentInfo *a_shm_info,
+                                unsigned a_size) ;
+void detach_shm_segment (Display *a_display, XShmSegmentInfo *a_shm_info) ;
+XvImage* create_shm_xv_image (Display *a_display,
+                              XvPortID a_xv_port,
+                              int a_format,
+                              int a_width,
+                              int a_height,
+                              XShmSegmentInfo *a_shm_info) ;
+void destroy_shm_xv_image (Display *a_display,
+                           XvImage *a_xv_image,
+                           XShmSegmentInfo *a_shm_info) ;
+enum bool_t xv_frame_alloc (struct frame_pool_t *a_pool,
+                            struct frame_t *a_frame) ;
+void xv_frame_free (struct frame_pool_t *a_pool,
+                    struct frame_t *a_frame) ;
+enum bool_t choose_xv_image_format (Display *a_display,
+                                    XvPortID a_xv_port,
+                                    enum yuv_format_t a_format,
+                                    enum yuv_format_t *a_image_format) ;
+enum bool_t ximage_frame_alloc (struct frame_pool_t *a_pool,
+                                struct frame_t *a_frame) ;
+void ximage_frame_free (struct frame_pool_t *a_pool,
+                        struct frame_t *a_frame) ;
+i420_row_to_rgb32_func_t lookup_i420_row_to_rgb32 (const char *a_name) ;
+double get_monotonic_time (void) ;
+int64_t get_monotonic_ns (void) ;
+
+static inline unsigned char
+clamp_to_byte (int a_value)
+{
+    if (a_value < 0) {
+        return 0 ;
+    }
+    if (a_value > 255) {
+        return 255 ;
+    }
+    return a_value ;
+}
+
+enum bool_t get_frame_logs (void) ;
+
+/*
+ * the functions of the library are global so that its files, and the
+ * test programs, share them, but only the xvplay_ ones are its API.
+ * The others are linked under an xvplay_priv_ name so that they do not
+ * clash with those of the programs linking libxvplay.a, while the code
+ * and the logs keep their short names.
+ * New global functions must be added to the list, test-symbols.sh
+ * checks that none is missing.
+ */
+#define XVPLAY_PRIVATE(a_name) \
+extern __typeof__ (a_name) a_name __asm__ ("xvplay_priv_" #a_name)
+
+XVPLAY_PRIVATE (attach_shm_segment) ;
+XVPLAY_PRIVATE (can_use_shm) ;
+XVPLAY_PRIVATE (choose_xv_image_format) ;
+XVPLAY_PRIVATE (compute_yuv_image_size) ;
+XVPLAY_PRIVATE (convert_i420_to_rgb32) ;
+XVPLAY_PRIVATE (copy_yuv_planes) ;
+XVPLAY_PRIVATE (create_shm_xv_image) ;
+XVPLAY_PRIVATE (destroy_shm_xv_image) ;
+XVPLAY_PRIVATE (detach_shm_segment) ;
+XVPLAY_PRIVATE (direct_source_new) ;
+XVPLAY_PRIVATE (file_sink_new) ;
+XVPLAY_PRIVATE (frame_alloc_aligned) ;
+XVPLAY_PRIVATE (frame_free_aligned) ;
+XVPLAY_PRIVATE (frame_pool_acquire) ;
+XVPLAY_PRIVATE (frame_pool_dump_stats) ;
+XVPLAY_PRIVATE (frame_pool_finalize) ;
+XVPLAY_PRIVATE (frame_pool_init) ;
+XVPLAY_PRIVATE (frame_pool_release) ;
+XVPLAY_PRIVATE (get_frame_logs) ;
+XVPLAY_PRIVATE (get_monotonic_ns) ;
+XVPLAY_PRIVATE (get_monotonic_time) ;
+XVPLAY_PRIVATE (get_shm_completion_type) ;
+XVPLAY_PRIVATE (get_xv_port) ;
+XVPLAY_PRIVATE (get_xv_supported_image_formats) ;
+XVPLAY_PRIVATE (lookup_i420_row_to_rgb32) ;
+XVPLAY_PRIVATE (lookup_image_format) ;
+XVPLAY_PRIVATE (mmap_source_new) ;
+XVPLAY_PRIVATE (null_sink_new) ;
+XVPLAY_PRIVATE (pattern_parse_name) ;
+XVPLAY_PRIVATE (pattern_source_new) ;
+XVPLAY_PRIVATE (pipe_source_new) ;
+XVPLAY_PRIVATE (preload_source_new) ;
+XVPLAY_PRIVATE (present_sink_new) ;
+XVPLAY_PRIVATE (read_next_yuv_image_into_buffer) ;
+XVPLAY_PRIVATE (read_next_yuv_image_of_size_and_format) ;
+XVPLAY_PRIVATE (release_xv_port) ;
+XVPLAY_PRIVATE (repack_yuv_frame) ;
+XVPLAY_PRIVATE (scale_filter_from_name) ;
+XVPLAY_PRIVATE (scale_filter_get_name) ;
+XVPLAY_PRIVATE (scaler_benchmark) ;
+XVPLAY_PRIVATE (scaler_destroy) ;
+XVPLAY_PRIVATE (scaler_dump_stats) ;
+XVPLAY_PRIVATE (scaler_new) ;
+XVPLAY_PRIVATE (scaler_scale) ;
+XVPLAY_PRIVATE (select_i420_row_to_rgb32) ;
+XVPLAY_PRIVATE (select_yuv_row_funcs) ;
+XVPLAY_PRIVATE (sink_destroy) ;
+XVPLAY_PRIVATE (sink_new) ;
+XVPLAY_PRIVATE (sink_options_init) ;
+XVPLAY_PRIVATE (sink_set_event_func) ;
+XVPLAY_PRIVATE (sink_set_geometry) ;
+XVPLAY_PRIVATE (sink_type_needs_display) ;
+XVPLAY_PRIVATE (stdio_source_new) ;
+XVPLAY_PRIVATE (wait_for_shm_completion) ;
+XVPLAY_PRIVATE (xcb_probe_xv_port) ;
+XVPLAY_PRIVATE (ximage_frame_alloc) ;
+XVPLAY_PRIVATE (ximage_frame_free) ;
+XVPLAY_PRIVATE (ximage_sink_new) ;
+XVPLAY_PRIVATE (xv_frame_alloc) ;
+XVPLAY_PRIVATE (xv_frame_free) ;
+XVPLAY_PRIVATE (xv_image_matches_yuv_layout) ;
+XVPLAY_PRIVATE (xv_port_can_scale) ;
+XVPLAY_PRIVATE (xv_port_matches_yuv_layout) ;
+XVPLAY_PRIVATE (xv_sink_new) ;
+XVPLAY_PRIVATE (y4m_parse_header) ;
+XVPLAY_PRIVATE (yuv_format_from_name) ;
+XVPLAY_PRIVATE (yuv_format_get_info) ;
+XVPLAY_PRIVATE (yuv_planes_from_frame) ;
+XVPLAY_PRIVATE (yuv_planes_from_xv_image) ;
+XVPLAY_PRIVATE (yuv_source_destroy) ;
+XVPLAY_PRIVATE (yuv_source_get_file_frame) ;
+XVPLAY_PRIVATE (yuv_source_get_frames_ahead) ;
+XVPLAY_PRIVATE (yuv_source_get_input_frame) ;
+XVPLAY_PRIVATE (yuv_source_get_nb_frames) ;
+XVPLAY_PRIVATE (yuv_source_set_range) ;
+
+#endif /*__XVPLAY_PRIVATE_H__*/
@@ -0,0 +1,673 @@
+/*
+ * Copyright (C) 2007 OpenedHand Ltd
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * Author:
+ *   Dodji Seketeli <dodji@openedhand.com>
+ */
+
+#include "xvplay-private.h"
+
+/*per frame logs, which benchmarks silence*/
+static enum bool_t log_frames=TRUE ;
+
+/**
+ * whether LOG_FRAME logs, see xvplay_set_frame_logs().
+ */
+enum bool_t
+get_frame_logs (void)
+{
+    return log_frames ;
+}
+
+/*
+ * the enums of xvplay.h are cast to the private ones, so they must
+ * keep the same values. The build breaks here otherwise.
+ */
+#define CHECK_SAME_VALUE(a_public, a_private) \
+typedef char check_##a_private[(int)(a_public) == (int)(a_private) ? 1 : -1]
+
+CHECK_SAME_VALUE (XVPLAY_FORMAT_UNKNOWN, YUV_FORMAT_UNDEF) ;
+CHECK_SAME_VALUE (XVPLAY_FORMAT_I420, YUV_FORMAT_420_PLANAR) ;
+CHECK_SAME_VALUE (XVPLAY_FORMAT_NV12, YUV_FORMAT_420_INTERLEAVED) ;
+CHECK_SAME_VALUE (XVPLAY_FORMAT_I422, YUV_FORMAT_422_PLANAR) ;
+CHECK_SAME_VALUE (XVPLAY_FORMAT_NV21, YUV_FORMAT_420_INTERLEAVED_VU) ;
+CHECK_SAME_VALUE (XVPLAY_FORMAT_YV12, YUV_FORMAT_YV12) ;
+CHECK_SAME_VALUE (XVPLAY_FORMAT_YV16, YUV_FORMAT_YV16) ;
+CHECK_SAME_VALUE (XVPLAY_FORMAT_YUY2, YUV_FORMAT_YUY2) ;
+CHECK_SAME_VALUE (XVPLAY_FORMAT_UYVY + 1, YUV_NB_FORMATS) ;
+CHECK_SAME_VALUE (XVPLAY_SINK_XV, SINK_TYPE_XV) ;
+CHECK_SAME_VALUE (XVPLAY_SINK_XIMAGE, SINK_TYPE_XIMAGE) ;
+CHECK_SAME_VALUE (XVPLAY_SINK_NULL, SINK_TYPE_NULL) ;
+CHECK_SAME_VALUE (XVPLAY_SINK_FILE, SINK_TYPE_FILE) ;
+CHECK_SAME_VALUE (XVPLAY_SINK_PRESENT, SINK_TYPE_PRESENT) ;
+CHECK_SAME_VALUE (XVPLAY_SCALE_FILTER_NEAREST, SCALE_FILTER_NEAREST) ;
+CHECK_SAME_VALUE (XVPLAY_SCALE_FILTER_BILINEAR, SCALE_FILTER_BILINEAR) ;
+CHECK_SAME_VALUE (XVPLAY_SCALE_FILTER_CUBIC, SCALE_FILTER_CUBIC) ;
+CHECK_SAME_VALUE (XVPLAY_RGB_ORDER_BGRX, RGB_ORDER_BGRX) ;
+CHECK_SAME_VALUE (XVPLAY_RGB_ORDER_RGBX, RGB_ORDER_RGBX) ;
+
+/*
+ * sources, frames and sinks are handed out as they are, behind the
+ * handles of xvplay.h. Pools and scalers need a bit more.
+ */
+struct xvplay_frame_pool_t {
+    struct frame_pool_t pool ;
+};
+
+struct xvplay_scaler_t {
+    struct scaler_t *scaler ;
+    unsigned width ;/*of the frames it is given*/
+    unsigned height ;
+};
+
+/*the row converters to RGB, once selected, without and with SIMD*/
+static i420_row_to_rgb32_func_t rgb_row_funcs[2] ;
+
+double
+get_monotonic_time (void)
+{
+    struct timespec ts ;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts) ;
+    return ts.tv_sec + ts.tv_nsec / 1e9 ;
+}
+
+int64_t
+get_monotonic_ns (void)
+{
+    struct timespec ts ;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts) ;
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec ;
+}
+
+
+/*************************
+ * <public api>
+ * ***********************/
+
+static void
+geometry_from_public (struct sink_geometry_t *a_geometry,
+                      const struct xvplay_geometry_t *a_public)
+{
+    a_geometry->src_x = a_public->src_x ;
+    a_geometry->src_y = a_public->src_y ;
+    a_geometry->src_width = a_public->src_width ;
+    a_geometry->src_height = a_public->src_height ;
+    a_geometry->dst_x = a_public->dst_x ;
+    a_geometry->dst_y = a_public->dst_y ;
+    a_geometry->dst_width = a_public->dst_width ;
+    a_geometry->dst_height = a_public->dst_height ;
+}
+
+/**
+ * the size of a frame of a_format stored the way yuv files hold
+ * them, planes one after the other.
+ */
+int
+xvplay_frame_size (enum xvplay_format_t a_format,
+                   unsigned a_width,
+                   unsigned a_height,
+                   unsigned *a_len)
+{
+    return compute_yuv_image_size ((enum yuv_format_t)a_format,
+                                   a_width, a_height, a_len) ;
+}
+
+enum xvplay_format_t
+xvplay_format_from_name (const char *a_name)
+{
+    return (enum xvplay_format_t)yuv_format_from_name (a_name) ;
+}
+
+/**
+ * the name of a_format, as xvplay_format_from_name() takes it.
+ * NULL for XVPLAY_FORMAT_UNKNOWN.
+ */
+const char*
+xvplay_format_get_name (enum xvplay_format_t a_format)
+{
+    const struct yuv_format_info_t *info=NULL ;
+
+    info = yuv_format_get_info ((enum yuv_format_t)a_format) ;
+    return info ? info->name : NULL ;
+}
+
+struct xvplay_source_t*
+xvplay_source_new_stdio (const char *a_path,
+                         unsigned a_width,
+                         unsigned a_height,
+                         enum xvplay_format_t a_format)
+{
+    return (struct xvplay_source_t*)
+        stdio_source_new (a_path, a_width, a_height,
+                          (enum yuv_format_t)a_format) ;
+}
+
+struct xvplay_source_t*
+xvplay_source_new_mmap (const char *a_path,
+                        unsigned a_width,
+                        unsigned a_height,
+                        enum xvplay_format_t a_format)
+{
+    return (struct xvplay_source_t*)
+        mmap_source_new (a_path, a_width, a_height,
+                         (enum yuv_format_t)a_format) ;
+}
+
+/**
+ * a source reading the file with O_DIRECT, through io_uring when
+ * the system has it.
+ */
+struct xvplay_source_t*
+xvplay_source_new_direct (const char *a_path,
+                          unsigned a_width,
+                          unsigned a_height,
+                          enum xvplay_format_t a_format)
+{
+    return (struct xvplay_source_t*)
+        direct_source_new (a_path, a_width, a_height,
+                           (enum yuv_format_t)a_format) ;
+}
+
+/**
+ * a source rendering the test pattern a_name, e.g. "bars" or
+ * "zoneplate", as --source pattern:<name> does.
+ */
+struct xvplay_source_t*
+xvplay_source_new_pattern (const char *a_name,
+                           unsigned a_width,
+                           unsigned a_height,
+                           enum xvplay_format_t a_format,
+                           int a_no_simd)
+{
+    return (struct xvplay_source_t*)
+        pattern_source_new (a_name, a_width, a_height,
+                            (enum yuv_format_t)a_format,
+                            a_no_simd ? TRUE : FALSE) ;
+}
+
+/**
+ * a source reading the first a_nb_frames frames of a_source into
+ * memory, then playing them over and over. It owns a_source.
+ */
+struct xvplay_source_t*
+xvplay_source_new_preload (struct xvplay_source_t *a_source,
+                           int a_nb_frames,
+                           int a_huge_pages)
+{
+    return (struct xvplay_source_t*)
+        preload_source_new ((struct yuv_source_t*)a_source, a_nb_frames,
+                            a_huge_pages ? TRUE : FALSE) ;
+}
+
+/**
+ * play the frames from a_start_frame to a_end_frame, excluded, -1
+ * meaning the end of the file, a_nb_loops times, 0 for ever.
+ */
+int
+xvplay_source_set_range (struct xvplay_source_t *a_source,
+                         int a_start_frame,
+                         int a_end_frame,
+                         int a_nb_loops,
+                         int a_reverse)
+{
+    return yuv_source_set_range ((struct yuv_source_t*)a_source,
+                                 a_start_frame, a_end_frame, a_nb_loops,
+                                 a_reverse ? TRUE : FALSE) ;
+}
+
+/**
+ * read the next frame of a_source into a_frame. 0 at the end of
+ * the range, or on errors.
+ */
+int
+xvplay_source_read_frame (struct xvplay_source_t *a_source,
+                          struct xvplay_frame_t *a_frame)
+{
+    struct yuv_source_t *source = (struct yuv_source_t*)a_source ;
+
+    RETURN_VAL_IF_FAIL (source && a_frame, 0) ;
+
+    return source->read_frame (source, (struct frame_t*)a_frame) ;
+}
+
+void
+xvplay_source_destroy (struct xvplay_source_t *a_source)
+{
+    yuv_source_destroy ((struct yuv_source_t*)a_source) ;
+}
+
+/**
+ * a pool of a_nb_frames frames of a_frame_len bytes. With a_sink,
+ * the frames get whatever the sink puts them with, e.g. an XvImage,
+ * and the pool must be destroyed before the sink.
+ */
+struct xvplay_frame_pool_t*
+xvplay_frame_pool_new (int a_nb_frames,
+                       unsigned a_frame_len,
+                       int a_huge_pages,
+                       struct xvplay_sink_t *a_sink)
+{
+    struct xvplay_frame_pool_t *pool=NULL ;
+    struct sink_t *sink = (struct sink_t*)a_sink ;
+
+    pool = calloc (1, sizeof (struct xvplay_frame_pool_t)) ;
+    if (!pool) {
+        return NULL ;
+    }
+    if (!frame_pool_init (&pool->pool, a_nb_frames, a_frame_len,
+                          a_huge_pages ? TRUE : FALSE,
+                          sink ? sink->alloc_frame : NULL,
+                          sink ? sink->free_frame : NULL,
+                          sink)) {
+        frame_pool_finalize (&pool->pool) ;
+        free (pool) ;
+        return NULL ;
+    }
+    return pool ;
+}
+
+/**
+ * a free frame of a_pool, NULL if they are all in use.
+ */
+struct xvplay_frame_t*
+xvplay_frame_pool_acquire (struct xvplay_frame_pool_t *a_pool)
+{
+    RETURN_VAL_IF_FAIL (a_pool, NULL) ;
+
+    return (struct xvplay_frame_t*)frame_pool_acquire (&a_pool->pool) ;
+}
+
+void
+xvplay_frame_pool_release (struct xvplay_frame_pool_t *a_pool,
+                           struct xvplay_frame_t *a_frame)
+{
+    RETURN_IF_FAIL (a_pool) ;
+
+    frame_pool_release (&a_pool->pool, (struct frame_t*)a_frame) ;
+}
+
+void
+xvplay_frame_pool_destroy (struct xvplay_frame_pool_t *a_pool)
+{
+    if (!a_pool) {
+        return ;
+    }
+    frame_pool_finalize (&a_pool->pool) ;
+    free (a_pool) ;
+}
+
+/**
+ * where the bytes of a_frame are. That may be memory of the source
+ * the frame was read from, which only lasts until the frame is
+ * released.
+ */
+const unsigned char*
+xvplay_frame_get_data (const struct xvplay_frame_t *a_frame)
+{
+    RETURN_VAL_IF_FAIL (a_frame, NULL) ;
+
+    return (const unsigned char*)((const struct frame_t*)a_frame)->data ;
+}
+
+unsigned
+xvplay_frame_get_len (const struct xvplay_frame_t *a_frame)
+{
+    RETURN_VAL_IF_FAIL (a_frame, 0) ;
+
+    return ((const struct frame_t*)a_frame)->len ;
+}
+
+/**
+ * the index the source read a_frame at, -1 if it was not read.
+ */
+int
+xvplay_frame_get_index (const struct xvplay_frame_t *a_frame)
+{
+    RETURN_VAL_IF_FAIL (a_frame, -1) ;
+
+    return ((const struct frame_t*)a_frame)->index ;
+}
+
+/**
+ * copy a_len bytes of frame data into the buffer of a_frame, e.g.
+ * a frame decoded by the caller. 0 if they do not fit.
+ */
+int
+xvplay_frame_load (struct xvplay_frame_t *a_frame,
+                   const unsigned char *a_data,
+                   unsigned a_len)
+{
+    struct frame_t *frame = (struct frame_t*)a_frame ;
+
+    RETURN_VAL_IF_FAIL (frame && frame->buf && a_data, 0) ;
+
+    if (a_len > frame->capacity) {
+        LOG_ERROR ("%u bytes do not fit a frame of %u\n",
+                   a_len, frame->capacity) ;
+        return 0 ;
+    }
+    memcpy (frame->buf, a_data, a_len) ;
+    frame->data = frame->buf ;
+    frame->len = a_len ;
+    return 1 ;
+}
+
+/**
+ * copy the a_width x a_height frame at a_src into a_dst, converting
+ * it from a_src_format to a_dst_format.
+ */
+int
+xvplay_repack_frame (const unsigned char *a_src,
+                     enum xvplay_format_t a_src_format,
+                     unsigned char *a_dst,
+                     enum xvplay_format_t a_dst_format,
+                     unsigned a_width,
+                     unsigned a_height,
+                     int a_no_simd)
+{
+    struct yuv_planes_t src, dst ;
+    unsigned char *tmp=NULL ;
+
+    RETURN_VAL_IF_FAIL (a_src && a_dst, 0) ;
+
+    if (!yuv_planes_from_frame (&src, (enum yuv_format_t)a_src_format,
+                                a_width, a_height, (unsigned char*)a_src)
+        || !yuv_planes_from_frame (&dst, (enum yuv_format_t)a_dst_format,
+                                   a_width, a_height, a_dst)) {
+        return 0 ;
+    }
+    if (a_src_format == a_dst_format) {
+        copy_yuv_planes (&src, &dst) ;
+        return 1 ;
+    }
+    tmp = malloc (2 * a_width) ;
+    if (!tmp) {
+        return 0 ;
+    }
+    repack_yuv_frame (&src, &dst, select_yuv_row_funcs (a_no_simd ? TRUE
+                                                                   : FALSE),
+                      tmp) ;
+    free (tmp) ;
+    return 1 ;
+}
+
+/**
+ * convert the a_width x a_height I420 frame at a_yuv to 32 bits RGB
+ * pixels, a_dst_stride bytes a line.
+ */
+void
+xvplay_convert_i420_to_rgb32 (const unsigned char *a_yuv,
+                              unsigned a_width,
+                              unsigned a_height,
+                              unsigned char *a_dst,
+                              unsigned a_dst_stride,
+                              enum xvplay_rgb_order_t a_order,
+                              int a_no_simd)
+{
+    int simd = a_no_simd ? 0 : 1 ;
+
+    RETURN_IF_FAIL (a_yuv && a_dst) ;
+
+    if (!rgb_row_funcs[simd]) {
+        rgb_row_funcs[simd] = select_i420_row_to_rgb32 (simd ? FALSE : TRUE) ;
+    }
+    convert_i420_to_rgb32 (a_yuv, a_width, a_height, a_dst, a_dst_stride,
+                           (enum rgb_order_t)a_order, rgb_row_funcs[simd]) ;
+}
+
+/**
+ * a scaler of the a_geometry rectangle of a_width x a_height frames
+ * of a_format to a_dst_width x a_dst_height frames, on up to
+ * a_nb_threads threads, 0 for the default.
+ */
+struct xvplay_scaler_t*
+xvplay_scaler_new (enum xvplay_format_t a_format,
+                   unsigned a_width,
+                   unsigned a_height,
+                   const struct xvplay_geometry_t *a_geometry,
+                   unsigned a_dst_width,
+                   unsigned a_dst_height,
+                   enum xvplay_scale_filter_t a_filter,
+                   int a_nb_threads,
+                   int a_no_simd)
+{
+    struct xvplay_scaler_t *scaler=NULL ;
+    struct sink_geometry_t geometry ;
+
+    RETURN_VAL_IF_FAIL (a_geometry, NULL) ;
+
+    scaler = calloc (1, sizeof (struct xvplay_scaler_t)) ;
+    if (!scaler) {
+        return NULL ;
+    }
+    geometry_from_public (&geometry, a_geometry) ;
+    scaler->scaler = scaler_new ((enum yuv_format_t)a_format,
+                                 a_width, a_height, &geometry,
+                                 a_dst_width, a_dst_height,
+                                 (enum scale_filter_t)a_filter,
+                                 a_nb_threads, a_no_simd ? TRUE : FALSE) ;
+    if (!scaler->scaler) {
+        free (scaler) ;
+        return NULL ;
+    }
+    scaler->width = a_width ;
+    scaler->height = a_height ;
+    return scaler ;
+}
+
+/**
+ * scale the frame at a_src into a_dst, which holds a frame of the
+ * destination size.
+ */
+void
+xvplay_scaler_scale (struct xvplay_scaler_t *a_scaler,
+                     const unsigned char *a_src,
+                     unsigned char *a_dst)
+{
+    struct yuv_planes_t src, dst ;
+    struct scaler_t *scaler=NULL ;
+
+    RETURN_IF_FAIL (a_scaler && a_src && a_dst) ;
+
+    scaler = a_scaler->scaler ;
+    if (!yuv_planes_from_frame (&src, scaler->format, a_scaler->width,
+                                a_scaler->height, (unsigned char*)a_src)
+        || !yuv_planes_from_frame (&dst, scaler->format, scaler->dst_width,
+                                   scaler->dst_height, a_dst)) {
+        return ;
+    }
+    scaler_scale (scaler, &src, &dst) ;
+}
+
+void
+xvplay_scaler_destroy (struct xvplay_scaler_t *a_scaler)
+{
+    if (!a_scaler) {
+        return ;
+    }
+    scaler_destroy (a_scaler->scaler) ;
+    free (a_scaler) ;
+}
+
+void
+xvplay_sink_options_init (struct xvplay_sink_options_t *a_options)
+{
+    RETURN_IF_FAIL (a_options) ;
+
+    memset (a_options, 0, sizeof (struct xvplay_sink_options_t)) ;
+    a_options->scale_filter = XVPLAY_SCALE_FILTER_BILINEAR ;
+}
+
+int
+xvplay_sink_type_needs_display (enum xvplay_sink_type_t a_type)
+{
+    return sink_type_needs_display ((enum sink_type_t)a_type) ;
+}
+
+/**
+ * a sink of a_type showing the a_width x a_height frames of
+ * a_format on a_window of a_display, or writing them to a_path
+ * for the file sink. a_options may be NULL for the defaults.
+ */
+struct xvplay_sink_t*
+xvplay_sink_new (enum xvplay_sink_type_t a_type,
+                 const char *a_path,
+                 Display *a_display,
+                 Window a_window,
+                 const struct xvplay_geometry_t *a_geometry,
+                 enum xvplay_format_t a_format,
+                 unsigned a_width,
+                 unsigned a_height,
+                 const struct xvplay_sink_options_t *a_options)
+{
+    struct sink_geometry_t geometry ;
+    struct sink_options_t options ;
+
+    RETURN_VAL_IF_FAIL (a_geometry, NULL) ;
+
+    geometry_from_public (&geometry, a_geometry) ;
+    sink_options_init (&options) ;
+    if (a_options) {
+        options.no_simd = a_options->no_simd ? TRUE : FALSE ;
+        options.no_shm = a_options->no_shm ? TRUE : FALSE ;
+        options.client_scale = a_options->client_scale ? TRUE : FALSE ;
+        options.scale_filter = (enum scale_filter_t)a_options->scale_filter ;
+        options.scale_threads = a_options->scale_threads ;
+        options.xcb = a_options->xcb ? TRUE : FALSE ;
+    }
+    return (struct xvplay_sink_t*)
+        sink_new ((enum sink_type_t)a_type, a_path, a_display, a_window,
+                  &geometry, (enum yuv_format_t)a_format,
+                  a_width, a_height, &options) ;
+}
+
+/**
+ * show another part of the frames, or show them somewhere else,
+ * e.g. once the window got resized.
+ */
+void
+xvplay_sink_set_geometry (struct xvplay_sink_t *a_sink,
+                          const struct xvplay_geometry_t *a_geometry)
+{
+    struct sink_geometry_t geometry ;
+
+    RETURN_IF_FAIL (a_sink && a_geometry) ;
+
+    geometry_from_public (&geometry, a_geometry) ;
+    sink_set_geometry ((struct sink_t*)a_sink, &geometry) ;
+}
+
+/**
+ * upload a_frame, a frame of a pool made for a_sink, and put it.
+ * It goes out with the next xvplay_sink_flush().
+ */
+int
+xvplay_sink_put_frame (struct xvplay_sink_t *a_sink,
+                       struct xvplay_frame_t *a_frame)
+{
+    struct sink_t *sink = (struct sink_t*)a_sink ;
+    struct frame_t *frame = (struct frame_t*)a_frame ;
+
+    RETURN_VAL_IF_FAIL (sink && frame, 0) ;
+
+    if (sink->upload_frame && !sink->upload_frame (sink, frame)) {
+        return 0 ;
+    }
+    return sink->put_frame (sink, frame) ;
+}
+
+/**
+ * push out the frames put so far, waiting for the XServer to have
+ * processed them if a_sync.
+ */
+void
+xvplay_sink_flush (struct xvplay_sink_t *a_sink, int a_sync)
+{
+    struct sink_t *sink = (struct sink_t*)a_sink ;
+
+    RETURN_IF_FAIL (sink) ;
+
+    if (sink->flush) {
+        sink->flush (sink, a_sync ? TRUE : FALSE) ;
+    }
+}
+
+/**
+ * wait for the XServer to be done reading a_frame, which must be
+ * before it is written to again.
+ */
+void
+xvplay_sink_wait_for_frame (struct xvplay_sink_t *a_sink,
+                            struct xvplay_frame_t *a_frame)
+{
+    RETURN_IF_FAIL (a_sink && a_frame) ;
+
+    wait_for_shm_completion (((struct sink_t*)a_sink)->display,
+                             (struct frame_t*)a_frame) ;
+}
+
+/**
+ * hand a_sink an event of its display which data is fetched, e.g.
+ * one an xvplay_event_func_t got. Events of other windows are
+ * ignored.
+ */
+void
+xvplay_sink_process_event (struct xvplay_sink_t *a_sink,
+                           const XGenericEventCookie *a_cookie)
+{
+    struct sink_t *sink = (struct sink_t*)a_sink ;
+
+    RETURN_IF_FAIL (sink && a_cookie) ;
+
+    if (sink->process_event) {
+        sink->process_event (sink, a_cookie) ;
+    }
+}
+
+/**
+ * destroy a_sink, once the pools made for it are.
+ */
+void
+xvplay_sink_destroy (struct xvplay_sink_t *a_sink)
+{
+    if (!a_sink) {
+        return ;
+    }
+    sink_destroy ((struct sink_t*)a_sink) ;
+}
+
+void
+xvplay_set_event_func (xvplay_event_func_t a_func)
+{
+    sink_set_event_func (a_func) ;
+}
+
+/**
+ * turn the logs emitted for every frame on or off, e.g. so that they
+ * do not get in the way of a benchmark.
+ */
+void
+xvplay_set_frame_logs (int a_enabled)
+{
+    log_frames = a_enabled ? TRUE : FALSE ;
+}
+
+/*************************
+ * </public api>
+ * ***********************/
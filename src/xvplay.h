@@ -0,0 +1,224 @@
+/*
+ * Copyright (C) 2007 OpenedHand Ltd
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * Author:
+ *   Dodji Seketeli <dodji@openedhand.com>
+ */
+
+/*
+ * libxvplay reads yuv frames, converts and scales them, and puts
+ * them to sinks such as an Xv port, an XImage or a file.
+ * Sources, frames, pools, scalers and sinks are handles, which
+ * layouts are private. What is declared here keeps its layout and
+ * signature across releases, XVPLAY_API_VERSION being bumped
+ * otherwise. Functions returning int for success return 0 on failure.
+ */
+#ifndef __XVPLAY_H__
+#define __XVPLAY_H__
+
+#include <X11/Xlib.h>
+
+#define XVPLAY_API_VERSION 1
+
+/******************
+ * <data types>
+ *****************/
+enum xvplay_format_t {
+    XVPLAY_FORMAT_UNKNOWN,
+    XVPLAY_FORMAT_I420,
+    XVPLAY_FORMAT_NV12,
+    XVPLAY_FORMAT_I422,
+    XVPLAY_FORMAT_NV21,
+    XVPLAY_FORMAT_YV12,/*I420 with V before U*/
+    XVPLAY_FORMAT_YV16,/*I422 with V before U*/
+    XVPLAY_FORMAT_YUY2,
+    XVPLAY_FORMAT_UYVY
+};
+
+enum xvplay_sink_type_t {
+    XVPLAY_SINK_XV,
+    XVPLAY_SINK_XIMAGE,
+    XVPLAY_SINK_NULL,
+    XVPLAY_SINK_FILE,
+    XVPLAY_SINK_PRESENT
+};
+
+/*how the client side scaler filters*/
+enum xvplay_scale_filter_t {
+    XVPLAY_SCALE_FILTER_NEAREST,
+    XVPLAY_SCALE_FILTER_BILINEAR,
+    XVPLAY_SCALE_FILTER_CUBIC/*Catmull-Rom*/
+};
+
+/*byte order of 32 bits RGB pixels in memory*/
+enum xvplay_rgb_order_t {
+    XVPLAY_RGB_ORDER_BGRX,
+    XVPLAY_RGB_ORDER_RGBX
+};
+
+struct xvplay_source_t ;
+struct xvplay_frame_t ;
+struct xvplay_frame_pool_t ;
+struct xvplay_scaler_t ;
+struct xvplay_sink_t ;
+
+/*which part of the frames is shown, and where*/
+struct xvplay_geometry_t {
+    int src_x ;
+    int src_y ;
+    int src_width ;
+    int src_height ;
+    int dst_x ;
+    int dst_y ;
+    int dst_width ;
+    int dst_height ;
+};
+
+/*how sinks work, besides what they show and where*/
+struct xvplay_sink_options_t {
+    int no_simd ;/*only use the scalar kernels*/
+    int no_shm ;
+    int client_scale ;/*scale frames even if the output could*/
+    enum xvplay_scale_filter_t scale_filter ;
+    int scale_threads ;/*0 for as many as there are cpus, up to a few*/
+    int xcb ;/*probe the xv port and put frames through XCB*/
+};
+
+/*
+ * gets the events a sink pulls off the queue of its display while
+ * it waits on the XServer, which may be meant for other sinks.
+ */
+typedef void (*xvplay_event_func_t) (const XEvent *a_event) ;
+/******************
+ * </data types>
+ *****************/
+
+int xvplay_frame_size (enum xvplay_format_t a_format,
+                       unsigned a_width,
+                       unsigned a_height,
+                       unsigned *a_len) ;
+enum xvplay_format_t xvplay_format_from_name (const char *a_name) ;
+const char* xvplay_format_get_name (enum xvplay_format_t a_format) ;
+
+struct xvplay_source_t*
+xvplay_source_new_stdio (const char *a_path,
+                         unsigned a_width,
+                         unsigned a_height,
+                         enum xvplay_format_t a_format) ;
+struct xvplay_source_t*
+xvplay_source_new_mmap (const char *a_path,
+                        unsigned a_width,
+                        unsigned a_height,
+                        enum xvplay_format_t a_format) ;
+struct xvplay_source_t*
+xvplay_source_new_direct (const char *a_path,
+                          unsigned a_width,
+                          unsigned a_height,
+                          enum xvplay_format_t a_format) ;
+struct xvplay_source_t*
+xvplay_source_new_pattern (const char *a_name,
+                           unsigned a_width,
+                           unsigned a_height,
+                           enum xvplay_format_t a_format,
+                           int a_no_simd) ;
+struct xvplay_source_t*
+xvplay_source_new_preload (struct xvplay_source_t *a_source,
+                           int a_nb_frames,
+                           int a_huge_pages) ;
+int xvplay_source_set_range (struct xvplay_source_t *a_source,
+                             int a_start_frame,
+                             int a_end_frame,
+                             int a_nb_loops,
+                             int a_reverse) ;
+int xvplay_source_read_frame (struct xvplay_source_t *a_source,
+                              struct xvplay_frame_t *a_frame) ;
+void xvplay_source_destroy (struct xvplay_source_t *a_source) ;
+
+struct xvplay_frame_pool_t*
+xvplay_frame_pool_new (int a_nb_frames,
+                       unsigned a_frame_len,
+                       int a_huge_pages,
+                       struct xvplay_sink_t *a_sink) ;
+struct xvplay_frame_t*
+xvplay_frame_pool_acquire (struct xvplay_frame_pool_t *a_pool) ;
+void xvplay_frame_pool_release (struct xvplay_frame_pool_t *a_pool,
+                                struct xvplay_frame_t *a_frame) ;
+void xvplay_frame_pool_destroy (struct xvplay_frame_pool_t *a_pool) ;
+const unsigned char*
+xvplay_frame_get_data (const struct xvplay_frame_t *a_frame) ;
+unsigned xvplay_frame_get_len (const struct xvplay_frame_t *a_frame) ;
+int xvplay_frame_get_index (const struct xvplay_frame_t *a_frame) ;
+int xvplay_frame_load (struct xvplay_frame_t *a_frame,
+                       const unsigned char *a_data,
+                       unsigned a_len) ;
+
+int xvplay_repack_frame (const unsigned char *a_src,
+                         enum xvplay_format_t a_src_format,
+                         unsigned char *a_dst,
+                         enum xvplay_format_t a_dst_format,
+                         unsigned a_width,
+                         unsigned a_height,
+                         int a_no_simd) ;
+void xvplay_convert_i420_to_rgb32 (const unsigned char *a_yuv,
+                                   unsigned a_width,
+                                   unsigned a_height,
+                                   unsigned char *a_dst,
+                                   unsigned a_dst_stride,
+                                   enum xvplay_rgb_order_t a_order,
+                                   int a_no_simd) ;
+
+struct xvplay_scaler_t*
+xvplay_scaler_new (enum xvplay_format_t a_format,
+                   unsigned a_width,
+                   unsigned a_height,
+                   const struct xvplay_geometry_t *a_geometry,
+                   unsigned a_dst_width,
+                   unsigned a_dst_height,
+                   enum xvplay_scale_filter_t a_filter,
+                   int a_nb_threads,
+                   int a_no_simd) ;
+void xvplay_scaler_scale (struct xvplay_scaler_t *a_scaler,
+                          const unsigned char *a_src,
+                          unsigned char *a_dst) ;
+void xvplay_scaler_destroy (struct xvplay_scaler_t *a_scaler) ;
+
+void xvplay_sink_options_init (struct xvplay_sink_options_t *a_options) ;
+int xvplay_sink_type_needs_display (enum xvplay_sink_type_t a_type) ;
+struct xvplay_sink_t*
+xvplay_sink_new (enum xvplay_sink_type_t a_type,
+                 const char *a_path,
+                 Display *a_display,
+                 Window a_window,
+                 const struct xvplay_geometry_t *a_geometry,
+                 enum xvplay_format_t a_format,
+                 unsigned a_width,
+                 unsigned a_height,
+                 const struct xvplay_sink_options_t *a_options) ;
+void xvplay_sink_set_geometry (struct xvplay_sink_t *a_sink,
+                               const struct xvplay_geometry_t *a_geometry) ;
+int xvplay_sink_put_frame (struct xvplay_sink_t *a_sink,
+                           struct xvplay_frame_t *a_frame) ;
+void xvplay_sink_flush (struct xvplay_sink_t *a_sink, int a_sync) ;
+void xvplay_sink_wait_for_frame (struct xvplay_sink_t *a_sink,
+                                 struct xvplay_frame_t *a_frame) ;
+void xvplay_sink_process_event (struct xvplay_sink_t *a_sink,
+                                const XGenericEventCookie *a_cookie) ;
+void xvplay_sink_destroy (struct xvplay_sink_t *a_sink) ;
+void xvplay_set_event_func (xvplay_event_func_t a_func) ;
+void xvplay_set_frame_logs (int a_enabled) ;
+
+#endif /*__XVPLAY_H__*/
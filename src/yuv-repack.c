@@ -0,0 +1,682 @@
+/*
+ * Copyright (C) 2007 OpenedHand Ltd
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * Author:
+ *   Dodji Seketeli <dodji@openedhand.com>
+ */
+
+#include "xvplay-private.h"
+
+/*************************
+ * <yuv repacking>
+ * ***********************/
+
+/*
+ * the formats frames can be read in or put to Xv in.
+ * conversions lists the formats a frame can be repacked to,
+ * cheapest first, starting with the format itself.
+ */
+static const struct yuv_format_info_t yuv_format_infos[YUV_NB_FORMATS] = {
+    [YUV_FORMAT_420_PLANAR] = {
+        YUV_FORMAT_420_PLANAR, "i420", GUID_I420_PLANAR,
+        YUV_LAYOUT_PLANAR, 1, FALSE,
+        {YUV_FORMAT_420_PLANAR, YUV_FORMAT_YV12,
+         YUV_FORMAT_420_INTERLEAVED, YUV_FORMAT_420_INTERLEAVED_VU,
+         YUV_FORMAT_YUY2, YUV_FORMAT_UYVY, YUV_FORMAT_YV16}
+    },
+    [YUV_FORMAT_YV12] = {
+        YUV_FORMAT_YV12, "yv12", GUID_YUV12_PLANAR,
+        YUV_LAYOUT_PLANAR, 1, TRUE,
+        {YUV_FORMAT_YV12, YUV_FORMAT_420_PLANAR,
+         YUV_FORMAT_420_INTERLEAVED_VU, YUV_FORMAT_420_INTERLEAVED,
+         YUV_FORMAT_YUY2, YUV_FORMAT_UYVY, YUV_FORMAT_YV16}
+    },
+    [YUV_FORMAT_420_INTERLEAVED] = {
+        YUV_FORMAT_420_INTERLEAVED, "nv12", GUID_NV12,
+        YUV_LAYOUT_SEMI_PLANAR, 1, FALSE,
+        {YUV_FORMAT_420_INTERLEAVED, YUV_FORMAT_420_INTERLEAVED_VU,
+         YUV_FORMAT_420_PLANAR, YUV_FORMAT_YV12,
+         YUV_FORMAT_YUY2, YUV_FORMAT_UYVY, YUV_FORMAT_YV16}
+    },
+    [YUV_FORMAT_420_INTERLEAVED_VU] = {
+        YUV_FORMAT_420_INTERLEAVED_VU, "nv21", GUID_NV21,
+        YUV_LAYOUT_SEMI_PLANAR, 1, TRUE,
+        {YUV_FORMAT_420_INTERLEAVED_VU, YUV_FORMAT_420_INTERLEAVED,
+         YUV_FORMAT_YV12, YUV_FORMAT_420_PLANAR,
+         YUV_FORMAT_YUY2, YUV_FORMAT_UYVY, YUV_FORMAT_YV16}
+    },
+    [YUV_FORMAT_422_PLANAR] = {
+        YUV_FORMAT_422_PLANAR, "i422", 0,
+        YUV_LAYOUT_PLANAR, 0, FALSE,
+        {YUV_FORMAT_422_PLANAR, YUV_FORMAT_YV16,
+         YUV_FORMAT_YUY2, YUV_FORMAT_UYVY,
+         YUV_FORMAT_420_PLANAR, YUV_FORMAT_YV12,
+         YUV_FORMAT_420_INTERLEAVED, YUV_FORMAT_420_INTERLEAVED_VU}
+    },
+    [YUV_FORMAT_YV16] = {
+        YUV_FORMAT_YV16, "yv16", GUID_YUV16_PLANAR,
+        YUV_LAYOUT_PLANAR, 0, TRUE,
+        {YUV_FORMAT_YV16, YUV_FORMAT_YUY2, YUV_FORMAT_UYVY,
+         YUV_FORMAT_YV12, YUV_FORMAT_420_PLANAR,
+         YUV_FORMAT_420_INTERLEAVED, YUV_FORMAT_420_INTERLEAVED_VU}
+    },
+    [YUV_FORMAT_YUY2] = {
+        YUV_FORMAT_YUY2, "yuy2", GUID_YUY2,
+        YUV_LAYOUT_PACKED, 0, FALSE,
+        {YUV_FORMAT_YUY2, YUV_FORMAT_UYVY, YUV_FORMAT_YV16,
+         YUV_FORMAT_420_PLANAR, YUV_FORMAT_YV12,
+         YUV_FORMAT_420_INTERLEAVED, YUV_FORMAT_420_INTERLEAVED_VU}
+    },
+    [YUV_FORMAT_UYVY] = {
+        YUV_FORMAT_UYVY, "uyvy", GUID_UYVY,
+        YUV_LAYOUT_PACKED, 0, FALSE,
+        {YUV_FORMAT_UYVY, YUV_FORMAT_YUY2, YUV_FORMAT_YV16,
+         YUV_FORMAT_420_PLANAR, YUV_FORMAT_YV12,
+         YUV_FORMAT_420_INTERLEAVED, YUV_FORMAT_420_INTERLEAVED_VU}
+    },
+};
+
+const struct yuv_format_info_t*
+yuv_format_get_info (enum yuv_format_t a_format)
+{
+    if (a_format <= YUV_FORMAT_UNDEF || a_format >= YUV_NB_FORMATS) {
+        return NULL ;
+    }
+    return &yuv_format_infos[a_format] ;
+}
+
+enum yuv_format_t
+yuv_format_from_name (const char *a_name)
+{
+    int i=0 ;
+
+    RETURN_VAL_IF_FAIL (a_name, YUV_FORMAT_UNDEF) ;
+
+    for (i=YUV_FORMAT_UNDEF+1 ; i < YUV_NB_FORMATS ; i++) {
+        if (!strcasecmp (yuv_format_infos[i].name, a_name)) {
+            return i ;
+        }
+    }
+    return YUV_FORMAT_UNDEF ;
+}
+
+/**
+ * describe the frame of a_format at a_data as stored in a yuv file,
+ * i.e. with planes of a_width samples per line, one after the other.
+ */
+enum bool_t
+yuv_planes_from_frame (struct yuv_planes_t *a_planes,
+                       enum yuv_format_t a_format,
+                       unsigned a_width,
+                       unsigned a_height,
+                       unsigned char *a_data)
+{
+    const struct yuv_format_info_t *info=NULL ;
+    unsigned char *first=NULL, *second=NULL ;
+
+    RETURN_VAL_IF_FAIL (a_planes && a_data, FALSE) ;
+
+    info = yuv_format_get_info (a_format) ;
+    RETURN_VAL_IF_FAIL (info, FALSE) ;
+
+    memset (a_planes, 0, sizeof (struct yuv_planes_t)) ;
+    a_planes->info = info ;
+    a_planes->width = a_width ;
+    a_planes->height = a_height ;
+    switch (info->layout) {
+        case YUV_LAYOUT_PLANAR:
+            a_planes->y = a_data ;
+            a_planes->y_pitch = a_width ;
+            a_planes->uv_pitch = a_width / 2 ;
+            first = a_data + a_width * a_height ;
+            second = first
+                + (a_width / 2) * (a_height >> info->chroma_y_shift) ;
+            break ;
+        case YUV_LAYOUT_SEMI_PLANAR:
+            a_planes->y = a_data ;
+            a_planes->y_pitch = a_width ;
+            a_planes->uv_pitch = a_width ;
+            first = a_data + a_width * a_height ;
+            second = first + 1 ;
+            break ;
+        case YUV_LAYOUT_PACKED:
+            a_planes->packed = a_data ;
+            a_planes->y_pitch = 2 * a_width ;
+            a_planes->uv_pitch = 2 * a_width ;
+            if (a_format == YUV_FORMAT_UYVY) {
+                a_planes->y = a_data + 1 ;
+                first = a_data ;
+            } else {
+                a_planes->y = a_data ;
+                first = a_data + 1 ;
+            }
+            second = first + 2 ;
+            break ;
+    }
+    a_planes->u = info->vu ? second : first ;
+    a_planes->v = info->vu ? first : second ;
+    return TRUE ;
+}
+
+/**
+ * describe the frame held by a_xv_image, which format is a_format,
+ * honoring the plane offsets and pitches of the adaptor.
+ */
+enum bool_t
+yuv_planes_from_xv_image (struct yuv_planes_t *a_planes,
+                          enum yuv_format_t a_format,
+                          XvImage *a_xv_image)
+{
+    const struct yuv_format_info_t *info=NULL ;
+    unsigned char *data=NULL, *first=NULL, *second=NULL ;
+
+    RETURN_VAL_IF_FAIL (a_planes && a_xv_image && a_xv_image->data, FALSE) ;
+
+    info = yuv_format_get_info (a_format) ;
+    RETURN_VAL_IF_FAIL (info, FALSE) ;
+
+    memset (a_planes, 0, sizeof (struct yuv_planes_t)) ;
+    data = (unsigned char*)a_xv_image->data ;
+    a_planes->info = info ;
+    a_planes->width = a_xv_image->width ;
+    a_planes->height = a_xv_image->height ;
+    switch (info->layout) {
+        case YUV_LAYOUT_PLANAR:
+            RETURN_VAL_IF_FAIL (a_xv_image->num_planes == 3, FALSE) ;
+            a_planes->y = data + a_xv_image->offsets[0] ;
+            a_planes->y_pitch = a_xv_image->pitches[0] ;
+            a_planes->uv_pitch = a_xv_image->pitches[1] ;
+            first = data + a_xv_image->offsets[1] ;
+            second = data + a_xv_image->offsets[2] ;
+            break ;
+        case YUV_LAYOUT_SEMI_PLANAR:
+            RETURN_VAL_IF_FAIL (a_xv_image->num_planes == 2, FALSE) ;
+            a_planes->y = data + a_xv_image->offsets[0] ;
+            a_planes->y_pitch = a_xv_image->pitches[0] ;
+            a_planes->uv_pitch = a_xv_image->pitches[1] ;
+            first = data + a_xv_image->offsets[1] ;
+            second = first + 1 ;
+            break ;
+        case YUV_LAYOUT_PACKED:
+            data += a_xv_image->offsets[0] ;
+            a_planes->packed = data ;
+            a_planes->y_pitch = a_xv_image->pitches[0] ;
+            a_planes->uv_pitch = a_xv_image->pitches[0] ;
+            if (a_format == YUV_FORMAT_UYVY) {
+                a_planes->y = data + 1 ;
+                first = data ;
+            } else {
+                a_planes->y = data ;
+                first = data + 1 ;
+            }
+            second = first + 2 ;
+            break ;
+    }
+    a_planes->u = info->vu ? second : first ;
+    a_planes->v = info->vu ? first : second ;
+    return TRUE ;
+}
+
+static void
+deinterleave_row_scalar (const unsigned char *a_src,
+                         unsigned char *a_first,
+                         unsigned char *a_second,
+                         unsigned a_nb)
+{
+    unsigned i=0 ;
+
+    for (i=0 ; i < a_nb ; i++) {
+        a_first[i] = a_src[2 * i] ;
+        a_second[i] = a_src[2 * i + 1] ;
+    }
+}
+
+static void
+interleave_row_scalar (const unsigned char *a_first,
+                       const unsigned char *a_second,
+                       unsigned char *a_dst,
+                       unsigned a_nb)
+{
+    unsigned i=0 ;
+
+    for (i=0 ; i < a_nb ; i++) {
+        a_dst[2 * i] = a_first[i] ;
+        a_dst[2 * i + 1] = a_second[i] ;
+    }
+}
+
+static void
+pack_422_row_scalar (const unsigned char *a_y,
+                     const unsigned char *a_u,
+                     const unsigned char *a_v,
+                     unsigned char *a_dst,
+                     unsigned a_width,
+                     enum bool_t a_uyvy)
+{
+    unsigned x=0 ;
+    int y_pos=0, c_pos=1 ;
+
+    if (a_uyvy) {
+        y_pos = 1 ;
+        c_pos = 0 ;
+    }
+    for (x=0 ; x + 1 < a_width ; x += 2) {
+        a_dst[y_pos] = a_y[x] ;
+        a_dst[c_pos] = a_u[x / 2] ;
+        a_dst[y_pos + 2] = a_y[x + 1] ;
+        a_dst[c_pos + 2] = a_v[x / 2] ;
+        a_dst += 4 ;
+    }
+}
+
+static void
+unpack_422_row_scalar (const unsigned char *a_src,
+                       unsigned char *a_y,
+                       unsigned char *a_u,
+                       unsigned char *a_v,
+                       unsigned a_width,
+                       enum bool_t a_uyvy)
+{
+    unsigned x=0 ;
+    int y_pos=0, c_pos=1 ;
+
+    if (a_uyvy) {
+        y_pos = 1 ;
+        c_pos = 0 ;
+    }
+    for (x=0 ; x + 1 < a_width ; x += 2) {
+        a_y[x] = a_src[y_pos] ;
+        a_u[x / 2] = a_src[c_pos] ;
+        a_y[x + 1] = a_src[y_pos + 2] ;
+        a_v[x / 2] = a_src[c_pos + 2] ;
+        a_src += 4 ;
+    }
+}
+
+static const struct yuv_row_funcs_t yuv_row_funcs_scalar = {
+    "scalar",
+    deinterleave_row_scalar,
+    interleave_row_scalar,
+    pack_422_row_scalar,
+    unpack_422_row_scalar
+};
+
+#ifdef HAVE_X86_SIMD
+
+/*16 pairs per iteration*/
+__attribute__ ((target ("sse2")))
+static void
+deinterleave_row_sse2 (const unsigned char *a_src,
+                       unsigned char *a_first,
+                       unsigned char *a_second,
+                       unsigned a_nb)
+{
+    const __m128i low_bytes = _mm_set1_epi16 (0xff) ;
+    unsigned i=0, n=a_nb & ~15u ;
+
+    for (i=0 ; i < n ; i += 16) {
+        __m128i s0 = _mm_loadu_si128 ((const __m128i*)(a_src + 2 * i)) ;
+        __m128i s1 = _mm_loadu_si128 ((const __m128i*)(a_src + 2 * i + 16)) ;
+
+        _mm_storeu_si128 ((__m128i*)(a_first + i),
+                          _mm_packus_epi16 (_mm_and_si128 (s0, low_bytes),
+                                            _mm_and_si128 (s1, low_bytes))) ;
+        _mm_storeu_si128 ((__m128i*)(a_second + i),
+                          _mm_packus_epi16 (_mm_srli_epi16 (s0, 8),
+                                            _mm_srli_epi16 (s1, 8))) ;
+    }
+    deinterleave_row_scalar (a_src + 2 * n, a_first + n, a_second + n,
+                             a_nb - n) ;
+}
+
+/*16 pairs per iteration*/
+__attribute__ ((target ("sse2")))
+static void
+interleave_row_sse2 (const unsigned char *a_first,
+                     const unsigned char *a_second,
+                     unsigned char *a_dst,
+                     unsigned a_nb)
+{
+    unsigned i=0, n=a_nb & ~15u ;
+
+    for (i=0 ; i < n ; i += 16) {
+        __m128i a = _mm_loadu_si128 ((const __m128i*)(a_first + i)) ;
+        __m128i b = _mm_loadu_si128 ((const __m128i*)(a_second + i)) ;
+
+        _mm_storeu_si128 ((__m128i*)(a_dst + 2 * i),
+                          _mm_unpacklo_epi8 (a, b)) ;
+        _mm_storeu_si128 ((__m128i*)(a_dst + 2 * i + 16),
+                          _mm_unpackhi_epi8 (a, b)) ;
+    }
+    interleave_row_scalar (a_first + n, a_second + n, a_dst + 2 * n,
+                           a_nb - n) ;
+}
+
+/*16 pixels per iteration*/
+__attribute__ ((target ("sse2")))
+static void
+pack_422_row_sse2 (const unsigned char *a_y,
+                   const unsigned char *a_u,
+                   const unsigned char *a_v,
+                   unsigned char *a_dst,
+                   unsigned a_width,
+                   enum bool_t a_uyvy)
+{
+    unsigned x=0, n=a_width & ~15u ;
+
+    for (x=0 ; x < n ; x += 16) {
+        __m128i y = _mm_loadu_si128 ((const __m128i*)(a_y + x)) ;
+        __m128i u = _mm_loadl_epi64 ((const __m128i*)(a_u + x / 2)) ;
+        __m128i v = _mm_loadl_epi64 ((const __m128i*)(a_v + x / 2)) ;
+        __m128i uv = _mm_unpacklo_epi8 (u, v) ;
+        __m128i lo, hi ;
+
+        if (a_uyvy) {
+            lo = _mm_unpacklo_epi8 (uv, y) ;
+            hi = _mm_unpackhi_epi8 (uv, y) ;
+        } else {
+            lo = _mm_unpacklo_epi8 (y, uv) ;
+            hi = _mm_unpackhi_epi8 (y, uv) ;
+        }
+        _mm_storeu_si128 ((__m128i*)(a_dst + 2 * x), lo) ;
+        _mm_storeu_si128 ((__m128i*)(a_dst + 2 * x + 16), hi) ;
+    }
+    pack_422_row_scalar (a_y + n, a_u + n / 2, a_v + n / 2, a_dst + 2 * n,
+                         a_width - n, a_uyvy) ;
+}
+
+/*16 pixels per iteration*/
+__attribute__ ((target ("sse2")))
+static void
+unpack_422_row_sse2 (const unsigned char *a_src,
+                     unsigned char *a_y,
+                     unsigned char *a_u,
+                     unsigned char *a_v,
+                     unsigned a_width,
+                     enum bool_t a_uyvy)
+{
+    const __m128i low_bytes = _mm_set1_epi16 (0xff) ;
+    const __m128i zero = _mm_setzero_si128 () ;
+    unsigned x=0, n=a_width & ~15u ;
+
+    for (x=0 ; x < n ; x += 16) {
+        __m128i s0 = _mm_loadu_si128 ((const __m128i*)(a_src + 2 * x)) ;
+        __m128i s1 = _mm_loadu_si128 ((const __m128i*)(a_src + 2 * x + 16)) ;
+        __m128i even = _mm_packus_epi16 (_mm_and_si128 (s0, low_bytes),
+                                         _mm_and_si128 (s1, low_bytes)) ;
+        __m128i odd = _mm_packus_epi16 (_mm_srli_epi16 (s0, 8),
+                                        _mm_srli_epi16 (s1, 8)) ;
+        __m128i y = a_uyvy ? odd : even ;
+        __m128i uv = a_uyvy ? even : odd ;
+
+        _mm_storeu_si128 ((__m128i*)(a_y + x), y) ;
+        _mm_storel_epi64 ((__m128i*)(a_u + x / 2),
+                          _mm_packus_epi16 (_mm_and_si128 (uv, low_bytes),
+                                            zero)) ;
+        _mm_storel_epi64 ((__m128i*)(a_v + x / 2),
+                          _mm_packus_epi16 (_mm_srli_epi16 (uv, 8), zero)) ;
+    }
+    unpack_422_row_scalar (a_src + 2 * n, a_y + n, a_u + n / 2, a_v + n / 2,
+                           a_width - n, a_uyvy) ;
+}
+
+static const struct yuv_row_funcs_t yuv_row_funcs_sse2 = {
+    "SSE2",
+    deinterleave_row_sse2,
+    interleave_row_sse2,
+    pack_422_row_sse2,
+    unpack_422_row_sse2
+};
+
+#endif /*HAVE_X86_SIMD*/
+
+/**
+ * pick the fastest repacking rows the CPU supports,
+ * or the scalar ones if a_no_simd is set.
+ */
+const struct yuv_row_funcs_t*
+select_yuv_row_funcs (enum bool_t a_no_simd)
+{
+#ifdef HAVE_X86_SIMD
+    if (!a_no_simd) {
+        __builtin_cpu_init () ;
+        if (__builtin_cpu_supports ("sse2")) {
+            return &yuv_row_funcs_sse2 ;
+        }
+    }
+#endif
+    return &yuv_row_funcs_scalar ;
+}
+
+/*
+ * copy a_nb_rows rows of a_row_len bytes between planes which
+ * pitches may differ, in one go if neither is padded.
+ * memcpy already picks the widest vector moves the CPU has.
+ */
+static void
+copy_plane (unsigned char *a_dst,
+            unsigned a_dst_pitch,
+            const unsigned char *a_src,
+            unsigned a_src_pitch,
+            unsigned a_row_len,
+            unsigned a_nb_rows)
+{
+    unsigned row=0 ;
+
+    if (a_dst_pitch == a_row_len && a_src_pitch == a_row_len) {
+        memcpy (a_dst, a_src, (size_t)a_row_len * a_nb_rows) ;
+        return ;
+    }
+    for (row=0 ; row < a_nb_rows ; row++) {
+        memcpy (a_dst + row * a_dst_pitch,
+                a_src + row * a_src_pitch,
+                a_row_len) ;
+    }
+}
+
+/**
+ * copy the frame described by a_src into a_dst, which has the same
+ * format but may have other plane pitches and offsets.
+ */
+void
+copy_yuv_planes (const struct yuv_planes_t *a_src,
+                 const struct yuv_planes_t *a_dst)
+{
+    const struct yuv_format_info_t *info=NULL ;
+    unsigned width=0, height=0, chroma_height=0 ;
+
+    RETURN_IF_FAIL (a_src && a_dst && a_src->info == a_dst->info) ;
+
+    info = a_src->info ;
+    width = a_src->width < a_dst->width ? a_src->width : a_dst->width ;
+    height = a_src->height < a_dst->height ? a_src->height : a_dst->height ;
+    chroma_height = height >> info->chroma_y_shift ;
+    switch (info->layout) {
+        case YUV_LAYOUT_PLANAR:
+            copy_plane (a_dst->y, a_dst->y_pitch,
+                        a_src->y, a_src->y_pitch, width, height) ;
+            copy_plane (a_dst->u, a_dst->uv_pitch,
+                        a_src->u, a_src->uv_pitch, width / 2, chroma_height) ;
+            copy_plane (a_dst->v, a_dst->uv_pitch,
+                        a_src->v, a_src->uv_pitch, width / 2, chroma_height) ;
+            break ;
+        case YUV_LAYOUT_SEMI_PLANAR:
+            copy_plane (a_dst->y, a_dst->y_pitch,
+                        a_src->y, a_src->y_pitch, width, height) ;
+            copy_plane (info->vu ? a_dst->v : a_dst->u, a_dst->uv_pitch,
+                        info->vu ? a_src->v : a_src->u, a_src->uv_pitch,
+                        width, chroma_height) ;
+            break ;
+        case YUV_LAYOUT_PACKED:
+            copy_plane (a_dst->packed, a_dst->y_pitch,
+                        a_src->packed, a_src->y_pitch, 2 * width, height) ;
+            break ;
+    }
+}
+
+/**
+ * copy the frame described by a_src into a_dst, converting between
+ * their formats.
+ * Chroma lines are dropped or doubled when going between 4:2:0
+ * and 4:2:2.
+ * a_tmp must hold at least twice the width of a line, for lines
+ * which have to be unpacked first.
+ */
+void
+repack_yuv_frame (const struct yuv_planes_t *a_src,
+                  const struct yuv_planes_t *a_dst,
+                  const struct yuv_row_funcs_t *a_funcs,
+                  unsigned char *a_tmp)
+{
+    const struct yuv_format_info_t *src_info=NULL, *dst_info=NULL ;
+    unsigned width=0, height=0, line=0, src_line=0, dst_line=0 ;
+    unsigned char *tmp_y=NULL, *tmp_u=NULL, *tmp_v=NULL ;
+
+    RETURN_IF_FAIL (a_src && a_dst && a_funcs && a_tmp) ;
+
+    src_info = a_src->info ;
+    dst_info = a_dst->info ;
+    width = a_src->width < a_dst->width ? a_src->width : a_dst->width ;
+    height = a_src->height < a_dst->height ? a_src->height : a_dst->height ;
+    tmp_y = a_tmp ;
+    tmp_u = tmp_y + width ;
+    tmp_v = tmp_u + width / 2 ;
+
+    for (line=0 ; line < height ; line++) {
+        const unsigned char *y=NULL, *u=NULL, *v=NULL ;
+        enum bool_t needs_chroma=FALSE ;
+
+        /*the dst chroma line of this line, if it starts one*/
+        needs_chroma = dst_info->layout == YUV_LAYOUT_PACKED
+            || !(line & ((1 << dst_info->chroma_y_shift) - 1)) ;
+        src_line = line >> src_info->chroma_y_shift ;
+        dst_line = line >> dst_info->chroma_y_shift ;
+
+        /*get the Y, U and V samples of the line, unpacking them if need be*/
+        switch (src_info->layout) {
+            case YUV_LAYOUT_PLANAR:
+                y = a_src->y + line * a_src->y_pitch ;
+                u = a_src->u + src_line * a_src->uv_pitch ;
+                v = a_src->v + src_line * a_src->uv_pitch ;
+                break ;
+            case YUV_LAYOUT_SEMI_PLANAR:
+                y = a_src->y + line * a_src->y_pitch ;
+                if (needs_chroma) {
+                    const unsigned char *uv = src_info->vu ? a_src->v
+                                                           : a_src->u ;
+
+                    uv += src_line * a_src->uv_pitch ;
+                    if (src_info->vu) {
+                        a_funcs->deinterleave (uv, tmp_v, tmp_u, width / 2) ;
+                    } else {
+                        a_funcs->deinterleave (uv, tmp_u, tmp_v, width / 2) ;
+                    }
+                    u = tmp_u ;
+                    v = tmp_v ;
+                }
+                break ;
+            case YUV_LAYOUT_PACKED:
+                a_funcs->unpack_422 (a_src->packed + line * a_src->y_pitch,
+                                     tmp_y, tmp_u, tmp_v, width,
+                                     src_info->format == YUV_FORMAT_UYVY) ;
+                y = tmp_y ;
+                u = tmp_u ;
+                v = tmp_v ;
+                break ;
+        }
+
+        /*then write them the way a_dst wants them*/
+        switch (dst_info->layout) {
+            case YUV_LAYOUT_PLANAR:
+                memcpy (a_dst->y + line * a_dst->y_pitch, y, width) ;
+                if (needs_chroma) {
+                    memcpy (a_dst->u + dst_line * a_dst->uv_pitch,
+                            u, width / 2) ;
+                    memcpy (a_dst->v + dst_line * a_dst->uv_pitch,
+                            v, width / 2) ;
+                }
+                break ;
+            case YUV_LAYOUT_SEMI_PLANAR:
+                memcpy (a_dst->y + line * a_dst->y_pitch, y, width) ;
+                if (needs_chroma) {
+                    if (dst_info->vu) {
+                        a_funcs->interleave (v, u, a_dst->v
+                                             + dst_line * a_dst->uv_pitch,
+                                             width / 2) ;
+                    } else {
+                        a_funcs->interleave (u, v, a_dst->u
+                                             + dst_line * a_dst->uv_pitch,
+                                             width / 2) ;
+                    }
+                }
+                break ;
+            case YUV_LAYOUT_PACKED:
+                a_funcs->pack_422 (y, u, v,
+                                   a_dst->packed + line * a_dst->y_pitch,
+                                   width,
+                                   dst_info->format == YUV_FORMAT_UYVY) ;
+                break ;
+        }
+    }
+}
+
+/**
+ * pick among the image formats of a_xv_port the one frames
+ * of a_format are the cheapest to repack to.
+ */
+enum bool_t
+choose_xv_image_format (Display *a_display,
+                        XvPortID a_xv_port,
+                        enum yuv_format_t a_format,
+                        enum yuv_format_t *a_image_format)
+{
+    const struct yuv_format_info_t *info=NULL, *target=NULL ;
+    XvImageFormatValues *image_formats=NULL ;
+    int nb_formats=0, i=0, j=0 ;
+    enum bool_t is_ok=FALSE ;
+
+    RETURN_VAL_IF_FAIL (a_display && a_image_format, FALSE) ;
+
+    info = yuv_format_get_info (a_format) ;
+    RETURN_VAL_IF_FAIL (info, FALSE) ;
+
+    image_formats = XvListImageFormats (a_display, a_xv_port, &nb_formats) ;
+    if (!image_formats) {
+        goto out ;
+    }
+    for (i=0 ; i < YUV_NB_FORMATS && info->conversions[i] ; i++) {
+        target = yuv_format_get_info (info->conversions[i]) ;
+        for (j=0 ; j < nb_formats ; j++) {
+            if (image_formats[j].type == XvYUV
+                && image_formats[j].id == target->fourcc) {
+                *a_image_format = target->format ;
+                is_ok = TRUE ;
+                goto out ;
+            }
+        }
+    }
+
+out:
+    if (image_formats) {
+        XFree (image_formats) ;
+    }
+    return is_ok ;
+}
+
+/*************************
+ * </yuv repacking>
+ * ***********************/
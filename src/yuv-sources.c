@@ -0,0 +1,2589 @@
+/*
+ * Copyright (C) 2007 OpenedHand Ltd
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * Author:
+ *   Dodji Seketeli <dodji@openedhand.com>
+ */
+
+#include "xvplay-private.h"
+
+/*************************
+ * <yuv sources>
+ * ***********************/
+
+static enum bool_t
+yuv_source_init (struct yuv_source_t *a_source,
+                 const char *a_name,
+                 unsigned a_width,
+                 unsigned a_height,
+                 enum yuv_format_t a_format)
+{
+    RETURN_VAL_IF_FAIL (a_source, FALSE) ;
+
+    a_source->name = a_name ;
+    a_source->width = a_width ;
+    a_source->height = a_height ;
+    a_source->format = a_format ;
+    a_source->nb_file_frames = -1 ;
+    a_source->end_frame = -1 ;
+    a_source->nb_loops = 1 ;
+    if (!compute_yuv_image_size (a_format, a_width, a_height,
+                                 &a_source->frame_len)
+        || !a_source->frame_len) {
+        LOG_ERROR ("could not compute the size of a %dx%d frame\n",
+                   a_width, a_height) ;
+        return FALSE ;
+    }
+    return TRUE ;
+}
+
+/**
+ * parse the stream parameters of a y4m file, a_line being its
+ * first line without the ending newline, e.g.
+ * "YUV4MPEG2 W1280 H720 F30000:1001 Ip A1:1 C420jpeg".
+ * Only 4:2:0 and 4:2:2 chroma can be played.
+ */
+enum bool_t
+y4m_parse_header (const char *a_line, struct y4m_header_t *a_header)
+{
+    const char *p=NULL, *value=NULL ;
+    char chroma[32] ;
+    unsigned num=0, den=0 ;
+    size_t len=0 ;
+
+    RETURN_VAL_IF_FAIL (a_line && a_header, FALSE) ;
+
+    if (strncmp (a_line, Y4M_SIGNATURE, Y4M_SIGNATURE_LEN)) {
+        return FALSE ;
+    }
+    memset (a_header, 0, sizeof (struct y4m_header_t)) ;
+    a_header->interlacing = '?' ;
+    strcpy (chroma, "420jpeg") ;
+    for (p = a_line + Y4M_SIGNATURE_LEN ; *p ; p += len) {
+        if (*p == ' ') {
+            len = 1 ;
+            continue ;
+        }
+        len = strcspn (p, " ") ;
+        value = p + 1 ;
+        switch (*p) {
+            case 'W':
+                a_header->width = strtoul (value, NULL, 10) ;
+                break ;
+            case 'H':
+                a_header->height = strtoul (value, NULL, 10) ;
+                break ;
+            case 'F':
+                if (sscanf (value, "%u:%u", &num, &den) == 2 && num && den) {
+                    a_header->fps = (double)num / den ;
+                }
+                break ;
+            case 'I':
+                a_header->interlacing = *value ;
+                break ;
+            case 'C':
+                if (len - 1 >= sizeof (chroma)) {
+                    LOG_ERROR ("unknown y4m chroma: %.*s\n",
+                               (int)len - 1, value) ;
+                    return FALSE ;
+                }
+                memcpy (chroma, value, len - 1) ;
+                chroma[len - 1] = 0 ;
+                break ;
+            default:
+                /*aspect ratio and X extensions do not matter here*/
+                break ;
+        }
+    }
+    if (!strcmp (chroma, "420jpeg") || !strcmp (chroma, "420paldv")
+        || !strcmp (chroma, "420mpeg2") || !strcmp (chroma, "420")) {
+        /*the chroma siting differs, not the layout*/
+        a_header->format = YUV_FORMAT_420_PLANAR ;
+    } else if (!strcmp (chroma, "422")) {
+        a_header->format = YUV_FORMAT_422_PLANAR ;
+    } else {
+        LOG_ERROR ("unsupported y4m chroma: %s\n", chroma) ;
+        return FALSE ;
+    }
+    if (!a_header->width || !a_header->height) {
+        LOG_ERROR ("y4m header without frame size\n") ;
+        return FALSE ;
+    }
+    return TRUE ;
+}
+
+/*tells whether a_line, without its newline, is a y4m frame marker*/
+static enum bool_t
+y4m_is_frame_marker (const char *a_line, unsigned a_len)
+{
+    return a_len >= 5 && !strncmp (a_line, "FRAME", 5)
+           && (a_len == 5 || a_line[5] == ' ') ;
+}
+
+/**
+ * set up a_source for the frames of a y4m file, which header
+ * line is a_header_len bytes long with its newline.
+ * The size and format in the header win over the ones given on the
+ * command line.
+ */
+static enum bool_t
+yuv_source_init_y4m (struct yuv_source_t *a_source,
+                     const char *a_name,
+                     const char *a_header,
+                     unsigned a_header_len)
+{
+    struct y4m_header_t header ;
+    const char *interlacing = "progressive" ;
+
+    RETURN_VAL_IF_FAIL (a_source && a_header, FALSE) ;
+
+    if (!y4m_parse_header (a_header, &header)
+        || !yuv_source_init (a_source, a_name, header.width, header.height,
+                             header.format)) {
+        LOG_ERROR ("bad y4m header: %s\n", a_header) ;
+        return FALSE ;
+    }
+    a_source->data_offset = a_header_len ;
+    a_source->has_frame_markers = TRUE ;
+    a_source->fps = header.fps ;
+    switch (header.interlacing) {
+        case 't': interlacing = "interlaced, top field first" ; break ;
+        case 'b': interlacing = "interlaced, bottom field first" ; break ;
+        case 'm': interlacing = "mixed interlacing" ; break ;
+        default: break ;
+    }
+    /*fields are shown woven, as they are stored*/
+    LOG ("y4m input: %ux%u %s at %.3f fps, %s\n",
+         header.width, header.height,
+         yuv_format_get_info (header.format)->name, header.fps,
+         interlacing) ;
+    return TRUE ;
+}
+
+/*where frame a_frame of the file starts, including its header*/
+static off_t
+yuv_source_get_frame_offset (struct yuv_source_t *a_source, int a_frame)
+{
+    return a_source->data_offset
+           + (off_t)a_frame * (a_source->frame_header_len
+                               + a_source->frame_len) ;
+}
+
+/**
+ * find the frames of a y4m file which first a_head_len bytes are at
+ * a_head, or take them for a_width x a_height raw frames of a_format.
+ * a_head must hold the y4m header and the first frame marker.
+ */
+static enum bool_t
+yuv_source_init_layout (struct yuv_source_t *a_source,
+                        const char *a_name,
+                        const char *a_head,
+                        off_t a_head_len,
+                        off_t a_file_len,
+                        unsigned a_width,
+                        unsigned a_height,
+                        enum yuv_format_t a_format)
+{
+    char line[Y4M_MAX_LINE_LEN] ;
+    const char *end=NULL ;
+    off_t max=0 ;
+
+    if (a_head_len < Y4M_SIGNATURE_LEN
+        || memcmp (a_head, Y4M_SIGNATURE, Y4M_SIGNATURE_LEN)) {
+        if (!yuv_source_init (a_source, a_name,
+                              a_width, a_height, a_format)) {
+            return FALSE ;
+        }
+        a_source->nb_file_frames = a_file_len / a_source->frame_len ;
+        return TRUE ;
+    }
+    max = a_head_len < Y4M_MAX_LINE_LEN ? a_head_len : Y4M_MAX_LINE_LEN ;
+    end = memchr (a_head, '\n', max) ;
+    if (!end) {
+        LOG_ERROR ("no end to the y4m header\n") ;
+        return FALSE ;
+    }
+    memcpy (line, a_head, end - a_head) ;
+    line[end - a_head] = 0 ;
+    if (!yuv_source_init_y4m (a_source, a_name, line, end - a_head + 1)) {
+        return FALSE ;
+    }
+    /*the first marker tells how long they all are*/
+    max = a_head_len - a_source->data_offset ;
+    if (max > Y4M_MAX_LINE_LEN) {
+        max = Y4M_MAX_LINE_LEN ;
+    }
+    end = memchr (a_head + a_source->data_offset, '\n', max) ;
+    if (!end || !y4m_is_frame_marker (a_head + a_source->data_offset,
+                                      end - a_head - a_source->data_offset)) {
+        LOG_ERROR ("no y4m frame marker after the header\n") ;
+        return FALSE ;
+    }
+    a_source->frame_header_len = end - a_head - a_source->data_offset + 1 ;
+    a_source->nb_file_frames = (a_file_len - a_source->data_offset)
+                               / (a_source->frame_header_len
+                                  + a_source->frame_len) ;
+    return TRUE ;
+}
+
+/**
+ * play the frames from a_start_frame up to, but not including,
+ * a_end_frame, a_nb_loops times, or for ever if a_nb_loops is 0.
+ * a_end_frame is -1 for the end of the file.
+ * Unless the size of the file is known, its frames can only be
+ * played once, forwards, from the first one.
+ */
+enum bool_t
+yuv_source_set_range (struct yuv_source_t *a_source,
+                      int a_start_frame,
+                      int a_end_frame,
+                      int a_nb_loops,
+                      enum bool_t a_reverse)
+{
+    RETURN_VAL_IF_FAIL (a_source && a_start_frame >= 0 && a_nb_loops >= 0,
+                        FALSE) ;
+
+    if (a_source->nb_file_frames < 0) {
+        if (a_start_frame || a_nb_loops != 1 || a_reverse) {
+            LOG_ERROR ("the input can only be played once from the start\n") ;
+            return FALSE ;
+        }
+    } else if (a_end_frame < 0 || a_end_frame > a_source->nb_file_frames) {
+        a_end_frame = a_source->nb_file_frames ;
+    }
+    if (a_end_frame >= 0 && a_start_frame >= a_end_frame) {
+        LOG_ERROR ("no frame to play from frame %d to frame %d,"
+                   " the file has %d\n",
+                   a_start_frame, a_end_frame, a_source->nb_file_frames) ;
+        return FALSE ;
+    }
+    a_source->start_frame = a_start_frame ;
+    a_source->end_frame = a_end_frame ;
+    a_source->nb_loops = a_nb_loops ;
+    a_source->reverse = a_reverse ;
+    if (a_source->range_changed) {
+        a_source->range_changed (a_source) ;
+    }
+    return TRUE ;
+}
+
+/**
+ * the nb of frames a_source plays in all, 0 if there is no telling,
+ * e.g. when looping for ever.
+ */
+int
+yuv_source_get_nb_frames (struct yuv_source_t *a_source)
+{
+    int64_t nb=0 ;
+
+    RETURN_VAL_IF_FAIL (a_source, 0) ;
+
+    if (a_source->end_frame < 0 || !a_source->nb_loops) {
+        return 0 ;
+    }
+    nb = (int64_t)(a_source->end_frame - a_source->start_frame)
+         * a_source->nb_loops ;
+    return nb > INT_MAX ? 0 : (int)nb ;
+}
+
+/**
+ * the frame of the file played at a_index,
+ * or -1 if a_index is past the end of the playback.
+ */
+int
+yuv_source_get_file_frame (struct yuv_source_t *a_source, int a_index)
+{
+    int nb=0, pos=0 ;
+
+    RETURN_VAL_IF_FAIL (a_source, -1) ;
+
+    if (a_index < 0) {
+        return -1 ;
+    }
+    if (a_source->end_frame < 0) {
+        /*the read past the end of the file tells*/
+        return a_source->start_frame + a_index ;
+    }
+    nb = a_source->end_frame - a_source->start_frame ;
+    if (a_source->nb_loops
+        && (int64_t)a_index >= (int64_t)nb * a_source->nb_loops) {
+        return -1 ;
+    }
+    pos = a_index % nb ;
+    if (a_source->reverse) {
+        return a_source->end_frame - 1 - pos ;
+    }
+    return a_source->start_frame + pos ;
+}
+
+/**
+ * the frame of the input played at a_index, which is the frame of
+ * the file but for sources playing the frames of another source,
+ * e.g. preloaded. -1 if a_index is past the end of the playback.
+ * That is what frames are told apart by, whichever way they are
+ * played, e.g. by --verify.
+ */
+int
+yuv_source_get_input_frame (struct yuv_source_t *a_source, int a_index)
+{
+    int frame=0 ;
+
+    RETURN_VAL_IF_FAIL (a_source, -1) ;
+
+    frame = yuv_source_get_file_frame (a_source, a_index) ;
+    if (frame >= 0 && a_source->get_input_frame) {
+        frame = a_source->get_input_frame (a_source, frame) ;
+    }
+    return frame ;
+}
+
+/**
+ * the frames of the file played in the a_max frames after a_index,
+ * up to the first one which is not next to the others in the file,
+ * e.g. when looping back. Reading ahead in playback order keeps the
+ * file cache warm whichever way the frames are played.
+ * returns the nb of frames, the first of which in the file is
+ * *a_first.
+ */
+int
+yuv_source_get_frames_ahead (struct yuv_source_t *a_source,
+                             int a_index,
+                             int a_max,
+                             int *a_first)
+{
+    int low=0, high=0, frame=0, i=0 ;
+
+    RETURN_VAL_IF_FAIL (a_source && a_first, 0) ;
+
+    low = high = yuv_source_get_file_frame (a_source, a_index + 1) ;
+    if (low < 0) {
+        return 0 ;
+    }
+    for (i=2 ; i <= a_max ; i++) {
+        frame = yuv_source_get_file_frame (a_source, a_index + i) ;
+        if (frame >= 0 && frame == high + 1) {
+            high = frame ;
+        } else if (frame >= 0 && frame == low - 1) {
+            low = frame ;
+        } else {
+            break ;
+        }
+    }
+    *a_first = low ;
+    return high - low + 1 ;
+}
+
+void
+yuv_source_destroy (struct yuv_source_t *a_source)
+{
+    RETURN_IF_FAIL (a_source) ;
+
+    if (a_source->destroy) {
+        a_source->destroy (a_source) ;
+    }
+    free (a_source) ;
+}
+
+/**
+ * read a line of a_file, with its newline, into a_buf which is
+ * a_size bytes long. The line is NUL terminated in place of the
+ * newline, *a_len still counting it.
+ */
+static enum bool_t
+read_line (FILE *a_file, char *a_buf, unsigned a_size, unsigned *a_len)
+{
+    unsigned len=0 ;
+    int c=0 ;
+
+    while ((c = getc (a_file)) != EOF) {
+        if (c == '\n') {
+            a_buf[len] = 0 ;
+            *a_len = len + 1 ;
+            return TRUE ;
+        }
+        if (len + 1 >= a_size) {
+            LOG_ERROR ("line longer than %u bytes\n", a_size) ;
+            return FALSE ;
+        }
+        a_buf[len++] = c ;
+    }
+    return FALSE ;
+}
+
+static enum bool_t
+stdio_source_read_frame (struct yuv_source_t *a_this,
+                         struct frame_t *a_frame)
+{
+    struct stdio_source_t *source = (struct stdio_source_t*)a_this ;
+    int frame=0, first=0, nb=0 ;
+
+    RETURN_VAL_IF_FAIL (source && a_frame, FALSE) ;
+
+    frame = yuv_source_get_file_frame (a_this, a_this->next_frame) ;
+    if (frame < 0) {
+        LOG ("end of the frames to play\n") ;
+        return FALSE ;
+    }
+    /*going on forwards needs no seek, and works on any file*/
+    if (frame != source->file_frame
+        && fseeko (source->file, yuv_source_get_frame_offset (a_this, frame),
+                   SEEK_SET)) {
+        LOG_ERROR ("failed to seek to frame %d: %s\n",
+                   frame, strerror (errno)) ;
+        source->file_frame = -1 ;
+        return FALSE ;
+    }
+    source->file_frame = -1 ;
+    nb = yuv_source_get_frames_ahead (a_this, a_this->next_frame,
+                                      READAHEAD_FRAMES, &first) ;
+    if (nb > 0) {
+        posix_fadvise (fileno (source->file),
+                       yuv_source_get_frame_offset (a_this, first),
+                       yuv_source_get_frame_offset (a_this, first + nb)
+                       - yuv_source_get_frame_offset (a_this, first),
+                       POSIX_FADV_WILLNEED) ;
+    }
+    if (a_this->has_frame_markers) {
+        char line[Y4M_MAX_LINE_LEN] ;
+        unsigned len=0 ;
+
+        if (!read_line (source->file, line, sizeof (line), &len)) {
+            LOG ("end of file\n") ;
+            return FALSE ;
+        }
+        if (!y4m_is_frame_marker (line, len - 1)) {
+            /*seeking assumes all the markers are alike*/
+            LOG_ERROR ("no y4m frame marker for frame %d\n", frame) ;
+            return FALSE ;
+        }
+    }
+    if (!read_next_yuv_image_of_size_and_format (source->file,
+                                                 a_this->width,
+                                                 a_this->height,
+                                                 a_this->format,
+                                                 a_frame)) {
+        return FALSE ;
+    }
+    source->file_frame = frame + 1 ;
+    a_frame->index = a_this->next_frame++ ;
+    return TRUE ;
+}
+
+/*the next read seeks to whichever frame comes then*/
+static enum bool_t
+stdio_source_skip_frames (struct yuv_source_t *a_this, int a_nb)
+{
+    RETURN_VAL_IF_FAIL (a_this && a_nb >= 0, FALSE) ;
+
+    a_this->next_frame += a_nb ;
+    return TRUE ;
+}
+
+/*the kernel only reads ahead by itself when going forwards*/
+static void
+stdio_source_range_changed (struct yuv_source_t *a_this)
+{
+    struct stdio_source_t *source = (struct stdio_source_t*)a_this ;
+
+    posix_fadvise (fileno (source->file), 0, 0,
+                   a_this->reverse ? POSIX_FADV_RANDOM
+                                   : POSIX_FADV_NORMAL) ;
+}
+
+static void
+stdio_source_destroy (struct yuv_source_t *a_this)
+{
+    struct stdio_source_t *source = (struct stdio_source_t*)a_this ;
+
+    if (source->file) {
+        fclose (source->file) ;
+        source->file = NULL ;
+    }
+}
+
+/**
+ * a source reading frames of a regular file with fread().
+ * y4m files tell their frame size and format, otherwise the frames
+ * are a_width x a_height raw frames of a_format.
+ */
+struct yuv_source_t*
+stdio_source_new (const char *a_path,
+                  unsigned a_width,
+                  unsigned a_height,
+                  enum yuv_format_t a_format)
+{
+    struct stdio_source_t *source=NULL ;
+    struct yuv_source_t *base=NULL ;
+    struct stat st ;
+    char line[Y4M_MAX_LINE_LEN] ;
+    unsigned len=0 ;
+
+    RETURN_VAL_IF_FAIL (a_path, NULL) ;
+
+    source = calloc (1, sizeof (struct stdio_source_t)) ;
+    if (!source) {
+        return NULL ;
+    }
+    base = &source->base ;
+    base->read_frame = stdio_source_read_frame ;
+    base->skip_frames = stdio_source_skip_frames ;
+    base->range_changed = stdio_source_range_changed ;
+    base->destroy = stdio_source_destroy ;
+    source->file = fopen (a_path, "r") ;
+    if (!source->file) {
+        LOG_ERROR ("could not open '%s': %s\n", a_path, strerror (errno)) ;
+        goto error ;
+    }
+    if (fstat (fileno (source->file), &st) || !S_ISREG (st.st_mode)) {
+        LOG_ERROR ("'%s' is not a regular file\n", a_path) ;
+        goto error ;
+    }
+
+    if (fread (line, 1, Y4M_SIGNATURE_LEN, source->file) == Y4M_SIGNATURE_LEN
+        && !memcmp (line, Y4M_SIGNATURE, Y4M_SIGNATURE_LEN)) {
+        if (!read_line (source->file, line + Y4M_SIGNATURE_LEN,
+                        sizeof (line) - Y4M_SIGNATURE_LEN, &len)
+            || !yuv_source_init_y4m (base, "stdio", line,
+                                     Y4M_SIGNATURE_LEN + len)) {
+            goto error ;
+        }
+        /*seeking needs the length of the frame markers*/
+        if (!read_line (source->file, line, sizeof (line), &len)
+            || !y4m_is_frame_marker (line, len - 1)) {
+            LOG_ERROR ("no frame in '%s'\n", a_path) ;
+            goto error ;
+        }
+        base->frame_header_len = len ;
+    } else if (!yuv_source_init (base, "stdio",
+                                 a_width, a_height, a_format)) {
+        goto error ;
+    }
+    if (fseeko (source->file, base->data_offset, SEEK_SET)) {
+        LOG_ERROR ("could not seek in '%s': %s\n", a_path, strerror (errno)) ;
+        goto error ;
+    }
+    base->nb_file_frames = (st.st_size - base->data_offset)
+                           / (base->frame_header_len + base->frame_len) ;
+    return &source->base ;
+
+error:
+    yuv_source_destroy (&source->base) ;
+    return NULL ;
+}
+
+/**
+ * give back the pages of the mapping that are well behind a_offset,
+ * so that playing a clip larger than RAM never keeps it all resident.
+ */
+static void
+mmap_source_release_behind (struct mmap_source_t *a_source, off_t a_offset)
+{
+    off_t end=0, start=0, kept=0 ;
+    long page_size = sysconf (_SC_PAGESIZE) ;
+
+    if (a_source->base.nb_loops != 1) {
+        /*the frames behind come back at the next loop*/
+        return ;
+    }
+    kept = MMAP_RELEASE_CHUNK
+         + (off_t)a_source->base.nb_frames_in_use * a_source->base.frame_len ;
+    if (a_source->base.reverse) {
+        start = a_offset + a_source->base.frame_len + kept ;
+        if (a_source->released_from - start < MMAP_RELEASE_CHUNK) {
+            return ;
+        }
+        start = (start + page_size - 1) & ~((off_t)page_size - 1) ;
+        madvise (a_source->map + start,
+                 a_source->released_from - start, MADV_DONTNEED) ;
+        posix_fadvise (a_source->fd, start,
+                       a_source->released_from - start, POSIX_FADV_DONTNEED) ;
+        a_source->released_from = start ;
+        return ;
+    }
+    end = a_offset - kept ;
+    if (end - a_source->released_len < MMAP_RELEASE_CHUNK) {
+        return ;
+    }
+    end &= ~((off_t)page_size - 1) ;
+    madvise (a_source->map + a_source->released_len,
+             end - a_source->released_len, MADV_DONTNEED) ;
+    posix_fadvise (a_source->fd, a_source->released_len,
+                   end - a_source->released_len, POSIX_FADV_DONTNEED) ;
+    a_source->released_len = end ;
+}
+
+static enum bool_t
+mmap_source_read_frame (struct yuv_source_t *a_this,
+                        struct frame_t *a_frame)
+{
+    struct mmap_source_t *source = (struct mmap_source_t*)a_this ;
+    off_t offset=0, ahead=0, ahead_end=0 ;
+    long page_size = sysconf (_SC_PAGESIZE) ;
+    int frame=0, first=0, nb=0 ;
+
+    RETURN_VAL_IF_FAIL (source && a_frame, FALSE) ;
+
+    frame = yuv_source_get_file_frame (a_this, a_this->next_frame) ;
+    if (frame < 0) {
+        LOG ("end of the frames to play\n") ;
+        return FALSE ;
+    }
+    offset = yuv_source_get_frame_offset (a_this, frame) ;
+    if (offset + a_this->frame_header_len + a_this->frame_len
+        > source->map_len) {
+        LOG ("end of file\n") ;
+        return FALSE ;
+    }
+    if (a_this->has_frame_markers) {
+        /*all the markers must be alike to find the frames*/
+        if (!y4m_is_frame_marker (source->map + offset,
+                                  a_this->frame_header_len - 1)
+            || source->map[offset + a_this->frame_header_len - 1] != '\n') {
+            LOG_ERROR ("no y4m frame marker for frame %d\n", frame) ;
+            return FALSE ;
+        }
+        offset += a_this->frame_header_len ;
+    }
+
+    /*have the kernel bring the next frames in while we use this one*/
+    nb = yuv_source_get_frames_ahead (a_this, a_this->next_frame,
+                                      READAHEAD_FRAMES, &first) ;
+    if (nb > 0) {
+        ahead = yuv_source_get_frame_offset (a_this, first)
+                & ~((off_t)page_size - 1) ;
+        ahead_end = yuv_source_get_frame_offset (a_this, first + nb) ;
+        if (ahead_end > source->map_len) {
+            ahead_end = source->map_len ;
+        }
+        madvise (source->map + ahead, ahead_end - ahead, MADV_WILLNEED) ;
+    }
+
+    if (a_this->zero_copy) {
+        a_frame->data = source->map + offset ;
+    } else {
+        if (a_this->frame_len > a_frame->capacity) {
+            LOG_ERROR ("frame buffer of %d bytes can't hold %d bytes\n",
+                       a_frame->capacity, a_this->frame_len) ;
+            return FALSE ;
+        }
+        memcpy (a_frame->buf, source->map + offset, a_this->frame_len) ;
+        a_frame->data = a_frame->buf ;
+    }
+    a_frame->len = a_this->frame_len ;
+    a_frame->index = a_this->next_frame++ ;
+
+    mmap_source_release_behind (source, offset) ;
+    return TRUE ;
+}
+
+static enum bool_t
+mmap_source_skip_frames (struct yuv_source_t *a_this, int a_nb)
+{
+    RETURN_VAL_IF_FAIL (a_this && a_nb >= 0, FALSE) ;
+
+    a_this->next_frame += a_nb ;
+    return TRUE ;
+}
+
+/*
+ * MADV_SEQUENTIAL reads ahead forwards on faults, and frees the pages
+ * behind. Either is wasted when playing in reverse or looping.
+ */
+static void
+mmap_source_range_changed (struct yuv_source_t *a_this)
+{
+    struct mmap_source_t *source = (struct mmap_source_t*)a_this ;
+    int advice=MADV_SEQUENTIAL, fadvice=POSIX_FADV_SEQUENTIAL ;
+
+    if (a_this->reverse) {
+        advice = MADV_RANDOM ;
+        fadvice = POSIX_FADV_RANDOM ;
+    } else if (a_this->nb_loops != 1) {
+        advice = MADV_NORMAL ;
+        fadvice = POSIX_FADV_NORMAL ;
+    }
+    madvise (source->map, source->map_len, advice) ;
+    posix_fadvise (source->fd, 0, 0, fadvice) ;
+}
+
+static void
+mmap_source_destroy (struct yuv_source_t *a_this)
+{
+    struct mmap_source_t *source = (struct mmap_source_t*)a_this ;
+
+    if (source->map) {
+        munmap (source->map, source->map_len) ;
+        source->map = NULL ;
+    }
+    if (source->fd >= 0) {
+        close (source->fd) ;
+        source->fd = -1 ;
+    }
+}
+
+/**
+ * a source mapping the whole yuv file.
+ * When the consumer sets zero_copy, frames point right into the
+ * mapping, otherwise they are copied from it into the frame buffer.
+ */
+struct yuv_source_t*
+mmap_source_new (const char *a_path,
+                 unsigned a_width,
+                 unsigned a_height,
+                 enum yuv_format_t a_format)
+{
+    struct mmap_source_t *source=NULL ;
+    struct stat st ;
+    void *map=NULL ;
+
+    RETURN_VAL_IF_FAIL (a_path, NULL) ;
+
+    source = calloc (1, sizeof (struct mmap_source_t)) ;
+    if (!source) {
+        return NULL ;
+    }
+    source->fd = -1 ;
+    source->base.read_frame = mmap_source_read_frame ;
+    source->base.skip_frames = mmap_source_skip_frames ;
+    source->base.range_changed = mmap_source_range_changed ;
+    source->base.destroy = mmap_source_destroy ;
+    source->fd = open (a_path, O_RDONLY) ;
+    if (source->fd < 0) {
+        LOG_ERROR ("could not open '%s': %s\n", a_path, strerror (errno)) ;
+        goto error ;
+    }
+    if (fstat (source->fd, &st) || st.st_size <= 0) {
+        LOG_ERROR ("could not get the size of '%s'\n", a_path) ;
+        goto error ;
+    }
+    map = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, source->fd, 0) ;
+    if (map == MAP_FAILED) {
+        LOG_ERROR ("could not map '%s': %s\n", a_path, strerror (errno)) ;
+        goto error ;
+    }
+    source->map = map ;
+    source->map_len = st.st_size ;
+    source->released_from = st.st_size ;
+    if (!yuv_source_init_layout (&source->base, "mmap",
+                                 source->map, source->map_len,
+                                 source->map_len,
+                                 a_width, a_height, a_format)) {
+        LOG_ERROR ("could not find the frames of '%s'\n", a_path) ;
+        goto error ;
+    }
+    madvise (source->map, source->map_len, MADV_SEQUENTIAL) ;
+    posix_fadvise (source->fd, 0, 0, POSIX_FADV_SEQUENTIAL) ;
+    return &source->base ;
+
+error:
+    yuv_source_destroy (&source->base) ;
+    return NULL ;
+}
+
+/**
+ * read up to a_len bytes of the pipe into a_buf, timing how long
+ * the producer leaves us waiting for them.
+ * returns the nb of bytes read, 0 at the end of the input, -1 on
+ * errors.
+ */
+static ssize_t
+pipe_source_read_some (struct pipe_source_t *a_source,
+                       char *a_buf,
+                       size_t a_len)
+{
+    struct pollfd pfd ;
+    double start=0 ;
+    ssize_t nb=0 ;
+
+    if (a_source->is_drained) {
+        /*the pipe was empty, so whatever comes next is worth waiting for*/
+        pfd.fd = a_source->fd ;
+        pfd.events = POLLIN ;
+        pfd.revents = 0 ;
+        if (!poll (&pfd, 1, 0)) {
+            start = get_monotonic_time () ;
+            while (poll (&pfd, 1, -1) < 0 && errno == EINTR)
+                ;
+            a_source->wait_time += get_monotonic_time () - start ;
+            a_source->nb_waits++ ;
+        }
+    }
+    do {
+        nb = read (a_source->fd, a_buf, a_len) ;
+    } while (nb < 0 && errno == EINTR) ;
+    if (nb < 0) {
+        LOG_ERROR ("failed to read the input: %s\n", strerror (errno)) ;
+        return -1 ;
+    }
+    a_source->nb_reads++ ;
+    a_source->nb_bytes += nb ;
+    a_source->is_drained = (size_t)nb < a_len ;
+    return nb ;
+}
+
+/**
+ * read exactly a_len bytes into a_buf, or skip them if a_buf is NULL,
+ * going on after the short reads of a pipe the producer has not
+ * filled yet.
+ * returns the nb of bytes read, less than a_len at the end of the
+ * input.
+ */
+static size_t
+pipe_source_read_exact (struct pipe_source_t *a_source,
+                        char *a_buf,
+                        size_t a_len)
+{
+    size_t len=0, nb_read=0 ;
+    ssize_t nb=0 ;
+
+    /*the bytes read ahead with the frame marker come first*/
+    len = a_source->block_end - a_source->block_start ;
+    if (len > a_len) {
+        len = a_len ;
+    }
+    if (a_buf) {
+        memcpy (a_buf, a_source->block + a_source->block_start, len) ;
+        a_buf += len ;
+    }
+    a_source->block_start += len ;
+    nb_read = len ;
+    while (nb_read < a_len) {
+        len = a_len - nb_read ;
+        if (a_buf) {
+            nb = pipe_source_read_some (a_source, a_buf, len) ;
+        } else {
+            nb = pipe_source_read_some (a_source, a_source->block,
+                                        len < PIPE_READ_BLOCK
+                                        ? len : PIPE_READ_BLOCK) ;
+        }
+        if (nb <= 0) {
+            break ;
+        }
+        if (a_buf) {
+            a_buf += nb ;
+        }
+        nb_read += nb ;
+    }
+    return nb_read ;
+}
+
+/**
+ * read a line, e.g. a y4m header or frame marker, into a_line, which
+ * is a_size bytes long. The line is NUL terminated in place of the
+ * newline, *a_len still counting it.
+ */
+static enum bool_t
+pipe_source_read_line (struct pipe_source_t *a_source,
+                       char *a_line,
+                       unsigned a_size,
+                       unsigned *a_len)
+{
+    char *end=NULL ;
+    unsigned len=0 ;
+    ssize_t nb=0 ;
+
+    for (;;) {
+        len = a_source->block_end - a_source->block_start ;
+        end = memchr (a_source->block + a_source->block_start, '\n', len) ;
+        if (end) {
+            len = end - (a_source->block + a_source->block_start) ;
+            if (len >= a_size) {
+                break ;
+            }
+            memcpy (a_line, a_source->block + a_source->block_start, len) ;
+            a_line[len] = 0 ;
+            *a_len = len + 1 ;
+            a_source->block_start += len + 1 ;
+            return TRUE ;
+        }
+        if (len >= a_size) {
+            break ;
+        }
+        /*make room after what is left, then read some more*/
+        memmove (a_source->block, a_source->block + a_source->block_start,
+                 len) ;
+        a_source->block_start = 0 ;
+        a_source->block_end = len ;
+        nb = pipe_source_read_some (a_source, a_source->block + len,
+                                    PIPE_READ_BLOCK - len) ;
+        if (nb <= 0) {
+            return FALSE ;
+        }
+        a_source->block_end += nb ;
+    }
+    LOG_ERROR ("line longer than %u bytes\n", a_size) ;
+    return FALSE ;
+}
+
+/*read the frame marker of a y4m stream, if any*/
+static enum bool_t
+pipe_source_read_frame_header (struct pipe_source_t *a_source)
+{
+    char line[Y4M_MAX_LINE_LEN] ;
+    unsigned len=0 ;
+
+    if (!a_source->base.has_frame_markers) {
+        return TRUE ;
+    }
+    if (!pipe_source_read_line (a_source, line, sizeof (line), &len)) {
+        return FALSE ;
+    }
+    if (!y4m_is_frame_marker (line, len - 1)) {
+        LOG_ERROR ("no y4m frame marker for frame %d\n",
+                   a_source->base.next_frame) ;
+        return FALSE ;
+    }
+    return TRUE ;
+}
+
+static enum bool_t
+pipe_source_read_frame (struct yuv_source_t *a_this,
+                        struct frame_t *a_frame)
+{
+    struct pipe_source_t *source = (struct pipe_source_t*)a_this ;
+    unsigned long nb_reads=0 ;
+    size_t nb_read=0 ;
+
+    RETURN_VAL_IF_FAIL (source && a_frame, FALSE) ;
+
+    if (a_this->frame_len > a_frame->capacity) {
+        LOG_ERROR ("frame buffer of %d bytes can't hold %d bytes\n",
+                   a_frame->capacity, a_this->frame_len) ;
+        return FALSE ;
+    }
+    if (!pipe_source_read_frame_header (source)) {
+        LOG ("end of file\n") ;
+        return FALSE ;
+    }
+    nb_reads = source->nb_reads ;
+    nb_read = pipe_source_read_exact (source, a_frame->buf,
+                                      a_this->frame_len) ;
+    if (!nb_read && !a_this->has_frame_markers) {
+        LOG ("end of file\n") ;
+        return FALSE ;
+    }
+    if (nb_read < a_this->frame_len) {
+        LOG_ERROR ("the input ended within frame %d\n", a_this->next_frame) ;
+        return FALSE ;
+    }
+    if (source->nb_reads - nb_reads > 1) {
+        source->nb_split_frames++ ;
+    }
+    a_frame->data = a_frame->buf ;
+    a_frame->len = a_this->frame_len ;
+    a_frame->index = a_this->next_frame++ ;
+    return TRUE ;
+}
+
+/*there is no seeking in a pipe, the frames are read and thrown away*/
+static enum bool_t
+pipe_source_skip_frames (struct yuv_source_t *a_this, int a_nb)
+{
+    struct pipe_source_t *source = (struct pipe_source_t*)a_this ;
+    int i=0 ;
+
+    RETURN_VAL_IF_FAIL (source && a_nb >= 0, FALSE) ;
+
+    for (i=0 ; i < a_nb ; i++) {
+        if (!pipe_source_read_frame_header (source)
+            || pipe_source_read_exact (source, NULL, a_this->frame_len)
+               < a_this->frame_len) {
+            return FALSE ;
+        }
+        a_this->next_frame++ ;
+    }
+    return TRUE ;
+}
+
+static void
+pipe_source_dump_stats (struct yuv_source_t *a_this,
+                        double a_fps,
+                        FILE *a_out)
+{
+    struct pipe_source_t *source = (struct pipe_source_t*)a_this ;
+
+    if (!source->nb_reads) {
+        return ;
+    }
+    fprintf (a_out, "pipe: %lu reads of %lu bytes on average, "
+             "%lu frames split across reads\n",
+             source->nb_reads,
+             (unsigned long)(source->nb_bytes / source->nb_reads),
+             source->nb_split_frames) ;
+    fprintf (a_out, "pipe: waited %lu times for the producer, %.3fs in all\n",
+             source->nb_waits, source->wait_time) ;
+}
+
+static void
+pipe_source_destroy (struct yuv_source_t *a_this)
+{
+    struct pipe_source_t *source = (struct pipe_source_t*)a_this ;
+
+    if (source->owns_fd && source->fd >= 0) {
+        close (source->fd) ;
+    }
+    source->fd = -1 ;
+    free (source->block) ;
+    source->block = NULL ;
+}
+
+/**
+ * a source reading a_path, or stdin if a_path is "-", front to back.
+ * Unlike the other sources, it works on pipes, but can't seek.
+ * y4m streams tell their frame size and format, otherwise the frames
+ * are a_width x a_height raw frames of a_format.
+ */
+struct yuv_source_t*
+pipe_source_new (const char *a_path,
+                 unsigned a_width,
+                 unsigned a_height,
+                 enum yuv_format_t a_format)
+{
+    struct pipe_source_t *source=NULL ;
+    char line[Y4M_MAX_LINE_LEN] ;
+    unsigned len=0 ;
+    ssize_t nb=0 ;
+
+    RETURN_VAL_IF_FAIL (a_path, NULL) ;
+
+    source = calloc (1, sizeof (struct pipe_source_t)) ;
+    if (!source) {
+        return NULL ;
+    }
+    source->fd = -1 ;
+    source->is_drained = TRUE ;
+    source->base.read_frame = pipe_source_read_frame ;
+    source->base.skip_frames = pipe_source_skip_frames ;
+    source->base.dump_stats = pipe_source_dump_stats ;
+    source->base.destroy = pipe_source_destroy ;
+    source->block = malloc (PIPE_READ_BLOCK) ;
+    if (!source->block) {
+        goto error ;
+    }
+    if (!strcmp (a_path, "-")) {
+        source->fd = STDIN_FILENO ;
+    } else {
+        source->fd = open (a_path, O_RDONLY) ;
+        if (source->fd < 0) {
+            LOG_ERROR ("could not open '%s': %s\n",
+                       a_path, strerror (errno)) ;
+            goto error ;
+        }
+        source->owns_fd = TRUE ;
+    }
+#ifdef F_SETPIPE_SZ
+    /*fewer, larger reads, and more slack for a bursty producer*/
+    if (fcntl (source->fd, F_SETPIPE_SZ, PIPE_BUFFER_SIZE) < 0
+        && errno != EBADF) {
+        LOG ("could not grow the pipe buffer: %s\n", strerror (errno)) ;
+    }
+    nb = fcntl (source->fd, F_GETPIPE_SZ) ;
+    if (nb > 0) {
+        LOG ("pipe buffer: %ld bytes\n", (long)nb) ;
+    }
+#endif
+
+    /*enough bytes to tell a y4m stream*/
+    while (source->block_end < Y4M_SIGNATURE_LEN) {
+        nb = pipe_source_read_some (source,
+                                    source->block + source->block_end,
+                                    PIPE_READ_BLOCK - source->block_end) ;
+        if (nb <= 0) {
+            break ;
+        }
+        source->block_end += nb ;
+    }
+    if (source->block_end >= Y4M_SIGNATURE_LEN
+        && !memcmp (source->block, Y4M_SIGNATURE, Y4M_SIGNATURE_LEN)) {
+        if (!pipe_source_read_line (source, line, sizeof (line), &len)
+            || !yuv_source_init_y4m (&source->base, "pipe", line, len)) {
+            goto error ;
+        }
+    } else if (!yuv_source_init (&source->base, "pipe",
+                                 a_width, a_height, a_format)) {
+        goto error ;
+    }
+    return &source->base ;
+
+error:
+    yuv_source_destroy (&source->base) ;
+    return NULL ;
+}
+
+/*
+ * direct io
+ */
+
+#ifdef HAVE_IO_URING
+static void
+io_ring_finalize (struct io_ring_t *a_ring)
+{
+    if (a_ring->sqes) {
+        munmap (a_ring->sqes, a_ring->sqes_len) ;
+        a_ring->sqes = NULL ;
+    }
+    if (a_ring->cq_map) {
+        munmap (a_ring->cq_map, a_ring->cq_map_len) ;
+        a_ring->cq_map = NULL ;
+    }
+    if (a_ring->sq_map) {
+        munmap (a_ring->sq_map, a_ring->sq_map_len) ;
+        a_ring->sq_map = NULL ;
+    }
+    if (a_ring->fd >= 0) {
+        close (a_ring->fd) ;
+        a_ring->fd = -1 ;
+    }
+}
+
+static enum bool_t
+io_ring_init (struct io_ring_t *a_ring, unsigned a_nb_entries)
+{
+    struct io_uring_params params ;
+    char *sq=NULL, *cq=NULL ;
+
+    memset (a_ring, 0, sizeof (struct io_ring_t)) ;
+    memset (&params, 0, sizeof (params)) ;
+    a_ring->fd = syscall (__NR_io_uring_setup, a_nb_entries, &params) ;
+    if (a_ring->fd < 0) {
+        LOG ("no io_uring: %s\n", strerror (errno)) ;
+        return FALSE ;
+    }
+    a_ring->sq_map_len = params.sq_off.array
+                         + params.sq_entries * sizeof (unsigned) ;
+    a_ring->sq_map = mmap (NULL, a_ring->sq_map_len,
+                           PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE,
+                           a_ring->fd, IORING_OFF_SQ_RING) ;
+    a_ring->cq_map_len = params.cq_off.cqes
+                         + params.cq_entries * sizeof (struct io_uring_cqe) ;
+    a_ring->cq_map = mmap (NULL, a_ring->cq_map_len,
+                           PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE,
+                           a_ring->fd, IORING_OFF_CQ_RING) ;
+    a_ring->sqes_len = params.sq_entries * sizeof (struct io_uring_sqe) ;
+    a_ring->sqes = mmap (NULL, a_ring->sqes_len,
+                         PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE,
+                         a_ring->fd, IORING_OFF_SQES) ;
+    if (a_ring->sq_map == MAP_FAILED
+        || a_ring->cq_map == MAP_FAILED
+        || a_ring->sqes == MAP_FAILED) {
+        LOG_ERROR ("could not map the io_uring: %s\n", strerror (errno)) ;
+        goto error ;
+    }
+    sq = a_ring->sq_map ;
+    a_ring->sq_head = (unsigned*)(sq + params.sq_off.head) ;
+    a_ring->sq_tail = (unsigned*)(sq + params.sq_off.tail) ;
+    a_ring->sq_mask = (unsigned*)(sq + params.sq_off.ring_mask) ;
+    a_ring->sq_array = (unsigned*)(sq + params.sq_off.array) ;
+    cq = a_ring->cq_map ;
+    a_ring->cq_head = (unsigned*)(cq + params.cq_off.head) ;
+    a_ring->cq_tail = (unsigned*)(cq + params.cq_off.tail) ;
+    a_ring->cq_mask = (unsigned*)(cq + params.cq_off.ring_mask) ;
+    a_ring->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes) ;
+    return TRUE ;
+
+error:
+    if (a_ring->sq_map == MAP_FAILED) {
+        a_ring->sq_map = NULL ;
+    }
+    if (a_ring->cq_map == MAP_FAILED) {
+        a_ring->cq_map = NULL ;
+    }
+    if (a_ring->sqes == MAP_FAILED) {
+        a_ring->sqes = NULL ;
+    }
+    io_ring_finalize (a_ring) ;
+    return FALSE ;
+}
+
+/*
+ * queue a read of a_len bytes at a_offset of a_fd into a_buf, which
+ * io_ring_submit() then hands to the kernel.
+ */
+static enum bool_t
+io_ring_queue_read (struct io_ring_t *a_ring,
+                    int a_fd,
+                    void *a_buf,
+                    unsigned a_len,
+                    off_t a_offset,
+                    uint64_t a_user_data)
+{
+    struct io_uring_sqe *sqe=NULL ;
+    unsigned tail=0, index=0 ;
+
+    tail = *a_ring->sq_tail + a_ring->nb_queued ;
+    if (tail - __atomic_load_n (a_ring->sq_head, __ATOMIC_ACQUIRE)
+        > *a_ring->sq_mask) {
+        /*the submission ring is full*/
+        return FALSE ;
+    }
+    index = tail & *a_ring->sq_mask ;
+    sqe = &a_ring->sqes[index] ;
+    memset (sqe, 0, sizeof (struct io_uring_sqe)) ;
+    sqe->opcode = IORING_OP_READ ;
+    sqe->fd = a_fd ;
+    sqe->addr = (uintptr_t)a_buf ;
+    sqe->len = a_len ;
+    sqe->off = a_offset ;
+    sqe->user_data = a_user_data ;
+    a_ring->sq_array[index] = index ;
+    a_ring->nb_queued++ ;
+    return TRUE ;
+}
+
+/*
+ * submit the reads queued, and if a_wait, wait for at least one of
+ * them to complete.
+ */
+static enum bool_t
+io_ring_submit (struct io_ring_t *a_ring, enum bool_t a_wait)
+{
+    unsigned nb=a_ring->nb_queued ;
+    int result=0 ;
+
+    if (!nb && !a_wait) {
+        return TRUE ;
+    }
+    __atomic_store_n (a_ring->sq_tail, *a_ring->sq_tail + nb,
+                      __ATOMIC_RELEASE) ;
+    a_ring->nb_queued = 0 ;
+    do {
+        result = syscall (__NR_io_uring_enter, a_ring->fd, nb,
+                          a_wait ? 1 : 0,
+                          a_wait ? IORING_ENTER_GETEVENTS : 0,
+                          NULL, 0) ;
+        if (result > 0) {
+            nb -= result ;
+        }
+    } while ((result < 0 && errno == EINTR) || (result > 0 && nb)) ;
+    if (result < 0) {
+        LOG_ERROR ("io_uring_enter failed: %s\n", strerror (errno)) ;
+        return FALSE ;
+    }
+    return TRUE ;
+}
+
+/*
+ * take the next completion, if any.
+ * returns FALSE if there is none yet.
+ */
+static enum bool_t
+io_ring_pop_completion (struct io_ring_t *a_ring,
+                        uint64_t *a_user_data,
+                        int *a_result)
+{
+    struct io_uring_cqe *cqe=NULL ;
+    unsigned head=0 ;
+
+    head = *a_ring->cq_head ;
+    if (head == __atomic_load_n (a_ring->cq_tail, __ATOMIC_ACQUIRE)) {
+        return FALSE ;
+    }
+    cqe = &a_ring->cqes[head & *a_ring->cq_mask] ;
+    *a_user_data = cqe->user_data ;
+    *a_result = cqe->res ;
+    __atomic_store_n (a_ring->cq_head, head + 1, __ATOMIC_RELEASE) ;
+    return TRUE ;
+}
+#endif
+
+/*read a_slot right away, without the ring*/
+static void
+direct_source_pread_slot (struct direct_source_t *a_source,
+                          struct direct_slot_t *a_slot,
+                          off_t a_offset)
+{
+    double start=0 ;
+    ssize_t nb=0 ;
+
+    start = get_monotonic_time () ;
+    do {
+        nb = pread (a_source->fd, a_slot->buf, a_slot->len, a_offset) ;
+    } while (nb < 0 && errno == EINTR) ;
+    a_source->wait_time += get_monotonic_time () - start ;
+    a_source->nb_waits++ ;
+    a_slot->result = nb < 0 ? -errno : (int)nb ;
+    a_slot->is_pending = FALSE ;
+}
+
+/*
+ * start reading the frame played at a_index into a_slot.
+ * returns FALSE if the frame is past the end of the range.
+ */
+static enum bool_t
+direct_source_submit (struct direct_source_t *a_source,
+                      struct direct_slot_t *a_slot,
+                      int a_index)
+{
+    struct yuv_source_t *base = &a_source->base ;
+    off_t offset=0, start=0 ;
+    int frame=0 ;
+
+    frame = yuv_source_get_file_frame (base, a_index) ;
+    if (frame < 0) {
+        return FALSE ;
+    }
+    offset = yuv_source_get_frame_offset (base, frame) ;
+    start = offset & ~((off_t)DIRECT_IO_ALIGN - 1) ;
+    a_slot->index = a_index ;
+    a_slot->head = offset - start ;
+    a_slot->len = (a_slot->head + base->frame_header_len + base->frame_len
+                   + DIRECT_IO_ALIGN - 1) & ~(DIRECT_IO_ALIGN - 1) ;
+    a_slot->is_pending = TRUE ;
+    a_slot->result = 0 ;
+    a_slot->serial = 0 ;
+    if (!a_source->nb_reads) {
+        a_source->start_time = get_monotonic_time () ;
+    }
+    a_source->nb_reads++ ;
+#ifdef HAVE_IO_URING
+    if (a_source->has_ring
+        && io_ring_queue_read (&a_source->ring, a_source->fd,
+                               a_slot->buf, a_slot->len, start,
+                               a_slot - a_source->slots)) {
+        return TRUE ;
+    }
+#endif
+    direct_source_pread_slot (a_source, a_slot, start) ;
+    return TRUE ;
+}
+
+/*wait until the read of a_slot is done*/
+static void
+direct_source_reap (struct direct_source_t *a_source,
+                    struct direct_slot_t *a_slot)
+{
+#ifdef HAVE_IO_URING
+    struct direct_slot_t *slot=NULL ;
+    uint64_t user_data=0 ;
+    double start=0 ;
+    int result=0 ;
+
+    if (!a_slot->is_pending || !a_source->has_ring) {
+        return ;
+    }
+    if (a_source->ring.nb_queued) {
+        io_ring_submit (&a_source->ring, FALSE) ;
+    }
+    while (a_slot->is_pending) {
+        if (!io_ring_pop_completion (&a_source->ring, &user_data, &result)) {
+            start = get_monotonic_time () ;
+            if (!io_ring_submit (&a_source->ring, TRUE)) {
+                a_slot->is_pending = FALSE ;
+                a_slot->result = -EIO ;
+                return ;
+            }
+            a_source->wait_time += get_monotonic_time () - start ;
+            a_source->nb_waits++ ;
+            continue ;
+        }
+        if (user_data >= (uint64_t)a_source->nb_slots) {
+            continue ;
+        }
+        slot = &a_source->slots[user_data] ;
+        slot->result = result ;
+        slot->is_pending = FALSE ;
+    }
+#endif
+}
+
+#ifdef HAVE_IO_URING
+/*
+ * stop using the ring, e.g. after one of its reads failed. The reads
+ * in flight are waited for while the ring is still there, and their
+ * frames forgotten, so that pread reads them again.
+ */
+static void
+direct_source_drop_ring (struct direct_source_t *a_source)
+{
+    int i=0 ;
+
+    /*reaping a slot may complete the others, so forget them all first*/
+    for (i=0 ; i < a_source->nb_slots ; i++) {
+        if (a_source->slots[i].is_pending) {
+            a_source->slots[i].index = -1 ;
+        }
+    }
+    for (i=0 ; i < a_source->nb_slots ; i++) {
+        direct_source_reap (a_source, &a_source->slots[i]) ;
+    }
+    io_ring_finalize (&a_source->ring) ;
+    a_source->has_ring = FALSE ;
+    a_source->depth = 0 ;
+}
+#endif
+
+/*the slot holding, or reading, the frame played at a_index, if any*/
+static struct direct_slot_t*
+direct_source_lookup_slot (struct direct_source_t *a_source, int a_index)
+{
+    int i=0 ;
+
+    for (i=0 ; i < a_source->nb_slots ; i++) {
+        if (a_source->slots[i].index == a_index) {
+            return &a_source->slots[i] ;
+        }
+    }
+    return NULL ;
+}
+
+/*
+ * a slot to read a frame into, which is neither one of the last
+ * nb_frames_in_use frames handed out, which the consumer may still
+ * use, nor one of the frames from a_index to a_index + depth, which
+ * are needed next. There are enough slots for one to be left.
+ */
+static struct direct_slot_t*
+direct_source_get_free_slot (struct direct_source_t *a_source, int a_index)
+{
+    struct direct_slot_t *slot=NULL ;
+    int i=0 ;
+
+    for (i=0 ; i < a_source->nb_slots ; i++) {
+        slot = &a_source->slots[i] ;
+        if (slot->serial
+            && a_source->nb_handed - slot->serial
+               < (unsigned long)a_source->base.nb_frames_in_use) {
+            continue ;
+        }
+        if (slot->index >= a_index
+            && slot->index <= a_index + a_source->depth) {
+            continue ;
+        }
+        return slot ;
+    }
+    return NULL ;
+}
+
+/*
+ * have the frames after a_index in flight, so that the disk works
+ * while the consumer uses a_index.
+ */
+static void
+direct_source_read_ahead (struct direct_source_t *a_source, int a_index)
+{
+    struct direct_slot_t *slot=NULL ;
+    int i=0 ;
+
+    for (i=1 ; i <= a_source->depth ; i++) {
+        if (direct_source_lookup_slot (a_source, a_index + i)) {
+            continue ;
+        }
+        slot = direct_source_get_free_slot (a_source, a_index) ;
+        if (!slot) {
+            break ;
+        }
+        direct_source_reap (a_source, slot) ;
+        if (!direct_source_submit (a_source, slot, a_index + i)) {
+            slot->index = -1 ;
+            break ;
+        }
+    }
+#ifdef HAVE_IO_URING
+    if (a_source->has_ring) {
+        io_ring_submit (&a_source->ring, FALSE) ;
+    }
+#endif
+}
+
+/*
+ * the consumer may hold nb_frames_in_use frames pointing into the
+ * slots, which it sets once the source is open, so they are made at
+ * the first read.
+ */
+static enum bool_t
+direct_source_alloc_slots (struct direct_source_t *a_source)
+{
+    struct yuv_source_t *base = &a_source->base ;
+    unsigned buf_len=0 ;
+    int i=0 ;
+
+    buf_len = (DIRECT_IO_ALIGN - 1 + base->frame_header_len + base->frame_len
+               + DIRECT_IO_ALIGN - 1) & ~(DIRECT_IO_ALIGN - 1) ;
+    a_source->nb_slots = base->nb_frames_in_use + a_source->depth + 1 ;
+    a_source->slots = calloc (a_source->nb_slots,
+                              sizeof (struct direct_slot_t)) ;
+    if (!a_source->slots) {
+        return FALSE ;
+    }
+    for (i=0 ; i < a_source->nb_slots ; i++) {
+        a_source->slots[i].index = -1 ;
+        if (posix_memalign ((void**)&a_source->slots[i].buf,
+                            DIRECT_IO_ALIGN, buf_len)) {
+            LOG_ERROR ("could not allocate %u bytes for direct io\n",
+                       buf_len) ;
+            return FALSE ;
+        }
+        a_source->slots[i].buf_len = buf_len ;
+    }
+    LOG ("direct io: %d buffers of %u bytes, %d reads ahead\n",
+         a_source->nb_slots, buf_len, a_source->depth) ;
+    return TRUE ;
+}
+
+static enum bool_t
+direct_source_read_frame (struct yuv_source_t *a_this,
+                          struct frame_t *a_frame)
+{
+    struct direct_source_t *source = (struct direct_source_t*)a_this ;
+    struct direct_slot_t *slot=NULL ;
+    const char *data=NULL ;
+    int index=0 ;
+
+    RETURN_VAL_IF_FAIL (source && a_frame, FALSE) ;
+
+    if (!source->slots && !direct_source_alloc_slots (source)) {
+        return FALSE ;
+    }
+    index = a_this->next_frame ;
+    slot = direct_source_lookup_slot (source, index) ;
+    if (!slot) {
+        slot = direct_source_get_free_slot (source, index) ;
+        RETURN_VAL_IF_FAIL (slot, FALSE) ;
+        direct_source_reap (source, slot) ;
+        if (!direct_source_submit (source, slot, index)) {
+            slot->index = -1 ;
+            LOG ("end of the frames to play\n") ;
+            return FALSE ;
+        }
+    }
+    /*queue the next ones before waiting for this one*/
+    direct_source_read_ahead (source, index) ;
+    direct_source_reap (source, slot) ;
+#ifdef HAVE_IO_URING
+    if (slot->result < 0 && source->has_ring) {
+        /*e.g. a kernel without IORING_OP_READ*/
+        LOG ("io_uring read failed: %s, using pread\n",
+             strerror (-slot->result)) ;
+        direct_source_drop_ring (source) ;
+        direct_source_pread_slot (source, slot,
+                                  yuv_source_get_frame_offset
+                                  (a_this, yuv_source_get_file_frame
+                                   (a_this, index)) - slot->head) ;
+    }
+#endif
+    source->end_time = get_monotonic_time () ;
+    if (slot->result < 0) {
+        LOG_ERROR ("could not read frame %d: %s\n",
+                   index, strerror (-slot->result)) ;
+        slot->index = -1 ;
+        return FALSE ;
+    }
+    source->nb_bytes += slot->result ;
+    if ((unsigned)slot->result
+        < slot->head + a_this->frame_header_len + a_this->frame_len) {
+        LOG ("end of file\n") ;
+        slot->index = -1 ;
+        return FALSE ;
+    }
+    data = slot->buf + slot->head ;
+    if (a_this->has_frame_markers) {
+        /*all the markers must be alike to find the frames*/
+        if (!y4m_is_frame_marker (data, a_this->frame_header_len - 1)
+            || data[a_this->frame_header_len - 1] != '\n') {
+            LOG_ERROR ("no y4m frame marker for frame %d\n", index) ;
+            return FALSE ;
+        }
+        data += a_this->frame_header_len ;
+    }
+
+    if (a_this->zero_copy) {
+        a_frame->data = (char*)data ;
+        slot->serial = ++source->nb_handed ;
+    } else {
+        if (a_this->frame_len > a_frame->capacity) {
+            LOG_ERROR ("frame buffer of %d bytes can't hold %d bytes\n",
+                       a_frame->capacity, a_this->frame_len) ;
+            return FALSE ;
+        }
+        memcpy (a_frame->buf, data, a_this->frame_len) ;
+        a_frame->data = a_frame->buf ;
+    }
+    a_frame->len = a_this->frame_len ;
+    a_frame->index = a_this->next_frame++ ;
+    return TRUE ;
+}
+
+static enum bool_t
+direct_source_skip_frames (struct yuv_source_t *a_this, int a_nb)
+{
+    RETURN_VAL_IF_FAIL (a_this && a_nb >= 0, FALSE) ;
+
+    /*the reads of the skipped frames are reaped as their slots go*/
+    a_this->next_frame += a_nb ;
+    return TRUE ;
+}
+
+static void
+direct_source_dump_stats (struct yuv_source_t *a_this,
+                          double a_fps,
+                          FILE *a_out)
+{
+    struct direct_source_t *source = (struct direct_source_t*)a_this ;
+    double seconds=0, rate=0, needed=0 ;
+
+    if (!source->nb_reads) {
+        return ;
+    }
+    seconds = source->end_time - source->start_time ;
+    if (seconds <= 0) {
+        seconds = 1e-9 ;
+    }
+    rate = source->nb_bytes / seconds / (1024.0 * 1024.0) ;
+    fprintf (a_out, "direct io: %s%s, %d reads in flight, "
+             "%lu reads of %lu bytes on average\n",
+#ifdef HAVE_IO_URING
+             source->has_ring ? "io_uring" : "pread",
+#else
+             "pread",
+#endif
+             source->is_direct ? "" : " through the page cache",
+             source->depth ? source->depth : 1,
+             source->nb_reads,
+             (unsigned long)(source->nb_bytes / source->nb_reads)) ;
+    if (a_fps > 0) {
+        needed = (a_this->frame_header_len + a_this->frame_len) * a_fps
+                 / (1024.0 * 1024.0) ;
+        fprintf (a_out, "direct io: %.2f MB/s sustained, %.2f MB/s needed"
+                 " for %.2f fps%s\n",
+                 rate, needed, a_fps,
+                 rate < needed ? ": the disk is too slow" : "") ;
+    } else {
+        fprintf (a_out, "direct io: %.2f MB/s sustained\n", rate) ;
+    }
+    fprintf (a_out, "direct io: waited %lu times for the disk, "
+             "%.3fs in all\n",
+             source->nb_waits, source->wait_time) ;
+}
+
+static void
+direct_source_destroy (struct yuv_source_t *a_this)
+{
+    struct direct_source_t *source = (struct direct_source_t*)a_this ;
+    int i=0 ;
+
+    if (source->slots) {
+        /*the kernel must be done with the buffers before they go*/
+        for (i=0 ; i < source->nb_slots ; i++) {
+            direct_source_reap (source, &source->slots[i]) ;
+        }
+        for (i=0 ; i < source->nb_slots ; i++) {
+            free (source->slots[i].buf) ;
+        }
+        free (source->slots) ;
+        source->slots = NULL ;
+    }
+#ifdef HAVE_IO_URING
+    if (source->has_ring) {
+        io_ring_finalize (&source->ring) ;
+        source->has_ring = FALSE ;
+    }
+#endif
+    if (source->fd >= 0) {
+        close (source->fd) ;
+        source->fd = -1 ;
+    }
+}
+
+/**
+ * a source reading a_path with O_DIRECT, keeping several frames in
+ * flight through io_uring, or one at a time with pread() if the
+ * system has no io_uring.
+ * Meant for clips read faster than the page cache helps with. When
+ * the consumer sets zero_copy, frames point right into the read
+ * buffers.
+ */
+struct yuv_source_t*
+direct_source_new (const char *a_path,
+                   unsigned a_width,
+                   unsigned a_height,
+                   enum yuv_format_t a_format)
+{
+    struct direct_source_t *source=NULL ;
+    struct stat st ;
+    char *head=NULL ;
+    ssize_t nb=0 ;
+
+    RETURN_VAL_IF_FAIL (a_path, NULL) ;
+
+    source = calloc (1, sizeof (struct direct_source_t)) ;
+    if (!source) {
+        return NULL ;
+    }
+    source->fd = -1 ;
+    source->base.read_frame = direct_source_read_frame ;
+    source->base.skip_frames = direct_source_skip_frames ;
+    source->base.dump_stats = direct_source_dump_stats ;
+    source->base.destroy = direct_source_destroy ;
+    source->fd = open (a_path, O_RDONLY | O_DIRECT) ;
+    source->is_direct = source->fd >= 0 ;
+    if (source->fd < 0 && errno == EINVAL) {
+        /*e.g. tmpfs, the reads still work, through the page cache*/
+        LOG ("'%s' can't be read with O_DIRECT\n", a_path) ;
+        source->fd = open (a_path, O_RDONLY) ;
+    }
+    if (source->fd < 0) {
+        LOG_ERROR ("could not open '%s': %s\n", a_path, strerror (errno)) ;
+        goto error ;
+    }
+    if (fstat (source->fd, &st) || st.st_size <= 0) {
+        LOG_ERROR ("could not get the size of '%s'\n", a_path) ;
+        goto error ;
+    }
+    source->file_len = st.st_size ;
+
+    /*the y4m header and first frame marker, if any*/
+    if (posix_memalign ((void**)&head, DIRECT_IO_ALIGN,
+                        2 * Y4M_MAX_LINE_LEN)) {
+        goto error ;
+    }
+    do {
+        nb = pread (source->fd, head, 2 * Y4M_MAX_LINE_LEN, 0) ;
+    } while (nb < 0 && errno == EINTR) ;
+    if (nb < 0) {
+        LOG_ERROR ("could not read '%s': %s\n", a_path, strerror (errno)) ;
+        goto error ;
+    }
+    if (!yuv_source_init_layout (&source->base, "direct io",
+                                 head, nb, source->file_len,
+                                 a_width, a_height, a_format)) {
+        LOG_ERROR ("could not find the frames of '%s'\n", a_path) ;
+        goto error ;
+    }
+    free (head) ;
+    head = NULL ;
+
+#ifdef HAVE_IO_URING
+    source->has_ring = io_ring_init (&source->ring,
+                                     DIRECT_IO_QUEUE_DEPTH * 2) ;
+    if (source->has_ring) {
+        source->depth = DIRECT_IO_QUEUE_DEPTH ;
+    }
+#endif
+    if (!source->depth) {
+        LOG ("reading '%s' one frame at a time with pread\n", a_path) ;
+    }
+    return &source->base ;
+
+error:
+    free (head) ;
+    yuv_source_destroy (&source->base) ;
+    return NULL ;
+}
+
+/*
+ * preloading
+ */
+
+/*
+ * allocate the a_len bytes of arena of a_source, from huge pages if
+ * a_huge_pages, touching them all so that playing does not fault.
+ */
+static enum bool_t
+preload_source_alloc_arena (struct preload_source_t *a_source,
+                            size_t a_len,
+                            enum bool_t a_huge_pages)
+{
+    size_t page_size=0 ;
+    void *buf=NULL ;
+
+    page_size = a_huge_pages ? HUGE_PAGE_SIZE : sysconf (_SC_PAGESIZE) ;
+    a_len = (a_len + page_size - 1) & ~(page_size - 1) ;
+#ifdef MAP_HUGETLB
+    if (a_huge_pages) {
+        buf = mmap (NULL, a_len, PROT_READ|PROT_WRITE,
+                    MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0) ;
+        if (buf != MAP_FAILED) {
+            a_source->memory = FRAME_MEMORY_MMAP ;
+            goto out ;
+        }
+        LOG ("no hugetlbfs pages available, "
+             "falling back to transparent huge pages\n") ;
+        buf = NULL ;
+    }
+#endif
+    if (posix_memalign (&buf, page_size, a_len)) {
+        LOG_ERROR ("failed to allocate %lu bytes\n", (unsigned long)a_len) ;
+        return FALSE ;
+    }
+#ifdef MADV_HUGEPAGE
+    if (a_huge_pages) {
+        madvise (buf, a_len, MADV_HUGEPAGE) ;
+    }
+#endif
+    a_source->memory = FRAME_MEMORY_HEAP ;
+
+out:
+    memset (buf, 0, a_len) ;
+    a_source->arena = buf ;
+    a_source->arena_len = a_len ;
+    /*so that it is not paged out in the middle of a benchmark*/
+    if (mlock (buf, a_len)) {
+        LOG ("could not lock the preloaded frames in RAM: %s\n",
+             strerror (errno)) ;
+    } else {
+        a_source->is_locked = TRUE ;
+    }
+    return TRUE ;
+}
+
+static enum bool_t
+preload_source_read_frame (struct yuv_source_t *a_this,
+                           struct frame_t *a_frame)
+{
+    struct preload_source_t *source = (struct preload_source_t*)a_this ;
+    char *data=NULL ;
+    int frame=0 ;
+
+    RETURN_VAL_IF_FAIL (source && a_frame, FALSE) ;
+
+    frame = yuv_source_get_file_frame (a_this, a_this->next_frame) ;
+    if (frame < 0) {
+        LOG ("end of the frames to play\n") ;
+        return FALSE ;
+    }
+    data = source->arena + (size_t)frame * source->frame_stride ;
+    if (a_this->zero_copy) {
+        a_frame->data = data ;
+    } else {
+        if (a_this->frame_len > a_frame->capacity) {
+            LOG_ERROR ("frame buffer of %d bytes can't hold %d bytes\n",
+                       a_frame->capacity, a_this->frame_len) ;
+            return FALSE ;
+        }
+        memcpy (a_frame->buf, data, a_this->frame_len) ;
+        a_frame->data = a_frame->buf ;
+    }
+    a_frame->len = a_this->frame_len ;
+    a_frame->index = a_this->next_frame++ ;
+    return TRUE ;
+}
+
+static enum bool_t
+preload_source_skip_frames (struct yuv_source_t *a_this, int a_nb)
+{
+    RETURN_VAL_IF_FAIL (a_this && a_nb >= 0, FALSE) ;
+
+    a_this->next_frame += a_nb ;
+    return TRUE ;
+}
+
+static int
+preload_source_get_input_frame (struct yuv_source_t *a_this, int a_frame)
+{
+    struct preload_source_t *source = (struct preload_source_t*)a_this ;
+
+    if (a_frame < 0 || a_frame >= a_this->nb_file_frames) {
+        return -1 ;
+    }
+    return source->input_frames[a_frame] ;
+}
+
+static void
+preload_source_destroy (struct yuv_source_t *a_this)
+{
+    struct preload_source_t *source = (struct preload_source_t*)a_this ;
+
+    free (source->input_frames) ;
+    source->input_frames = NULL ;
+    if (!source->arena) {
+        return ;
+    }
+    if (source->is_locked) {
+        munlock (source->arena, source->arena_len) ;
+    }
+    if (source->memory == FRAME_MEMORY_MMAP) {
+        munmap (source->arena, source->arena_len) ;
+    } else {
+        free (source->arena) ;
+    }
+    source->arena = NULL ;
+}
+
+/**
+ * read up to a_nb_frames frames of a_source, in the order it plays
+ * them, into one arena, then close it.
+ * The source returned plays those frames over and over, without
+ * any I/O, so that benchmarks measure the display alone; bound it
+ * with --nb-frames or --duration.
+ * a_source is destroyed, even on errors.
+ */
+struct yuv_source_t*
+preload_source_new (struct yuv_source_t *a_source,
+                    int a_nb_frames,
+                    enum bool_t a_huge_pages)
+{
+    struct preload_source_t *source=NULL ;
+    struct frame_t frame ;
+    int i=0 ;
+
+    RETURN_VAL_IF_FAIL (a_source && a_nb_frames > 0, NULL) ;
+
+    source = calloc (1, sizeof (struct preload_source_t)) ;
+    if (!source) {
+        goto error ;
+    }
+    source->base.read_frame = preload_source_read_frame ;
+    source->base.skip_frames = preload_source_skip_frames ;
+    source->base.get_input_frame = preload_source_get_input_frame ;
+    source->base.destroy = preload_source_destroy ;
+    if (!yuv_source_init (&source->base, "preload", a_source->width,
+                          a_source->height, a_source->format)) {
+        goto error ;
+    }
+    source->base.fps = a_source->fps ;
+    if (yuv_source_get_nb_frames (a_source) > 0
+        && yuv_source_get_nb_frames (a_source) < a_nb_frames) {
+        a_nb_frames = yuv_source_get_nb_frames (a_source) ;
+    }
+    /*cache line aligned frames*/
+    source->frame_stride = (source->base.frame_len + 63) & ~63 ;
+    if (!preload_source_alloc_arena (source,
+                                     (size_t)a_nb_frames
+                                     * source->frame_stride,
+                                     a_huge_pages)) {
+        goto error ;
+    }
+    source->input_frames = calloc (a_nb_frames, sizeof (int)) ;
+    if (!source->input_frames) {
+        goto error ;
+    }
+
+    memset (&frame, 0, sizeof (frame)) ;
+    a_source->zero_copy = FALSE ;
+    for (i=0 ; i < a_nb_frames ; i++) {
+        frame.buf = source->arena + (size_t)i * source->frame_stride ;
+        frame.capacity = source->frame_stride ;
+        if (!a_source->read_frame (a_source, &frame)) {
+            break ;
+        }
+        source->input_frames[i] = yuv_source_get_input_frame (a_source,
+                                                              frame.index) ;
+    }
+    if (!i) {
+        LOG_ERROR ("no frame to preload\n") ;
+        goto error ;
+    }
+    yuv_source_destroy (a_source) ;
+    a_source = NULL ;
+    source->base.nb_file_frames = i ;
+    yuv_source_set_range (&source->base, 0, i, 0, FALSE) ;
+
+    fprintf (stdout, "preloaded %d frames of %u bytes: %.2f MB of %s"
+             " pages, %s\n",
+             i, source->base.frame_len,
+             source->arena_len / (1024.0 * 1024.0),
+             source->memory == FRAME_MEMORY_MMAP ? "huge"
+             : a_huge_pages ? "transparent huge" : "normal",
+             source->is_locked ? "locked in RAM" : "not locked") ;
+    return &source->base ;
+
+error:
+    if (a_source) {
+        yuv_source_destroy (a_source) ;
+    }
+    if (source) {
+        yuv_source_destroy (&source->base) ;
+    }
+    return NULL ;
+}
+
+/*
+ * test patterns
+ */
+
+static const char *pattern_names[PATTERN_NB_TYPES] = {
+    "bars",
+    "zoneplate",
+    "gradient",
+    "counter"
+};
+
+/*the Y, U and V of 75% white, yellow, cyan, green, magenta, red,
+ * blue and black, BT.601*/
+static const unsigned char pattern_bar_colors[8][3] = {
+    {180, 128, 128},
+    {162, 44, 142},
+    {131, 156, 44},
+    {112, 72, 58},
+    {84, 184, 198},
+    {65, 100, 212},
+    {35, 212, 114},
+    {16, 128, 128}
+};
+
+/*the digits of the counter, 3 bits by 5 rows, the left column first*/
+static const unsigned char pattern_digits[10][5] = {
+    {7, 5, 5, 5, 7},
+    {2, 6, 2, 2, 7},
+    {7, 1, 7, 4, 7},
+    {7, 1, 7, 1, 7},
+    {5, 5, 7, 1, 1},
+    {7, 4, 7, 1, 7},
+    {7, 4, 7, 5, 7},
+    {7, 1, 1, 1, 1},
+    {7, 5, 7, 5, 7},
+    {7, 5, 7, 1, 7}
+};
+
+/**
+ * parse the name of a test pattern, one of pattern_names, which but
+ * for "counter" can end with "+counter" to have the frame number
+ * drawn over the pattern, e.g. "zoneplate+counter".
+ */
+enum bool_t
+pattern_parse_name (const char *a_name,
+                    enum pattern_type_t *a_type,
+                    enum bool_t *a_has_counter)
+{
+    size_t len=0 ;
+    int i=0 ;
+
+    RETURN_VAL_IF_FAIL (a_name && a_type && a_has_counter, FALSE) ;
+
+    len = strcspn (a_name, "+") ;
+    for (i=0 ; i < PATTERN_NB_TYPES ; i++) {
+        if (strlen (pattern_names[i]) == len
+            && !strncmp (a_name, pattern_names[i], len)) {
+            break ;
+        }
+    }
+    if (i == PATTERN_NB_TYPES) {
+        return FALSE ;
+    }
+    *a_type = i ;
+    *a_has_counter = i == PATTERN_COUNTER ;
+    if (a_name[len]) {
+        if (i == PATTERN_COUNTER || strcmp (a_name + len, "+counter")) {
+            return FALSE ;
+        }
+        *a_has_counter = TRUE ;
+    }
+    return TRUE ;
+}
+
+static void
+ramp_row_scalar (unsigned char *a_dst, unsigned a_start, unsigned a_nb)
+{
+    unsigned i=0 ;
+
+    for (i=0 ; i < a_nb ; i++) {
+        a_dst[i] = a_start + i ;
+    }
+}
+
+/*the phases wrap every 65536, the wave goes up then down in 512 steps*/
+static void
+zone_plate_row_scalar (unsigned char *a_dst,
+                       const uint32_t *a_phases,
+                       uint32_t a_offset,
+                       unsigned a_nb)
+{
+    unsigned i=0, p=0 ;
+
+    for (i=0 ; i < a_nb ; i++) {
+        p = ((a_phases[i] + a_offset) >> 7) & 511 ;
+        a_dst[i] = p < 256 ? p : 511 - p ;
+    }
+}
+
+static const struct pattern_row_funcs_t pattern_row_funcs_scalar = {
+    "scalar",
+    ramp_row_scalar,
+    zone_plate_row_scalar
+};
+
+#ifdef HAVE_X86_SIMD
+
+/*16 samples per iteration*/
+__attribute__ ((target ("sse2")))
+static void
+ramp_row_sse2 (unsigned char *a_dst, unsigned a_start, unsigned a_nb)
+{
+    const __m128i step = _mm_set1_epi8 (16) ;
+    __m128i v = _mm_add_epi8 (_mm_set1_epi8 ((char)a_start),
+                              _mm_setr_epi8 (0, 1, 2, 3, 4, 5, 6, 7,
+                                             8, 9, 10, 11, 12, 13, 14, 15)) ;
+    unsigned i=0, n=a_nb & ~15u ;
+
+    for (i=0 ; i < n ; i += 16) {
+        _mm_storeu_si128 ((__m128i*)(a_dst + i), v) ;
+        v = _mm_add_epi8 (v, step) ;
+    }
+    ramp_row_scalar (a_dst + n, a_start + n, a_nb - n) ;
+}
+
+/*16 samples per iteration*/
+__attribute__ ((target ("sse2")))
+static void
+zone_plate_row_sse2 (unsigned char *a_dst,
+                     const uint32_t *a_phases,
+                     uint32_t a_offset,
+                     unsigned a_nb)
+{
+    const __m128i offset = _mm_set1_epi32 ((int)a_offset) ;
+    const __m128i mask = _mm_set1_epi32 (511) ;
+    const __m128i top = _mm_set1_epi16 (511) ;
+    unsigned i=0, n=a_nb & ~15u ;
+    __m128i p[4], lo, hi ;
+    int j=0 ;
+
+    for (i=0 ; i < n ; i += 16) {
+        for (j=0 ; j < 4 ; j++) {
+            p[j] = _mm_loadu_si128 ((const __m128i*)(a_phases + i + 4 * j)) ;
+            p[j] = _mm_and_si128 (_mm_srli_epi32 (_mm_add_epi32 (p[j],
+                                                                 offset),
+                                                  7),
+                                  mask) ;
+        }
+        /*fits in 16 bits, then down the wave past 255*/
+        lo = _mm_packs_epi32 (p[0], p[1]) ;
+        hi = _mm_packs_epi32 (p[2], p[3]) ;
+        lo = _mm_min_epi16 (lo, _mm_sub_epi16 (top, lo)) ;
+        hi = _mm_min_epi16 (hi, _mm_sub_epi16 (top, hi)) ;
+        _mm_storeu_si128 ((__m128i*)(a_dst + i), _mm_packus_epi16 (lo, hi)) ;
+    }
+    zone_plate_row_scalar (a_dst + n, a_phases + n, a_offset, a_nb - n) ;
+}
+
+static const struct pattern_row_funcs_t pattern_row_funcs_sse2 = {
+    "sse2",
+    ramp_row_sse2,
+    zone_plate_row_sse2
+};
+
+#endif /*HAVE_X86_SIMD*/
+
+static const struct pattern_row_funcs_t*
+select_pattern_row_funcs (enum bool_t a_no_simd)
+{
+#ifdef HAVE_X86_SIMD
+    if (!a_no_simd) {
+        __builtin_cpu_init () ;
+        if (__builtin_cpu_supports ("sse2")) {
+            return &pattern_row_funcs_sse2 ;
+        }
+    }
+#endif
+    return &pattern_row_funcs_scalar ;
+}
+
+/*copy the a_nb bytes of a_src to a_dst, from a_shift bytes in on*/
+static void
+rotate_row (unsigned char *a_dst,
+            const unsigned char *a_src,
+            unsigned a_nb,
+            unsigned a_shift)
+{
+    memcpy (a_dst, a_src + a_shift, a_nb - a_shift) ;
+    memcpy (a_dst + a_nb - a_shift, a_src, a_shift) ;
+}
+
+/*
+ * render line a_line of frame a_frame of the pattern, and its chroma
+ * samples if a_has_chroma.
+ */
+static void
+pattern_source_render_line (struct pattern_source_t *a_source,
+                            int a_frame,
+                            unsigned a_line,
+                            unsigned char *a_y,
+                            unsigned char *a_u,
+                            unsigned char *a_v,
+                            enum bool_t a_has_chroma)
+{
+    unsigned width=0, half=0, shift=0 ;
+
+    width = a_source->base.width ;
+    half = width / 2 ;
+    switch (a_source->type) {
+        case PATTERN_BARS:
+            shift = (unsigned)((uint64_t)a_frame * PATTERN_BARS_SPEED
+                               % width) & ~1u ;
+            rotate_row (a_y, a_source->bars, width, shift) ;
+            if (a_has_chroma) {
+                rotate_row (a_u, a_source->bars + width, half, shift / 2) ;
+                rotate_row (a_v, a_source->bars + width + half, half,
+                            shift / 2) ;
+            }
+            break ;
+        case PATTERN_ZONE_PLATE:
+            a_source->funcs->zone_plate (a_y, a_source->zone_phases,
+                                         a_source->zone_phases[width + a_line]
+                                         + (uint32_t)a_frame
+                                           * PATTERN_ZONE_PLATE_SPEED,
+                                         width) ;
+            if (a_has_chroma) {
+                memset (a_u, 128, half) ;
+                memset (a_v, 128, half) ;
+            }
+            break ;
+        case PATTERN_GRADIENT:
+            a_source->funcs->ramp (a_y, a_line + 2 * (unsigned)a_frame,
+                                   width) ;
+            if (a_has_chroma) {
+                a_source->funcs->ramp (a_u, a_frame, half) ;
+                memset (a_v, a_line * 256 / a_source->base.height, half) ;
+            }
+            break ;
+        default:
+            memset (a_y, 128, width) ;
+            if (a_has_chroma) {
+                memset (a_u, 128, half) ;
+                memset (a_v, 128, half) ;
+            }
+            break ;
+    }
+}
+
+/*
+ * draw line a_line of the number of frame a_frame, in white digits
+ * on a black box in the top left corner.
+ */
+static void
+pattern_source_draw_counter (struct pattern_source_t *a_source,
+                             int a_frame,
+                             unsigned a_line,
+                             unsigned char *a_y,
+                             unsigned char *a_u,
+                             unsigned char *a_v,
+                             enum bool_t a_has_chroma)
+{
+    unsigned scale=0, box_width=0, row=0, value=0, bits=0, x=0, n=0 ;
+    int i=0, column=0 ;
+
+    scale = a_source->base.height / PATTERN_COUNTER_SCALE ;
+    if (!scale) {
+        scale = 1 ;
+    }
+    /*a block of margin around the digits, and between them*/
+    if (a_line >= 7 * scale) {
+        return ;
+    }
+    box_width = (PATTERN_COUNTER_DIGITS * 4 + 1) * scale ;
+    if (box_width > a_source->base.width) {
+        box_width = a_source->base.width ;
+    }
+    memset (a_y, 16, box_width) ;
+    if (a_has_chroma) {
+        memset (a_u, 128, box_width / 2) ;
+        memset (a_v, 128, box_width / 2) ;
+    }
+    row = a_line / scale ;
+    if (row < 1 || row > 5) {
+        return ;
+    }
+    value = a_frame ;
+    for (i = PATTERN_COUNTER_DIGITS - 1 ; i >= 0 ; i--) {
+        bits = pattern_digits[value % 10][row - 1] ;
+        value /= 10 ;
+        for (column=0 ; column < 3 ; column++) {
+            if (!(bits & (4 >> column))) {
+                continue ;
+            }
+            x = (1 + 4 * i + column) * scale ;
+            if (x >= box_width) {
+                continue ;
+            }
+            n = box_width - x < scale ? box_width - x : scale ;
+            memset (a_y + x, 235, n) ;
+        }
+    }
+}
+
+/*
+ * render frame a_frame of the pattern into a_planes, line by line.
+ * Planar lines are rendered in place, the others in tmp first and
+ * then interleaved or packed.
+ */
+static void
+pattern_source_render (struct pattern_source_t *a_source,
+                       int a_frame,
+                       const struct yuv_planes_t *a_planes)
+{
+    const struct yuv_format_info_t *info=NULL ;
+    unsigned width=0, height=0, line=0, chroma_line=0 ;
+    unsigned char *tmp_y=NULL, *tmp_u=NULL, *tmp_v=NULL ;
+
+    info = a_planes->info ;
+    width = a_planes->width ;
+    height = a_planes->height ;
+    tmp_y = a_source->tmp ;
+    tmp_u = tmp_y + width ;
+    tmp_v = tmp_u + width / 2 ;
+
+    for (line=0 ; line < height ; line++) {
+        unsigned char *y=tmp_y, *u=tmp_u, *v=tmp_v ;
+        enum bool_t has_chroma=FALSE ;
+
+        chroma_line = line >> info->chroma_y_shift ;
+        has_chroma = (info->layout == YUV_LAYOUT_PACKED
+                      || !(line & ((1 << info->chroma_y_shift) - 1)))
+                     && chroma_line < height >> info->chroma_y_shift ;
+        if (info->layout != YUV_LAYOUT_PACKED) {
+            y = a_planes->y + line * a_planes->y_pitch ;
+        }
+        if (info->layout == YUV_LAYOUT_PLANAR && has_chroma) {
+            u = a_planes->u + chroma_line * a_planes->uv_pitch ;
+            v = a_planes->v + chroma_line * a_planes->uv_pitch ;
+        }
+        pattern_source_render_line (a_source, a_frame, line,
+                                    y, u, v, has_chroma) ;
+        if (a_source->has_counter) {
+            pattern_source_draw_counter (a_source, a_frame, line,
+                                         y, u, v, has_chroma) ;
+        }
+        switch (info->layout) {
+            case YUV_LAYOUT_PLANAR:
+                break ;
+            case YUV_LAYOUT_SEMI_PLANAR:
+                if (!has_chroma) {
+                    break ;
+                }
+                if (info->vu) {
+                    a_source->row_funcs->interleave (v, u, a_planes->v
+                                                     + chroma_line
+                                                     * a_planes->uv_pitch,
+                                                     width / 2) ;
+                } else {
+                    a_source->row_funcs->interleave (u, v, a_planes->u
+                                                     + chroma_line
+                                                     * a_planes->uv_pitch,
+                                                     width / 2) ;
+                }
+                break ;
+            case YUV_LAYOUT_PACKED:
+                a_source->row_funcs->pack_422 (y, u, v, a_planes->packed
+                                               + line * a_planes->y_pitch,
+                                               width,
+                                               info->format
+                                               == YUV_FORMAT_UYVY) ;
+                break ;
+        }
+    }
+}
+
+static enum bool_t
+pattern_source_read_frame (struct yuv_source_t *a_this,
+                           struct frame_t *a_frame)
+{
+    struct pattern_source_t *source = (struct pattern_source_t*)a_this ;
+    struct yuv_planes_t planes ;
+    int64_t start=0 ;
+    int frame=0 ;
+
+    RETURN_VAL_IF_FAIL (source && a_frame, FALSE) ;
+
+    frame = yuv_source_get_file_frame (a_this, a_this->next_frame) ;
+    if (frame < 0) {
+        LOG ("end of the frames to play\n") ;
+        return FALSE ;
+    }
+    if (a_this->frame_len > a_frame->capacity) {
+        LOG_ERROR ("frame buffer of %d bytes can't hold %d bytes\n",
+                   a_frame->capacity, a_this->frame_len) ;
+        return FALSE ;
+    }
+    if (!yuv_planes_from_frame (&planes, a_this->format, a_this->width,
+                                a_this->height,
+                                (unsigned char*)a_frame->buf)) {
+        return FALSE ;
+    }
+    start = get_monotonic_ns () ;
+    pattern_source_render (source, frame, &planes) ;
+    source->render_ns += get_monotonic_ns () - start ;
+    source->nb_rendered++ ;
+    a_frame->data = a_frame->buf ;
+    a_frame->len = a_this->frame_len ;
+    a_frame->index = a_this->next_frame++ ;
+    return TRUE ;
+}
+
+static enum bool_t
+pattern_source_skip_frames (struct yuv_source_t *a_this, int a_nb)
+{
+    RETURN_VAL_IF_FAIL (a_this && a_nb >= 0, FALSE) ;
+
+    a_this->next_frame += a_nb ;
+    return TRUE ;
+}
+
+static void
+pattern_source_dump_stats (struct yuv_source_t *a_this,
+                           double a_fps,
+                           FILE *a_out)
+{
+    struct pattern_source_t *source = (struct pattern_source_t*)a_this ;
+    double seconds=0 ;
+
+    if (!source->nb_rendered) {
+        return ;
+    }
+    seconds = source->render_ns / 1e9 ;
+    if (seconds <= 0) {
+        seconds = 1e-9 ;
+    }
+    fprintf (a_out, "pattern: %lu frames rendered with the %s rows, "
+             "%.3f ms each, %.1f Mpix/s\n",
+             source->nb_rendered, source->funcs->name,
+             seconds * 1e3 / source->nb_rendered,
+             (double)source->nb_rendered * a_this->width * a_this->height
+             / seconds / 1e6) ;
+}
+
+static void
+pattern_source_destroy (struct yuv_source_t *a_this)
+{
+    struct pattern_source_t *source = (struct pattern_source_t*)a_this ;
+
+    free (source->tmp) ;
+    source->tmp = NULL ;
+    free (source->bars) ;
+    source->bars = NULL ;
+    free (source->zone_phases) ;
+    source->zone_phases = NULL ;
+}
+
+/*the Y, then U, then V line of the bars, from left to right*/
+static enum bool_t
+pattern_source_init_bars (struct pattern_source_t *a_source)
+{
+    unsigned width=0, half=0, x=0 ;
+
+    width = a_source->base.width ;
+    half = width / 2 ;
+    a_source->bars = malloc (width + 2 * half) ;
+    if (!a_source->bars) {
+        return FALSE ;
+    }
+    for (x=0 ; x < width ; x++) {
+        a_source->bars[x] = pattern_bar_colors[x * 8 / width][0] ;
+    }
+    for (x=0 ; x < half ; x++) {
+        a_source->bars[width + x] = pattern_bar_colors[2 * x * 8 / width][1] ;
+        a_source->bars[width + half + x]
+                                = pattern_bar_colors[2 * x * 8 / width][2] ;
+    }
+    return TRUE ;
+}
+
+/*
+ * the phase of the zone plate is k.(x^2 + y^2) from the center, k
+ * being such that it changes by half a period between the last two
+ * samples of the widest axis: the rings get as close as they can.
+ */
+static enum bool_t
+pattern_source_init_zone_plate (struct pattern_source_t *a_source)
+{
+    unsigned width=0, height=0, radius=0, k=0, i=0 ;
+    int d=0 ;
+
+    width = a_source->base.width ;
+    height = a_source->base.height ;
+    a_source->zone_phases = malloc ((width + height) * sizeof (uint32_t)) ;
+    if (!a_source->zone_phases) {
+        return FALSE ;
+    }
+    radius = (width > height ? width : height) / 2 ;
+    k = radius ? (1 << 14) / radius : 1 ;
+    if (!k) {
+        k = 1 ;
+    }
+    for (i=0 ; i < width ; i++) {
+        d = (int)i - (int)width / 2 ;
+        a_source->zone_phases[i] = (uint32_t)(d * d) * k ;
+    }
+    for (i=0 ; i < height ; i++) {
+        d = (int)i - (int)height / 2 ;
+        a_source->zone_phases[width + i] = (uint32_t)(d * d) * k ;
+    }
+    return TRUE ;
+}
+
+/**
+ * create a source rendering the test pattern a_name, e.g. "bars"
+ * or "gradient+counter", see pattern_parse_name(), into frames of
+ * a_width x a_height in a_format.
+ * The source never ends, so bound it with --nb-frames or --duration;
+ * as frames only depend on their index, any range can be played.
+ */
+struct yuv_source_t*
+pattern_source_new (const char *a_name,
+                    unsigned a_width,
+                    unsigned a_height,
+                    enum yuv_format_t a_format,
+                    enum bool_t a_no_simd)
+{
+    struct pattern_source_t *source=NULL ;
+    enum bool_t is_ok=FALSE ;
+
+    RETURN_VAL_IF_FAIL (a_name, NULL) ;
+
+    source = calloc (1, sizeof (struct pattern_source_t)) ;
+    if (!source) {
+        return NULL ;
+    }
+    source->base.read_frame = pattern_source_read_frame ;
+    source->base.skip_frames = pattern_source_skip_frames ;
+    source->base.dump_stats = pattern_source_dump_stats ;
+    source->base.destroy = pattern_source_destroy ;
+    if (!pattern_parse_name (a_name, &source->type, &source->has_counter)) {
+        LOG_ERROR ("unknown pattern: %s\n", a_name) ;
+        goto error ;
+    }
+    if (!yuv_source_init (&source->base, "pattern", a_width, a_height,
+                          a_format)) {
+        goto error ;
+    }
+    /*as many frames as can be counted*/
+    source->base.nb_file_frames = INT_MAX ;
+    source->funcs = select_pattern_row_funcs (a_no_simd) ;
+    source->row_funcs = select_yuv_row_funcs (a_no_simd) ;
+    source->tmp = malloc (2 * a_width + 64) ;
+    if (!source->tmp) {
+        goto error ;
+    }
+    switch (source->type) {
+        case PATTERN_BARS:
+            is_ok = pattern_source_init_bars (source) ;
+            break ;
+        case PATTERN_ZONE_PLATE:
+            is_ok = pattern_source_init_zone_plate (source) ;
+            break ;
+        default:
+            is_ok = TRUE ;
+            break ;
+    }
+    if (!is_ok) {
+        LOG_ERROR ("could not allocate the %s pattern\n", a_name) ;
+        goto error ;
+    }
+    LOG ("pattern source: %s, %ux%u %s, %s rows\n",
+         a_name, a_width, a_height,
+         yuv_format_get_info (a_format)->name, source->funcs->name) ;
+    return &source->base ;
+
+error:
+    yuv_source_destroy (&source->base) ;
+    return NULL ;
+}
+
+/*************************
+ * </yuv sources>
+ * ***********************/
@@ -0,0 +1,338 @@
+/*
+ * Copyright (C) 2007 OpenedHand Ltd
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * Author:
+ *   Dodji Seketeli <dodji@openedhand.com>
+ */
+
+#include "xvplay-private.h"
+
+/*************************
+ * <yuv to rgb>
+ * ***********************/
+
+/*
+ * The conversion uses the usual BT.601 limited range coefficients
+ * in 8 bits fixed point, with C = Y-16, D = U-128 and E = V-128:
+ *   R = (298*C + 409*E + 128) >> 8
+ *   G = (298*C - 100*D - 208*E + 128) >> 8
+ *   B = (298*C + 516*D + 128) >> 8
+ * clamped to [0, 255].
+ * The SIMD rows compute exactly that in 32 bits lanes, so they give
+ * the same bytes as the scalar one.
+ */
+
+static void
+i420_row_to_rgb32_scalar (const unsigned char *a_y,
+                          const unsigned char *a_u,
+                          const unsigned char *a_v,
+                          unsigned char *a_dst,
+                          unsigned a_width,
+                          enum rgb_order_t a_order)
+{
+    unsigned x=0 ;
+    int b_pos=0, r_pos=2 ;
+
+    if (a_order == RGB_ORDER_RGBX) {
+        b_pos = 2 ;
+        r_pos = 0 ;
+    }
+    for (x=0 ; x < a_width ; x++) {
+        int c = (a_y[x] - 16) * 298 ;
+        int d = a_u[x / 2] - 128 ;
+        int e = a_v[x / 2] - 128 ;
+
+        a_dst[b_pos] = clamp_to_byte ((c + 516 * d + 128) >> 8) ;
+        a_dst[1] = clamp_to_byte ((c - 100 * d - 208 * e + 128) >> 8) ;
+        a_dst[r_pos] = clamp_to_byte ((c + 409 * e + 128) >> 8) ;
+        a_dst[3] = 0 ;
+        a_dst += 4 ;
+    }
+}
+
+#ifdef HAVE_X86_SIMD
+
+/*round, shift and saturate two vectors of 4 int32 to 8 bytes*/
+__attribute__ ((target ("sse2")))
+static inline __m128i
+sse2_pack_channel (__m128i a_lo, __m128i a_hi)
+{
+    const __m128i round = _mm_set1_epi32 (128) ;
+
+    a_lo = _mm_srai_epi32 (_mm_add_epi32 (a_lo, round), 8) ;
+    a_hi = _mm_srai_epi32 (_mm_add_epi32 (a_hi, round), 8) ;
+    return _mm_packus_epi16 (_mm_packs_epi32 (a_lo, a_hi),
+                             _mm_setzero_si128 ()) ;
+}
+
+/*8 pixels per iteration, the remainder goes through the scalar row*/
+__attribute__ ((target ("sse2")))
+static void
+i420_row_to_rgb32_sse2 (const unsigned char *a_y,
+                        const unsigned char *a_u,
+                        const unsigned char *a_v,
+                        unsigned char *a_dst,
+                        unsigned a_width,
+                        enum rgb_order_t a_order)
+{
+    const __m128i zero = _mm_setzero_si128 () ;
+    const __m128i y_offset = _mm_set1_epi16 (16) ;
+    const __m128i uv_offset = _mm_set1_epi16 (128) ;
+    /*pairs of int16 multiplied and summed by _mm_madd_epi16()*/
+    const __m128i cd_to_b = _mm_set_epi16 (516, 298, 516, 298,
+                                           516, 298, 516, 298) ;
+    const __m128i cd_to_g = _mm_set_epi16 (-100, 298, -100, 298,
+                                           -100, 298, -100, 298) ;
+    const __m128i e0_to_g = _mm_set_epi16 (0, -208, 0, -208,
+                                           0, -208, 0, -208) ;
+    const __m128i ce_to_r = _mm_set_epi16 (409, 298, 409, 298,
+                                           409, 298, 409, 298) ;
+    unsigned x=0, n=a_width & ~7u ;
+
+    for (x=0 ; x < n ; x += 8) {
+        __m128i c, d, e, cd_lo, cd_hi, ce_lo, ce_hi, e0_lo, e0_hi ;
+        __m128i b, g, r, bg, rx ;
+        int u4=0, v4=0 ;
+
+        c = _mm_loadl_epi64 ((const __m128i*)(a_y + x)) ;
+        c = _mm_sub_epi16 (_mm_unpacklo_epi8 (c, zero), y_offset) ;
+        memcpy (&u4, a_u + x / 2, 4) ;
+        memcpy (&v4, a_v + x / 2, 4) ;
+        d = _mm_unpacklo_epi8 (_mm_cvtsi32_si128 (u4), zero) ;
+        d = _mm_sub_epi16 (d, uv_offset) ;
+        d = _mm_unpacklo_epi16 (d, d) ;
+        e = _mm_unpacklo_epi8 (_mm_cvtsi32_si128 (v4), zero) ;
+        e = _mm_sub_epi16 (e, uv_offset) ;
+        e = _mm_unpacklo_epi16 (e, e) ;
+
+        cd_lo = _mm_unpacklo_epi16 (c, d) ;
+        cd_hi = _mm_unpackhi_epi16 (c, d) ;
+        ce_lo = _mm_unpacklo_epi16 (c, e) ;
+        ce_hi = _mm_unpackhi_epi16 (c, e) ;
+        e0_lo = _mm_unpacklo_epi16 (e, zero) ;
+        e0_hi = _mm_unpackhi_epi16 (e, zero) ;
+
+        b = sse2_pack_channel (_mm_madd_epi16 (cd_lo, cd_to_b),
+                               _mm_madd_epi16 (cd_hi, cd_to_b)) ;
+        g = sse2_pack_channel
+                (_mm_add_epi32 (_mm_madd_epi16 (cd_lo, cd_to_g),
+                                _mm_madd_epi16 (e0_lo, e0_to_g)),
+                 _mm_add_epi32 (_mm_madd_epi16 (cd_hi, cd_to_g),
+                                _mm_madd_epi16 (e0_hi, e0_to_g))) ;
+        r = sse2_pack_channel (_mm_madd_epi16 (ce_lo, ce_to_r),
+                               _mm_madd_epi16 (ce_hi, ce_to_r)) ;
+
+        if (a_order == RGB_ORDER_RGBX) {
+            bg = _mm_unpacklo_epi8 (r, g) ;
+            rx = _mm_unpacklo_epi8 (b, zero) ;
+        } else {
+            bg = _mm_unpacklo_epi8 (b, g) ;
+            rx = _mm_unpacklo_epi8 (r, zero) ;
+        }
+        _mm_storeu_si128 ((__m128i*)(a_dst + 4 * x),
+                          _mm_unpacklo_epi16 (bg, rx)) ;
+        _mm_storeu_si128 ((__m128i*)(a_dst + 4 * x + 16),
+                          _mm_unpackhi_epi16 (bg, rx)) ;
+    }
+    i420_row_to_rgb32_scalar (a_y + n, a_u + n / 2, a_v + n / 2,
+                              a_dst + 4 * n, a_width - n, a_order) ;
+}
+
+__attribute__ ((target ("avx2")))
+static inline __m256i
+avx2_pack_channel (__m256i a_lo, __m256i a_hi)
+{
+    const __m256i round = _mm256_set1_epi32 (128) ;
+
+    a_lo = _mm256_srai_epi32 (_mm256_add_epi32 (a_lo, round), 8) ;
+    a_hi = _mm256_srai_epi32 (_mm256_add_epi32 (a_hi, round), 8) ;
+    /*packing within each 128 bits lane puts the pixels back in order*/
+    return _mm256_packus_epi16 (_mm256_packs_epi32 (a_lo, a_hi),
+                                _mm256_setzero_si256 ()) ;
+}
+
+/*16 pixels per iteration, the remainder goes through the scalar row*/
+__attribute__ ((target ("avx2")))
+static void
+i420_row_to_rgb32_avx2 (const unsigned char *a_y,
+                        const unsigned char *a_u,
+                        const unsigned char *a_v,
+                        unsigned char *a_dst,
+                        unsigned a_width,
+                        enum rgb_order_t a_order)
+{
+    const __m256i zero = _mm256_setzero_si256 () ;
+    const __m256i y_offset = _mm256_set1_epi16 (16) ;
+    const __m256i uv_offset = _mm256_set1_epi16 (128) ;
+    const __m256i cd_to_b = _mm256_set_epi16 (516, 298, 516, 298,
+                                              516, 298, 516, 298,
+                                              516, 298, 516, 298,
+                                              516, 298, 516, 298) ;
+    const __m256i cd_to_g = _mm256_set_epi16 (-100, 298, -100, 298,
+                                              -100, 298, -100, 298,
+                                              -100, 298, -100, 298,
+                                              -100, 298, -100, 298) ;
+    const __m256i e0_to_g = _mm256_set_epi16 (0, -208, 0, -208,
+                                              0, -208, 0, -208,
+                                              0, -208, 0, -208,
+                                              0, -208, 0, -208) ;
+    const __m256i ce_to_r = _mm256_set_epi16 (409, 298, 409, 298,
+                                              409, 298, 409, 298,
+                                              409, 298, 409, 298,
+                                              409, 298, 409, 298) ;
+    unsigned x=0, n=a_width & ~15u ;
+
+    for (x=0 ; x < n ; x += 16) {
+        __m256i c, d, e, cd_lo, cd_hi, ce_lo, ce_hi, e0_lo, e0_hi ;
+        __m256i b, g, r, bg, rx, lo, hi ;
+        __m128i uv ;
+
+        c = _mm256_cvtepu8_epi16
+                (_mm_loadu_si128 ((const __m128i*)(a_y + x))) ;
+        c = _mm256_sub_epi16 (c, y_offset) ;
+        uv = _mm_loadl_epi64 ((const __m128i*)(a_u + x / 2)) ;
+        d = _mm256_cvtepu8_epi16 (_mm_unpacklo_epi8 (uv, uv)) ;
+        d = _mm256_sub_epi16 (d, uv_offset) ;
+        uv = _mm_loadl_epi64 ((const __m128i*)(a_v + x / 2)) ;
+        e = _mm256_cvtepu8_epi16 (_mm_unpacklo_epi8 (uv, uv)) ;
+        e = _mm256_sub_epi16 (e, uv_offset) ;
+
+        /*
+         * unpacking works within 128 bits lanes: the lo vectors hold
+         * pixels 0-3 and 8-11, the hi ones pixels 4-7 and 12-15.
+         */
+        cd_lo = _mm256_unpacklo_epi16 (c, d) ;
+        cd_hi = _mm256_unpackhi_epi16 (c, d) ;
+        ce_lo = _mm256_unpacklo_epi16 (c, e) ;
+        ce_hi = _mm256_unpackhi_epi16 (c, e) ;
+        e0_lo = _mm256_unpacklo_epi16 (e, zero) ;
+        e0_hi = _mm256_unpackhi_epi16 (e, zero) ;
+
+        b = avx2_pack_channel (_mm256_madd_epi16 (cd_lo, cd_to_b),
+                               _mm256_madd_epi16 (cd_hi, cd_to_b)) ;
+        g = avx2_pack_channel
+                (_mm256_add_epi32 (_mm256_madd_epi16 (cd_lo, cd_to_g),
+                                   _mm256_madd_epi16 (e0_lo, e0_to_g)),
+                 _mm256_add_epi32 (_mm256_madd_epi16 (cd_hi, cd_to_g),
+                                   _mm256_madd_epi16 (e0_hi, e0_to_g))) ;
+        r = avx2_pack_channel (_mm256_madd_epi16 (ce_lo, ce_to_r),
+                               _mm256_madd_epi16 (ce_hi, ce_to_r)) ;
+
+        if (a_order == RGB_ORDER_RGBX) {
+            bg = _mm256_unpacklo_epi8 (r, g) ;
+            rx = _mm256_unpacklo_epi8 (b, zero) ;
+        } else {
+            bg = _mm256_unpacklo_epi8 (b, g) ;
+            rx = _mm256_unpacklo_epi8 (r, zero) ;
+        }
+        /*pixels 0-3 and 8-11, then 4-7 and 12-15*/
+        lo = _mm256_unpacklo_epi16 (bg, rx) ;
+        hi = _mm256_unpackhi_epi16 (bg, rx) ;
+        _mm256_storeu_si256 ((__m256i*)(a_dst + 4 * x),
+                             _mm256_permute2x128_si256 (lo, hi, 0x20)) ;
+        _mm256_storeu_si256 ((__m256i*)(a_dst + 4 * x + 32),
+                             _mm256_permute2x128_si256 (lo, hi, 0x31)) ;
+    }
+    i420_row_to_rgb32_scalar (a_y + n, a_u + n / 2, a_v + n / 2,
+                              a_dst + 4 * n, a_width - n, a_order) ;
+}
+
+#endif /*HAVE_X86_SIMD*/
+
+/**
+ * pick the fastest row converter the CPU supports,
+ * or the scalar one if a_no_simd is set.
+ */
+i420_row_to_rgb32_func_t
+select_i420_row_to_rgb32 (enum bool_t a_no_simd)
+{
+#ifdef HAVE_X86_SIMD
+    if (!a_no_simd) {
+        __builtin_cpu_init () ;
+        if (__builtin_cpu_supports ("avx2")) {
+            LOG ("converting yuv to rgb with AVX2\n") ;
+            return i420_row_to_rgb32_avx2 ;
+        }
+        if (__builtin_cpu_supports ("sse2")) {
+            LOG ("converting yuv to rgb with SSE2\n") ;
+            return i420_row_to_rgb32_sse2 ;
+        }
+    }
+#endif
+    LOG ("converting yuv to rgb with scalar code\n") ;
+    return i420_row_to_rgb32_scalar ;
+}
+
+/**
+ * the row converter called a_name: scalar, sse2 or avx2. NULL if it
+ * is not built in, or if the CPU does not support it. Lets tests run
+ * each of them, where select_i420_row_to_rgb32() picks one.
+ */
+i420_row_to_rgb32_func_t
+lookup_i420_row_to_rgb32 (const char *a_name)
+{
+    RETURN_VAL_IF_FAIL (a_name, NULL) ;
+
+    if (!strcmp (a_name, "scalar")) {
+        return i420_row_to_rgb32_scalar ;
+    }
+#ifdef HAVE_X86_SIMD
+    __builtin_cpu_init () ;
+    if (!strcmp (a_name, "sse2") && __builtin_cpu_supports ("sse2")) {
+        return i420_row_to_rgb32_sse2 ;
+    }
+    if (!strcmp (a_name, "avx2") && __builtin_cpu_supports ("avx2")) {
+        return i420_row_to_rgb32_avx2 ;
+    }
+#endif
+    return NULL ;
+}
+
+/**
+ * convert the I420 frame a_yuv of a_width x a_height pixels into
+ * 32 bits pixels ordered as a_order, a row at a time with a_row_func.
+ * a_dst_stride is the nb of bytes between two lines of a_dst.
+ */
+void
+convert_i420_to_rgb32 (const unsigned char *a_yuv,
+                       unsigned a_width,
+                       unsigned a_height,
+                       unsigned char *a_dst,
+                       unsigned a_dst_stride,
+                       enum rgb_order_t a_order,
+                       i420_row_to_rgb32_func_t a_row_func)
+{
+    const unsigned char *y_plane=NULL, *u_plane=NULL, *v_plane=NULL ;
+    unsigned y=0 ;
+
+    RETURN_IF_FAIL (a_yuv && a_dst && a_row_func) ;
+
+    y_plane = a_yuv ;
+    u_plane = y_plane + a_width * a_height ;
+    v_plane = u_plane + (a_width / 2) * (a_height / 2) ;
+    for (y=0 ; y < a_height ; y++) {
+        a_row_func (y_plane + y * a_width,
+                    u_plane + (y / 2) * (a_width / 2),
+                    v_plane + (y / 2) * (a_width / 2),
+                    a_dst + y * a_dst_stride,
+                    a_width, a_order) ;
+    }
+}
+
+/*************************
+ * </yuv to rgb>
+ * ***********************/
@@ -0,0 +1,980 @@
+/*
+ * Copyright (C) 2007 OpenedHand Ltd
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * Author:
+ *   Dodji Seketeli <dodji@openedhand.com>
+ */
+
+#include "xvplay-private.h"
+
+/*XvGrabPort succeeds on ports we already hold, so remember them*/
+static XvPortID grabbed_xv_ports[MAX_STREAMS] ;
+static int nb_grabbed_xv_ports=0 ;
+static enum bool_t shm_attach_failed=FALSE ;
+
+/*************************
+ * <yuv stuff>
+ * ***********************/
+
+enum bool_t
+compute_yuv_image_size (enum yuv_format_t a_yuv_format,
+                        unsigned a_width,
+                        unsigned a_height,
+                        unsigned *a_len)
+{
+    const struct yuv_format_info_t *info=NULL ;
+
+    RETURN_VAL_IF_FAIL (a_len, FALSE) ;
+
+    info = yuv_format_get_info (a_yuv_format) ;
+    if (!info) {
+        LOG_ERROR ("unsupported format: %d\n", a_yuv_format) ;
+        return FALSE ;
+    }
+    switch (info->layout) {
+        case YUV_LAYOUT_PLANAR:
+            *a_len = a_width * a_height
+                + 2 * (a_width / 2) * (a_height >> info->chroma_y_shift) ;
+            break ;
+        case YUV_LAYOUT_SEMI_PLANAR:
+            *a_len = a_width * a_height
+                + a_width * (a_height >> info->chroma_y_shift) ;
+            break ;
+        case YUV_LAYOUT_PACKED:
+            *a_len = 2 * a_width * a_height ;
+            break ;
+    }
+    return TRUE ;
+}
+
+/**
+ * read the next frame of a_input into a_frame,
+ * which memory comes from a frame_pool_t.
+ */
+enum bool_t
+read_next_yuv_image_of_size_and_format (FILE *a_input,
+                                        unsigned a_width,
+                                        unsigned a_height,
+                                        enum yuv_format_t a_yuv_format,
+                                        struct frame_t *a_frame)
+{
+    unsigned nb_to_read=0 ;
+
+    RETURN_VAL_IF_FAIL (a_input && a_frame, FALSE) ;
+
+    if (!compute_yuv_image_size (a_yuv_format, a_width,
+                                 a_height, &nb_to_read)) {
+        LOG_ERROR ("failed to compute image size\n") ;
+        return FALSE ;
+    }
+    RETURN_VAL_IF_FAIL (nb_to_read, FALSE) ;
+
+    if (nb_to_read > a_frame->capacity) {
+        LOG_ERROR ("frame buffer of %d bytes can't hold %d bytes\n",
+                   a_frame->capacity, nb_to_read) ;
+        return FALSE ;
+    }
+    if (!read_next_yuv_image_into_buffer (a_input,
+                                          a_frame->buf,
+                                          nb_to_read)) {
+        return FALSE ;
+    }
+    a_frame->data = a_frame->buf ;
+    a_frame->len = nb_to_read ;
+    return TRUE ;
+}
+
+/**
+ * read the next a_len bytes of a_input into a_buf,
+ * which must be at least a_len bytes long.
+ * This lets the caller read a frame straight into the
+ * memory it will hand to the XServer, e.g. a SHM segment.
+ */
+enum bool_t
+read_next_yuv_image_into_buffer (FILE *a_input,
+                                 char *a_buf,
+                                 unsigned a_len)
+{
+    unsigned nb_read=0 ;
+
+    RETURN_VAL_IF_FAIL (a_input && a_buf && a_len, FALSE) ;
+
+    LOG_FRAME ("reading image of %d bytes ...\n", a_len) ;
+    nb_read = fread (a_buf, 1, a_len, a_input) ;
+    if (nb_read != a_len) {
+        LOG_ERROR ("unexpected end of file\n") ;
+        return FALSE ;
+    }
+    LOG_FRAME ("image read ok\n") ;
+    return TRUE ;
+}
+
+/**
+ * tells whether the planes of a_xv_image are laid out exactly like
+ * a frame of a_format in a yuv file, i.e. whether XvPutImage can
+ * read a frame right where it sits in the file.
+ */
+enum bool_t
+xv_image_matches_yuv_layout (const XvImage *a_xv_image,
+                             enum yuv_format_t a_format,
+                             unsigned a_width,
+                             unsigned a_height)
+{
+    const struct yuv_format_info_t *info=NULL ;
+    unsigned frame_len=0, luma_len=0 ;
+    int nb_planes=0, pitches[3], offsets[3], i=0 ;
+
+    RETURN_VAL_IF_FAIL (a_xv_image, FALSE) ;
+
+    info = yuv_format_get_info (a_format) ;
+    if (!info
+        || !compute_yuv_image_size (a_format, a_width,
+                                    a_height, &frame_len)) {
+        return FALSE ;
+    }
+    luma_len = a_width * a_height ;
+    switch (info->layout) {
+        case YUV_LAYOUT_PLANAR:
+            nb_planes = 3 ;
+            pitches[0] = a_width ;
+            pitches[1] = pitches[2] = a_width / 2 ;
+            offsets[0] = 0 ;
+            offsets[1] = luma_len ;
+            offsets[2] = luma_len
+                + (a_width / 2) * (a_height >> info->chroma_y_shift) ;
+            break ;
+        case YUV_LAYOUT_SEMI_PLANAR:
+            nb_planes = 2 ;
+            pitches[0] = pitches[1] = a_width ;
+            offsets[0] = 0 ;
+            offsets[1] = luma_len ;
+            break ;
+        case YUV_LAYOUT_PACKED:
+            nb_planes = 1 ;
+            pitches[0] = 2 * a_width ;
+            offsets[0] = 0 ;
+            break ;
+    }
+    if (a_xv_image->num_planes != nb_planes
+        || (unsigned)a_xv_image->data_size > frame_len) {
+        return FALSE ;
+    }
+    for (i=0 ; i < nb_planes ; i++) {
+        if (a_xv_image->pitches[i] != pitches[i]
+            || a_xv_image->offsets[i] != offsets[i]) {
+            return FALSE ;
+        }
+    }
+    return TRUE ;
+}
+
+/**
+ * tells whether the images a_xv_port creates for frames of a_format
+ * are laid out like the frames in a yuv file.
+ */
+enum bool_t
+xv_port_matches_yuv_layout (Display *a_display,
+                            XvPortID a_xv_port,
+                            enum yuv_format_t a_format,
+                            unsigned a_width,
+                            unsigned a_height)
+{
+    XvImage *xv_image=NULL ;
+    enum bool_t is_ok=FALSE ;
+
+    RETURN_VAL_IF_FAIL (a_display && yuv_format_get_info (a_format), FALSE) ;
+
+    xv_image = XvCreateImage (a_display, a_xv_port,
+                              yuv_format_get_info (a_format)->fourcc,
+                              NULL, a_width, a_height) ;
+    if (!xv_image) {
+        return FALSE ;
+    }
+    is_ok = xv_image_matches_yuv_layout (xv_image, a_format,
+                                         a_width, a_height) ;
+    XFree (xv_image) ;
+    return is_ok ;
+}
+
+/**
+ * tells whether a_xv_port shows the src rectangle of a_geometry at
+ * the size of its dst rectangle, rather than at the best size it
+ * can manage.
+ */
+enum bool_t
+xv_port_can_scale (Display *a_display,
+                   XvPortID a_xv_port,
+                   const struct sink_geometry_t *a_geometry)
+{
+    unsigned width=0, height=0 ;
+
+    RETURN_VAL_IF_FAIL (a_display && a_geometry, FALSE) ;
+
+    if (XvQueryBestSize (a_display, a_xv_port, False,
+                         a_geometry->src_width, a_geometry->src_height,
+                         a_geometry->dst_width, a_geometry->dst_height,
+                         &width, &height) != Success) {
+        return FALSE ;
+    }
+    return width == (unsigned)a_geometry->dst_width
+           && height == (unsigned)a_geometry->dst_height ;
+}
+
+static enum bool_t
+is_xv_port_grabbed (XvPortID a_port)
+{
+    int i=0 ;
+
+    for (i=0 ; i < nb_grabbed_xv_ports ; i++) {
+        if (grabbed_xv_ports[i] == a_port) {
+            return TRUE ;
+        }
+    }
+    return FALSE ;
+}
+
+/**
+ * ungrab a port got from get_xv_port(), so that it can be
+ * handed out again.
+ */
+void
+release_xv_port (Display *a_display, XvPortID a_port)
+{
+    int i=0 ;
+
+    RETURN_IF_FAIL (a_display) ;
+
+    XvUngrabPort (a_display, a_port, CurrentTime) ;
+    for (i=0 ; i < nb_grabbed_xv_ports ; i++) {
+        if (grabbed_xv_ports[i] == a_port) {
+            grabbed_xv_ports[i] = grabbed_xv_ports[--nb_grabbed_xv_ports] ;
+            break ;
+        }
+    }
+}
+
+/**
+ * grab the first port able to put images which no other stream
+ * of ours holds. It must be given back with release_xv_port().
+ */
+enum bool_t
+get_xv_port (Display *a_display, Drawable a_drawable, XvPortID *a_port)
+{
+    enum bool_t result=FALSE ;
+    XvAdaptorInfo *adaptor_infos=NULL ;
+    int nb_adaptors=0, i=0 ;
+
+    RETURN_VAL_IF_FAIL (a_display && a_port, FALSE) ;
+
+    if (XvQueryAdaptors (a_display, a_drawable,
+                         &nb_adaptors, &adaptor_infos) != Success) {
+        LOG_ERROR ("XvQueryAdaptors failed\n") ;
+        goto out ;
+    }
+    LOG ("got %d adaptors\n", nb_adaptors) ;
+
+    for (i=0; i<nb_adaptors;i++) {
+        /*
+         * get the first adaptor that supports
+         * video input and image puting
+         */
+        if ((adaptor_infos[i].type & (XvInputMask|XvImageMask))
+            == (XvInputMask|XvImageMask)) {
+            XvPortID p = 0 ;
+            /*get the first port that we can grab*/
+            for (p = adaptor_infos[i].base_id ;
+                 p < adaptor_infos[i].base_id + adaptor_infos[i].num_ports;
+                 p++) {
+                if (is_xv_port_grabbed (p)) {
+                    continue ;
+                }
+                if (nb_grabbed_xv_ports >= MAX_STREAMS) {
+                    LOG_ERROR ("too many grabbed ports\n") ;
+                    goto out ;
+                }
+                if (XvGrabPort (a_display, p, CurrentTime) == Success) {
+                    grabbed_xv_ports[nb_grabbed_xv_ports++] = p ;
+                    *a_port = p ;
+                    result = TRUE ;
+                    goto out ;
+                } else {
+                    LOG_ERROR ("failed to grab port: %d\n", p) ;
+                }
+            }
+        }
+    }
+
+out:
+    if (adaptor_infos) {
+        XvFreeAdaptorInfo (adaptor_infos) ;
+        adaptor_infos = NULL ;
+    }
+    return result ;
+}
+
+#ifdef HAVE_XCB_XV
+
+/**
+ * what get_xv_port(), choose_xv_image_format(), xv_port_can_scale()
+ * and xv_port_matches_yuv_layout() find out, through XCB: one round
+ * trip for the adaptors, then one for the formats, attributes, sizes
+ * and layouts of all of them, which requests are all sent before the
+ * first reply is waited for. Only then is a port grabbed, on the first
+ * adaptor which has a format for us, one port at a time like
+ * get_xv_port() does, so that no other client is refused a port we
+ * end up not using. The port must be given back with release_xv_port().
+ */
+enum bool_t
+xcb_probe_xv_port (Display *a_display,
+                   Window a_window,
+                   enum yuv_format_t a_format,
+                   unsigned a_width,
+                   unsigned a_height,
+                   const struct sink_geometry_t *a_geometry,
+                   struct xv_port_probe_t *a_probe)
+{
+    const struct yuv_format_info_t *info=NULL, *target=NULL ;
+    xcb_connection_t *connection=NULL ;
+    xcb_xv_query_adaptors_reply_t *adaptors=NULL ;
+    xcb_xv_adaptor_info_iterator_t it ;
+    struct {
+        xcb_xv_port_t base_port ;
+        int nb_ports ;
+        xcb_xv_list_image_formats_cookie_t formats ;
+        xcb_xv_query_port_attributes_cookie_t attributes ;
+        xcb_xv_query_best_size_cookie_t best_size ;
+        xcb_xv_query_image_attributes_cookie_t layouts[YUV_NB_FORMATS] ;
+        int nb_layouts ;
+        enum yuv_format_t image_format ;/*UNDEF if it has none for us*/
+        int layout_index ;/*of image_format among the layouts*/
+        enum bool_t can_scale ;
+        enum bool_t matches_layout ;
+        int nb_attributes ;
+    } adaptor_probes[XCB_MAX_PROBED_ADAPTORS] ;
+    xcb_xv_list_image_formats_reply_t *formats=NULL ;
+    xcb_xv_image_format_info_t *format_infos=NULL ;
+    xcb_xv_query_port_attributes_reply_t *attributes=NULL ;
+    xcb_xv_query_best_size_reply_t *best_size=NULL ;
+    xcb_xv_query_image_attributes_reply_t *layout=NULL ;
+    xcb_xv_grab_port_reply_t *grab=NULL ;
+    xcb_generic_error_t *error=NULL ;
+    int nb_adaptors=0, nb_formats=0, i=0, j=0, k=0 ;
+    int picked=-1 ;
+    xcb_xv_port_t port=0 ;
+    enum bool_t is_grabbed=FALSE ;
+    int64_t start=0 ;
+
+    RETURN_VAL_IF_FAIL (a_display && a_geometry && a_probe, FALSE) ;
+    info = yuv_format_get_info (a_format) ;
+    RETURN_VAL_IF_FAIL (info, FALSE) ;
+
+    memset (a_probe, 0, sizeof (struct xv_port_probe_t)) ;
+    start = get_monotonic_ns () ;
+    connection = XGetXCBConnection (a_display) ;
+    /*the requests Xlib holds, e.g. the window creation, go first*/
+    XFlush (a_display) ;
+
+    adaptors = xcb_xv_query_adaptors_reply
+                    (connection,
+                     xcb_xv_query_adaptors (connection, a_window), &error) ;
+    a_probe->nb_round_trips++ ;
+    if (!adaptors) {
+        LOG_ERROR ("xcb_xv_query_adaptors failed\n") ;
+        free (error) ;
+        return FALSE ;
+    }
+    LOG ("got %d adaptors\n", adaptors->num_adaptors) ;
+
+    for (it = xcb_xv_query_adaptors_info_iterator (adaptors) ;
+         it.rem && nb_adaptors < XCB_MAX_PROBED_ADAPTORS ;
+         xcb_xv_adaptor_info_next (&it)) {
+        const xcb_xv_adaptor_info_t *adaptor = it.data ;
+
+        if ((adaptor->type & (XCB_XV_TYPE_INPUT_MASK|XCB_XV_TYPE_IMAGE_MASK))
+            != (XCB_XV_TYPE_INPUT_MASK|XCB_XV_TYPE_IMAGE_MASK)) {
+            continue ;
+        }
+        memset (&adaptor_probes[nb_adaptors], 0,
+                sizeof (adaptor_probes[nb_adaptors])) ;
+        /*the ports of an adaptor share its formats*/
+        port = adaptor->base_id ;
+        adaptor_probes[nb_adaptors].base_port = port ;
+        adaptor_probes[nb_adaptors].nb_ports = adaptor->num_ports ;
+        adaptor_probes[nb_adaptors].formats =
+                            xcb_xv_list_image_formats (connection, port) ;
+        adaptor_probes[nb_adaptors].attributes =
+                            xcb_xv_query_port_attributes (connection, port) ;
+        adaptor_probes[nb_adaptors].best_size =
+                            xcb_xv_query_best_size (connection, port,
+                                                    a_geometry->src_width,
+                                                    a_geometry->src_height,
+                                                    a_geometry->dst_width,
+                                                    a_geometry->dst_height,
+                                                    0) ;
+        /*the layout of the format we may end up with is only needed then*/
+        for (j=0 ; j < YUV_NB_FORMATS && info->conversions[j] ; j++) {
+            target = yuv_format_get_info (info->conversions[j]) ;
+            adaptor_probes[nb_adaptors].layouts[j] =
+                        xcb_xv_query_image_attributes (connection, port,
+                                                       target->fourcc,
+                                                       a_width, a_height) ;
+        }
+        adaptor_probes[nb_adaptors].nb_layouts = j ;
+        nb_adaptors++ ;
+    }
+    free (adaptors) ;
+    adaptors = NULL ;
+
+    /*all the requests went out, only the first reply waits*/
+    a_probe->nb_round_trips++ ;
+    for (i=0 ; i < nb_adaptors ; i++) {
+        adaptor_probes[i].image_format = YUV_FORMAT_UNDEF ;
+        formats = xcb_xv_list_image_formats_reply
+                            (connection, adaptor_probes[i].formats, &error) ;
+        free (error) ;
+        error = NULL ;
+        format_infos = formats ? xcb_xv_list_image_formats_format (formats)
+                               : NULL ;
+        nb_formats = formats
+                     ? xcb_xv_list_image_formats_format_length (formats) : 0 ;
+        for (j=0 ; j < adaptor_probes[i].nb_layouts
+                   && adaptor_probes[i].image_format == YUV_FORMAT_UNDEF ;
+             j++) {
+            target = yuv_format_get_info (info->conversions[j]) ;
+            for (k=0 ; k < nb_formats ; k++) {
+                if (format_infos[k].type == XCB_XV_IMAGE_FORMAT_INFO_TYPE_YUV
+                    && format_infos[k].id == (uint32_t)target->fourcc) {
+                    adaptor_probes[i].image_format = target->format ;
+                    adaptor_probes[i].layout_index = j ;
+                    break ;
+                }
+            }
+        }
+        free (formats) ;
+        formats = NULL ;
+
+        attributes = xcb_xv_query_port_attributes_reply
+                            (connection, adaptor_probes[i].attributes, &error) ;
+        free (error) ;
+        error = NULL ;
+        if (attributes) {
+            adaptor_probes[i].nb_attributes = attributes->num_attributes ;
+            free (attributes) ;
+        }
+        best_size = xcb_xv_query_best_size_reply
+                            (connection, adaptor_probes[i].best_size, &error) ;
+        free (error) ;
+        error = NULL ;
+        if (best_size) {
+            adaptor_probes[i].can_scale =
+                best_size->actual_width == a_geometry->dst_width
+                && best_size->actual_height == a_geometry->dst_height ;
+            free (best_size) ;
+        }
+        /*every reply must be read, so that none is left queued*/
+        for (j=0 ; j < adaptor_probes[i].nb_layouts ; j++) {
+            layout = xcb_xv_query_image_attributes_reply
+                            (connection, adaptor_probes[i].layouts[j], &error) ;
+            free (error) ;
+            error = NULL ;
+            if (layout
+                && adaptor_probes[i].image_format != YUV_FORMAT_UNDEF
+                && j == adaptor_probes[i].layout_index) {
+                XvImage image ;
+                int pitches[3], offsets[3] ;
+                uint32_t *layout_pitches=NULL, *layout_offsets=NULL ;
+
+                memset (&image, 0, sizeof (image)) ;
+                image.num_planes = layout->num_planes ;
+                image.data_size = layout->data_size ;
+                image.pitches = pitches ;
+                image.offsets = offsets ;
+                layout_pitches = xcb_xv_query_image_attributes_pitches (layout) ;
+                layout_offsets = xcb_xv_query_image_attributes_offsets (layout) ;
+                for (k=0 ; k < 3 ; k++) {
+                    pitches[k] = k < (int)layout->num_planes
+                                 ? (int)layout_pitches[k] : 0 ;
+                    offsets[k] = k < (int)layout->num_planes
+                                 ? (int)layout_offsets[k] : 0 ;
+                }
+                adaptor_probes[i].matches_layout =
+                    image.num_planes <= 3
+                    && xv_image_matches_yuv_layout
+                            (&image, adaptor_probes[i].image_format,
+                             a_width, a_height) ;
+            }
+            free (layout) ;
+        }
+    }
+
+    /*
+     * grab the first free port of the adaptors we can use, in the
+     * order get_xv_port() tries them. A port another client holds
+     * is no error, the next one is tried.
+     */
+    for (i=0 ; i < nb_adaptors && !is_grabbed ; i++) {
+        if (adaptor_probes[i].image_format == YUV_FORMAT_UNDEF) {
+            continue ;
+        }
+        for (port = adaptor_probes[i].base_port ;
+             port < adaptor_probes[i].base_port + adaptor_probes[i].nb_ports ;
+             port++) {
+            if (is_xv_port_grabbed (port)) {
+                continue ;
+            }
+            if (nb_grabbed_xv_ports >= MAX_STREAMS) {
+                LOG_ERROR ("too many grabbed ports\n") ;
+                return FALSE ;
+            }
+            grab = xcb_xv_grab_port_reply
+                        (connection,
+                         xcb_xv_grab_port (connection, port, XCB_CURRENT_TIME),
+                         &error) ;
+            a_probe->nb_round_trips++ ;
+            free (error) ;
+            error = NULL ;
+            is_grabbed = grab
+                         && grab->result == XCB_XV_GRAB_PORT_STATUS_SUCCESS ;
+            free (grab) ;
+            if (is_grabbed) {
+                picked = i ;
+                break ;
+            }
+        }
+    }
+    a_probe->probe_ns = get_monotonic_ns () - start ;
+    if (picked < 0) {
+        LOG_ERROR ("no free xv port supports a format %s frames "
+                   "can be repacked to\n", info->name) ;
+        return FALSE ;
+    }
+    grabbed_xv_ports[nb_grabbed_xv_ports++] = port ;
+    a_probe->port = port ;
+    a_probe->image_format = adaptor_probes[picked].image_format ;
+    a_probe->can_scale = adaptor_probes[picked].can_scale ;
+    a_probe->matches_layout = adaptor_probes[picked].matches_layout ;
+    a_probe->nb_attributes = adaptor_probes[picked].nb_attributes ;
+    LOG ("probed %d adaptors in %d round trips, %.3f ms\n",
+         nb_adaptors, a_probe->nb_round_trips, a_probe->probe_ns / 1e6) ;
+    return TRUE ;
+}
+
+#endif /*HAVE_XCB_XV*/
+
+enum bool_t
+get_xv_supported_image_formats (Display *a_display,
+                                XvPortID a_xv_port,
+                                XvImageFormatValues **a_formats,
+                                int *a_nb_formats)
+{
+    XvImageFormatValues *image_formats=NULL ;
+    int nb_formats=0, i=0 ;
+
+    image_formats = XvListImageFormats (a_display, a_xv_port, &nb_formats) ;
+    if (!image_formats) {
+        return FALSE ;
+    }
+    LOG_ERROR ("XServer supports %d formats\n", nb_formats) ;
+    for (i=0 ; i < nb_formats ; i++) {
+        LOG ("format id: %#x", image_formats[i]) ;
+    }
+    XFree (image_formats) ;
+    return TRUE ;
+}
+
+enum bool_t
+lookup_image_format (Display *a_display,
+                     XvPortID a_xv_port,
+                     int a_format,
+                     XvImageFormatValues *a_image_format)
+{
+    XvImageFormatValues *image_formats=NULL ;
+    int nb_formats=0, i=0 ;
+    enum bool_t is_ok=FALSE ;
+
+    RETURN_VAL_IF_FAIL (a_display && a_image_format, FALSE) ;
+
+    image_formats = XvListImageFormats (a_display, a_xv_port, &nb_formats) ;
+    if (!image_formats) {
+        goto out ;
+    }
+    for (i=0 ; i < nb_formats ; i++) {
+        if (image_formats[i].id == a_format) {
+            memcpy (a_image_format,
+                    &image_formats[i],
+                    sizeof (XvImageFormatValues)) ;
+            is_ok = TRUE ;
+            break ;
+        }
+    }
+
+out:
+    if (image_formats) {
+        XFree (image_formats) ;
+    }
+    return is_ok ;
+}
+
+static int
+shm_error_handler (Display *a_display, XErrorEvent *a_event)
+{
+    shm_attach_failed = TRUE ;
+    return 0 ;
+}
+
+/**
+ * tells whether frames can be handed to the XServer through
+ * MIT-SHM segments. That requires the extension and a server
+ * that runs on the same host as us; the latter is only known
+ * for sure once XShmAttach() has been tried, so
+ * create_shm_xv_image() can still fail after this returned TRUE.
+ */
+enum bool_t
+can_use_shm (Display *a_display)
+{
+    char *display_name=NULL ;
+
+    RETURN_VAL_IF_FAIL (a_display, FALSE) ;
+
+    if (!XShmQueryExtension (a_display)) {
+        LOG ("XServer does not support MIT-SHM\n") ;
+        return FALSE ;
+    }
+    /*
+     * a display name like "host:0" designates a remote server,
+     * which can't see our SHM segments.
+     */
+    display_name = DisplayString (a_display) ;
+    if (display_name
+        && display_name[0] != ':'
+        && strncmp (display_name, "unix:", 5)
+        && strncmp (display_name, "localhost:", 10)) {
+        LOG ("display '%s' looks remote, not using MIT-SHM\n", display_name) ;
+        return FALSE ;
+    }
+    return TRUE ;
+}
+
+/**
+ * create a SHM segment of a_size bytes and have the XServer
+ * attach it.
+ * returns FALSE if either fails, e.g. because the server is remote,
+ * in which case nothing needs to be released.
+ */
+enum bool_t
+attach_shm_segment (Display *a_display,
+                    XShmSegmentInfo *a_shm_info,
+                    unsigned a_size)
+{
+    int (*old_error_handler) (Display*, XErrorEvent*)=NULL ;
+
+    RETURN_VAL_IF_FAIL (a_display && a_shm_info && a_size, FALSE) ;
+
+    a_shm_info->shmid = shmget (IPC_PRIVATE, a_size, IPC_CREAT|0600) ;
+    if (a_shm_info->shmid < 0) {
+        LOG_ERROR ("failed to create a SHM segment of %d bytes\n", a_size) ;
+        return FALSE ;
+    }
+    a_shm_info->shmaddr = shmat (a_shm_info->shmid, NULL, 0) ;
+    if (a_shm_info->shmaddr == (char*)-1) {
+        LOG_ERROR ("failed to attach SHM segment\n") ;
+        shmctl (a_shm_info->shmid, IPC_RMID, NULL) ;
+        a_shm_info->shmid = -1 ;
+        return FALSE ;
+    }
+    a_shm_info->readOnly = False ;
+
+    /*
+     * a remote or sandboxed server fails the attach with an
+     * asynchronous X error, so trap it and sync to get it now.
+     */
+    shm_attach_failed = FALSE ;
+    XSync (a_display, False) ;
+    old_error_handler = XSetErrorHandler (shm_error_handler) ;
+    XShmAttach (a_display, a_shm_info) ;
+    XSync (a_display, False) ;
+    XSetErrorHandler (old_error_handler) ;
+
+    /*
+     * mark the segment for destruction right away, so that
+     * it does not outlive us if we crash.
+     */
+    shmctl (a_shm_info->shmid, IPC_RMID, NULL) ;
+
+    if (shm_attach_failed) {
+        LOG ("XServer could not attach the SHM segment\n") ;
+        shmdt (a_shm_info->shmaddr) ;
+        a_shm_info->shmaddr = (char*)-1 ;
+        a_shm_info->shmid = -1 ;
+        return FALSE ;
+    }
+    return TRUE ;
+}
+
+void
+detach_shm_segment (Display *a_display, XShmSegmentInfo *a_shm_info)
+{
+    RETURN_IF_FAIL (a_display && a_shm_info) ;
+
+    XShmDetach (a_display, a_shm_info) ;
+    XSync (a_display, False) ;
+    shmdt (a_shm_info->shmaddr) ;
+    a_shm_info->shmaddr = (char*)-1 ;
+    a_shm_info->shmid = -1 ;
+}
+
+/**
+ * create an XvImage which data lives in a SHM segment
+ * shared with the XServer.
+ * returns NULL if the segment could not be created or attached,
+ * in which case the caller should fall back to XvPutImage.
+ * the result must be released with destroy_shm_xv_image().
+ */
+XvImage*
+create_shm_xv_image (Display *a_display,
+                     XvPortID a_xv_port,
+                     int a_format,
+                     int a_width,
+                     int a_height,
+                     XShmSegmentInfo *a_shm_info)
+{
+    XvImage *xv_image=NULL ;
+
+    RETURN_VAL_IF_FAIL (a_display && a_shm_info, NULL) ;
+
+    memset (a_shm_info, 0, sizeof (XShmSegmentInfo)) ;
+    a_shm_info->shmid = -1 ;
+    a_shm_info->shmaddr = (char*)-1 ;
+
+    xv_image = XvShmCreateImage (a_display, a_xv_port, a_format, NULL,
+                                 a_width, a_height, a_shm_info) ;
+    if (!xv_image) {
+        LOG_ERROR ("XvShmCreateImage failed\n") ;
+        return NULL ;
+    }
+    if (!attach_shm_segment (a_display, a_shm_info, xv_image->data_size)) {
+        XFree (xv_image) ;
+        return NULL ;
+    }
+    xv_image->data = a_shm_info->shmaddr ;
+    return xv_image ;
+}
+
+void
+destroy_shm_xv_image (Display *a_display,
+                      XvImage *a_xv_image,
+                      XShmSegmentInfo *a_shm_info)
+{
+    RETURN_IF_FAIL (a_display && a_xv_image && a_shm_info) ;
+
+    detach_shm_segment (a_display, a_shm_info) ;
+    XFree (a_xv_image) ;
+}
+
+/**
+ * frame_alloc_func_t of the Xv sink, giving a frame an XvImage
+ * created once.
+ * In SHM mode the frame buffer is the SHM segment of the image,
+ * otherwise it is a page aligned buffer the image points to.
+ * If frames must be uploaded, the frame buffer is a separate page
+ * aligned buffer, and the image has its own memory.
+ */
+enum bool_t
+xv_frame_alloc (struct frame_pool_t *a_pool,
+                struct frame_t *a_frame)
+{
+    struct xv_sink_t *sink=NULL ;
+    unsigned len=0 ;
+    int fourcc=0 ;
+    void *data=NULL ;
+
+    RETURN_VAL_IF_FAIL (a_pool && a_pool->user_data && a_frame, FALSE) ;
+
+    sink = a_pool->user_data ;
+    fourcc = yuv_format_get_info (sink->image_format)->fourcc ;
+    if (sink->needs_upload
+        && !frame_alloc_aligned (a_pool, a_frame, a_pool->frame_len)) {
+        return FALSE ;
+    }
+    if (sink->use_shm) {
+        a_frame->xv_image = create_shm_xv_image (sink->base.display,
+                                                 sink->xv_port,
+                                                 fourcc,
+                                                 sink->base.image_width,
+                                                 sink->base.image_height,
+                                                 &a_frame->shm_info) ;
+        if (a_frame->xv_image
+            && !sink->needs_upload
+            && (unsigned)a_frame->xv_image->data_size < a_pool->frame_len) {
+            LOG_ERROR ("SHM image is smaller than a frame\n") ;
+            destroy_shm_xv_image (sink->base.display,
+                                  a_frame->xv_image,
+                                  &a_frame->shm_info) ;
+            a_frame->xv_image = NULL ;
+        }
+        if (a_frame->xv_image) {
+            a_frame->has_shm = TRUE ;
+            if (sink->needs_upload) {
+                a_pool->nb_allocated_bytes += a_frame->xv_image->data_size ;
+                return TRUE ;
+            }
+            a_frame->buf = a_frame->xv_image->data ;
+            a_frame->data = a_frame->buf ;
+            a_frame->capacity = a_frame->xv_image->data_size ;
+            a_frame->memory = FRAME_MEMORY_SHM ;
+            /*frames must be copied into the segments*/
+            sink->base.zero_copy = FALSE ;
+            a_pool->nb_allocs++ ;
+            a_pool->nb_allocated_bytes += a_frame->capacity ;
+            return TRUE ;
+        }
+        /*no need to try again for the next frames*/
+        LOG ("falling back to XvPutImage\n") ;
+        sink->use_shm = FALSE ;
+    }
+
+    a_frame->xv_image = (XvImage*) XvCreateImage (sink->base.display,
+                                                  sink->xv_port,
+                                                  fourcc,
+                                                  NULL,
+                                                  sink->base.image_width,
+                                                  sink->base.image_height) ;
+    if (!a_frame->xv_image) {
+        LOG_ERROR ("failed to create image\n") ;
+        goto error ;
+    }
+    if (sink->needs_upload) {
+        if (posix_memalign (&data, 64, a_frame->xv_image->data_size)) {
+            LOG_ERROR ("failed to allocate %d bytes\n",
+                       a_frame->xv_image->data_size) ;
+            goto error ;
+        }
+        a_frame->xv_image->data = data ;
+        a_pool->nb_allocated_bytes += a_frame->xv_image->data_size ;
+        return TRUE ;
+    }
+    /*XvPutImage sends data_size bytes, which can be more than a frame*/
+    len = a_pool->frame_len ;
+    if ((unsigned)a_frame->xv_image->data_size > len) {
+        len = a_frame->xv_image->data_size ;
+    }
+    if (!frame_alloc_aligned (a_pool, a_frame, len)) {
+        goto error ;
+    }
+    a_frame->xv_image->data = a_frame->buf ;
+    return TRUE ;
+
+error:
+    if (a_frame->xv_image) {
+        XFree (a_frame->xv_image) ;
+        a_frame->xv_image = NULL ;
+    }
+    frame_free_aligned (a_pool, a_frame) ;
+    return FALSE ;
+}
+
+void
+xv_frame_free (struct frame_pool_t *a_pool,
+               struct frame_t *a_frame)
+{
+    struct xv_sink_t *sink=NULL ;
+
+    RETURN_IF_FAIL (a_pool && a_pool->user_data && a_frame) ;
+
+    sink = a_pool->user_data ;
+    if (!a_frame->xv_image) {
+        return ;
+    }
+    if (a_frame->has_shm) {
+        wait_for_shm_completion (sink->base.display, a_frame) ;
+        destroy_shm_xv_image (sink->base.display,
+                              a_frame->xv_image,
+                              &a_frame->shm_info) ;
+        a_frame->has_shm = FALSE ;
+        if (a_frame->memory == FRAME_MEMORY_SHM) {
+            /*the frame buffer was the segment*/
+            a_frame->buf = NULL ;
+            a_frame->data = NULL ;
+            a_frame->memory = FRAME_MEMORY_NONE ;
+        }
+    } else {
+        if (sink->needs_upload) {
+            free (a_frame->xv_image->data) ;
+        }
+        XFree (a_frame->xv_image) ;
+    }
+    a_frame->xv_image = NULL ;
+    frame_free_aligned (a_pool, a_frame) ;
+}
+
+/*the type of the MIT-SHM completion events, once queried*/
+static int shm_completion_type=-1 ;
+
+/**
+ * the type of the MIT-SHM completion events of a_display, queried the
+ * first time, or -1 if it has no MIT-SHM. With a NULL a_display,
+ * the type queried so far.
+ */
+int
+get_shm_completion_type (Display *a_display)
+{
+    if (shm_completion_type < 0 && a_display
+        && XShmQueryExtension (a_display)) {
+        shm_completion_type = XShmGetEventBase (a_display) + ShmCompletion ;
+    }
+    return shm_completion_type ;
+}
+
+static Bool
+is_shm_completion_of_frame (Display *a_display,
+                            XEvent *a_event,
+                            XPointer a_frame)
+{
+    struct frame_t *frame = (struct frame_t*)a_frame ;
+
+    return a_event->type == shm_completion_type
+        && ((XShmCompletionEvent*)a_event)->shmseg == frame->shm_info.shmseg ;
+}
+
+/**
+ * block until the XServer tells us it is done reading the
+ * SHM segment of a_frame, leaving the other events queued.
+ */
+void
+wait_for_shm_completion (Display *a_display, struct frame_t *a_frame)
+{
+    XEvent event ;
+
+    RETURN_IF_FAIL (a_frame) ;
+
+    if (!a_frame->shm_pending) {
+        return ;
+    }
+    RETURN_IF_FAIL (a_display) ;
+    if (get_shm_completion_type (a_display) < 0) {
+        LOG_ERROR ("no MIT-SHM to wait for\n") ;
+        a_frame->shm_pending = FALSE ;
+        return ;
+    }
+    XIfEvent (a_display, &event,
+              is_shm_completion_of_frame, (XPointer)a_frame) ;
+    a_frame->shm_pending = FALSE ;
+}
+
+/*************************
+ * </yuv stuff>
+ * ***********************/